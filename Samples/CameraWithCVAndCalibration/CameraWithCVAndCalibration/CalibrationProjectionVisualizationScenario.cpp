@@ -377,7 +377,10 @@ void CalibrationProjectionVisualizationScenario::InitializeArucoRendering()
         m_modelRenderers.push_back(slateTextureRenderer);
         m_arucoDetectorLeft = slateTextureRenderer;
 
-        pLFSlateCameraRenderer->SetFrameCallBack(SlateFrameRendererWithCV::FrameReadyCallback, slateTextureRenderer.get());
+        if (pLFSlateCameraRenderer)
+        {
+            pLFSlateCameraRenderer->GetFrameBus().Subscribe(slateTextureRenderer->GetFrameQueue());
+        }
     }
 
     {
@@ -414,7 +417,10 @@ void CalibrationProjectionVisualizationScenario::InitializeArucoRendering()
         m_modelRenderers.push_back(slateTextureRenderer);
         m_arucoDetectorRight = slateTextureRenderer;
 
-        pRFSlateCameraRenderer->SetFrameCallBack(SlateFrameRendererWithCV::FrameReadyCallback, slateTextureRenderer.get());
+        if (pRFSlateCameraRenderer)
+        {
+            pRFSlateCameraRenderer->GetFrameBus().Subscribe(slateTextureRenderer->GetFrameQueue());
+        }
     }
 
 }
@@ -0,0 +1,263 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+#pragma once
+
+// Publish/subscribe distribution of the sensor frames: the capture thread
+// publishes every frame once, and each subscriber (renderer, CV processing,
+// recorder...) consumes it from its own bounded queue on its own thread, so a
+// slow subscriber never delays the capture or the other subscribers.
+// Frames are reference counted (AddRef/Release, as IResearchModeSensorFrame),
+// and only depend on the C++ standard library.
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace BasicHologram
+{
+    // Owning reference to a frame, released when the last reference goes away
+    template <typename TFrame>
+    class FrameRef
+    {
+    public:
+        FrameRef() = default;
+
+        FrameRef(const FrameRef& other) :
+            m_pFrame(other.m_pFrame)
+        {
+            if (m_pFrame)
+            {
+                m_pFrame->AddRef();
+            }
+        }
+
+        FrameRef(FrameRef&& other) :
+            m_pFrame(other.m_pFrame)
+        {
+            other.m_pFrame = nullptr;
+        }
+
+        ~FrameRef()
+        {
+            Reset();
+        }
+
+        FrameRef& operator=(FrameRef other)
+        {
+            std::swap(m_pFrame, other.m_pFrame);
+            return *this;
+        }
+
+        // Takes over the reference held by the caller, e.g. from GetNextBuffer
+        static FrameRef Attach(TFrame* pFrame)
+        {
+            FrameRef ref;
+            ref.m_pFrame = pFrame;
+            return ref;
+        }
+
+        void Reset()
+        {
+            if (m_pFrame)
+            {
+                m_pFrame->Release();
+                m_pFrame = nullptr;
+            }
+        }
+
+        TFrame* Get() const { return m_pFrame; }
+        TFrame* operator->() const { return m_pFrame; }
+        explicit operator bool() const { return m_pFrame != nullptr; }
+
+    private:
+        TFrame* m_pFrame = nullptr;
+    };
+
+    enum class FrameDropPolicy
+    {
+        DropOldest,     // keep the most recent frames (rendering, CV on the latest frame)
+        DropNewest,     // keep the queued frames, skip the new ones while full
+        Block           // the publisher waits for room (recording without gaps)
+    };
+
+    // Bounded queue of the frames delivered to one subscriber
+    template <typename TFrame>
+    class FrameQueue
+    {
+    public:
+        FrameQueue(size_t depth, FrameDropPolicy policy) :
+            m_depth(std::max<size_t>(depth, 1)),
+            m_policy(policy)
+        {
+        }
+
+        // Waits for the next frame; returns false once the queue is closed
+        bool Pop(FrameRef<TFrame>& frame)
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_condVar.wait(lock, [this] { return !m_frames.empty() || m_closed; });
+            return PopLocked(frame);
+        }
+
+        // Same as Pop, returns false as well when no frame arrived within timeout
+        template <typename TRep, typename TPeriod>
+        bool Pop(FrameRef<TFrame>& frame, const std::chrono::duration<TRep, TPeriod>& timeout)
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_condVar.wait_for(lock, timeout, [this] { return !m_frames.empty() || m_closed; });
+            return PopLocked(frame);
+        }
+
+        bool TryPop(FrameRef<TFrame>& frame)
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            return PopLocked(frame);
+        }
+
+        // Wakes up the consumer and the publisher, frames pushed afterwards are dropped
+        void Close()
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            m_closed = true;
+            m_frames.clear();
+            m_condVar.notify_all();
+        }
+
+        uint64_t DroppedCount()
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            return m_dropped;
+        }
+
+        void Push(const FrameRef<TFrame>& frame)
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            if (m_policy == FrameDropPolicy::Block)
+            {
+                m_condVar.wait(lock, [this] { return m_frames.size() < m_depth || m_closed; });
+            }
+            if (m_closed)
+            {
+                return;
+            }
+            if (m_frames.size() >= m_depth)
+            {
+                ++m_dropped;
+                if (m_policy == FrameDropPolicy::DropNewest)
+                {
+                    return;
+                }
+                m_frames.pop_front();
+            }
+            m_frames.push_back(frame);
+            m_condVar.notify_all();
+        }
+
+    private:
+        bool PopLocked(FrameRef<TFrame>& frame)
+        {
+            if (m_frames.empty())
+            {
+                return false;
+            }
+            frame = std::move(m_frames.front());
+            m_frames.pop_front();
+            // Room for a blocked publisher
+            m_condVar.notify_all();
+            return true;
+        }
+
+        const size_t m_depth;
+        const FrameDropPolicy m_policy;
+
+        std::mutex m_mutex;
+        std::condition_variable m_condVar;
+        std::deque<FrameRef<TFrame>> m_frames;
+        uint64_t m_dropped = 0;
+        bool m_closed = false;
+    };
+
+    template <typename TFrame>
+    class FrameBus
+    {
+    public:
+        std::shared_ptr<FrameQueue<TFrame>> Subscribe(size_t depth, FrameDropPolicy policy)
+        {
+            auto queue = std::make_shared<FrameQueue<TFrame>>(depth, policy);
+            Subscribe(queue);
+            return queue;
+        }
+
+        // The bus does not keep the queue alive: dropping the last reference
+        // to it unsubscribes
+        void Subscribe(const std::shared_ptr<FrameQueue<TFrame>>& queue)
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            m_subscribers.push_back(queue);
+        }
+
+        void Unsubscribe(const std::shared_ptr<FrameQueue<TFrame>>& queue)
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            m_subscribers.erase(
+                std::remove_if(m_subscribers.begin(), m_subscribers.end(),
+                    [&queue](const std::weak_ptr<FrameQueue<TFrame>>& subscriber)
+                    {
+                        auto locked = subscriber.lock();
+                        return !locked || locked == queue;
+                    }),
+                m_subscribers.end());
+        }
+
+        // Hands the frame to every subscriber, without copying it
+        void Publish(const FrameRef<TFrame>& frame)
+        {
+            std::vector<std::shared_ptr<FrameQueue<TFrame>>> subscribers;
+            {
+                std::lock_guard<std::mutex> guard(m_mutex);
+                subscribers.reserve(m_subscribers.size());
+                for (auto it = m_subscribers.begin(); it != m_subscribers.end();)
+                {
+                    if (auto queue = it->lock())
+                    {
+                        subscribers.push_back(std::move(queue));
+                        ++it;
+                    }
+                    else
+                    {
+                        it = m_subscribers.erase(it);
+                    }
+                }
+            }
+            // Outside of the lock, a blocking subscriber only holds up the publisher
+            for (auto& queue : subscribers)
+            {
+                queue->Push(frame);
+            }
+        }
+
+        size_t SubscriberCount()
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            return m_subscribers.size();
+        }
+
+    private:
+        std::mutex m_mutex;
+        std::vector<std::weak_ptr<FrameQueue<TFrame>>> m_subscribers;
+    };
+}
@@ -11,6 +11,7 @@
 
 #include "pch.h"
 #include "SlateCameraRenderer.h"
+#include "SlateTextureKernels.h"
 
 using namespace BasicHologram;
 using namespace DirectX;
@@ -75,19 +76,8 @@ void SlateCameraRenderer::CameraUpdateThread(SlateCameraRenderer* pSlateCameraRe
 
         winrt::check_hresult(pSlateCameraRenderer->m_pRMCameraSensor->GetNextBuffer(&pSensorFrame));
 
-        std::lock_guard<std::mutex> guard(pSlateCameraRenderer->m_mutex);
-
-        if (pSlateCameraRenderer->m_frameCallback)
-        {
-            pSlateCameraRenderer->m_frameCallback(pSensorFrame, pSlateCameraRenderer->m_frameCtx);
-        }
-
-        if (pSlateCameraRenderer->m_pSensorFrame)
-        {
-            pSlateCameraRenderer->m_pSensorFrame->Release();
-        }
-
-        pSlateCameraRenderer->m_pSensorFrame = pSensorFrame;
+        // The bus takes over the reference returned by GetNextBuffer
+        pSlateCameraRenderer->m_frameBus.Publish(FrameRef<IResearchModeSensorFrame>::Attach(pSensorFrame));
     }
 
     if (pSlateCameraRenderer->m_pRMCameraSensor)
@@ -98,11 +88,14 @@ void SlateCameraRenderer::CameraUpdateThread(SlateCameraRenderer* pSlateCameraRe
 
 void SlateCameraRenderer::UpdateSlateTexture()
 {
-    if (m_pSensorFrame)
+    FrameRef<IResearchModeSensorFrame> sensorFrame;
+
+    // The texture keeps showing the last frame until a new one is published
+    if (m_renderQueue->TryPop(sensorFrame))
     {
-        EnsureTextureForCameraFrame(m_pSensorFrame);
+        EnsureTextureForCameraFrame(sensorFrame.Get());
 
-        UpdateTextureFromCameraFrame(m_pSensorFrame, m_texture2D);
+        UpdateTextureFromCameraFrame(sensorFrame.Get(), m_texture2D);
     }
 }
 
@@ -122,36 +115,6 @@ void SlateCameraRenderer::EnsureTextureForCameraFrame(IResearchModeSensorFrame*
     }
 }
 
-BYTE ConvertDepthPixel(USHORT v, BYTE bSigma, USHORT mask, USHORT maxshort, const int vmin, const int vmax)
-{
-    if ((mask != 0) && (bSigma & mask) > 0)
-    {
-        v = 0;
-    }
-
-    if ((maxshort != 0) && (v > maxshort))
-    {
-        v = 0;
-    }
-    
-    float colorValue = 0.0f;
-    if (v <= vmin)
-    {
-        colorValue = 0.0f;
-    }
-    else if (v >= vmax)
-    {
-        colorValue = 1.0f;
-    }
-    else
-    {
-        colorValue = (float)(v - vmin) / (float)(vmax - vmin);
-    }
-
-    return (BYTE)(colorValue * 255);
-}
-
-
 void SlateCameraRenderer::UpdateTextureFromCameraFrame(IResearchModeSensorFrame* pSensorFrame, std::shared_ptr<Texture2D> texture2D)
 {
 	HRESULT hr = S_OK;
@@ -179,54 +142,23 @@ void SlateCameraRenderer::UpdateTextureFromCameraFrame(IResearchModeSensorFrame*
             texture2D->MapCPUTexture<void>(
                 D3D11_MAP_WRITE /* mapType */);
 
-        for (UINT i = 0; i < resolution.Height; i++)
+        switch (m_pRMCameraSensor->GetSensorType())
         {
-            for (UINT j = 0; j < resolution.Width; j++)
-            {
-                UINT32 pixel = 0;
-                BYTE inputPixel = pImage[resolution.Width * i + j];
-                pixel = inputPixel | (inputPixel << 8) | (inputPixel << 16);
-
-                if (m_pRMCameraSensor->GetSensorType() == LEFT_FRONT)
-                {
-                    *((UINT32*)(mappedTexture)+((texture2D->GetRowPitch() / 4) * i + (resolution.Width - j - 1))) = pixel;
-                }
-                else if (m_pRMCameraSensor->GetSensorType() == RIGHT_FRONT)
-                {
-                    *((UINT32*)(mappedTexture)+((texture2D->GetRowPitch() / 4) * (resolution.Height - i - 1) + j)) = pixel;
-                }
-                else
-                {
-                    *((UINT32*)(mappedTexture)+((m_texture2D->GetRowPitch() / 4) * i + j)) = pixel;
-                }
-            }
+        case LEFT_FRONT:
+            GrayToBgra<SlateOrientation::MirrorX>(pImage, resolution.Width, resolution.Height, mappedTexture, texture2D->GetRowPitch());
+            break;
+        case RIGHT_FRONT:
+            GrayToBgra<SlateOrientation::FlipY>(pImage, resolution.Width, resolution.Height, mappedTexture, texture2D->GetRowPitch());
+            break;
+        default:
+            GrayToBgra<SlateOrientation::Identity>(pImage, resolution.Width, resolution.Height, mappedTexture, texture2D->GetRowPitch());
+            break;
         }
 	}
 
     if (pDepthFrame)
     {
-        int maxClampDepth = 0;
-        USHORT maxshort = 0;
-        USHORT mask = 0;
         const BYTE *pSigma = nullptr;
-
-        if (m_pRMCameraSensor->GetSensorType() == DEPTH_LONG_THROW)
-        {
-            mask = 0x80;
-            maxClampDepth = 4000;
-        }
-        else if (m_pRMCameraSensor->GetSensorType() == DEPTH_AHAT)
-        {
-            mask = 0x0;
-            maxClampDepth = 1000;
-            maxshort = 4090;
-        }
-
-        if (m_pRMCameraSensor->GetSensorType() == DEPTH_LONG_THROW)
-        {
-            hr = pDepthFrame->GetSigmaBuffer(&pSigma, &outBufferCount);
-        }
-
         const UINT16 *pDepth = nullptr;
         pDepthFrame->GetBuffer(&pDepth, &outBufferCount);
 
@@ -234,24 +166,17 @@ void SlateCameraRenderer::UpdateTextureFromCameraFrame(IResearchModeSensorFrame*
             texture2D->MapCPUTexture<void>(
                 D3D11_MAP_WRITE /* mapType */);
 
-        for (UINT i = 0; i < resolution.Height; i++)
+        if (m_pRMCameraSensor->GetSensorType() == DEPTH_LONG_THROW)
         {
-            for (UINT j = 0; j < resolution.Width; j++)
-            {
-                UINT32 pixel = 0;
-                //BYTE inputPixel = pImage[resolution.Width * i + j];
-                BYTE inputPixel = ConvertDepthPixel(
-                    pDepth[resolution.Width * i + j],
-                    pSigma[resolution.Width * i + j],
-                    mask,
-                    maxshort,
-                    0,
-                    maxClampDepth);
-
-                pixel = inputPixel | (inputPixel << 8) | (inputPixel << 16);
-
-                *((UINT32*)(mappedTexture)+((m_texture2D->GetRowPitch() / 4) * i + j)) = pixel;
-            }
+            hr = pDepthFrame->GetSigmaBuffer(&pSigma, &outBufferCount);
+
+            DepthToBgra<SlateOrientation::Identity, LongThrowDepthRange>(
+                pDepth, pSigma, resolution.Width, resolution.Height, mappedTexture, texture2D->GetRowPitch());
+        }
+        else if (m_pRMCameraSensor->GetSensorType() == DEPTH_AHAT)
+        {
+            DepthToBgra<SlateOrientation::Identity, AhatDepthRange>(
+                pDepth, pSigma, resolution.Width, resolution.Height, mappedTexture, texture2D->GetRowPitch());
         }
     }
     
@@ -16,6 +16,7 @@
 #include "ShaderStructures.h"
 #include "researchmode\ResearchModeApi.h"
 #include "ModelRenderer.h"
+#include "SensorFrameBus.h"
 
 namespace BasicHologram
 {
@@ -28,11 +29,12 @@ namespace BasicHologram
         {
             m_pRMCameraSensor = pLLSensor;
             m_pRMCameraSensor->AddRef();
-            m_pSensorFrame = nullptr;
-            m_frameCallback = nullptr;
 
             m_pixelShaderFile = L"ms-appx:///PixelShader.cso";
 
+            // The slate only shows the latest frame
+            m_renderQueue = m_frameBus.Subscribe(1, FrameDropPolicy::DropOldest);
+
             m_pCameraUpdateThread = new std::thread(CameraUpdateThread, this, hasData, pCamAccessConsent);
         }
         virtual ~SlateCameraRenderer()
@@ -52,10 +54,11 @@ namespace BasicHologram
             return DirectX::XMMatrixRotationAxis(DirectX::XMVectorSet(0.f, 1.f, 0.f, 0.f), -DirectX::XM_PIDIV2);
         }
 
-        void SetFrameCallBack(std::function<void(IResearchModeSensorFrame*, PVOID frameCtx)> frameCallback, PVOID frameCtx)
+        // Every frame captured by the sensor is published once on the bus,
+        // subscribe a queue to it to process the frames on another thread
+        FrameBus<IResearchModeSensorFrame>& GetFrameBus()
         {
-            m_frameCallback = frameCallback;
-            m_frameCtx = frameCtx;
+            return m_frameBus;
         }
 
     protected:
@@ -72,10 +75,9 @@ namespace BasicHologram
         static void CameraUpdateThread(SlateCameraRenderer* pSlateCameraRenderer, HANDLE hasData, ResearchModeSensorConsent *pCamAccessConsent);
 
 		IResearchModeSensor *m_pRMCameraSensor = nullptr;
-		IResearchModeSensorFrame* m_pSensorFrame;
 
-        std::function<void(IResearchModeSensorFrame*, PVOID frameCtx)> m_frameCallback;
-        PVOID m_frameCtx;
+        FrameBus<IResearchModeSensorFrame> m_frameBus;
+        std::shared_ptr<FrameQueue<IResearchModeSensorFrame>> m_renderQueue;
 
         std::thread *m_pCameraUpdateThread;
         bool m_fExit = { false };
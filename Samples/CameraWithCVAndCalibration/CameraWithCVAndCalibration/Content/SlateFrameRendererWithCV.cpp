@@ -11,6 +11,7 @@
 
 #include "pch.h"
 #include "SlateFrameRendererWithCV.h"
+#include "SlateTextureKernels.h"
 
 #include <opencv2/core.hpp>
 #include "OpenCVFrameProcessing.h"
@@ -36,15 +37,7 @@ void SlateFrameRendererWithCV::UpdateSlateTextureWithBitmap(const BYTE *pImage,
         m_texture2D->MapCPUTexture<void>(
             D3D11_MAP_WRITE /* mapType */);
 
-    for (UINT i = 0; i < uWidth * uHeight; i++)
-    {
-        UINT32 pixel = 0;
-        BYTE inputPixel = pImage[i];
-
-        pixel = inputPixel | (inputPixel << 8) | (inputPixel << 16);
-
-        *((UINT32*)(mappedTexture)+(i)) = pixel;
-    }
+    GrayToBgra<SlateOrientation::Identity>(pImage, uWidth, uHeight, mappedTexture, m_texture2D->GetRowPitch());
 
     m_texture2D->UnmapCPUTexture();
     m_texture2D->CopyCPU2GPU();
@@ -177,14 +170,14 @@ void SlateFrameRendererWithCV::UpdateSlateTexture()
     size_t outBufferCount = 0;
     const BYTE *pImage = nullptr;
 
-    if (m_pSensorFrame == nullptr)
+    if (!m_sensorFrame)
     {
         return;
     }
 
-    m_pSensorFrame->GetResolution(&resolution);
+    m_sensorFrame->GetResolution(&resolution);
 
-    hr = m_pSensorFrame->QueryInterface(IID_PPV_ARGS(&pVLCFrame));
+    hr = m_sensorFrame->QueryInterface(IID_PPV_ARGS(&pVLCFrame));
 
     if (SUCCEEDED(hr))
     {
@@ -205,8 +198,7 @@ void SlateFrameRendererWithCV::UpdateSlateTexture()
         pVLCFrame->Release();
     }
 
-    m_pSensorFrame->Release();
-    m_pSensorFrame = nullptr;
+    m_sensorFrame.Reset();
 }
 
 void SlateFrameRendererWithCV::EnsureSlateTexture()
@@ -226,25 +218,19 @@ void SlateFrameRendererWithCV::FrameProcessing()
 
     while (!m_fExit)
     {
-        WaitForSingleObject(m_hFrameEvent, INFINITE);
+        FrameRef<IResearchModeSensorFrame> sensorFrame;
+
+        // Returns false once the queue is closed on exit
+        if (!m_frameQueue->Pop(sensorFrame))
+        {
+            return;
+        }
 
         //Sleep(500);
         {
             std::lock_guard<std::mutex> guard(m_mutex);
-            {
-                std::lock_guard<std::mutex> frameguard(m_frameMutex);
 
-                if (m_pSensorFrameIn == nullptr)
-                {
-                    return;
-                }
-                if (m_pSensorFrame)
-                {
-                    m_pSensorFrame->Release();
-                }
-                m_pSensorFrame = m_pSensorFrameIn;
-                m_pSensorFrameIn = nullptr;
-            }
+            m_sensorFrame = sensorFrame;
 
             {
                 std::lock_guard<std::mutex> guard(m_cornerMutex);
@@ -252,7 +238,7 @@ void SlateFrameRendererWithCV::FrameProcessing()
                 m_corners.clear();
                 m_ids.clear();
 
-                m_cvFrameProcessor(m_pSensorFrame, m_cvResultMat, m_ids, m_corners);
+                m_cvFrameProcessor(m_sensorFrame.Get(), m_cvResultMat, m_ids, m_corners);
 
                 m_centers.clear();
 
@@ -274,11 +260,8 @@ void SlateFrameRendererWithCV::FrameProcessing()
                     m_centers.push_back(center);
                 }
 
-                m_pSensorFrame->GetTimeStamp(&m_timeStamp);
+                m_sensorFrame->GetTimeStamp(&m_timeStamp);
             }
-
-
-            ResetEvent(m_hFrameEvent);
         }
     }
 }
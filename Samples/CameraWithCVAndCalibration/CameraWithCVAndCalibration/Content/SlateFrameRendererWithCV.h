@@ -16,6 +16,7 @@
 #include "researchmode\ResearchModeApi.h"
 #include "ShaderStructures.h"
 #include "ModelRenderer.h"
+#include "SensorFrameBus.h"
 #include <opencv2/core.hpp>
 #include <opencv2/imgproc.hpp>  // cv::Canny()
 #include <opencv2/aruco.hpp>
@@ -33,20 +34,20 @@ namespace BasicHologram
         {
             m_Width = 0;
             m_Height = 0;
-            m_pSensorFrame = nullptr;
-            m_pSensorFrameIn = nullptr;
-            m_hFrameEvent = NULL;
 
             m_pixelShaderFile = L"ms-appx:///PixelShader.cso";
 
             m_fExit = false;
-            m_hFrameEvent = CreateEvent(NULL, true, false, NULL);
+            // CV processing runs on the latest frame, the older ones are skipped
+            m_frameQueue = std::make_shared<FrameQueue<IResearchModeSensorFrame>>(1, FrameDropPolicy::DropOldest);
 
             m_cvFrameProcessor = cvFrameProcessor;
         }
         virtual ~SlateFrameRendererWithCV()
         {
             m_fExit = true;
+            // Wakes up the processing thread waiting for a frame
+            m_frameQueue->Close();
             m_pFrameUpdateThread->join();
         }
 
@@ -55,22 +56,10 @@ namespace BasicHologram
         void UpdateSlateTextureWithBitmap(const BYTE *pImage, UINT uWidth, UINT uHeight);
         void StartCVProcessing(BYTE bright);
 
-        static void FrameReadyCallback(IResearchModeSensorFrame* pSensorFrame, PVOID frameCtx)
+        // Subscribe it to the frame bus of the camera to process
+        std::shared_ptr<FrameQueue<IResearchModeSensorFrame>> GetFrameQueue()
         {
-            SlateFrameRendererWithCV *pSlateTexture = (SlateFrameRendererWithCV*)frameCtx;
-            std::lock_guard<std::mutex> guard(pSlateTexture->m_frameMutex);
-
-            if (pSlateTexture->m_pSensorFrameIn)
-            {
-                pSlateTexture->m_pSensorFrameIn->Release();
-            }
-            pSlateTexture->m_pSensorFrameIn = pSensorFrame;
-            if (pSensorFrame)
-            {
-                pSensorFrame->AddRef();
-            }
-
-            SetEvent(pSlateTexture->m_hFrameEvent);
+            return m_frameQueue;
         }
 
         bool GetFirstCenter(float *px, float *py, ResearchModeSensorTimestamp *pTimeStamp);
@@ -90,11 +79,9 @@ namespace BasicHologram
         static void FrameProcessingThread(SlateFrameRendererWithCV* pSlateCameraRenderer);
         bool m_fExit = { false };
         std::thread *m_pFrameUpdateThread;
-        HANDLE m_hFrameEvent;
 
-        std::mutex m_frameMutex;
-        IResearchModeSensorFrame* m_pSensorFrame;
-        IResearchModeSensorFrame* m_pSensorFrameIn;
+        std::shared_ptr<FrameQueue<IResearchModeSensorFrame>> m_frameQueue;
+        FrameRef<IResearchModeSensorFrame> m_sensorFrame;
         UINT m_Width;
         UINT m_Height;
 
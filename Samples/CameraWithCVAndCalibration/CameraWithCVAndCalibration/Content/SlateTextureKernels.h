@@ -0,0 +1,235 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+#pragma once
+
+// Conversion of the research mode camera frames to the BGRA slate textures.
+// The kernels only depend on the C++ standard library, and use NEON on ARM
+// (the HoloLens 2) and SSE2 on x86/x64, with a scalar fallback otherwise.
+
+#include <cstdint>
+#include <vector>
+
+#if defined(_M_ARM64) || defined(_M_ARM) || defined(__ARM_NEON)
+#define SLATE_KERNELS_NEON
+#include <arm_neon.h>
+#elif defined(_M_X64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SLATE_KERNELS_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace BasicHologram
+{
+    // How the frame is laid out on the slate
+    enum class SlateOrientation
+    {
+        Identity,
+        MirrorX,    // columns right to left (LEFT_FRONT, depth)
+        FlipY       // rows bottom to top (RIGHT_FRONT)
+    };
+
+    // Depth to gray mapping of a sensor: values above MaxShort (when not 0)
+    // are invalid, and [VMin, VMax] is mapped to [0, 255]. Pixels whose sigma
+    // has a SigmaMask bit set are invalid too.
+    struct LongThrowDepthRange
+    {
+        static const uint16_t MaxShort = 0;
+        static const int VMin = 0;
+        static const int VMax = 4000;
+        static const uint8_t SigmaMask = 0x80;
+    };
+
+    struct AhatDepthRange
+    {
+        static const uint16_t MaxShort = 4090;
+        static const int VMin = 0;
+        static const int VMax = 1000;
+        static const uint8_t SigmaMask = 0x0;
+    };
+
+    // Reference conversion of a depth value, with the sigma mask already applied
+    inline uint8_t ConvertDepthToGray(uint16_t v, uint16_t maxshort, int vmin, int vmax)
+    {
+        if ((maxshort != 0) && (v > maxshort))
+        {
+            v = 0;
+        }
+
+        float colorValue = 0.0f;
+        if (v <= vmin)
+        {
+            colorValue = 0.0f;
+        }
+        else if (v >= vmax)
+        {
+            colorValue = 1.0f;
+        }
+        else
+        {
+            colorValue = (float)(v - vmin) / (float)(vmax - vmin);
+        }
+
+        return (uint8_t)(colorValue * 255);
+    }
+
+    // ConvertDepthToGray for all the 16-bit values, built once per range
+    template <typename TRange>
+    const uint8_t* DepthToGrayLut()
+    {
+        static const std::vector<uint8_t> lut = []()
+        {
+            std::vector<uint8_t> table(65536);
+            for (uint32_t v = 0; v < table.size(); v++)
+            {
+                table[v] = ConvertDepthToGray((uint16_t)v, TRange::MaxShort, TRange::VMin, TRange::VMax);
+            }
+            return table;
+        }();
+        return lut.data();
+    }
+
+    namespace SlateKernels
+    {
+        inline uint32_t GrayToBgra(uint8_t g)
+        {
+            return g | (g << 8) | (g << 16);
+        }
+
+        // Writes count gray pixels as BGRA (alpha 0) to dst[0, count), or to
+        // dst[count - 1] down to dst[0] when mirrored
+        template <bool Mirror>
+        inline void ExpandGraySpan(const uint8_t* gray, uint32_t count, uint32_t* dst)
+        {
+            uint32_t j = 0;
+#if defined(SLATE_KERNELS_NEON)
+            const uint8x16_t zero = vdupq_n_u8(0);
+            for (; j + 16 <= count; j += 16)
+            {
+                uint8x16_t g = vld1q_u8(gray + j);
+                uint32_t* out = dst + j;
+                if (Mirror)
+                {
+                    g = vrev64q_u8(g);
+                    g = vcombine_u8(vget_high_u8(g), vget_low_u8(g));
+                    out = dst + count - j - 16;
+                }
+                uint8x16x4_t bgra = { { g, g, g, zero } };
+                vst4q_u8(reinterpret_cast<uint8_t*>(out), bgra);
+            }
+#elif defined(SLATE_KERNELS_SSE2)
+            const __m128i zero = _mm_setzero_si128();
+            for (; j + 16 <= count; j += 16)
+            {
+                const __m128i g = _mm_loadu_si128(reinterpret_cast<const __m128i*>(gray + j));
+                const __m128i gg0 = _mm_unpacklo_epi8(g, g);
+                const __m128i gg1 = _mm_unpackhi_epi8(g, g);
+                const __m128i g00 = _mm_unpacklo_epi8(g, zero);
+                const __m128i g01 = _mm_unpackhi_epi8(g, zero);
+                // 16-bit (g | g << 8) next to 16-bit g gives the bytes g, g, g, 0
+                __m128i p[4] =
+                {
+                    _mm_unpacklo_epi16(gg0, g00),
+                    _mm_unpackhi_epi16(gg0, g00),
+                    _mm_unpacklo_epi16(gg1, g01),
+                    _mm_unpackhi_epi16(gg1, g01)
+                };
+                if (Mirror)
+                {
+                    __m128i* out = reinterpret_cast<__m128i*>(dst + count - j - 16);
+                    for (int k = 0; k < 4; k++)
+                    {
+                        _mm_storeu_si128(out + 3 - k, _mm_shuffle_epi32(p[k], _MM_SHUFFLE(0, 1, 2, 3)));
+                    }
+                }
+                else
+                {
+                    __m128i* out = reinterpret_cast<__m128i*>(dst + j);
+                    for (int k = 0; k < 4; k++)
+                    {
+                        _mm_storeu_si128(out + k, p[k]);
+                    }
+                }
+            }
+#endif
+            for (; j < count; j++)
+            {
+                dst[Mirror ? count - j - 1 : j] = GrayToBgra(gray[j]);
+            }
+        }
+
+        inline uint32_t* DestinationRow(void* dst, uint32_t rowPitch, uint32_t height, uint32_t row, bool flip)
+        {
+            return reinterpret_cast<uint32_t*>(static_cast<uint8_t*>(dst) + (size_t)rowPitch * (flip ? height - row - 1 : row));
+        }
+    }
+
+    // Gray (VLC, or processed image) frame to BGRA texture. rowPitch is the
+    // byte pitch of the mapped texture (Texture2D::GetRowPitch()), dst points
+    // at the first pixel to write.
+    template <SlateOrientation Orientation>
+    void GrayToBgra(const uint8_t* src, uint32_t width, uint32_t height, void* dst, uint32_t rowPitch)
+    {
+        for (uint32_t i = 0; i < height; i++)
+        {
+            SlateKernels::ExpandGraySpan<Orientation == SlateOrientation::MirrorX>(
+                src + (size_t)width * i,
+                width,
+                SlateKernels::DestinationRow(dst, rowPitch, height, i, Orientation == SlateOrientation::FlipY));
+        }
+    }
+
+    // Depth (or active brightness) frame to BGRA texture, through the lookup
+    // table of TRange. sigma may be null, in which case no pixel is masked.
+    template <SlateOrientation Orientation, typename TRange>
+    void DepthToBgra(const uint16_t* depth, const uint8_t* sigma, uint32_t width, uint32_t height, void* dst, uint32_t rowPitch)
+    {
+        const uint8_t* lut = DepthToGrayLut<TRange>();
+        const uint32_t kBlockSize = 64;
+        uint8_t gray[kBlockSize];
+
+        for (uint32_t i = 0; i < height; i++)
+        {
+            const uint16_t* depthRow = depth + (size_t)width * i;
+            const uint8_t* sigmaRow = sigma ? sigma + (size_t)width * i : nullptr;
+            uint32_t* dstRow = SlateKernels::DestinationRow(dst, rowPitch, height, i, Orientation == SlateOrientation::FlipY);
+
+            for (uint32_t j = 0; j < width; j += kBlockSize)
+            {
+                const uint32_t count = (width - j < kBlockSize) ? width - j : kBlockSize;
+                if (TRange::SigmaMask != 0 && sigmaRow)
+                {
+                    // Masked pixels read the entry of 0, without a branch
+                    for (uint32_t k = 0; k < count; k++)
+                    {
+                        const uint16_t keep = (uint16_t)0 - (uint16_t)((sigmaRow[j + k] & TRange::SigmaMask) == 0);
+                        gray[k] = lut[depthRow[j + k] & keep];
+                    }
+                }
+                else
+                {
+                    for (uint32_t k = 0; k < count; k++)
+                    {
+                        gray[k] = lut[depthRow[j + k]];
+                    }
+                }
+
+                if (Orientation == SlateOrientation::MirrorX)
+                {
+                    SlateKernels::ExpandGraySpan<true>(gray, count, dstRow + (width - j - count));
+                }
+                else
+                {
+                    SlateKernels::ExpandGraySpan<false>(gray, count, dstRow + j);
+                }
+            }
+        }
+    }
+}
@@ -23,9 +23,7 @@ using namespace winrt::Windows::UI::Input::Spatial;
 void AccelRenderer::AccelUpdateLoop()
 {
     uint64_t lastSocTick = 0; 
-    uint64_t lastHupTick = 0; 
     LARGE_INTEGER qpf;
-    uint64_t lastQpcNow = 0;
 
     // Cache the QueryPerformanceFrequency
     QueryPerformanceFrequency(&qpf);
@@ -34,82 +32,53 @@ void AccelRenderer::AccelUpdateLoop()
 
     while (!m_fExit)
     {
-        char printString[1000];
-
         IResearchModeSensorFrame* pSensorFrame = nullptr;
         IResearchModeAccelFrame *pSensorAccelFrame = nullptr;
         ResearchModeSensorTimestamp timeStamp;
         const AccelDataStruct *pAccelBuffer = nullptr;
         size_t BufferOutLength;
+        LARGE_INTEGER qpcReceived;
+        LARGE_INTEGER qpcProcessed;
 
         winrt::check_hresult(m_pAccelSensor->GetNextBuffer(&pSensorFrame));
+        QueryPerformanceCounter(&qpcReceived);
 
         winrt::check_hresult(pSensorFrame->QueryInterface(IID_PPV_ARGS(&pSensorAccelFrame)));
 
-        {
-            std::lock_guard<std::mutex> guard(m_sampleMutex);
-
-            winrt::check_hresult(pSensorAccelFrame->GetCalibratedAccelaration(&m_accelSample));
-        }
-
         winrt::check_hresult(pSensorAccelFrame->GetCalibratedAccelarationSamples(
             &pAccelBuffer,
             &BufferOutLength));
 
-        lastHupTick = 0;
-        std::string hupTimeDeltas = "";
-
-        for (UINT i = 0; i < BufferOutLength; i++)
+        for (UINT i = 1; i < BufferOutLength; i++)
         {
-            pSensorFrame->GetTimeStamp(&timeStamp);
-            if (lastHupTick != 0)
+            if (pAccelBuffer[i].VinylHupTicks < pAccelBuffer[i - 1].VinylHupTicks)
             {
-                if (pAccelBuffer[i].VinylHupTicks < lastHupTick)
-                {
-                    sprintf(printString, "####ACCEL BAD HUP ORDERING\n");
-                    OutputDebugStringA(printString);
-                    DebugBreak();
-                }
-                sprintf(printString, " %I64d", (pAccelBuffer[i].VinylHupTicks - lastHupTick) / 1000); // Microseconds
-
-                hupTimeDeltas = hupTimeDeltas + printString;
-
+                OutputDebugStringA("####ACCEL BAD HUP ORDERING\n");
+                DebugBreak();
             }
-            lastHupTick = pAccelBuffer[i].VinylHupTicks;
         }
 
-        hupTimeDeltas = hupTimeDeltas + "\n";
-        //OutputDebugStringA(hupTimeDeltas.c_str());
+        // Keep the whole batch, not only the latest sample
+        m_accelSamples.Push(pAccelBuffer, BufferOutLength);
+        QueryPerformanceCounter(&qpcProcessed);
 
         pSensorFrame->GetTimeStamp(&timeStamp);
-        LARGE_INTEGER qpcNow;
-        uint64_t uqpcNow;
-        QueryPerformanceCounter(&qpcNow);
-        uqpcNow = qpcNow.QuadPart;
+
+        const uint64_t receivedUs = TicksToMicroseconds(qpcReceived.QuadPart, qpf.QuadPart);
+        const uint64_t frameUs = TicksToMicroseconds(timeStamp.HostTicks, timeStamp.HostTicksPerSecond);
+        m_telemetry->Record(TelemetryMetric::SensorToHost, receivedUs > frameUs ? receivedUs - frameUs : 0);
+        m_telemetry->Record(TelemetryMetric::Processing, TicksToMicroseconds(qpcProcessed.QuadPart - qpcReceived.QuadPart, qpf.QuadPart));
 
         if (lastSocTick != 0)
         {
-            uint64_t timeInMilliseconds =
-                (1000 *
-                (uqpcNow - lastQpcNow)) /
-                qpf.QuadPart;
-
             if (timeStamp.HostTicks < lastSocTick)
             {
                 DebugBreak();
             }
 
-            sprintf(printString, "####Accel: % 3.4f % 3.4f % 3.4f %f %I64d %I64d\n",
-                m_accelSample.x,
-                m_accelSample.y,
-                m_accelSample.z,
-                sqrt(m_accelSample.x * m_accelSample.x + m_accelSample.y * m_accelSample.y + m_accelSample.z * m_accelSample.z),
-                    (((timeStamp.HostTicks - lastSocTick) * 1000) / timeStamp.HostTicksPerSecond), // Milliseconds
-                timeInMilliseconds);
-            //OutputDebugStringA(printString);
+            m_telemetry->Record(TelemetryMetric::Interval, TicksToMicroseconds(timeStamp.HostTicks - lastSocTick, timeStamp.HostTicksPerSecond));
         }
         lastSocTick = timeStamp.HostTicks;
-        lastQpcNow = uqpcNow;
 
         if (pSensorFrame)
         {
@@ -127,8 +96,13 @@ void AccelRenderer::AccelUpdateLoop()
 
 void AccelRenderer::GetAccelSample(DirectX::XMFLOAT3 *pAccelSample)
 {
-    std::lock_guard<std::mutex> guard(m_sampleMutex);
-
+    // Before the first sample, or when the latest one was being overwritten
+    // while it was read, the previous sample is returned again
+    AccelDataStruct sample;
+    if (m_accelSamples.Latest(sample))
+    {
+        m_accelSample = DirectX::XMFLOAT3(sample.AccelValues);
+    }
     *pAccelSample = m_accelSample;
 }
 
@@ -15,6 +15,8 @@
 #include "..\Common\StepTimer.h"
 #include "ShaderStructures.h"
 #include "researchmode\ResearchModeApi.h"
+#include "ImuSampleRing.h"
+#include "StreamTelemetry.h"
 #include <Texture2D.h>
 
 namespace BasicHologram
@@ -27,6 +29,7 @@ namespace BasicHologram
         {
             m_pAccelSensor = pAccelSensor;
             m_pAccelSensor->AddRef();
+            m_telemetry = std::make_shared<StreamTelemetry>(winrt::to_string(m_pAccelSensor->GetFriendlyName()));
             m_pAccelUpdateThread = new std::thread(AccelUpdateThread, this, hasData, pCamAccessConsent);
         }
         virtual ~AccelRenderer()
@@ -51,6 +54,18 @@ namespace BasicHologram
 
         void GetAccelSample(DirectX::XMFLOAT3 *pAccleSample);
 
+        // Every sample of the batches received, for full rate consumers
+        const ImuSampleRing<AccelDataStruct>& GetAccelSamples() const
+        {
+            return m_accelSamples;
+        }
+
+        // Timing of the batches received from the sensor
+        std::shared_ptr<StreamTelemetry> GetTelemetry() const
+        {
+            return m_telemetry;
+        }
+
     private:
         static void AccelUpdateThread(AccelRenderer* pSpinningCube, HANDLE hasData, ResearchModeSensorConsent *pCamAccessConsent);
         void AccelUpdateLoop();
@@ -61,8 +76,11 @@ namespace BasicHologram
 
 		IResearchModeSensor *m_pAccelSensor = nullptr;
 		IResearchModeSensorFrame* m_pSensorFrame;
-        DirectX::XMFLOAT3 m_accelSample;
-        std::mutex m_sampleMutex;
+        // A few seconds at the sensor rate
+        ImuSampleRing<AccelDataStruct> m_accelSamples{ 1 << 14 };
+        // Last valid sample returned by GetAccelSample, only used by its caller's thread
+        DirectX::XMFLOAT3 m_accelSample = {};
+        std::shared_ptr<StreamTelemetry> m_telemetry;
 
         std::thread *m_pAccelUpdateThread;
         bool m_fExit = { false };
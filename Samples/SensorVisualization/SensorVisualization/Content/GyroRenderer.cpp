@@ -23,9 +23,7 @@ using namespace winrt::Windows::UI::Input::Spatial;
 void GyroRenderer::GyroUpdateLoop()
 {
     uint64_t lastSocTick = 0; 
-    uint64_t lastHupTick = 0; 
     LARGE_INTEGER qpf;
-    uint64_t lastQpcNow = 0;
 
     // Cache the QueryPerformanceFrequency
     QueryPerformanceFrequency(&qpf);
@@ -34,81 +32,53 @@ void GyroRenderer::GyroUpdateLoop()
 
     while (!m_fExit)
     {
-        char printString[1000];
-
         IResearchModeSensorFrame* pSensorFrame = nullptr;
         IResearchModeGyroFrame *pGyroFrame = nullptr;
         ResearchModeSensorTimestamp timeStamp;
         const GyroDataStruct *pGyroBuffer = nullptr;
         size_t BufferOutLength;
+        LARGE_INTEGER qpcReceived;
+        LARGE_INTEGER qpcProcessed;
 
         winrt::check_hresult(m_pGyroSensor->GetNextBuffer(&pSensorFrame));
+        QueryPerformanceCounter(&qpcReceived);
 
         winrt::check_hresult(pSensorFrame->QueryInterface(IID_PPV_ARGS(&pGyroFrame)));
 
-        {
-            std::lock_guard<std::mutex> guard(m_sampleMutex);
-
-            winrt::check_hresult(pGyroFrame->GetCalibratedGyro(&m_gyroSample));
-        }
-
         winrt::check_hresult(pGyroFrame->GetCalibratedGyroSamples(
             &pGyroBuffer,
             &BufferOutLength));
 
-        lastHupTick = 0;
-        std::string hupTimeDeltas = "";
-
-        for (UINT i = 0; i < BufferOutLength; i++)
+        for (UINT i = 1; i < BufferOutLength; i++)
         {
-            pSensorFrame->GetTimeStamp(&timeStamp);
-            if (lastHupTick != 0)
+            if (pGyroBuffer[i].VinylHupTicks < pGyroBuffer[i - 1].VinylHupTicks)
             {
-                if (pGyroBuffer[i].VinylHupTicks < lastHupTick)
-                {
-                    sprintf(printString, "####GYRO BAD HUP ORDERING\n");
-                    OutputDebugStringA(printString);
-                    DebugBreak();
-                }
-                sprintf(printString, " %I64d", (pGyroBuffer[i].VinylHupTicks - lastHupTick) / 1000); // Microseconds
-
-                hupTimeDeltas = hupTimeDeltas + printString;
-
+                OutputDebugStringA("####GYRO BAD HUP ORDERING\n");
+                DebugBreak();
             }
-            lastHupTick = pGyroBuffer[i].VinylHupTicks;
         }
 
-        hupTimeDeltas = hupTimeDeltas + "\n";
-        //OutputDebugStringA(hupTimeDeltas.c_str());
+        // Keep the whole batch, not only the latest sample
+        m_gyroSamples.Push(pGyroBuffer, BufferOutLength);
+        QueryPerformanceCounter(&qpcProcessed);
 
         pSensorFrame->GetTimeStamp(&timeStamp);
-        LARGE_INTEGER qpcNow;
-        uint64_t uqpcNow;
-        QueryPerformanceCounter(&qpcNow);
-        uqpcNow = qpcNow.QuadPart;
+
+        const uint64_t receivedUs = TicksToMicroseconds(qpcReceived.QuadPart, qpf.QuadPart);
+        const uint64_t frameUs = TicksToMicroseconds(timeStamp.HostTicks, timeStamp.HostTicksPerSecond);
+        m_telemetry->Record(TelemetryMetric::SensorToHost, receivedUs > frameUs ? receivedUs - frameUs : 0);
+        m_telemetry->Record(TelemetryMetric::Processing, TicksToMicroseconds(qpcProcessed.QuadPart - qpcReceived.QuadPart, qpf.QuadPart));
 
         if (lastSocTick != 0)
         {
-            uint64_t timeInMilliseconds =
-                (1000 *
-                (uqpcNow - lastQpcNow)) /
-                qpf.QuadPart;
-
             if (timeStamp.HostTicks < lastSocTick)
             {
                 DebugBreak();
             }
 
-            sprintf(printString, "####Gyro: % 3.4f % 3.4f % 3.4f %I64d %I64d\n",
-                m_gyroSample.x,
-                m_gyroSample.y,
-                m_gyroSample.z,
-                    (((timeStamp.HostTicks - lastSocTick) * 1000) / timeStamp.HostTicksPerSecond), // Milliseconds
-                timeInMilliseconds);
-            OutputDebugStringA(printString);
+            m_telemetry->Record(TelemetryMetric::Interval, TicksToMicroseconds(timeStamp.HostTicks - lastSocTick, timeStamp.HostTicksPerSecond));
         }
         lastSocTick = timeStamp.HostTicks;
-        lastQpcNow = uqpcNow;
 
         if (pSensorFrame)
         {
@@ -126,8 +96,13 @@ void GyroRenderer::GyroUpdateLoop()
 
 void GyroRenderer::GetGyroSample(DirectX::XMFLOAT3 *pGyroSample)
 {
-    std::lock_guard<std::mutex> guard(m_sampleMutex);
-
+    // Before the first sample, or when the latest one was being overwritten
+    // while it was read, the previous sample is returned again
+    GyroDataStruct sample;
+    if (m_gyroSamples.Latest(sample))
+    {
+        m_gyroSample = DirectX::XMFLOAT3(sample.GyroValues);
+    }
     *pGyroSample = m_gyroSample;
 }
 
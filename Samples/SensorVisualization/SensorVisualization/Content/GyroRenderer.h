@@ -15,6 +15,8 @@
 #include "..\Common\StepTimer.h"
 #include "ShaderStructures.h"
 #include "researchmode\ResearchModeApi.h"
+#include "ImuSampleRing.h"
+#include "StreamTelemetry.h"
 #include <Texture2D.h>
 
 namespace BasicHologram
@@ -27,6 +29,7 @@ namespace BasicHologram
         {
             m_pGyroSensor = pAccelSensor;
             m_pGyroSensor->AddRef();
+            m_telemetry = std::make_shared<StreamTelemetry>(winrt::to_string(m_pGyroSensor->GetFriendlyName()));
             m_pAccelUpdateThread = new std::thread(GyroUpdateThread, this, hasData, pCamAccessConsent);
         }
         virtual ~GyroRenderer()
@@ -51,6 +54,18 @@ namespace BasicHologram
 
         void GetGyroSample(DirectX::XMFLOAT3 *pGyroSample);
 
+        // Every sample of the batches received, for full rate consumers
+        const ImuSampleRing<GyroDataStruct>& GetGyroSamples() const
+        {
+            return m_gyroSamples;
+        }
+
+        // Timing of the batches received from the sensor
+        std::shared_ptr<StreamTelemetry> GetTelemetry() const
+        {
+            return m_telemetry;
+        }
+
     private:
         static void GyroUpdateThread(GyroRenderer* pSpinningCube, HANDLE hasData, ResearchModeSensorConsent *pCamAccessConsent);
         void GyroUpdateLoop();
@@ -61,8 +76,11 @@ namespace BasicHologram
 
 		IResearchModeSensor *m_pGyroSensor = nullptr;
 		IResearchModeSensorFrame* m_pSensorFrame;
-        DirectX::XMFLOAT3 m_gyroSample;
-        std::mutex m_sampleMutex;
+        // A few seconds at the sensor rate
+        ImuSampleRing<GyroDataStruct> m_gyroSamples{ 1 << 16 };
+        // Last valid sample returned by GetGyroSample, only used by its caller's thread
+        DirectX::XMFLOAT3 m_gyroSample = {};
+        std::shared_ptr<StreamTelemetry> m_telemetry;
 
         std::thread *m_pAccelUpdateThread;
         bool m_fExit = { false };
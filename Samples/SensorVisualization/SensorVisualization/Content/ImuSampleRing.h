@@ -0,0 +1,164 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+#pragma once
+
+// Keeps every IMU sample of the batches returned by the sensor, so that
+// visual-inertial consumers get the full rate rather than one sample per
+// rendered frame. TSample is one of AccelDataStruct, GyroDataStruct and
+// MagDataStruct.
+//
+// One thread (the update loop) pushes, any number of threads query, without
+// locks: readers copy the samples and then discard the ones the writer may
+// have overwritten meanwhile.
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+namespace BasicHologram
+{
+    enum class ImuClock
+    {
+        VinylHup,   // VinylHupTicks, IMU hardware clock in nanoseconds
+        Soc         // SocTicks, in the time base of the frame timestamps
+    };
+
+    template <typename TSample>
+    class ImuSampleRing
+    {
+    public:
+        // capacity is rounded up to a power of two
+        explicit ImuSampleRing(size_t capacity)
+        {
+            size_t size = 1;
+            while (size < capacity)
+            {
+                size <<= 1;
+            }
+            m_samples.resize(size);
+            m_mask = size - 1;
+        }
+
+        // Writer side, samples ordered by time
+        void Push(const TSample* pSamples, size_t count)
+        {
+            const uint64_t capacity = m_mask + 1;
+            uint64_t head = m_head.load(std::memory_order_relaxed);
+
+            // Copying more than the capacity would overwrite the batch itself
+            if (count > capacity)
+            {
+                pSamples += count - capacity;
+                count = static_cast<size_t>(capacity);
+            }
+
+            for (size_t i = 0; i < count; i++, head++)
+            {
+                // Readers treat the slot as overwritten from here on
+                m_writing.store(head, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_release);
+
+                m_samples[head & m_mask] = pSamples[i];
+                m_head.store(head + 1, std::memory_order_release);
+            }
+        }
+
+        // Appends the samples with begin <= ticks < end to samples, oldest first,
+        // and returns how many were appended. Samples older than the capacity are lost.
+        size_t Query(uint64_t begin, uint64_t end, std::vector<TSample>& samples, ImuClock clock = ImuClock::Soc) const
+        {
+            const size_t initialSize = samples.size();
+            const uint64_t head = m_head.load(std::memory_order_acquire);
+            const uint64_t capacity = m_mask + 1;
+            uint64_t first = head > capacity ? head - capacity : 0;
+
+            // Lower bound of begin
+            uint64_t count = head - first;
+            while (count > 0)
+            {
+                const uint64_t step = count / 2;
+                if (Ticks(m_samples[(first + step) & m_mask], clock) < begin)
+                {
+                    first += step + 1;
+                    count -= step + 1;
+                }
+                else
+                {
+                    count = step;
+                }
+            }
+
+            for (uint64_t i = first; i < head; i++)
+            {
+                const TSample& sample = m_samples[i & m_mask];
+                if (Ticks(sample, clock) >= end)
+                {
+                    break;
+                }
+                samples.push_back(sample);
+            }
+
+            // Drop the copies of the slots rewritten while reading
+            std::atomic_thread_fence(std::memory_order_acquire);
+            const uint64_t oldestValid = OldestValid();
+            if (first < oldestValid)
+            {
+                const size_t overwritten = static_cast<size_t>(std::min<uint64_t>(oldestValid - first, samples.size() - initialSize));
+                samples.erase(samples.begin() + initialSize, samples.begin() + initialSize + overwritten);
+            }
+
+            return samples.size() - initialSize;
+        }
+
+        // Most recent sample, false before the first one
+        bool Latest(TSample& sample) const
+        {
+            const uint64_t head = m_head.load(std::memory_order_acquire);
+            if (head == 0)
+            {
+                return false;
+            }
+            sample = m_samples[(head - 1) & m_mask];
+            std::atomic_thread_fence(std::memory_order_acquire);
+            return head - 1 >= OldestValid();
+        }
+
+        // Number of samples pushed since the creation
+        uint64_t TotalCount() const
+        {
+            return m_head.load(std::memory_order_acquire);
+        }
+
+    private:
+        static uint64_t Ticks(const TSample& sample, ImuClock clock)
+        {
+            return clock == ImuClock::Soc ? sample.SocTicks : sample.VinylHupTicks;
+        }
+
+        // Index of the oldest sample not being (or having been) overwritten
+        uint64_t OldestValid() const
+        {
+            const uint64_t head = m_head.load(std::memory_order_relaxed);
+            const uint64_t writing = std::max(m_writing.load(std::memory_order_relaxed) + 1, head);
+            const uint64_t capacity = m_mask + 1;
+            return writing > capacity ? writing - capacity : 0;
+        }
+
+        std::vector<TSample> m_samples;
+        uint64_t m_mask;
+
+        // Index of the next sample, and of the sample being written
+        std::atomic<uint64_t> m_head = { 0 };
+        std::atomic<uint64_t> m_writing = { 0 };
+    };
+}
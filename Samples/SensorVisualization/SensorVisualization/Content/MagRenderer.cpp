@@ -23,9 +23,7 @@ using namespace winrt::Windows::UI::Input::Spatial;
 void MagRenderer::MagUpdateLoop()
 {
     uint64_t lastSocTick = 0; 
-    uint64_t lastHupTick = 0; 
     LARGE_INTEGER qpf;
-    uint64_t lastQpcNow = 0;
 
     // Cache the QueryPerformanceFrequency
     QueryPerformanceFrequency(&qpf);
@@ -34,81 +32,53 @@ void MagRenderer::MagUpdateLoop()
 
     while (!m_fExit)
     {
-        char printString[1000];
-
         IResearchModeSensorFrame* pSensorFrame = nullptr;
         IResearchModeMagFrame *pMagFrame = nullptr;
         ResearchModeSensorTimestamp timeStamp;
         const MagDataStruct *pMagBuffer = nullptr;
         size_t BufferOutLength;
+        LARGE_INTEGER qpcReceived;
+        LARGE_INTEGER qpcProcessed;
 
         winrt::check_hresult(m_pGyroSensor->GetNextBuffer(&pSensorFrame));
+        QueryPerformanceCounter(&qpcReceived);
 
         winrt::check_hresult(pSensorFrame->QueryInterface(IID_PPV_ARGS(&pMagFrame)));
 
-        {
-            std::lock_guard<std::mutex> guard(m_sampleMutex);
-
-            winrt::check_hresult(pMagFrame->GetMagnetometer(&m_magSample));
-        }
-
         winrt::check_hresult(pMagFrame->GetMagnetometerSamples(
             &pMagBuffer,
             &BufferOutLength));
 
-        lastHupTick = 0;
-        std::string hupTimeDeltas = "";
-
-        for (UINT i = 0; i < BufferOutLength; i++)
+        for (UINT i = 1; i < BufferOutLength; i++)
         {
-            pSensorFrame->GetTimeStamp(&timeStamp);
-            if (lastHupTick != 0)
+            if (pMagBuffer[i].VinylHupTicks < pMagBuffer[i - 1].VinylHupTicks)
             {
-                if (pMagBuffer[i].VinylHupTicks < lastHupTick)
-                {
-                    sprintf(printString, "####MAG BAD HUP ORDERING\n");
-                    OutputDebugStringA(printString);
-                    DebugBreak();
-                }
-                sprintf(printString, " %I64d", (pMagBuffer[i].VinylHupTicks - lastHupTick) / 1000); // Microseconds
-
-                hupTimeDeltas = hupTimeDeltas + printString;
-
+                OutputDebugStringA("####MAG BAD HUP ORDERING\n");
+                DebugBreak();
             }
-            lastHupTick = pMagBuffer[i].VinylHupTicks;
         }
 
-        hupTimeDeltas = hupTimeDeltas + "\n";
-        //OutputDebugStringA(hupTimeDeltas.c_str());
+        // Keep the whole batch, not only the latest sample
+        m_magSamples.Push(pMagBuffer, BufferOutLength);
+        QueryPerformanceCounter(&qpcProcessed);
 
         pSensorFrame->GetTimeStamp(&timeStamp);
-        LARGE_INTEGER qpcNow;
-        uint64_t uqpcNow;
-        QueryPerformanceCounter(&qpcNow);
-        uqpcNow = qpcNow.QuadPart;
+
+        const uint64_t receivedUs = TicksToMicroseconds(qpcReceived.QuadPart, qpf.QuadPart);
+        const uint64_t frameUs = TicksToMicroseconds(timeStamp.HostTicks, timeStamp.HostTicksPerSecond);
+        m_telemetry->Record(TelemetryMetric::SensorToHost, receivedUs > frameUs ? receivedUs - frameUs : 0);
+        m_telemetry->Record(TelemetryMetric::Processing, TicksToMicroseconds(qpcProcessed.QuadPart - qpcReceived.QuadPart, qpf.QuadPart));
 
         if (lastSocTick != 0)
         {
-            uint64_t timeInMilliseconds =
-                (1000 *
-                (uqpcNow - lastQpcNow)) /
-                qpf.QuadPart;
-
             if (timeStamp.HostTicks < lastSocTick)
             {
                 DebugBreak();
             }
 
-            sprintf(printString, "####MAG: % 3.4f % 3.4f % 3.4f %I64d %I64d\n",
-                m_magSample.x,
-                m_magSample.y,
-                m_magSample.z,
-                    (((timeStamp.HostTicks - lastSocTick) * 1000) / timeStamp.HostTicksPerSecond), // Milliseconds
-                timeInMilliseconds);
-            OutputDebugStringA(printString);
+            m_telemetry->Record(TelemetryMetric::Interval, TicksToMicroseconds(timeStamp.HostTicks - lastSocTick, timeStamp.HostTicksPerSecond));
         }
         lastSocTick = timeStamp.HostTicks;
-        lastQpcNow = uqpcNow;
 
         if (pSensorFrame)
         {
@@ -126,8 +96,13 @@ void MagRenderer::MagUpdateLoop()
 
 void MagRenderer::GetMagSample(DirectX::XMFLOAT3 *pMagSample)
 {
-    std::lock_guard<std::mutex> guard(m_sampleMutex);
-
+    // Before the first sample, or when the latest one was being overwritten
+    // while it was read, the previous sample is returned again
+    MagDataStruct sample;
+    if (m_magSamples.Latest(sample))
+    {
+        m_magSample = DirectX::XMFLOAT3(sample.MagValues);
+    }
     *pMagSample = m_magSample;
 }
 
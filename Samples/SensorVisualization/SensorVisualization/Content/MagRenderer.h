@@ -15,6 +15,8 @@
 #include "..\Common\StepTimer.h"
 #include "ShaderStructures.h"
 #include "researchmode\ResearchModeApi.h"
+#include "ImuSampleRing.h"
+#include "StreamTelemetry.h"
 #include <Texture2D.h>
 
 namespace BasicHologram
@@ -27,6 +29,7 @@ namespace BasicHologram
         {
             m_pGyroSensor = pAccelSensor;
             m_pGyroSensor->AddRef();
+            m_telemetry = std::make_shared<StreamTelemetry>(winrt::to_string(m_pGyroSensor->GetFriendlyName()));
             m_pAccelUpdateThread = new std::thread(MagUpdateThread, this, hasData, pCamAccessConsent);
         }
         virtual ~MagRenderer()
@@ -51,6 +54,18 @@ namespace BasicHologram
 
         void GetMagSample(DirectX::XMFLOAT3 *pAccleSample);
 
+        // Every sample of the batches received, for full rate consumers
+        const ImuSampleRing<MagDataStruct>& GetMagSamples() const
+        {
+            return m_magSamples;
+        }
+
+        // Timing of the batches received from the sensor
+        std::shared_ptr<StreamTelemetry> GetTelemetry() const
+        {
+            return m_telemetry;
+        }
+
     private:
         static void MagUpdateThread(MagRenderer* pSpinningCube, HANDLE hasData, ResearchModeSensorConsent *pCamAccessConsent);
         void MagUpdateLoop();
@@ -61,8 +76,11 @@ namespace BasicHologram
 
 		IResearchModeSensor *m_pGyroSensor = nullptr;
 		IResearchModeSensorFrame* m_pSensorFrame;
-        DirectX::XMFLOAT3 m_magSample;
-        std::mutex m_sampleMutex;
+        // A few seconds at the sensor rate
+        ImuSampleRing<MagDataStruct> m_magSamples{ 1 << 10 };
+        // Last valid sample returned by GetMagSample, only used by its caller's thread
+        DirectX::XMFLOAT3 m_magSample = {};
+        std::shared_ptr<StreamTelemetry> m_telemetry;
 
         std::thread *m_pAccelUpdateThread;
         bool m_fExit = { false };
@@ -11,6 +11,7 @@
 
 #include "pch.h"
 #include "SlateCameraRenderer.h"
+#include "SlateTextureKernels.h"
 
 using namespace BasicHologram;
 using namespace DirectX;
@@ -21,7 +22,6 @@ void SlateCameraRenderer::CameraUpdateThread(SlateCameraRenderer* pSlateCameraRe
 {
     HRESULT hr = S_OK;
     LARGE_INTEGER qpf;
-    uint64_t lastQpcNow = 0;
 
     QueryPerformanceFrequency(&qpf);
 
@@ -77,43 +77,27 @@ void SlateCameraRenderer::CameraUpdateThread(SlateCameraRenderer* pSlateCameraRe
         HRESULT hr = S_OK;
         IResearchModeSensorFrame* pSensorFrame = nullptr;
         LARGE_INTEGER qpcNow;
-        uint64_t uqpcNow;
-        QueryPerformanceCounter(&qpcNow);
-        uqpcNow = qpcNow.QuadPart;
         ResearchModeSensorTimestamp timeStamp;
 
         winrt::check_hresult(pSlateCameraRenderer->m_pRMCameraSensor->GetNextBuffer(&pSensorFrame));
+        QueryPerformanceCounter(&qpcNow);
 
         pSensorFrame->GetTimeStamp(&timeStamp);
 
         {
-            if (lastQpcNow != 0)
-            {
-                pSlateCameraRenderer->m_refreshTimeInMilliseconds =
-                    (1000 *
-                    (uqpcNow - lastQpcNow)) /
-                    qpf.QuadPart;
-            }
-
-            if (pSlateCameraRenderer->m_lastHostTicks != 0)
-            {
-                pSlateCameraRenderer->m_sensorRefreshTime = timeStamp.HostTicks - pSlateCameraRenderer->m_lastHostTicks;
-            }
+            StreamTelemetry& telemetry = *pSlateCameraRenderer->m_telemetry;
+            const uint64_t receivedUs = TicksToMicroseconds(qpcNow.QuadPart, qpf.QuadPart);
+            const uint64_t frameUs = TicksToMicroseconds(timeStamp.HostTicks, timeStamp.HostTicksPerSecond);
+            telemetry.Record(TelemetryMetric::SensorToHost, receivedUs > frameUs ? receivedUs - frameUs : 0);
 
-            std::lock_guard<std::mutex> guard(pSlateCameraRenderer->m_mutex);
-
-            if (pSlateCameraRenderer->m_frameCallback)
+            if (pSlateCameraRenderer->m_lastHostTicks != 0 && timeStamp.HostTicks > pSlateCameraRenderer->m_lastHostTicks)
             {
-                pSlateCameraRenderer->m_frameCallback(pSensorFrame, pSlateCameraRenderer->m_frameCtx);
+                telemetry.Record(TelemetryMetric::Interval, TicksToMicroseconds(timeStamp.HostTicks - pSlateCameraRenderer->m_lastHostTicks, timeStamp.HostTicksPerSecond));
             }
 
-            if (pSlateCameraRenderer->m_pSensorFrame)
-            {
-                pSlateCameraRenderer->m_pSensorFrame->Release();
-            }
+            // The bus takes over the reference returned by GetNextBuffer
+            pSlateCameraRenderer->m_frameBus.Publish(FrameRef<IResearchModeSensorFrame>::Attach(pSensorFrame));
 
-            pSlateCameraRenderer->m_pSensorFrame = pSensorFrame;
-            lastQpcNow = uqpcNow;
             pSlateCameraRenderer->m_lastHostTicks = timeStamp.HostTicks;
         }
     }
@@ -126,16 +110,19 @@ void SlateCameraRenderer::CameraUpdateThread(SlateCameraRenderer* pSlateCameraRe
 
 void SlateCameraRenderer::UpdateSlateTexture()
 {
-    char printString[1000];
+    FrameRef<IResearchModeSensorFrame> sensorFrame;
 
-    if (m_pSensorFrame)
+    // The texture keeps showing the last frame until a new one is published
+    if (m_renderQueue->TryPop(sensorFrame))
     {
-        EnsureTextureForCameraFrame(m_pSensorFrame);
+        const auto uploadStart = std::chrono::steady_clock::now();
 
-        UpdateTextureFromCameraFrame(m_pSensorFrame, m_texture2D);
+        EnsureTextureForCameraFrame(sensorFrame.Get());
 
-        sprintf(printString, "####CameraSlate %I64d %I64d\n", m_refreshTimeInMilliseconds, m_sensorRefreshTime);
-        //OutputDebugStringA(printString);
+        UpdateTextureFromCameraFrame(sensorFrame.Get(), m_texture2D);
+
+        m_telemetry->Record(TelemetryMetric::Processing,
+            std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - uploadStart).count());
     }
 }
 
@@ -166,36 +153,6 @@ void SlateCameraRenderer::EnsureTextureForCameraFrame(IResearchModeSensorFrame*
     }
 }
 
-BYTE ConvertDepthPixel(USHORT v, BYTE bSigma, USHORT mask, USHORT maxshort, const int vmin, const int vmax)
-{
-    if ((mask != 0) && (bSigma & mask) > 0)
-    {
-        v = 0;
-    }
-
-    if ((maxshort != 0) && (v > maxshort))
-    {
-        v = 0;
-    }
-    
-    float colorValue = 0.0f;
-    if (v <= vmin)
-    {
-        colorValue = 0.0f;
-    }
-    else if (v >= vmax)
-    {
-        colorValue = 1.0f;
-    }
-    else
-    {
-        colorValue = (float)(v - vmin) / (float)(vmax - vmin);
-    }
-
-    return (BYTE)(colorValue * 255);
-}
-
-
 void SlateCameraRenderer::UpdateTextureFromCameraFrame(IResearchModeSensorFrame* pSensorFrame, std::shared_ptr<Texture2D> texture2D)
 {
     HRESULT hr = S_OK;
@@ -232,54 +189,23 @@ void SlateCameraRenderer::UpdateTextureFromCameraFrame(IResearchModeSensorFrame*
             texture2D->MapCPUTexture<void>(
                 D3D11_MAP_WRITE /* mapType */);
 
-        for (UINT i = 0; i < resolution.Height; i++)
+        switch (m_pRMCameraSensor->GetSensorType())
         {
-            for (UINT j = 0; j < resolution.Width; j++)
-            {
-                UINT32 pixel = 0;
-                BYTE inputPixel = pImage[resolution.Width * i + j];
-                pixel = inputPixel | (inputPixel << 8) | (inputPixel << 16);
-
-                if (m_pRMCameraSensor->GetSensorType() == LEFT_FRONT)
-                {
-                    *((UINT32*)(mappedTexture)+((texture2D->GetRowPitch() / 4) * i + (resolution.Width - j - 1))) = pixel;
-                }
-                else if (m_pRMCameraSensor->GetSensorType() == RIGHT_FRONT)
-                {
-                    *((UINT32*)(mappedTexture)+((texture2D->GetRowPitch() / 4) * (resolution.Height - i - 1) + j)) = pixel;
-                }
-                else
-                {
-                    *((UINT32*)(mappedTexture)+((m_texture2D->GetRowPitch() / 4) * i + j)) = pixel;
-                }
-            }
+        case LEFT_FRONT:
+            GrayToBgra<SlateOrientation::MirrorX>(pImage, resolution.Width, resolution.Height, mappedTexture, texture2D->GetRowPitch());
+            break;
+        case RIGHT_FRONT:
+            GrayToBgra<SlateOrientation::FlipY>(pImage, resolution.Width, resolution.Height, mappedTexture, texture2D->GetRowPitch());
+            break;
+        default:
+            GrayToBgra<SlateOrientation::Identity>(pImage, resolution.Width, resolution.Height, mappedTexture, texture2D->GetRowPitch());
+            break;
         }
     }
 
     if (pDepthFrame)
     {
-        int maxClampDepth = 0;
-        USHORT maxshort = 0;
-        USHORT mask = 0;
         const BYTE *pSigma = nullptr;
-
-        if (m_pRMCameraSensor->GetSensorType() == DEPTH_LONG_THROW)
-        {
-            mask = 0x80;
-            maxClampDepth = 4000;
-        }
-        else if (m_pRMCameraSensor->GetSensorType() == DEPTH_AHAT)
-        {
-            mask = 0x0;
-            maxClampDepth = 1000;
-            maxshort = 4090;
-        }
-
-        if (m_pRMCameraSensor->GetSensorType() == DEPTH_LONG_THROW)
-        {
-            hr = pDepthFrame->GetSigmaBuffer(&pSigma, &outBufferCount);
-        }
-
         const UINT16 *pDepth = nullptr;
         pDepthFrame->GetBuffer(&pDepth, &outBufferCount);
 
@@ -287,48 +213,22 @@ void SlateCameraRenderer::UpdateTextureFromCameraFrame(IResearchModeSensorFrame*
             texture2D->MapCPUTexture<void>(
                 D3D11_MAP_WRITE /* mapType */);
 
-        for (UINT i = 0; i < resolution.Height; i++)
-        {
-            for (UINT j = 0; j < resolution.Width; j++)
-            {
-                UINT32 pixel = 0;
-                BYTE inputPixel = ConvertDepthPixel(
-                    pDepth[resolution.Width * i + j],
-                    pSigma ? pSigma[resolution.Width * i + j] : 0,
-                    mask,
-                    maxshort,
-                    0,
-                    maxClampDepth);
-
-                pixel = inputPixel | (inputPixel << 8) | (inputPixel << 16);
-
-                *((UINT32*)(mappedTexture)+((texture2D->GetRowPitch() / 4) * i + (resolution.Width - j - 1))) = pixel;
-            }
-        }
-
         if (m_pRMCameraSensor->GetSensorType() == DEPTH_LONG_THROW)
         {
             const UINT16 *pAbImage = nullptr;
+            hr = pDepthFrame->GetSigmaBuffer(&pSigma, &outBufferCount);
             pDepthFrame->GetAbDepthBuffer(&pAbImage, &outBufferCount);
 
-            for (UINT i = 0; i < resolution.Height; i++)
-            {
-                for (UINT j = 0; j < resolution.Width; j++)
-                {
-                    UINT32 pixel = 0;
-                    BYTE inputPixel = ConvertDepthPixel(
-                        pAbImage[resolution.Width * i + j],
-                        pSigma ? pSigma[resolution.Width * i + j] : 0,
-                        mask,
-                        maxshort,
-                        0,
-                        maxClampDepth);
-
-                    pixel = inputPixel | (inputPixel << 8) | (inputPixel << 16);
-
-                    *((UINT32*)(mappedTexture)+((texture2D->GetRowPitch() / 4) * i + resolution.Width + (resolution.Width - j - 1))) = pixel;
-                }
-            }
+            // Depth on the left half of the texture, active brightness on the right half
+            DepthToBgra<SlateOrientation::MirrorX, LongThrowDepthRange>(
+                pDepth, pSigma, resolution.Width, resolution.Height, mappedTexture, texture2D->GetRowPitch());
+            DepthToBgra<SlateOrientation::MirrorX, LongThrowDepthRange>(
+                pAbImage, pSigma, resolution.Width, resolution.Height, (UINT32*)(mappedTexture) + resolution.Width, texture2D->GetRowPitch());
+        }
+        else if (m_pRMCameraSensor->GetSensorType() == DEPTH_AHAT)
+        {
+            DepthToBgra<SlateOrientation::MirrorX, AhatDepthRange>(
+                pDepth, pSigma, resolution.Width, resolution.Height, mappedTexture, texture2D->GetRowPitch());
         }
     }
     
@@ -16,6 +16,8 @@
 #include "ShaderStructures.h"
 #include "researchmode\ResearchModeApi.h"
 #include "ModelRenderer.h"
+#include "SensorFrameBus.h"
+#include "StreamTelemetry.h"
 
 namespace BasicHologram
 {
@@ -28,13 +30,15 @@ namespace BasicHologram
         {
             m_pRMCameraSensor = pLLSensor;
             m_pRMCameraSensor->AddRef();
-            m_pSensorFrame = nullptr;
-            m_frameCallback = nullptr;
+            m_telemetry = std::make_shared<StreamTelemetry>(winrt::to_string(m_pRMCameraSensor->GetFriendlyName()));
             m_slateWidth = fWidth;
             m_slateHeight = fHeight;
 
             m_pixelShaderFile = L"ms-appx:///PixelShader.cso";
 
+            // The slate only shows the latest frame
+            m_renderQueue = m_frameBus.Subscribe(1, FrameDropPolicy::DropOldest);
+
             m_pCameraUpdateThread = new std::thread(CameraUpdateThread, this, hasData, pCamAccessConsent);
         }
         virtual ~SlateCameraRenderer()
@@ -54,10 +58,11 @@ namespace BasicHologram
             return DirectX::XMMatrixRotationAxis(DirectX::XMVectorSet(0.f, 1.f, 0.f, 0.f), -DirectX::XM_PIDIV2);
         }
 
-        void SetFrameCallBack(std::function<void(IResearchModeSensorFrame*, PVOID frameCtx)> frameCallback, PVOID frameCtx)
+        // Every frame captured by the sensor is published once on the bus,
+        // subscribe a queue to it to process the frames on another thread
+        FrameBus<IResearchModeSensorFrame>& GetFrameBus()
         {
-            m_frameCallback = frameCallback;
-            m_frameCtx = frameCtx;
+            return m_frameBus;
         }
 
         ResearchModeSensorType GetSensorType()
@@ -70,6 +75,12 @@ namespace BasicHologram
             return m_lastHostTicks;
         }
 
+        // Timing of the frames, from the capture to the texture upload
+        std::shared_ptr<StreamTelemetry> GetTelemetry() const
+        {
+            return m_telemetry;
+        }
+
     protected:
 
         void GetModelVertices(std::vector<VertexPositionColor> &returnedModelVertices);
@@ -84,16 +95,14 @@ namespace BasicHologram
         static void CameraUpdateThread(SlateCameraRenderer* pSlateCameraRenderer, HANDLE hasData, ResearchModeSensorConsent *pCamAccessConsent);
 
 		IResearchModeSensor *m_pRMCameraSensor = nullptr;
-		IResearchModeSensorFrame* m_pSensorFrame;
-        uint64_t m_refreshTimeInMilliseconds = 0;
-        uint64_t m_sensorRefreshTime = 0;
         uint64_t m_lastHostTicks = 0;
+        std::shared_ptr<StreamTelemetry> m_telemetry;
 
         float m_slateWidth;
         float m_slateHeight;
 
-        std::function<void(IResearchModeSensorFrame*, PVOID frameCtx)> m_frameCallback;
-        PVOID m_frameCtx;
+        FrameBus<IResearchModeSensorFrame> m_frameBus;
+        std::shared_ptr<FrameQueue<IResearchModeSensorFrame>> m_renderQueue;
 
         std::thread *m_pCameraUpdateThread;
         bool m_fExit = { false };
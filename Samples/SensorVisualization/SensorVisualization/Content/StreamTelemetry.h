@@ -0,0 +1,372 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+#pragma once
+
+// Timing telemetry of the sensor loops: every stream records its
+// sensor-to-host latency, the interval between frames and its processing
+// time into fixed-size histograms. Recording is lock-free and never
+// allocates, so it stays on in release builds; the registry summarizes the
+// histograms on request, and a background thread appends them to a CSV file
+// to spot dropped frames and jitter without a debugger attached.
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace BasicHologram
+{
+    // Converts ticks of a counter running at frequency ticks per second, without overflowing
+    inline uint64_t TicksToMicroseconds(uint64_t ticks, uint64_t frequency)
+    {
+        return (ticks / frequency) * 1000000 + ((ticks % frequency) * 1000000) / frequency;
+    }
+
+    struct LatencySummary
+    {
+        uint64_t count = 0;
+        double meanUs = 0.0;
+        uint64_t p50Us = 0;
+        uint64_t p90Us = 0;
+        uint64_t p99Us = 0;
+        uint64_t maxUs = 0;
+        // Values above 1.5 times the median: on an interval histogram, the
+        // frames that came late or were dropped
+        uint64_t longCount = 0;
+    };
+
+    // Histogram of durations in microseconds: exact below 32us, then sixteen
+    // buckets per power of two (at most 6% wide) up to about nine hours.
+    class LatencyHistogram
+    {
+    public:
+        static constexpr size_t kSubBucketBits = 4;
+        static constexpr size_t kSubBucketCount = 1 << kSubBucketBits;
+        static constexpr size_t kBucketCount = 512;
+
+        struct Counts
+        {
+            std::array<uint64_t, kBucketCount> buckets = {};
+            uint64_t count = 0;
+            uint64_t sumUs = 0;
+            uint64_t maxUs = 0;
+        };
+
+        void Record(uint64_t us)
+        {
+            m_buckets[BucketIndex(us)].fetch_add(1, std::memory_order_relaxed);
+            m_sumUs.fetch_add(us, std::memory_order_relaxed);
+            UpdateMax(m_maxUs, us);
+            UpdateMax(m_windowMaxUs, us);
+        }
+
+        // Totals since the creation. The counters are read one by one, so a
+        // concurrent Record may be only partly visible
+        Counts Read() const
+        {
+            Counts counts;
+            for (size_t i = 0; i < kBucketCount; i++)
+            {
+                counts.buckets[i] = m_buckets[i].load(std::memory_order_relaxed);
+                counts.count += counts.buckets[i];
+            }
+            counts.sumUs = m_sumUs.load(std::memory_order_relaxed);
+            counts.maxUs = m_maxUs.load(std::memory_order_relaxed);
+            return counts;
+        }
+
+        // Largest value since the previous call, for the periodic reports
+        uint64_t TakeWindowMax()
+        {
+            return m_windowMaxUs.exchange(0, std::memory_order_relaxed);
+        }
+
+        static LatencySummary Summarize(const Counts& counts)
+        {
+            LatencySummary summary;
+            summary.count = counts.count;
+            summary.maxUs = counts.maxUs;
+            if (counts.count == 0)
+            {
+                return summary;
+            }
+
+            summary.meanUs = static_cast<double>(counts.sumUs) / counts.count;
+            summary.p50Us = std::min(Percentile(counts, 0.50), counts.maxUs);
+            summary.p90Us = std::min(Percentile(counts, 0.90), counts.maxUs);
+            summary.p99Us = std::min(Percentile(counts, 0.99), counts.maxUs);
+
+            const uint64_t longThreshold = summary.p50Us + summary.p50Us / 2;
+            for (size_t i = 0; i < kBucketCount; i++)
+            {
+                if (BucketLowerBound(i) > longThreshold)
+                {
+                    summary.longCount += counts.buckets[i];
+                }
+            }
+            return summary;
+        }
+
+        static size_t BucketIndex(uint64_t us)
+        {
+            if (us < 2 * kSubBucketCount)
+            {
+                return static_cast<size_t>(us);
+            }
+
+            size_t exponent = kSubBucketBits + 1;
+            while ((us >> (exponent + 1)) != 0)
+            {
+                exponent++;
+            }
+            const size_t subBucket = static_cast<size_t>(us >> (exponent - kSubBucketBits)) & (kSubBucketCount - 1);
+            const size_t index = (exponent - kSubBucketBits + 1) * kSubBucketCount + subBucket;
+            return std::min(index, kBucketCount - 1);
+        }
+
+        static uint64_t BucketLowerBound(size_t index)
+        {
+            if (index < 2 * kSubBucketCount)
+            {
+                return index;
+            }
+            const size_t exponent = index / kSubBucketCount + kSubBucketBits - 1;
+            return static_cast<uint64_t>(kSubBucketCount + index % kSubBucketCount) << (exponent - kSubBucketBits);
+        }
+
+    private:
+        static void UpdateMax(std::atomic<uint64_t>& max, uint64_t us)
+        {
+            uint64_t current = max.load(std::memory_order_relaxed);
+            while (us > current && !max.compare_exchange_weak(current, us, std::memory_order_relaxed))
+            {
+            }
+        }
+
+        // Middle of the bucket holding the given fraction of the values
+        static uint64_t Percentile(const Counts& counts, double fraction)
+        {
+            const uint64_t rank = static_cast<uint64_t>(fraction * (counts.count - 1));
+            uint64_t seen = 0;
+            for (size_t i = 0; i < kBucketCount; i++)
+            {
+                seen += counts.buckets[i];
+                if (seen > rank)
+                {
+                    const uint64_t lower = BucketLowerBound(i);
+                    const uint64_t upper = i + 1 < kBucketCount ? BucketLowerBound(i + 1) : lower;
+                    return lower + (upper - lower) / 2;
+                }
+            }
+            return counts.maxUs;
+        }
+
+        std::array<std::atomic<uint64_t>, kBucketCount> m_buckets = {};
+        std::atomic<uint64_t> m_sumUs = { 0 };
+        std::atomic<uint64_t> m_maxUs = { 0 };
+        std::atomic<uint64_t> m_windowMaxUs = { 0 };
+    };
+
+    enum class TelemetryMetric
+    {
+        SensorToHost,   // host time when the frame is received minus its timestamp
+        Interval,       // between the timestamps of two consecutive frames
+        Processing,     // spent by the consumer on the frame (texture upload...)
+        Count
+    };
+
+    inline const char* TelemetryMetricName(TelemetryMetric metric)
+    {
+        switch (metric)
+        {
+        case TelemetryMetric::SensorToHost:
+            return "sensor_to_host";
+        case TelemetryMetric::Interval:
+            return "interval";
+        case TelemetryMetric::Processing:
+            return "processing";
+        default:
+            return "unknown";
+        }
+    }
+
+    // Histograms of one stream, written by the sensor loop and its consumers
+    class StreamTelemetry
+    {
+    public:
+        explicit StreamTelemetry(const std::string& name) :
+            m_name(name)
+        {
+        }
+
+        const std::string& GetName() const
+        {
+            return m_name;
+        }
+
+        void Record(TelemetryMetric metric, uint64_t us)
+        {
+            m_histograms[static_cast<size_t>(metric)].Record(us);
+        }
+
+        LatencyHistogram& GetHistogram(TelemetryMetric metric)
+        {
+            return m_histograms[static_cast<size_t>(metric)];
+        }
+
+    private:
+        const std::string m_name;
+        std::array<LatencyHistogram, static_cast<size_t>(TelemetryMetric::Count)> m_histograms;
+    };
+
+    struct TelemetryReport
+    {
+        std::string stream;
+        TelemetryMetric metric;
+        LatencySummary summary;
+    };
+
+    class TelemetryRegistry
+    {
+    public:
+        ~TelemetryRegistry()
+        {
+            StopCsvWriter();
+        }
+
+        void Register(const std::shared_ptr<StreamTelemetry>& stream)
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            m_streams.push_back({ stream, {} });
+        }
+
+        // Totals since the streams started, one report per stream and metric
+        std::vector<TelemetryReport> Snapshot()
+        {
+            std::vector<TelemetryReport> reports;
+            std::lock_guard<std::mutex> guard(m_mutex);
+            for (auto& entry : m_streams)
+            {
+                for (size_t metric = 0; metric < static_cast<size_t>(TelemetryMetric::Count); metric++)
+                {
+                    const LatencyHistogram::Counts counts = entry.stream->GetHistogram(static_cast<TelemetryMetric>(metric)).Read();
+                    reports.push_back({ entry.stream->GetName(), static_cast<TelemetryMetric>(metric), LatencyHistogram::Summarize(counts) });
+                }
+            }
+            return reports;
+        }
+
+        // Appends, every period, the summary of the values recorded during
+        // that period to a CSV file
+        void StartCsvWriter(const std::wstring& path, std::chrono::milliseconds period)
+        {
+            StopCsvWriter();
+
+            m_file.open(path, std::ios::out | std::ios::app);
+            if (!m_file.is_open())
+            {
+                return;
+            }
+            m_file << "time_s,stream,metric,count,mean_us,p50_us,p90_us,p99_us,max_us,long_count\n";
+
+            m_stopWriter = false;
+            m_writerStart = std::chrono::steady_clock::now();
+            m_writerThread = std::thread([this, period]
+            {
+                std::unique_lock<std::mutex> lock(m_writerMutex);
+                while (!m_writerCondVar.wait_for(lock, period, [this] { return m_stopWriter; }))
+                {
+                    WriteWindow();
+                }
+                WriteWindow();
+            });
+        }
+
+        void StopCsvWriter()
+        {
+            if (!m_writerThread.joinable())
+            {
+                return;
+            }
+            {
+                std::lock_guard<std::mutex> guard(m_writerMutex);
+                m_stopWriter = true;
+                m_writerCondVar.notify_all();
+            }
+            m_writerThread.join();
+            m_file.close();
+        }
+
+    private:
+        struct Entry
+        {
+            std::shared_ptr<StreamTelemetry> stream;
+            std::array<LatencyHistogram::Counts, static_cast<size_t>(TelemetryMetric::Count)> written;
+        };
+
+        void WriteWindow()
+        {
+            const double time = std::chrono::duration<double>(std::chrono::steady_clock::now() - m_writerStart).count();
+
+            std::lock_guard<std::mutex> guard(m_mutex);
+            for (auto& entry : m_streams)
+            {
+                for (size_t metric = 0; metric < static_cast<size_t>(TelemetryMetric::Count); metric++)
+                {
+                    LatencyHistogram& histogram = entry.stream->GetHistogram(static_cast<TelemetryMetric>(metric));
+                    const LatencyHistogram::Counts counts = histogram.Read();
+                    LatencyHistogram::Counts& written = entry.written[metric];
+
+                    // Only what was recorded since the previous line
+                    LatencyHistogram::Counts window;
+                    for (size_t i = 0; i < LatencyHistogram::kBucketCount; i++)
+                    {
+                        window.buckets[i] = counts.buckets[i] - written.buckets[i];
+                        window.count += window.buckets[i];
+                    }
+                    window.sumUs = counts.sumUs - written.sumUs;
+                    window.maxUs = histogram.TakeWindowMax();
+                    written = counts;
+
+                    if (window.count == 0)
+                    {
+                        continue;
+                    }
+
+                    const LatencySummary summary = LatencyHistogram::Summarize(window);
+                    m_file << time << "," << entry.stream->GetName() << "," << TelemetryMetricName(static_cast<TelemetryMetric>(metric)) << ","
+                           << summary.count << "," << summary.meanUs << "," << summary.p50Us << "," << summary.p90Us << ","
+                           << summary.p99Us << "," << summary.maxUs << "," << summary.longCount << "\n";
+                }
+            }
+            m_file.flush();
+        }
+
+        std::mutex m_mutex;
+        std::vector<Entry> m_streams;
+
+        std::mutex m_writerMutex;
+        std::condition_variable m_writerCondVar;
+        std::thread m_writerThread;
+        bool m_stopWriter = false;
+        std::chrono::steady_clock::time_point m_writerStart;
+        std::ofstream m_file;
+    };
+}
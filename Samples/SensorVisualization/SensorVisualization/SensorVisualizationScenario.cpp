@@ -215,6 +215,7 @@ void SensorVisualizationScenario::IntializeModelRendering()
 
         slateCameraRenderer->SetOffset(offset);
         m_modelRenderers.push_back(slateCameraRenderer);
+        m_telemetry.Register(slateCameraRenderer->GetTelemetry());
 
         pLLSlateCameraRenderer = slateCameraRenderer.get();
 
@@ -233,6 +234,7 @@ void SensorVisualizationScenario::IntializeModelRendering()
 
         slateCameraRenderer->SetOffset(offset);
         m_modelRenderers.push_back(slateCameraRenderer);
+        m_telemetry.Register(slateCameraRenderer->GetTelemetry());
     }
 
     if (m_pLTSensor)
@@ -250,6 +252,7 @@ void SensorVisualizationScenario::IntializeModelRendering()
         slateCameraRenderer->SetOffset(offset);
         slateCameraRenderer->SetModelTransform(modelRotation);
         m_modelRenderers.push_back(slateCameraRenderer);
+        m_telemetry.Register(slateCameraRenderer->GetTelemetry());
 
         m_LTCameraRenderer = slateCameraRenderer;
     }
@@ -266,22 +269,31 @@ void SensorVisualizationScenario::IntializeModelRendering()
 
         slateCameraRenderer->SetOffset(offset);
         m_modelRenderers.push_back(slateCameraRenderer);
+        m_telemetry.Register(slateCameraRenderer->GetTelemetry());
     }
 
     if (m_pAccelSensor)
     {
         m_AccelRenderer = std::make_shared<AccelRenderer>(m_deviceResources, m_pAccelSensor, imuConsentGiven, &imuAccessCheck);
+        m_telemetry.Register(m_AccelRenderer->GetTelemetry());
     }
 
     if (m_pGyroSensor)
     {
         m_GyroRenderer = std::make_shared<GyroRenderer>(m_deviceResources, m_pGyroSensor, imuConsentGiven, &imuAccessCheck);
+        m_telemetry.Register(m_GyroRenderer->GetTelemetry());
     }
 
     if (m_pMagSensor)
     {
         m_MagRenderer = std::make_shared<MagRenderer>(m_deviceResources, m_pMagSensor, imuConsentGiven, &imuAccessCheck);
+        m_telemetry.Register(m_MagRenderer->GetTelemetry());
     }
+
+    // Latency, frame interval and processing time of every stream, summarized
+    // every few seconds, e.g. to spot dropped frames on a device in use
+    std::wstring telemetryPath = std::wstring(winrt::Windows::Storage::ApplicationData::Current().LocalFolder().Path()) + L"\\telemetry.csv";
+    m_telemetry.StartCsvWriter(telemetryPath, std::chrono::seconds(5));
 }
 
 void SensorVisualizationScenario::PositionHologram(winrt::Windows::UI::Input::Spatial::SpatialPointerPose const& pointerPose, const DX::StepTimer& timer)
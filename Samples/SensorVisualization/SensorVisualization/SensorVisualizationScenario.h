@@ -34,6 +34,12 @@ namespace BasicHologram
         static void CamAccessOnComplete(ResearchModeSensorConsent consent);
         static void ImuAccessOnComplete(ResearchModeSensorConsent consent);
 
+        // Timing histograms of the sensor streams, for in-app queries
+        TelemetryRegistry& GetTelemetry()
+        {
+            return m_telemetry;
+        }
+
     protected:
 
         IResearchModeSensorDevice *m_pSensorDevice;
@@ -57,5 +63,7 @@ namespace BasicHologram
         std::shared_ptr<MagRenderer>                                m_MagRenderer;
         std::shared_ptr<SlateCameraRenderer>                        m_LFCameraRenderer;
         std::shared_ptr<SlateCameraRenderer>                        m_LTCameraRenderer;
+
+        TelemetryRegistry                                           m_telemetry;
     };
 }
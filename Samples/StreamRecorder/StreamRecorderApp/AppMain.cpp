@@ -10,8 +10,10 @@
 //*********************************************************
 
 #include "AppMain.h"
+#include "StringHelpers.h"
 #include <winrt/Windows.Foundation.h>
 #include <ctime>
+#include <fstream>
 
 using namespace DirectX;
 using namespace std;
@@ -23,7 +25,10 @@ enum class ButtonID
 	Stop
 };
 
-// Set streams to capture
+// Files sent when a streamed recording stops are read and sent this much at a time
+static constexpr size_t kStreamedFileChunkBytes = 1024 * 1024;
+
+// Default streams to capture, when there is no kStreamSettingsFileName file
 /* Supported ResearchMode streams:
 {
 	LEFT_FRONT,
@@ -31,9 +36,13 @@ enum class ButtonID
 	RIGHT_FRONT,
 	RIGHT_RIGHT,
 	DEPTH_AHAT,
-	DEPTH_LONG_THROW
+	DEPTH_LONG_THROW,
+	IMU_ACCEL,
+	IMU_GYRO,
+	IMU_MAG
 }*/
-// Note that concurrent access to AHAT and Long Throw is currently not supported
+// Note that concurrent access to AHAT and Long Throw is currently not supported.
+// IMU streams save every sample to <sensor>_imu.bin, see RMImuReader.h
 std::vector<ResearchModeSensorType> AppMain::kEnabledRMStreamTypes = { ResearchModeSensorType::DEPTH_LONG_THROW };
 /* Supported not-ResearchMode streams:
 {
@@ -42,8 +51,57 @@ std::vector<ResearchModeSensorType> AppMain::kEnabledRMStreamTypes = { ResearchM
 }*/
 std::vector<StreamTypes> AppMain::kEnabledStreamTypes = { StreamTypes::PV };
 
+// Stream settings: when the app's LocalState folder holds a kStreamSettingsFileName file (it can be
+// uploaded with the Device Portal file explorer), the streams listed in it are captured instead of
+// the default ones, one per line, each optionally followed by its rate: N to record every Nth frame,
+// or Xfps to record at most X frames per second, e.g. "LEFT_FRONT 3" or "PV 5fps" (see StreamSettings.h).
+// The other frames are dropped before being copied or converted. The streams are selected at launch,
+// the rates are read again when a recording starts; the settings of a recording are saved in
+// <recording>_streams.txt, in the same format
+const wchar_t AppMain::kStreamSettingsFileName[] = L"stream_settings.txt";
+
+// Pre-roll: when kPreRollSeconds > 0, every stream keeps its last kPreRollSeconds of frames
+// in memory while not recording (at most kPreRollMaxBytesPerStream bytes per stream), and
+// writes them at the beginning of the next recording. PV frames take about 1.3MB each
+const float AppMain::kPreRollSeconds = 0.0f;
+const size_t AppMain::kPreRollMaxBytesPerStream = 256 * 1024 * 1024;
+
+// Trigger-based recording: when kTriggerConditions is not TriggerNone, Start arms the recording,
+// and the frames are only written from kTriggerPreSeconds before any of the conditions holds
+// to kTriggerPostSeconds after none of them holds anymore. Conditions can be combined, e.g.
+// TriggerHeadMotion | TriggerHandsPresent | TriggerQRCodeVisible. The frames before a trigger
+// event come from the pre-roll buffers, which are enabled for kTriggerPreSeconds at least
+const unsigned AppMain::kTriggerConditions = TriggerNone;
+const float AppMain::kTriggerPreSeconds = 2.0f;
+const float AppMain::kTriggerPostSeconds = 3.0f;
+const float AppMain::kTriggerHeadSpeed = 0.5f;			// meters per second
+const float AppMain::kTriggerHeadAngularSpeed = 90.0f;	// degrees per second
+
+// Live streaming: when kStreamingHost is not empty, the camera frames, the PV frames and the head,
+// hand and eye poses are sent over TCP to StreamRecorderConverter/stream_receiver.py running on that
+// host while recording, instead of being written to tarballs on the device. The other files
+// (calibration, poses, IMU samples) are written on the device as usual, and sent in the background
+// when the recording stops; the next recording waits for them. The recording goes to the device
+// when the host cannot be reached
+const wchar_t AppMain::kStreamingHost[] = L"";
+const wchar_t AppMain::kStreamingPort[] = L"23940";
+
+// Recording governor: when kGovernorEnabled is true, while recording, the frame bytes written per
+// second, the time the writers spend writing and the frames they miss are checked every second
+// against a budget. Under pressure, the streams are throttled one step at a time: VLC at half rate,
+// no VLC, PV in NV12 rather than BGRA8, PV at half rate, depth at half rate; the steps are lifted
+// when the pressure is gone. No frames are written anymore below kGovernorMinFreeMegabytes of free
+// space. The decisions are saved in <recording>_governor.txt, and the frames written, throttled and
+// missed per stream in <recording>_frame_counts.txt. Disabled by default: throttled recordings miss
+// frames, and tools other than StreamRecorderConverter may not read NV12 PV frames
+const bool AppMain::kGovernorEnabled = false;
+const float AppMain::kGovernorMaxMegabytesPerSecond = 0.0f;	// 0 for no limit
+const unsigned AppMain::kGovernorMinFreeMegabytes = 1024;
+const float AppMain::kGovernorMinRecordingSeconds = 60.0f;	// throttle when the free space lasts less at the current rate
+
 AppMain::AppMain() :
 	m_recording(false),
+	m_preRollEnabled(false),
 	m_currentHeight(1.0f),
 	m_coordAxes("Unlit_VS.cso", "UnlitTexture_PS.cso", make_shared<Mesh>("coord_axes.obj")),
 	m_qrCodeCoordAxes("Unlit_VS.cso", "UnlitTexture_PS.cso", make_shared<Mesh>("coord_axes.obj")),
@@ -72,22 +130,57 @@ AppMain::AppMain() :
 
 	m_hethateyeStream.Clear();
 
+	if (kTriggerConditions != TriggerNone)
+	{
+		TriggerSettings settings;
+		settings.conditions = kTriggerConditions;
+		settings.headSpeed = kTriggerHeadSpeed;
+		settings.headAngularSpeed = kTriggerHeadAngularSpeed;
+		settings.preWindow = static_cast<long long>(kTriggerPreSeconds * 1e7f);
+		settings.postWindow = static_cast<long long>(kTriggerPostSeconds * 1e7f);
+		m_trigger = std::make_shared<TriggerEngine>(settings);
+	}
+
+	if (kGovernorEnabled)
+	{
+		GovernorSettings settings;
+		settings.maxBytesPerSecond = kGovernorMaxMegabytesPerSecond * 1024.0 * 1024.0;
+		settings.minFreeBytes = kGovernorMinFreeMegabytes * 1024ull * 1024ull;
+		settings.minRecordingSeconds = kGovernorMinRecordingSeconds;
+		m_governor = std::make_shared<RecordingGovernor>(settings);
+	}
+
+	if (!ReadStreamSettings(m_streamSettings))
+	{
+		m_streamSettings.rmStreams = kEnabledRMStreamTypes;
+		m_streamSettings.streams = kEnabledStreamTypes;
+	}
 
-	if (AppMain::kEnabledRMStreamTypes.size() > 0)
+	if (m_streamSettings.rmStreams.size() > 0)
 	{
 		// Enable SensorScenario for RM
-		m_scenario = std::make_unique<SensorScenario>(kEnabledRMStreamTypes);
+		m_scenario = std::make_unique<SensorScenario>(m_streamSettings.rmStreams);
 		m_scenario->InitializeSensors();
 		m_scenario->InitializeCameraReaders();
+		m_scenario->InitializeImuReaders();
+		m_scenario->SetStreamRates(m_streamSettings);
+		if (m_trigger)
+		{
+			m_scenario->SetTrigger(m_trigger);
+		}
+		if (m_governor)
+		{
+			m_scenario->SetGovernor(m_governor);
+		}
 	}	
 
-	for (int i = 0; i < kEnabledStreamTypes.size(); ++i)
+	for (int i = 0; i < m_streamSettings.streams.size(); ++i)
 	{
-		if (kEnabledStreamTypes[i] == StreamTypes::PV)
+		if (m_streamSettings.streams[i] == StreamTypes::PV)
 		{
 			m_videoFrameProcessorOperation = InitializeVideoFrameProcessorAsync();
 		}
-		else if (kEnabledStreamTypes[i] == StreamTypes::EYE)
+		else if (m_streamSettings.streams[i] == StreamTypes::EYE)
 		{
 			m_mixedReality.EnableEyeTracking();
 		}
@@ -102,6 +195,11 @@ void AppMain::Update()
 	m_mixedReality.Update();
 	m_hands.UpdateFromMixedReality(m_mixedReality);
 
+	if (!m_preRollEnabled && PreRollSeconds() > 0.0f)
+	{
+		EnablePreRoll();
+	}
+
 	auto startButton = m_menu.GetButton((unsigned)ButtonID::Start);
 	auto stopButton = m_menu.GetButton((unsigned)ButtonID::Stop);
 	startButton->SetDisabled(m_recording || (!IsVideoFrameProcessorWantedAndReady()));
@@ -116,6 +214,11 @@ void AppMain::Update()
 	m_menu.SetRotation(-headForward, XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
 	m_menu.Update(frameDelta, m_hands);
 
+	if (m_recording && m_governor)
+	{
+		m_governor->Update(m_mixedReality.GetPredictedDisplayTime());
+	}
+
 	// Look for a QR code in the scene and get its transformation, if we didn't find one yet;
 	// but do not change the world coordinate system if we're recording already.
 	// Note that, with the current implementation, after finding a QRCode we'll not look
@@ -131,7 +234,8 @@ void AppMain::Update()
 		}
 	}
 
-	if (m_recording)
+	// Head and hands are also tracked before the recording starts, to fill the pre-roll
+	if (m_recording || m_preRollEnabled)
 	{		
 		HeTHaTEyeFrame frame;
 		// Get head transform
@@ -170,14 +274,27 @@ void AppMain::Update()
 		{
 			frame.eyeGazePresent = false;
 		}
-		m_hethateyeStream.AddFrame(std::move(frame));			
-		
+		if (m_recording && m_trigger)
+		{
+			UpdateTrigger(frame);
+		}
+
+		if (m_recording && (!m_trigger || m_trigger->ShouldWrite(frame.timestamp)))
+		{
+			// Frames since the pre-roll window of a trigger event go first
+			m_hethateyeStream.FlushPreRoll();
+			m_hethateyeStream.AddFrame(std::move(frame));
+		}
+		else if (m_hethateyeStream.IsPreRollEnabled())
+		{
+			m_hethateyeStream.AddPreRollFrame(std::move(frame));
+		}
 	}
 	// Roughly estimate user height by projecting a ray from the HL to the floor
 	// using surface mapping.
 	// This is useful for visualization purposes at postprocessing time,
 	// and can be disabled
-	else if (m_mixedReality.IsSurfaceMappingActive())
+	if (!m_recording && m_mixedReality.IsSurfaceMappingActive())
 	{
 		// Find intersection with surface mapping mesh when casting a ray
 		// from head position (projected forwards 1m) in the -y direction
@@ -214,6 +331,17 @@ void AppMain::Update()
 	{
 		debugTextString += "None";
 	}
+	if (m_trigger)
+	{
+		debugTextString += "\nTrigger: ";
+		debugTextString += m_trigger->IsTriggered() ? "on" : "off";
+		debugTextString += ", " + to_string(m_trigger->Windows().size()) + " events";
+	}
+	if (m_governor && m_governor->Level() > 0)
+	{
+		debugTextString += "\nThrottled: ";
+		debugTextString += m_governor->Policy().name;
+	}
 	
 	m_debugText.SetText(debugTextString);
 
@@ -243,6 +371,14 @@ bool AppMain::SetDateTimePath()
 
 winrt::Windows::Foundation::IAsyncAction AppMain::StartRecordingAsync()
 {
+	// The folder of the last streamed recording is replaced below, its files must be sent first
+	if (m_stopStreamingOperation)
+	{
+		auto stopStreamingOperation = m_stopStreamingOperation;
+		m_stopStreamingOperation = nullptr;
+		co_await stopStreamingOperation;
+	}
+
 	StorageFolder localFolder = ApplicationData::Current().LocalFolder();
 	auto archiveSourceFolder = co_await localFolder.CreateFolderAsync(
 																	L"archiveSource",
@@ -251,14 +387,40 @@ winrt::Windows::Foundation::IAsyncAction AppMain::StartRecordingAsync()
 	{
 		m_archiveFolder = archiveSourceFolder;
 
+		// The rates can change between recordings, the streams cannot
+		StreamSettings settings;
+		if (ReadStreamSettings(settings))
+		{
+			m_streamSettings.rmRates = settings.rmRates;
+			m_streamSettings.rates = settings.rates;
+			SetStreamRates();
+		}
+
+		if (kStreamingHost[0] != L'\0')
+		{
+			StartStreaming();
+		}
+		if (m_governor)
+		{
+			m_governor->Start(archiveSourceFolder.Path().c_str(), m_mixedReality.GetPredictedDisplayTime());
+		}
 		if (m_scenario)
 		{
-			m_scenario->StartRecording(archiveSourceFolder, m_mixedReality.GetWorldCoordinateSystem());
+			m_scenario->StartRecording(archiveSourceFolder, m_mixedReality.GetWorldCoordinateSystem(), m_streamClient);
 		}
 		if (m_videoFrameProcessor)
 		{
 			m_videoFrameProcessor->Clear();
-			m_videoFrameProcessor->StartRecording(archiveSourceFolder, m_mixedReality.GetWorldCoordinateSystem());
+			m_videoFrameProcessor->StartRecording(archiveSourceFolder, m_mixedReality.GetWorldCoordinateSystem(), m_streamClient);
+		}
+		if (m_trigger)
+		{
+			m_trigger->Reset();
+		}
+		else
+		{
+			// Head and hand frames tracked while the folder was being created are in the pre-roll
+			m_hethateyeStream.FlushPreRoll();
 		}
 		m_recording = true;
 	}
@@ -286,8 +448,47 @@ void AppMain::StopRecording()
 		m_hethateyeStream.DumpTransformToDisk(m_qrCodeTransform, m_archiveFolder, m_datetime, suffix);
 	}
 
+	if (m_trigger)
+	{
+		// Time intervals during which the trigger conditions held
+		std::wstring fullName(m_archiveFolder.Path().data());
+		fullName += L"\\" + m_datetime + L"_triggers.txt";
+		std::ofstream file(fullName);
+		m_trigger->Write(file);
+	}
+
+	{
+		// Streams recorded and their rates
+		std::wstring fullName(m_archiveFolder.Path().data());
+		fullName += L"\\" + m_datetime + L"_streams.txt";
+		std::ofstream file(fullName);
+		m_streamSettings.Write(file);
+	}
+
+	if (m_governor)
+	{
+		// Throttling decisions, and what became of the frames of every stream
+		std::wstring fullName(m_archiveFolder.Path().data());
+		std::ofstream file(fullName + L"\\" + m_datetime + L"_governor.txt");
+		m_governor->Write(file);
+		std::ofstream countsFile(fullName + L"\\" + m_datetime + L"_frame_counts.txt");
+		m_governor->WriteFrameCounts(countsFile);
+	}
+
 	winrt::hstring archiveName{m_datetime.c_str()};
-	m_archiveFolder.RenameAsync(archiveName);
+	if (m_streamClient)
+	{
+		// The head, hand and eye log is only sent again if lines were dropped
+		const bool posesStreamed = m_hethateyeStream.StopStreaming();
+		const std::wstring sentFileName = posesStreamed ? m_datetime + L"_head_hand_eye.csv" : L"";
+		// The folder is renamed once its files are sent
+		m_stopStreamingOperation = StopStreamingAsync(m_streamClient, m_streamChannel, m_archiveFolder, archiveName, sentFileName);
+		m_streamClient = nullptr;
+	}
+	else
+	{
+		m_archiveFolder.RenameAsync(archiveName);
+	}
 
 	m_archiveFolder = nullptr;
 }
@@ -306,6 +507,16 @@ winrt::Windows::Foundation::IAsyncAction AppMain::InitializeVideoFrameProcessorA
 		throw winrt::hresult(E_POINTER);
 	}
 
+	if (m_trigger)
+	{
+		m_videoFrameProcessor->SetTrigger(m_trigger);
+	}
+	if (m_governor)
+	{
+		m_videoFrameProcessor->SetGovernor(m_governor);
+	}
+	m_videoFrameProcessor->SetStreamRate(m_streamSettings.Rate(StreamTypes::PV));
+
 	co_await m_videoFrameProcessor->InitializeAsync();
 }
 
@@ -315,6 +526,135 @@ bool AppMain::IsVideoFrameProcessorWantedAndReady() const
 		m_videoFrameProcessorOperation.Status() == winrt::Windows::Foundation::AsyncStatus::Completed);
 }
 
+bool AppMain::ReadStreamSettings(StreamSettings& settings) const
+{
+	std::wstring fullName(ApplicationData::Current().LocalFolder().Path().data());
+	fullName += L"\\";
+	fullName += kStreamSettingsFileName;
+	std::ifstream file(fullName);
+	if (!file.is_open())
+	{
+		return false;
+	}
+	// Invalid lines are reported in the debug output and ignored
+	settings.Read(file);
+	return true;
+}
+
+void AppMain::SetStreamRates()
+{
+	if (m_scenario)
+	{
+		m_scenario->SetStreamRates(m_streamSettings);
+	}
+	if (m_videoFrameProcessor)
+	{
+		m_videoFrameProcessor->SetStreamRate(m_streamSettings.Rate(StreamTypes::PV));
+	}
+}
+
+void AppMain::EnablePreRoll()
+{
+	// Poses of the buffered frames are expressed in the world coordinate system
+	// available now, wait for positional tracking and for the PV camera
+	auto worldCoordSystem = m_mixedReality.GetWorldCoordinateSystem();
+	if (!worldCoordSystem || !IsVideoFrameProcessorWantedAndReady())
+	{
+		return;
+	}
+
+	const long long duration = static_cast<long long>(PreRollSeconds() * 1e7f);
+	if (m_scenario)
+	{
+		m_scenario->EnablePreRoll(duration, kPreRollMaxBytesPerStream, worldCoordSystem);
+	}
+	if (m_videoFrameProcessor)
+	{
+		m_videoFrameProcessor->EnablePreRoll(duration, kPreRollMaxBytesPerStream, worldCoordSystem);
+	}
+	m_hethateyeStream.EnablePreRoll(duration, kPreRollMaxBytesPerStream);
+	m_preRollEnabled = true;
+}
+
+float AppMain::PreRollSeconds() const
+{
+	// The frames before a trigger event are taken from the pre-roll buffers
+	return m_trigger ? std::max(kPreRollSeconds, kTriggerPreSeconds) : kPreRollSeconds;
+}
+
+void AppMain::UpdateTrigger(const HeTHaTEyeFrame& frame)
+{
+	TriggerFeatures features;
+	features.timestamp = frame.timestamp;
+	XMStoreFloat3(reinterpret_cast<XMFLOAT3*>(features.headPosition), m_mixedReality.GetHeadPosition());
+	XMStoreFloat3(reinterpret_cast<XMFLOAT3*>(features.headForward), m_mixedReality.GetHeadForwardDirection());
+	features.handPresent = frame.leftHandPresent || frame.rightHandPresent;
+	for (const QRCode& qrcode : m_mixedReality.GetTrackedQRCodeList())
+	{
+		features.qrCodeLastSeen = std::max(features.qrCodeLastSeen, qrcode.lastSeenTimestamp);
+	}
+	m_trigger->Update(features);
+}
+
+void AppMain::StartStreaming()
+{
+	auto streamClient = std::make_shared<Io::StreamClient>();
+	if (!streamClient->Connect(kStreamingHost, kStreamingPort))
+	{
+		return;
+	}
+
+	m_streamChannel = streamClient->AddChannel();
+	streamClient->Send(m_streamChannel, Io::StreamMessageType::Begin, Utf16ToUtf8(m_datetime));
+	m_hethateyeStream.StartStreaming(streamClient, m_datetime);
+	m_streamClient = streamClient;
+}
+
+winrt::Windows::Foundation::IAsyncAction AppMain::StopStreamingAsync(std::shared_ptr<Io::StreamClient> streamClient, uint16_t channel,
+	StorageFolder archiveFolder, winrt::hstring archiveName, std::wstring sentFileName)
+{
+	// Off the UI thread: the files can be large (IMU streams), and the host slow
+	co_await winrt::resume_background();
+
+	// Send the files written to the archive folder (the camera frames went to the host already),
+	// except sentFileName, in chunks of bounded size: the first one creates the file on the host
+	const std::wstring folderPath(archiveFolder.Path().c_str());
+	std::vector<char> chunk(kStreamedFileChunkBytes);
+	WIN32_FIND_DATAW findData;
+	HANDLE hFind = FindFirstFileExW((folderPath + L"\\*").c_str(), FindExInfoBasic, &findData, FindExSearchNameMatch, nullptr, 0);
+	if (hFind != INVALID_HANDLE_VALUE)
+	{
+		do
+		{
+			const std::wstring fileName(findData.cFileName);
+			if ((findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) || fileName == sentFileName)
+			{
+				continue;
+			}
+
+			std::ifstream file(folderPath + L"\\" + fileName, std::ios::binary);
+			const std::string path = Utf16ToUtf8(fileName);
+			Io::StreamMessageType type = Io::StreamMessageType::File;
+			do
+			{
+				file.read(chunk.data(), chunk.size());
+				const Io::Buffer part = { reinterpret_cast<const uint8_t*>(chunk.data()), static_cast<size_t>(file.gcount()) };
+				if (!streamClient->Send(channel, type, path, &part, 1, Io::StreamFlow::Wait))
+				{
+					break;
+				}
+				type = Io::StreamMessageType::FileAppend;
+			} while (file);
+		} while (streamClient->IsConnected() && FindNextFileW(hFind, &findData));
+		FindClose(hFind);
+	}
+
+	streamClient->Send(channel, Io::StreamMessageType::End, "");
+	streamClient->Close();
+
+	co_await archiveFolder.RenameAsync(archiveName);
+}
+
 void AppMain::OnButtonPressed(FloatingSlateButton* pButton)
 {
 	if (pButton->GetID() == (unsigned)ButtonID::Start)
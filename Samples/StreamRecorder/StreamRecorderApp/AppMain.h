@@ -19,16 +19,13 @@
 #include "../Cannon/TrackedHands.h"
 
 #include "HeTHaTEyeStream.h"
+#include "RecordingGovernor.h"
 #include "SensorScenario.h"
+#include "StreamClient.h"
+#include "StreamSettings.h"
+#include "TriggerEngine.h"
 #include "VideoFrameProcessor.h"
 
-enum StreamTypes
-{
-	PV,  // RGB
-	EYE  // Eye gaze tracking
-	// Hands captured by default
-};
-
 class AppMain : public IFloatingSlateButtonCallback
 {
 public:
@@ -46,10 +43,36 @@ public:
 
 	static std::vector<ResearchModeSensorType> kEnabledRMStreamTypes;
 	static std::vector<StreamTypes> kEnabledStreamTypes;
+	static const wchar_t kStreamSettingsFileName[];
+
+	static const float kPreRollSeconds;
+	static const size_t kPreRollMaxBytesPerStream;
+
+	static const unsigned kTriggerConditions;
+	static const float kTriggerPreSeconds;
+	static const float kTriggerPostSeconds;
+	static const float kTriggerHeadSpeed;
+	static const float kTriggerHeadAngularSpeed;
+
+	static const wchar_t kStreamingHost[];
+	static const wchar_t kStreamingPort[];
+
+	static const bool kGovernorEnabled;
+	static const float kGovernorMaxMegabytesPerSecond;
+	static const unsigned kGovernorMinFreeMegabytes;
+	static const float kGovernorMinRecordingSeconds;
 
 private:
 	winrt::Windows::Foundation::IAsyncAction InitializeVideoFrameProcessorAsync();
 	bool IsVideoFrameProcessorWantedAndReady() const;
+	bool ReadStreamSettings(StreamSettings& settings) const;
+	void SetStreamRates();
+	void EnablePreRoll();
+	float PreRollSeconds() const;
+	void UpdateTrigger(const HeTHaTEyeFrame& frame);
+	void StartStreaming();
+	static winrt::Windows::Foundation::IAsyncAction StopStreamingAsync(std::shared_ptr<Io::StreamClient> streamClient, uint16_t channel,
+		winrt::Windows::Storage::StorageFolder archiveFolder, winrt::hstring archiveName, std::wstring sentFileName);
 	inline bool IsQRCodeDetected() { return m_qrCodeValue.length() > 0; };
 	
 	bool SetDateTimePath();
@@ -74,14 +97,27 @@ private:
 	HeTHaTStreamVisualizer m_hethatStreamVis;
 
 	winrt::Windows::Storage::StorageFolder m_archiveFolder = nullptr;
+	// Streams recorded, selected at launch, and their rates.
+	// Declared before m_scenario, which keeps a reference to the RM streams
+	StreamSettings m_streamSettings;
 	std::unique_ptr<SensorScenario> m_scenario = nullptr;;
 
 	std::unique_ptr<VideoFrameProcessor> m_videoFrameProcessor = nullptr;
+	// Null unless recording is trigger-based
+	std::shared_ptr<TriggerEngine> m_trigger = nullptr;
+	// Null unless the recording is governed
+	std::shared_ptr<RecordingGovernor> m_governor = nullptr;
 	winrt::Windows::Foundation::IAsyncAction m_videoFrameProcessorOperation = nullptr;
+	// Null unless the recording is streamed to a host
+	std::shared_ptr<Io::StreamClient> m_streamClient = nullptr;
+	uint16_t m_streamChannel = 0;
+	// Sending the files of the last streamed recording, null when done
+	winrt::Windows::Foundation::IAsyncAction m_stopStreamingOperation = nullptr;
 
 	std::wstring m_datetime;
 
 	Timer m_frameDeltaTimer;
 	bool m_recording;
+	bool m_preRollEnabled;
 	float m_currentHeight;
 };
@@ -14,6 +14,8 @@
 #include <winrt/Windows.Storage.h>
 #include <fstream>
 #include <iomanip>
+#include <sstream>
+#include "StringHelpers.h"
 
 using namespace DirectX;
 using namespace winrt::Windows::Storage;
@@ -27,6 +29,10 @@ HeTHaTEyeStream::HeTHaTEyeStream()
 void HeTHaTEyeStream::AddFrame(HeTHaTEyeFrame&& frame)
 {
     m_hethateyeLog.push_back(std::move(frame));
+    if (m_streamClient)
+    {
+        StreamFrame(m_hethateyeLog.back());
+    }
 }
 
 void HeTHaTEyeStream::Clear()
@@ -34,6 +40,56 @@ void HeTHaTEyeStream::Clear()
     m_hethateyeLog.clear();
 }
 
+void HeTHaTEyeStream::EnablePreRoll(long long duration, size_t maxBytes)
+{
+    m_preRoll = std::make_unique<PreRollBuffer<HeTHaTEyeFrame>>(duration, maxBytes);
+}
+
+bool HeTHaTEyeStream::IsPreRollEnabled() const
+{
+    return m_preRoll != nullptr;
+}
+
+void HeTHaTEyeStream::AddPreRollFrame(HeTHaTEyeFrame&& frame)
+{
+    BufferedFrame<HeTHaTEyeFrame> bufferedFrame;
+    bufferedFrame.timestamp = frame.timestamp;
+    bufferedFrame.hasMetadata = true;
+    bufferedFrame.metadata = std::move(frame);
+    m_preRoll->Push(std::move(bufferedFrame));
+}
+
+void HeTHaTEyeStream::FlushPreRoll()
+{
+    if (!m_preRoll)
+    {
+        return;
+    }
+    for (BufferedFrame<HeTHaTEyeFrame>& frame : m_preRoll->Drain())
+    {
+        m_hethateyeLog.push_back(std::move(frame.metadata));
+        if (m_streamClient)
+        {
+            StreamFrame(m_hethateyeLog.back());
+        }
+    }
+}
+
+void HeTHaTEyeStream::StartStreaming(const std::shared_ptr<Io::StreamClient>& streamClient, const std::wstring& datetime_path)
+{
+    m_streamClient = streamClient;
+    // Lines are small, the window holds a few seconds of them
+    m_streamChannel = streamClient->AddChannel(1024 * 1024);
+    m_streamFileName = Utf16ToUtf8(datetime_path + L"_head_hand_eye.csv");
+    m_streamComplete = true;
+}
+
+bool HeTHaTEyeStream::StopStreaming()
+{
+    m_streamClient = nullptr;
+    return m_streamComplete;
+}
+
 size_t HeTHaTEyeStream::FrameCount() const
 {
     return m_hethateyeLog.size();
@@ -102,6 +158,29 @@ void DumpEyeGazeIfPresentElseZero(bool present, const XMVECTOR& origin, const XM
     out << "," << distance;
 }
 
+// One line of the head_hand_eye.csv file, without the end of line
+void WriteFrame(const HeTHaTEyeFrame& frame, std::ostream& out)
+{
+    out << frame.timestamp << ",";
+    out << frame.headTransform;
+    out << ",";
+    out << frame.leftHandPresent;
+    for (int j = 0; j < (int)HandJointIndex::Count; ++j)
+    {
+        out << ",";
+        DumpHandIfPresentElseZero(frame.leftHandPresent, frame.leftHandTransform[j], out);
+    }
+    out << ",";
+    out << frame.rightHandPresent;
+    for (int j = 0; j < (int)HandJointIndex::Count; ++j)
+    {
+        out << ",";
+        DumpHandIfPresentElseZero(frame.rightHandPresent, frame.rightHandTransform[j], out);
+    }
+    out << ",";
+    DumpEyeGazeIfPresentElseZero(frame.eyeGazePresent, frame.eyeGazeOrigin, frame.eyeGazeDirection, frame.eyeGazeDistance, out);
+}
+
 bool HeTHaTEyeStream::DumpToDisk(const StorageFolder& folder, const std::wstring& datetime_path) const
 {  
     auto path = folder.Path().data();
@@ -115,30 +194,27 @@ bool HeTHaTEyeStream::DumpToDisk(const StorageFolder& folder, const std::wstring
 
     for (const HeTHaTEyeFrame& frame : m_hethateyeLog)
     {
-        file << frame.timestamp << ",";
-        file << frame.headTransform;
-        file << ",";
-        file << frame.leftHandPresent;
-        for (int j = 0; j < (int)HandJointIndex::Count; ++j)
-        {
-            file << ",";
-            DumpHandIfPresentElseZero(frame.leftHandPresent, frame.leftHandTransform[j], file);
-        }
-        file << ",";
-        file << frame.rightHandPresent;
-        for (int j = 0; j < (int)HandJointIndex::Count; ++j)
-        {
-            file << ",";
-            DumpHandIfPresentElseZero(frame.rightHandPresent, frame.rightHandTransform[j], file);
-        }
-        file << ",";
-        DumpEyeGazeIfPresentElseZero(frame.eyeGazePresent, frame.eyeGazeOrigin, frame.eyeGazeDirection, frame.eyeGazeDistance, file);
+        WriteFrame(frame, file);
         file << std::endl;
     }
     file.close();
     return true;
 }
 
+void HeTHaTEyeStream::StreamFrame(const HeTHaTEyeFrame& frame)
+{
+    std::ostringstream line;
+    WriteFrame(frame, line);
+    line << "\n";
+    const std::string lineString = line.str();
+
+    const Io::Buffer part = { reinterpret_cast<const uint8_t*>(lineString.data()), lineString.size() };
+    if (!m_streamClient->Send(m_streamChannel, Io::StreamMessageType::FileAppend, m_streamFileName, &part, 1, Io::StreamFlow::Drop))
+    {
+        m_streamComplete = false;
+    }
+}
+
 bool HeTHaTEyeStream::DumpTransformToDisk(const XMMATRIX& mtx, const StorageFolder& folder, const std::wstring& datetime_path, const std::wstring& suffix) const
 {
     auto path = folder.Path().data();
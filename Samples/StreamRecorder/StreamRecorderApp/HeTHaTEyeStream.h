@@ -14,6 +14,8 @@
 #include <vector>
 #include "../Cannon/DrawCall.h"
 #include "../Cannon/MixedReality.h"
+#include "PreRollBuffer.h"
+#include "StreamClient.h"
 
 __declspec(align(16))
 struct HeTHaTEyeFrame
@@ -37,6 +39,17 @@ public:
 
     void AddFrame(HeTHaTEyeFrame&& frame);
     void Clear();
+    // Keep the frames of the last duration (in hundreds of nanoseconds, at most maxBytes)
+    // added while not recording, FlushPreRoll appends them to the log
+    void EnablePreRoll(long long duration, size_t maxBytes);
+    bool IsPreRollEnabled() const;
+    void AddPreRollFrame(HeTHaTEyeFrame&& frame);
+    void FlushPreRoll();
+    // While streaming, every frame added to the log is also sent to the host of
+    // streamClient, as a line of <datetime_path>_head_hand_eye.csv
+    void StartStreaming(const std::shared_ptr<Io::StreamClient>& streamClient, const std::wstring& datetime_path);
+    // Returns false when lines were dropped: the file has to be sent again as a whole
+    bool StopStreaming();
     const std::vector<HeTHaTEyeFrame>& Log() const;
     size_t FrameCount() const;
     bool DumpToDisk(const winrt::Windows::Storage::StorageFolder& folder, const std::wstring& datetime_path) const;
@@ -44,7 +57,16 @@ public:
                              const std::wstring& datetime_path, const std::wstring& suffix) const;
 
 private:
+    void StreamFrame(const HeTHaTEyeFrame& frame);
+
     std::vector<HeTHaTEyeFrame> m_hethateyeLog;
+    std::unique_ptr<PreRollBuffer<HeTHaTEyeFrame>> m_preRoll;
+
+    // Null when not streaming
+    std::shared_ptr<Io::StreamClient> m_streamClient;
+    uint16_t m_streamChannel = 0;
+    std::string m_streamFileName;
+    bool m_streamComplete = true;
 };
 
 class HeTHaTStreamVisualizer
@@ -0,0 +1,119 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// A file of a frame, as it will be added to the stream tarball
+struct BufferedFile
+{
+    std::wstring name;
+    std::vector<uint8_t> data;
+};
+
+// A frame kept in memory before the recording starts: the files to write to
+// the tarball, and the per-frame metadata (e.g. its pose) to log along with them
+template <typename TMetadata>
+struct BufferedFrame
+{
+    long long timestamp = 0;
+    bool hasMetadata = false;
+    TMetadata metadata;
+    std::vector<BufferedFile> files;
+
+    size_t ByteSize() const
+    {
+        size_t byteSize = sizeof(*this) + files.capacity() * sizeof(BufferedFile);
+        for (const BufferedFile& file : files)
+        {
+            byteSize += file.name.capacity() * sizeof(wchar_t) + file.data.capacity();
+        }
+        return byteSize;
+    }
+};
+
+// Memory bounded buffer holding the most recent frames of a stream, so that
+// a recording can start with the frames captured in the seconds before it was
+// started. Frames older than the duration (in the timestamp units) are
+// dropped, and so are the oldest ones whenever the heap memory of the frames
+// would exceed maxBytes. Frames are moved in and out of the buffer: their
+// data is never copied between the capture thread and the writer.
+template <typename TMetadata>
+class PreRollBuffer
+{
+public:
+    PreRollBuffer(long long duration, size_t maxBytes) :
+        m_duration(duration),
+        m_maxBytes(maxBytes)
+    {
+    }
+
+    // Returns false when the frame alone does not fit in the buffer
+    bool Push(BufferedFrame<TMetadata>&& frame)
+    {
+        const size_t frameBytes = frame.ByteSize();
+        if (frameBytes > m_maxBytes)
+        {
+            return false;
+        }
+
+        std::lock_guard<std::mutex> guard(m_mutex);
+        while (!m_frames.empty() &&
+               (m_byteCount + frameBytes > m_maxBytes || m_frames.front().timestamp < frame.timestamp - m_duration))
+        {
+            m_byteCount -= m_frames.front().ByteSize();
+            m_frames.pop_front();
+        }
+        m_byteCount += frameBytes;
+        m_frames.push_back(std::move(frame));
+        return true;
+    }
+
+    // Hand all the buffered frames, oldest first, over to the caller
+    std::deque<BufferedFrame<TMetadata>> Drain()
+    {
+        std::deque<BufferedFrame<TMetadata>> frames;
+        std::lock_guard<std::mutex> guard(m_mutex);
+        frames.swap(m_frames);
+        m_byteCount = 0;
+        return frames;
+    }
+
+    void Clear()
+    {
+        Drain();
+    }
+
+    bool Empty()
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        return m_frames.empty();
+    }
+
+    size_t ByteCount()
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        return m_byteCount;
+    }
+
+private:
+    const long long m_duration;
+    const size_t m_maxBytes;
+
+    std::mutex m_mutex;
+    std::deque<BufferedFrame<TMetadata>> m_frames;
+    size_t m_byteCount = 0;
+};
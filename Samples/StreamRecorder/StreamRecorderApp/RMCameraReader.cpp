@@ -10,6 +10,7 @@
 //*********************************************************
 
 #include "RMCameraReader.h"
+#include <chrono>
 #include <sstream>
 
 using namespace winrt::Windows::Perception;
@@ -17,6 +18,10 @@ using namespace winrt::Windows::Perception::Spatial;
 using namespace winrt::Windows::Foundation::Numerics;
 using namespace winrt::Windows::Storage;
 
+// The write thread sleeps until the next frame, or at most this long so that
+// it notices the exit request and the storage changes
+static constexpr std::chrono::milliseconds kFrameWaitTimeout(100);
+
 
 namespace Depth
 {
@@ -86,12 +91,21 @@ void RMCameraReader::CameraUpdateThread(RMCameraReader* pCameraReader, HANDLE ca
 
             if (SUCCEEDED(hr))
             {
-                std::lock_guard<std::mutex> guard(pCameraReader->m_sensorFrameMutex);
-                if (pCameraReader->m_pSensorFrame)
                 {
-                    pCameraReader->m_pSensorFrame->Release();
+                    std::lock_guard<std::mutex> guard(pCameraReader->m_sensorFrameMutex);
+                    if (pCameraReader->m_pSensorFrame)
+                    {
+                        // The write thread fell behind and missed that frame
+                        if (!pCameraReader->m_sensorFrameTaken && pCameraReader->m_governor)
+                        {
+                            pCameraReader->m_governor->ReportLost(pCameraReader->m_governorStream);
+                        }
+                        pCameraReader->m_pSensorFrame->Release();
+                    }
+                    pCameraReader->m_pSensorFrame = pSensorFrame;
+                    pCameraReader->m_sensorFrameTaken = false;
                 }
-                pCameraReader->m_pSensorFrame = pSensorFrame;
+                pCameraReader->m_sensorFrameCondVar.notify_one();
             }
         }
 
@@ -106,15 +120,26 @@ void RMCameraReader::CameraWriteThread(RMCameraReader* pReader)
 {
     while (!pReader->m_fExit)
     {
+        {
+            // Wait for a frame the thread has not looked at yet, rather than
+            // taking both mutexes again and again for the same frame
+            std::unique_lock<std::mutex> reader_lock(pReader->m_sensorFrameMutex);
+            pReader->m_sensorFrameCondVar.wait_for(reader_lock, kFrameWaitTimeout, [pReader]
+            {
+                return pReader->m_fExit || !pReader->m_sensorFrameTaken;
+            });
+        }
+
         std::unique_lock<std::mutex> storage_lock(pReader->m_storageMutex);
-        if (pReader->m_storageFolder == nullptr)
+        if (pReader->m_storageFolder == nullptr && !pReader->m_preRoll)
         {
-            pReader->m_storageCondVar.wait(storage_lock);
+            pReader->m_storageCondVar.wait_for(storage_lock, kFrameWaitTimeout);
         }
-        
+
         std::lock_guard<std::mutex> reader_guard(pReader->m_sensorFrameMutex);
-        if (pReader->m_pSensorFrame)
+        if (pReader->m_pSensorFrame && !pReader->m_sensorFrameTaken)
         {
+            pReader->m_sensorFrameTaken = true;
             if (pReader->IsNewTimestamp(pReader->m_pSensorFrame))
             {
                 pReader->SaveFrame(pReader->m_pSensorFrame);
@@ -237,16 +262,53 @@ bool RMCameraReader::IsNewTimestamp(IResearchModeSensorFrame* pSensorFrame)
     return true;
 }
 
-void RMCameraReader::SetStorageFolder(const StorageFolder& storageFolder)
+void RMCameraReader::SetStorageFolder(const StorageFolder& storageFolder, const std::shared_ptr<Io::StreamClient>& streamClient)
 {
     std::lock_guard<std::mutex> storage_guard(m_storageMutex);
     m_storageFolder = storageFolder;
-    wchar_t fileName[MAX_PATH] = {};    
-    swprintf_s(fileName, L"%s\\%s.tar", m_storageFolder.Path().data(), m_pRMSensor->GetFriendlyName());
-    m_tarball.reset(new Io::Tarball(fileName));
+    if (streamClient)
+    {
+        m_tarball.reset(new Io::StreamedTarball(streamClient, std::wstring(m_pRMSensor->GetFriendlyName()) + L".tar"));
+    }
+    else
+    {
+        wchar_t fileName[MAX_PATH] = {};
+        swprintf_s(fileName, L"%s\\%s.tar", m_storageFolder.Path().data(), m_pRMSensor->GetFriendlyName());
+        m_tarball.reset(new Io::Tarball(fileName));
+    }
     m_storageCondVar.notify_all();
 }
 
+void RMCameraReader::EnablePreRoll(long long duration, size_t maxBytes, const SpatialCoordinateSystem& coordSystem)
+{
+    std::lock_guard<std::mutex> storage_guard(m_storageMutex);
+    m_worldCoordSystem = coordSystem;
+    m_preRoll = std::make_unique<PreRollBuffer<FrameLocation>>(duration, maxBytes);
+    m_storageCondVar.notify_all();
+}
+
+void RMCameraReader::SetTrigger(const std::shared_ptr<TriggerEngine>& trigger)
+{
+    std::lock_guard<std::mutex> storage_guard(m_storageMutex);
+    m_trigger = trigger;
+}
+
+void RMCameraReader::SetGovernor(const std::shared_ptr<RecordingGovernor>& governor)
+{
+    std::lock_guard<std::mutex> storage_guard(m_storageMutex);
+    std::lock_guard<std::mutex> reader_guard(m_sensorFrameMutex);
+    const ResearchModeSensorType type = m_pRMSensor->GetSensorType();
+    const bool isDepth = (type == DEPTH_LONG_THROW || type == DEPTH_AHAT);
+    m_governorStream = governor->Register(m_pRMSensor->GetFriendlyName(), isDepth ? GovernedStreamKind::Depth : GovernedStreamKind::VLC);
+    m_governor = governor;
+}
+
+void RMCameraReader::SetStreamRate(const StreamRate& rate)
+{
+    std::lock_guard<std::mutex> storage_guard(m_storageMutex);
+    m_decimator.SetRate(rate);
+}
+
 void RMCameraReader::ResetStorageFolder()
 {
     std::lock_guard<std::mutex> storage_guard(m_storageMutex);
@@ -274,7 +336,7 @@ std::string CreateHeader(const ResearchModeSensorResolution& resolution, int max
     return header.str();
 }
 
-void RMCameraReader::SaveDepth(IResearchModeSensorFrame* pSensorFrame, IResearchModeSensorDepthFrame* pDepthFrame)
+void RMCameraReader::SaveDepth(IResearchModeSensorFrame* pSensorFrame, IResearchModeSensorDepthFrame* pDepthFrame, std::vector<BufferedFile>& files)
 {        
     // Get resolution (will be used for PGM header)
     ResearchModeSensorResolution resolution;    
@@ -345,11 +407,11 @@ void RMCameraReader::SaveDepth(IResearchModeSensorFrame* pSensorFrame, IResearch
         depthPgmData.push_back((BYTE)d);
     }
 
-    m_tarball->AddFile(outputAbPath, &abPgmData[0], abPgmData.size());
-    m_tarball->AddFile(outputDepthPath, &depthPgmData[0], depthPgmData.size());
+    files.push_back(BufferedFile{ outputAbPath, std::move(abPgmData) });
+    files.push_back(BufferedFile{ outputDepthPath, std::move(depthPgmData) });
 }
 
-void RMCameraReader::SaveVLC(IResearchModeSensorFrame* pSensorFrame, IResearchModeSensorVLCFrame* pVLCFrame)
+void RMCameraReader::SaveVLC(IResearchModeSensorFrame* pSensorFrame, IResearchModeSensorVLCFrame* pVLCFrame, std::vector<BufferedFile>& files)
 {        
     wchar_t outputPath[MAX_PATH];
 
@@ -374,12 +436,58 @@ void RMCameraReader::SaveVLC(IResearchModeSensorFrame* pSensorFrame, IResearchMo
     pgmData.insert(pgmData.end(), headerString.c_str(), headerString.c_str() + headerString.size());
     pgmData.insert(pgmData.end(), pImage, pImage + outBufferCount);
 
-    m_tarball->AddFile(outputPath, &pgmData[0], pgmData.size());
+    files.push_back(BufferedFile{ outputPath, std::move(pgmData) });
+}
+
+size_t RMCameraReader::WriteVLC(IResearchModeSensorFrame* pSensorFrame, IResearchModeSensorVLCFrame* pVLCFrame, long long timestamp)
+{
+    // Same file as SaveVLC, but the image goes from the sensor buffer to the tarball
+    // (or to the socket) as it is, without being copied after the PGM header first
+    wchar_t outputPath[MAX_PATH];
+    swprintf_s(outputPath, L"%llu.pgm", timestamp);
+
+    ResearchModeSensorResolution resolution;
+    winrt::check_hresult(pSensorFrame->GetResolution(&resolution));
+    const std::string headerString = CreateHeader(resolution, 255);
+
+    size_t outBufferCount = 0;
+    const BYTE* pImage = nullptr;
+    winrt::check_hresult(pVLCFrame->GetBuffer(&pImage, &outBufferCount));
+
+    const Io::Buffer parts[] =
+    {
+        { reinterpret_cast<const uint8_t*>(headerString.data()), headerString.size() },
+        { pImage, outBufferCount }
+    };
+    m_tarball->AddFile(outputPath, parts, 2);
+    return headerString.size() + outBufferCount;
 }
 
 void RMCameraReader::SaveFrame(IResearchModeSensorFrame* pSensorFrame)
 {
-    AddFrameLocation();
+    const long long timestamp = m_converter.RelativeTicksToAbsoluteTicks(HundredsOfNanoseconds(checkAndConvertUnsigned(m_prevTimestamp))).count();
+
+    // Decide before serializing: frames that are neither written
+    // nor kept in the pre-roll buffer are dropped
+    const bool write = m_tarball && (!m_trigger || m_trigger->ShouldWrite(timestamp));
+    if (!write && !m_preRoll)
+    {
+        return;
+    }
+    // Frames in excess of the stream rate, and the frames the
+    // governor throttles, are dropped before anything is copied
+    if (!m_decimator.Keep(timestamp))
+    {
+        return;
+    }
+    if (write && m_governor && !m_governor->ShouldWrite(m_governorStream))
+    {
+        return;
+    }
+
+    BufferedFrame<FrameLocation> frame;
+    frame.timestamp = timestamp;
+    frame.hasMetadata = LocateFrame(frame.metadata);
 
 	IResearchModeSensorVLCFrame* pVLCFrame = nullptr;
 	IResearchModeSensorDepthFrame* pDepthFrame = nullptr;
@@ -391,20 +499,85 @@ void RMCameraReader::SaveFrame(IResearchModeSensorFrame* pSensorFrame)
 		hr = pSensorFrame->QueryInterface(IID_PPV_ARGS(&pDepthFrame));
 	}
 
+    if (pVLCFrame && write)
+    {
+        if (m_preRoll)
+        {
+            FlushPreRoll();
+        }
+        if (frame.hasMetadata)
+        {
+            m_frameLocations.push_back(frame.metadata);
+        }
+        const auto writeStart = std::chrono::steady_clock::now();
+        ReportWrite(WriteVLC(pSensorFrame, pVLCFrame, timestamp), writeStart);
+        pVLCFrame->Release();
+        return;
+    }
+
 	if (pVLCFrame)
 	{
-		SaveVLC(pSensorFrame, pVLCFrame);
+		SaveVLC(pSensorFrame, pVLCFrame, frame.files);
         pVLCFrame->Release();
 	}
 
 	if (pDepthFrame)
 	{		
-		SaveDepth(pSensorFrame, pDepthFrame);
+		SaveDepth(pSensorFrame, pDepthFrame, frame.files);
         pDepthFrame->Release();
 	}    
+
+    if (write)
+    {
+        // Frames buffered before the recording started,
+        // or before the trigger event, go first
+        if (m_preRoll)
+        {
+            FlushPreRoll();
+        }
+        const auto writeStart = std::chrono::steady_clock::now();
+        ReportWrite(WriteFrame(frame), writeStart);
+    }
+    else
+    {
+        m_preRoll->Push(std::move(frame));
+    }
+}
+
+size_t RMCameraReader::WriteFrame(const BufferedFrame<FrameLocation>& frame)
+{
+    if (frame.hasMetadata)
+    {
+        m_frameLocations.push_back(frame.metadata);
+    }
+    size_t byteCount = 0;
+    for (const BufferedFile& file : frame.files)
+    {
+        m_tarball->AddFile(file.name, file.data.data(), file.data.size());
+        byteCount += file.data.size();
+    }
+    return byteCount;
+}
+
+void RMCameraReader::ReportWrite(size_t byteCount, std::chrono::steady_clock::time_point writeStart)
+{
+    if (m_governor)
+    {
+        const auto duration = std::chrono::duration_cast<HundredsOfNanoseconds>(std::chrono::steady_clock::now() - writeStart);
+        m_governor->ReportWrite(m_governorStream, byteCount, duration.count());
+    }
+}
+
+void RMCameraReader::FlushPreRoll()
+{
+    // Lock on m_storageMutex from caller
+    for (const BufferedFrame<FrameLocation>& frame : m_preRoll->Drain())
+    {
+        WriteFrame(frame);
+    }
 }
 
-bool RMCameraReader::AddFrameLocation()
+bool RMCameraReader::LocateFrame(FrameLocation& frameLocation)
 {         
     auto timestamp = PerceptionTimestampHelper::FromSystemRelativeTargetTime(HundredsOfNanoseconds(checkAndConvertUnsigned(m_prevTimestamp)));
     auto location = m_locator.TryLocateAtTimestamp(timestamp, m_worldCoordSystem);
@@ -414,7 +587,7 @@ bool RMCameraReader::AddFrameLocation()
     }
     const float4x4 dynamicNodeToCoordinateSystem = make_float4x4_from_quaternion(location.Orientation()) * make_float4x4_translation(location.Position());
     auto absoluteTimestamp = m_converter.RelativeTicksToAbsoluteTicks(HundredsOfNanoseconds((long long)m_prevTimestamp)).count();
-    m_frameLocations.push_back(std::move(FrameLocation{absoluteTimestamp, dynamicNodeToCoordinateSystem}));
+    frameLocation = FrameLocation{absoluteTimestamp, dynamicNodeToCoordinateSystem};
 
     return true;
 }
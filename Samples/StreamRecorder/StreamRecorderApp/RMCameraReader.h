@@ -12,9 +12,15 @@
 #pragma once
 
 #include "researchmode\ResearchModeApi.h"
+#include "PreRollBuffer.h"
+#include "RecordingGovernor.h"
+#include "StreamClient.h"
+#include "StreamSettings.h"
 #include "Tar.h"
 #include "TimeConverter.h"
+#include "TriggerEngine.h"
 
+#include <condition_variable>
 #include <mutex>
 #include <winrt/Windows.Perception.Spatial.h>
 #include <winrt/Windows.Perception.Spatial.Preview.h>
@@ -36,6 +42,7 @@ public:
 	{
 		m_pRMSensor = pLLSensor;
 		m_pRMSensor->AddRef();
+		m_sensorType = m_pRMSensor->GetSensorType();
 		m_pSensorFrame = nullptr;
 
 		// Get GUID identifying the rigNode to
@@ -48,13 +55,29 @@ public:
 		m_pWriteThread = new std::thread(CameraWriteThread, this);
 	}
 
-	void SetStorageFolder(const winrt::Windows::Storage::StorageFolder& storageFolder);
+	// The frames go to <sensor>.tar in storageFolder, or to the host of streamClient when
+	// not null; calibration and poses are written to storageFolder in both cases
+	void SetStorageFolder(const winrt::Windows::Storage::StorageFolder& storageFolder, const std::shared_ptr<Io::StreamClient>& streamClient = nullptr);
 	void SetWorldCoordSystem(const winrt::Windows::Perception::Spatial::SpatialCoordinateSystem& coordSystem);
 	void ResetStorageFolder();	
+	// Keep the frames of the last duration (in hundreds of nanoseconds, at most maxBytes)
+	// while not recording, and write them at the beginning of the next recording.
+	// Their poses are expressed in coordSystem
+	void EnablePreRoll(long long duration, size_t maxBytes, const winrt::Windows::Perception::Spatial::SpatialCoordinateSystem& coordSystem);
+	// While recording, only write the frames within the trigger windows,
+	// the other ones go to the pre-roll buffer
+	void SetTrigger(const std::shared_ptr<TriggerEngine>& trigger);
+	// While recording, the governor decides which frames are written
+	void SetGovernor(const std::shared_ptr<RecordingGovernor>& governor);
+	// Frames in excess of rate are dropped, whether recording or not
+	void SetStreamRate(const StreamRate& rate);
+	ResearchModeSensorType SensorType() const { return m_sensorType; }
 
 	virtual ~RMCameraReader()
 	{
 		m_fExit = true;
+		m_sensorFrameCondVar.notify_all();
+		m_storageCondVar.notify_all();
 		m_pCameraUpdateThread->join();
 
 		if (m_pRMSensor)
@@ -75,19 +98,28 @@ protected:
 	bool IsNewTimestamp(IResearchModeSensorFrame* pSensorFrame);
 
 	void SaveFrame(IResearchModeSensorFrame* pSensorFrame);
-	void SaveVLC(IResearchModeSensorFrame* pSensorFrame, IResearchModeSensorVLCFrame* pVLCFrame);
-	void SaveDepth(IResearchModeSensorFrame* pSensorFrame, IResearchModeSensorDepthFrame* pDepthFrame);
+	void SaveVLC(IResearchModeSensorFrame* pSensorFrame, IResearchModeSensorVLCFrame* pVLCFrame, std::vector<BufferedFile>& files);
+	size_t WriteVLC(IResearchModeSensorFrame* pSensorFrame, IResearchModeSensorVLCFrame* pVLCFrame, long long timestamp);
+	void SaveDepth(IResearchModeSensorFrame* pSensorFrame, IResearchModeSensorDepthFrame* pDepthFrame, std::vector<BufferedFile>& files);
+	size_t WriteFrame(const BufferedFrame<FrameLocation>& frame);
+	void ReportWrite(size_t byteCount, std::chrono::steady_clock::time_point writeStart);
+	void FlushPreRoll();
 
 	void DumpCalibration();
 
 	void SetLocator(const GUID& guid);
-	bool AddFrameLocation();
+	bool LocateFrame(FrameLocation& location);
 	void DumpFrameLocations();
 
 	// Mutex to access sensor frame
 	std::mutex m_sensorFrameMutex;
+	// Signaled when a new sensor frame replaces m_pSensorFrame
+	std::condition_variable m_sensorFrameCondVar;
 	IResearchModeSensor* m_pRMSensor = nullptr;
 	IResearchModeSensorFrame* m_pSensorFrame = nullptr;
+	ResearchModeSensorType m_sensorType;
+	// Whether the write thread took m_pSensorFrame before the next one replaced it
+	bool m_sensorFrameTaken = true;
 
 	bool m_fExit = false;
 	std::thread* m_pCameraUpdateThread;
@@ -98,7 +130,7 @@ protected:
 	// conditional variable to enable / disable writing to disk
 	std::condition_variable m_storageCondVar;	
 	winrt::Windows::Storage::StorageFolder m_storageFolder = nullptr;
-	std::unique_ptr<Io::Tarball> m_tarball;
+	std::unique_ptr<Io::Archive> m_tarball;
 
 	TimeConverter m_converter;
 	UINT64 m_prevTimestamp = 0;
@@ -106,4 +138,14 @@ protected:
 	winrt::Windows::Perception::Spatial::SpatialLocator m_locator = nullptr;
 	winrt::Windows::Perception::Spatial::SpatialCoordinateSystem m_worldCoordSystem = nullptr;
 	std::vector<FrameLocation> m_frameLocations;	
+
+	// Frames captured while not recording, null when pre-roll is disabled
+	std::unique_ptr<PreRollBuffer<FrameLocation>> m_preRoll;
+	// Null when every frame is written while recording
+	std::shared_ptr<TriggerEngine> m_trigger;
+	// Null when the recording is not governed
+	std::shared_ptr<RecordingGovernor> m_governor;
+	size_t m_governorStream = 0;
+	// Frames in excess of the stream rate
+	FrameDecimator m_decimator;
 };
@@ -0,0 +1,277 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+#include "RMImuReader.h"
+#include <cstring>
+
+using namespace winrt::Windows::Storage;
+
+// The samples are written about twice per second, or as soon as this many are
+// waiting (~2 seconds of gyro, the fastest IMU)
+static constexpr std::chrono::milliseconds kWritePeriod(500);
+static constexpr size_t kWriteChunkSamples = 16 * 1024;
+
+static void FillValues(ImuSampleRecord& record, const AccelDataStruct& sample)
+{
+    memcpy(record.values, sample.AccelValues, sizeof(record.values));
+    record.temperature = sample.temperature;
+}
+
+static void FillValues(ImuSampleRecord& record, const GyroDataStruct& sample)
+{
+    memcpy(record.values, sample.GyroValues, sizeof(record.values));
+    record.temperature = sample.temperature;
+}
+
+static void FillValues(ImuSampleRecord& record, const MagDataStruct& sample)
+{
+    memcpy(record.values, sample.MagValues, sizeof(record.values));
+    record.temperature = 0.f;
+}
+
+void RMImuReader::ImuUpdateThread(RMImuReader* pReader, HANDLE imuConsentGiven, ResearchModeSensorConsent* imuAccessConsent)
+{
+    DWORD waitResult = WaitForSingleObject(imuConsentGiven, INFINITE);
+
+    if (waitResult != WAIT_OBJECT_0 || *imuAccessConsent != ResearchModeSensorConsent::Allowed)
+    {
+        OutputDebugString(L"IMU access is denied");
+        return;
+    }
+
+    HRESULT hr = pReader->m_pRMSensor->OpenStream();
+
+    if (FAILED(hr))
+    {
+        pReader->m_pRMSensor->Release();
+        pReader->m_pRMSensor = nullptr;
+        return;
+    }
+
+    while (!pReader->m_fExit)
+    {
+        IResearchModeSensorFrame* pSensorFrame = nullptr;
+
+        hr = pReader->m_pRMSensor->GetNextBuffer(&pSensorFrame);
+
+        if (SUCCEEDED(hr))
+        {
+            pReader->AppendSamples(pSensorFrame);
+            pSensorFrame->Release();
+        }
+    }
+
+    pReader->m_pRMSensor->CloseStream();
+}
+
+void RMImuReader::ImuWriteThread(RMImuReader* pReader)
+{
+    // Nothing waits for the IMU samples before the end of the recording,
+    // the camera writers go first
+    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_BELOW_NORMAL);
+
+    while (!pReader->m_fExit)
+    {
+        {
+            std::unique_lock<std::mutex> sample_lock(pReader->m_sampleMutex);
+            pReader->m_sampleCondVar.wait_for(sample_lock, kWritePeriod);
+        }
+
+        std::lock_guard<std::mutex> file_guard(pReader->m_fileMutex);
+        pReader->WritePending();
+    }
+}
+
+void RMImuReader::AppendSamples(IResearchModeSensorFrame* pSensorFrame)
+{
+    size_t sampleCount = 0;
+
+    switch (m_pRMSensor->GetSensorType())
+    {
+    case IMU_ACCEL:
+    {
+        IResearchModeAccelFrame* pAccelFrame = nullptr;
+        const AccelDataStruct* pAccelBuffer = nullptr;
+        if (SUCCEEDED(pSensorFrame->QueryInterface(IID_PPV_ARGS(&pAccelFrame))))
+        {
+            if (SUCCEEDED(pAccelFrame->GetCalibratedAccelarationSamples(&pAccelBuffer, &sampleCount)))
+            {
+                AppendSamples(pAccelBuffer, sampleCount);
+            }
+            pAccelFrame->Release();
+        }
+        break;
+    }
+    case IMU_GYRO:
+    {
+        IResearchModeGyroFrame* pGyroFrame = nullptr;
+        const GyroDataStruct* pGyroBuffer = nullptr;
+        if (SUCCEEDED(pSensorFrame->QueryInterface(IID_PPV_ARGS(&pGyroFrame))))
+        {
+            if (SUCCEEDED(pGyroFrame->GetCalibratedGyroSamples(&pGyroBuffer, &sampleCount)))
+            {
+                AppendSamples(pGyroBuffer, sampleCount);
+            }
+            pGyroFrame->Release();
+        }
+        break;
+    }
+    case IMU_MAG:
+    {
+        IResearchModeMagFrame* pMagFrame = nullptr;
+        const MagDataStruct* pMagBuffer = nullptr;
+        if (SUCCEEDED(pSensorFrame->QueryInterface(IID_PPV_ARGS(&pMagFrame))))
+        {
+            if (SUCCEEDED(pMagFrame->GetMagnetometerSamples(&pMagBuffer, &sampleCount)))
+            {
+                AppendSamples(pMagBuffer, sampleCount);
+            }
+            pMagFrame->Release();
+        }
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+template <typename TSample>
+void RMImuReader::AppendSamples(const TSample* pSamples, size_t count)
+{
+    std::lock_guard<std::mutex> guard(m_sampleMutex);
+    if (!m_recording)
+    {
+        return;
+    }
+
+    const size_t offset = m_pendingSamples.size();
+    m_pendingSamples.resize(offset + count);
+    size_t keptCount = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        const long long timestamp = m_converter.RelativeTicksToAbsoluteTicks(HundredsOfNanoseconds(checkAndConvertUnsigned(pSamples[i].SocTicks))).count();
+        if (!m_decimator.Keep(timestamp))
+        {
+            continue;
+        }
+        ImuSampleRecord& record = m_pendingSamples[offset + keptCount++];
+        record.timestamp = timestamp;
+        record.socTicks = pSamples[i].SocTicks;
+        record.vinylHupTicks = pSamples[i].VinylHupTicks;
+        FillValues(record, pSamples[i]);
+    }
+    // Shrinking keeps the capacity
+    m_pendingSamples.resize(offset + keptCount);
+
+    if (m_pendingSamples.size() >= kWriteChunkSamples)
+    {
+        m_sampleCondVar.notify_all();
+    }
+}
+
+void RMImuReader::WritePending()
+{
+    // Lock on m_fileMutex from caller.
+    // Swapping keeps the capacity of both buffers, the update thread
+    // does not reallocate once the recording is running
+    {
+        std::lock_guard<std::mutex> sample_guard(m_sampleMutex);
+        m_writeSamples.swap(m_pendingSamples);
+    }
+
+    if (m_file.is_open() && !m_writeSamples.empty())
+    {
+        m_file.write(reinterpret_cast<const char*>(m_writeSamples.data()), m_writeSamples.size() * sizeof(ImuSampleRecord));
+    }
+    m_writeSamples.clear();
+}
+
+void RMImuReader::SetStorageFolder(const StorageFolder& storageFolder)
+{
+    std::lock_guard<std::mutex> file_guard(m_fileMutex);
+    m_storageFolder = storageFolder;
+
+    wchar_t fileName[MAX_PATH] = {};
+    swprintf_s(fileName, L"%s\\%s_imu.bin", m_storageFolder.Path().data(), m_pRMSensor->GetFriendlyName());
+    m_file.open(fileName, std::ios::binary);
+    assert(m_file.is_open());
+
+    const ImuFileHeader header = { { 'R', 'M', 'I', 'M' }, 1, static_cast<uint32_t>(m_pRMSensor->GetSensorType()), sizeof(ImuSampleRecord) };
+    m_file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    DumpExtrinsics();
+
+    std::lock_guard<std::mutex> sample_guard(m_sampleMutex);
+    m_pendingSamples.clear();
+    m_recording = true;
+}
+
+void RMImuReader::SetStreamRate(const StreamRate& rate)
+{
+    std::lock_guard<std::mutex> sample_guard(m_sampleMutex);
+    m_decimator.SetRate(rate);
+}
+
+void RMImuReader::ResetStorageFolder()
+{
+    std::lock_guard<std::mutex> file_guard(m_fileMutex);
+    {
+        std::lock_guard<std::mutex> sample_guard(m_sampleMutex);
+        m_recording = false;
+    }
+
+    WritePending();
+    m_file.close();
+    m_storageFolder = nullptr;
+}
+
+void RMImuReader::DumpExtrinsics()
+{
+    // Extrinsics (rotation and translation) with respect to the rigNode,
+    // the magnetometer has none
+    DirectX::XMFLOAT4X4 extrinsics;
+    HRESULT hr = E_NOINTERFACE;
+
+    if (m_pRMSensor->GetSensorType() == IMU_ACCEL)
+    {
+        IResearchModeAccelSensor* pAccelSensor = nullptr;
+        if (SUCCEEDED(m_pRMSensor->QueryInterface(IID_PPV_ARGS(&pAccelSensor))))
+        {
+            hr = pAccelSensor->GetExtrinsicsMatrix(&extrinsics);
+            pAccelSensor->Release();
+        }
+    }
+    else if (m_pRMSensor->GetSensorType() == IMU_GYRO)
+    {
+        IResearchModeGyroSensor* pGyroSensor = nullptr;
+        if (SUCCEEDED(m_pRMSensor->QueryInterface(IID_PPV_ARGS(&pGyroSensor))))
+        {
+            hr = pGyroSensor->GetExtrinsicsMatrix(&extrinsics);
+            pGyroSensor->Release();
+        }
+    }
+
+    if (FAILED(hr))
+    {
+        return;
+    }
+
+    // Same layout as the camera extrinsics
+    wchar_t outputExtrinsicsPath[MAX_PATH] = {};
+    swprintf_s(outputExtrinsicsPath, L"%s\\%s_extrinsics.txt", m_storageFolder.Path().data(), m_pRMSensor->GetFriendlyName());
+
+    std::ofstream fileExtrinsics(outputExtrinsicsPath);
+    fileExtrinsics << extrinsics.m[0][0] << "," << extrinsics.m[1][0] << "," << extrinsics.m[2][0] << "," << extrinsics.m[3][0] << ","
+                   << extrinsics.m[0][1] << "," << extrinsics.m[1][1] << "," << extrinsics.m[2][1] << "," << extrinsics.m[3][1] << ","
+                   << extrinsics.m[0][2] << "," << extrinsics.m[1][2] << "," << extrinsics.m[2][2] << "," << extrinsics.m[3][2] << ","
+                   << extrinsics.m[0][3] << "," << extrinsics.m[1][3] << "," << extrinsics.m[2][3] << "," << extrinsics.m[3][3] << "\n";
+    fileExtrinsics.close();
+}
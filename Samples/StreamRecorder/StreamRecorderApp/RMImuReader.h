@@ -0,0 +1,126 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+#pragma once
+
+#include "researchmode\ResearchModeApi.h"
+#include "StreamSettings.h"
+#include "TimeConverter.h"
+
+#include <condition_variable>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <winrt/Windows.Storage.h>
+
+
+// Layout of <sensor>_imu.bin: one ImuFileHeader, then one ImuSampleRecord per
+// sample, little-endian. Read by load_imu in StreamRecorderConverter/utils.py
+struct ImuFileHeader
+{
+	char magic[4];			// "RMIM"
+	uint32_t version;		// 1
+	uint32_t sensorType;	// IMU_ACCEL, IMU_GYRO or IMU_MAG
+	uint32_t recordSize;	// sizeof(ImuSampleRecord)
+};
+
+struct ImuSampleRecord
+{
+	long long timestamp;	// SocTicks as absolute ticks, as the camera frame names
+	uint64_t socTicks;
+	uint64_t vinylHupTicks;
+	float values[3];		// m/s^2, rad/s or gauss
+	float temperature;		// 0 for the magnetometer
+};
+
+static_assert(sizeof(ImuFileHeader) == 16, "Unexpected IMU file header size");
+static_assert(sizeof(ImuSampleRecord) == 40, "Unexpected IMU record size");
+
+
+// Records every sample of the batches returned by an IMU sensor.
+// The update thread only appends the samples to a memory buffer, and a
+// low priority thread writes that buffer in large chunks, so that the
+// kHz sample rate never competes with the camera writers for the disk.
+class RMImuReader
+{
+public:
+	RMImuReader(IResearchModeSensor* pImuSensor, HANDLE imuConsentGiven, ResearchModeSensorConsent* imuAccessConsent)
+	{
+		m_pRMSensor = pImuSensor;
+		m_pRMSensor->AddRef();
+		m_sensorType = m_pRMSensor->GetSensorType();
+
+		m_pImuUpdateThread = new std::thread(ImuUpdateThread, this, imuConsentGiven, imuAccessConsent);
+		m_pWriteThread = new std::thread(ImuWriteThread, this);
+	}
+
+	void SetStorageFolder(const winrt::Windows::Storage::StorageFolder& storageFolder);
+	void ResetStorageFolder();
+	// Samples in excess of rate are dropped
+	void SetStreamRate(const StreamRate& rate);
+	ResearchModeSensorType SensorType() const { return m_sensorType; }
+
+	virtual ~RMImuReader()
+	{
+		m_fExit = true;
+		m_pImuUpdateThread->join();
+
+		if (m_pRMSensor)
+		{
+			m_pRMSensor->CloseStream();
+			m_pRMSensor->Release();
+		}
+
+		{
+			std::lock_guard<std::mutex> guard(m_sampleMutex);
+			m_sampleCondVar.notify_all();
+		}
+		m_pWriteThread->join();
+	}
+
+protected:
+	// Thread for retrieving samples
+	static void ImuUpdateThread(RMImuReader* pReader, HANDLE imuConsentGiven, ResearchModeSensorConsent* imuAccessConsent);
+	// Thread for writing samples to disk
+	static void ImuWriteThread(RMImuReader* pReader);
+
+	void AppendSamples(IResearchModeSensorFrame* pSensorFrame);
+	template <typename TSample>
+	void AppendSamples(const TSample* pSamples, size_t count);
+	// Lock on m_fileMutex from caller
+	void WritePending();
+
+	void DumpExtrinsics();
+
+	IResearchModeSensor* m_pRMSensor = nullptr;
+	ResearchModeSensorType m_sensorType;
+
+	bool m_fExit = false;
+	std::thread* m_pImuUpdateThread;
+	std::thread* m_pWriteThread;
+
+	// Samples received since the last write, only taken while recording
+	std::mutex m_sampleMutex;
+	std::condition_variable m_sampleCondVar;
+	std::vector<ImuSampleRecord> m_pendingSamples;
+	bool m_recording = false;
+	// Samples in excess of the stream rate
+	FrameDecimator m_decimator;
+
+	// Held while writing, so that the chunks land in order
+	std::mutex m_fileMutex;
+	std::vector<ImuSampleRecord> m_writeSamples;
+	winrt::Windows::Storage::StorageFolder m_storageFolder = nullptr;
+	std::ofstream m_file;
+
+	TimeConverter m_converter;
+};
@@ -0,0 +1,305 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+#include "RecordingGovernor.h"
+#include "StringHelpers.h"
+
+#include <windows.h>
+#include <algorithm>
+#include <limits>
+
+// From the first level to the last one: VLC frames go first, then PV frames
+// get smaller, then fewer, and depth frames go last
+static const GovernorPolicy kPolicies[] =
+{
+    { "full_rate", 1, 1, 1, false },
+    { "vlc_half_rate", 2, 1, 1, false },
+    { "vlc_off", 0, 1, 1, false },
+    { "pv_compact", 0, 1, 1, true },
+    { "pv_half_rate", 0, 1, 2, true },
+    { "depth_half_rate", 0, 2, 2, true },
+    // Only when the free space drops below the minimum
+    { "frames_off", 0, 0, 0, true }
+};
+
+static constexpr unsigned kLevelCount = sizeof(kPolicies) / sizeof(kPolicies[0]);
+static constexpr unsigned kFramesOffLevel = kLevelCount - 1;
+
+RecordingGovernor::RecordingGovernor(const GovernorSettings& settings) :
+    m_settings(settings)
+{
+}
+
+size_t RecordingGovernor::Register(const std::wstring& name, GovernedStreamKind kind)
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    const size_t stream = m_streamCount.load();
+    if (stream == kMaxStreams)
+    {
+        // Not governed, the writer calls ignore it
+        return kMaxStreams;
+    }
+    m_streams[stream].name = Utf16ToUtf8(name);
+    m_streams[stream].kind = kind;
+    m_streamCount.store(stream + 1);
+    return stream;
+}
+
+bool RecordingGovernor::ShouldWrite(size_t stream)
+{
+    if (stream >= kMaxStreams)
+    {
+        return true;
+    }
+
+    Stream& state = m_streams[stream];
+    const GovernorPolicy& policy = Policy();
+    unsigned decimation = 1;
+    switch (state.kind)
+    {
+    case GovernedStreamKind::VLC:
+        decimation = policy.vlcDecimation;
+        break;
+    case GovernedStreamKind::Depth:
+        decimation = policy.depthDecimation;
+        break;
+    case GovernedStreamKind::PV:
+        decimation = policy.pvDecimation;
+        break;
+    }
+
+    const uint64_t frame = state.frameCount.fetch_add(1, std::memory_order_relaxed);
+    if (decimation == 0 || frame % decimation != 0)
+    {
+        state.skippedCount.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    return true;
+}
+
+bool RecordingGovernor::IsPVCompact() const
+{
+    return Policy().pvCompact;
+}
+
+void RecordingGovernor::ReportWrite(size_t stream, size_t bytes, long long durationTicks)
+{
+    if (stream >= kMaxStreams)
+    {
+        return;
+    }
+    Stream& state = m_streams[stream];
+    state.writtenCount.fetch_add(1, std::memory_order_relaxed);
+    state.byteCount.fetch_add(bytes, std::memory_order_relaxed);
+    state.writeTicks.fetch_add(static_cast<uint64_t>(std::max(durationTicks, 0LL)), std::memory_order_relaxed);
+}
+
+void RecordingGovernor::ReportLost(size_t stream)
+{
+    if (stream >= kMaxStreams)
+    {
+        return;
+    }
+    m_streams[stream].lostCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+void RecordingGovernor::Start(const std::wstring& storagePath, long long timestamp)
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    m_storagePath = storagePath;
+    m_started = true;
+    m_lastEvaluation = timestamp;
+    m_quietPeriods = 0;
+    m_decisions.clear();
+    m_level.store(0);
+
+    const size_t streamCount = m_streamCount.load();
+    for (size_t i = 0; i < streamCount; ++i)
+    {
+        Stream& stream = m_streams[i];
+        stream.frameCount.store(0, std::memory_order_relaxed);
+        stream.writtenCount.store(0, std::memory_order_relaxed);
+        stream.skippedCount.store(0, std::memory_order_relaxed);
+        stream.lostCount.store(0, std::memory_order_relaxed);
+        stream.byteCount.store(0, std::memory_order_relaxed);
+        stream.writeTicks.store(0, std::memory_order_relaxed);
+        stream.lastWrittenCount = 0;
+        stream.lastLostCount = 0;
+        stream.lastByteCount = 0;
+        stream.lastWriteTicks = 0;
+    }
+}
+
+bool RecordingGovernor::Update(long long timestamp)
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    if (!m_started || timestamp - m_lastEvaluation < m_settings.period)
+    {
+        return false;
+    }
+
+    const double periodTicks = static_cast<double>(timestamp - m_lastEvaluation);
+    m_lastEvaluation = timestamp;
+
+    // Measurements over the period
+    GovernorDecision measurements = {};
+    measurements.timestamp = timestamp;
+    uint64_t byteCount = 0;
+    const size_t streamCount = m_streamCount.load();
+    for (size_t i = 0; i < streamCount; ++i)
+    {
+        Stream& stream = m_streams[i];
+        const uint64_t writtenCount = stream.writtenCount.load(std::memory_order_relaxed);
+        const uint64_t lostCount = stream.lostCount.load(std::memory_order_relaxed);
+        const uint64_t streamByteCount = stream.byteCount.load(std::memory_order_relaxed);
+        const uint64_t writeTicks = stream.writeTicks.load(std::memory_order_relaxed);
+
+        const uint64_t written = writtenCount - stream.lastWrittenCount;
+        const uint64_t lost = lostCount - stream.lastLostCount;
+        byteCount += streamByteCount - stream.lastByteCount;
+        measurements.writeLoad = std::max(measurements.writeLoad, (writeTicks - stream.lastWriteTicks) / periodTicks);
+        if (written + lost > 0)
+        {
+            measurements.lostFraction = std::max(measurements.lostFraction, static_cast<double>(lost) / (written + lost));
+        }
+
+        stream.lastWrittenCount = writtenCount;
+        stream.lastLostCount = lostCount;
+        stream.lastByteCount = streamByteCount;
+        stream.lastWriteTicks = writeTicks;
+    }
+    measurements.bytesPerSecond = byteCount / (periodTicks * 1e-7);
+    measurements.freeBytes = FreeBytes();
+
+    const unsigned level = m_level.load();
+    if (measurements.freeBytes < m_settings.minFreeBytes)
+    {
+        m_quietPeriods = 0;
+        if (level == kFramesOffLevel)
+        {
+            return false;
+        }
+        ChangeLevel(kFramesOffLevel, timestamp, "free_space_exhausted", measurements);
+        return true;
+    }
+
+    // The first budget exceeded by the measurements, scaled down by
+    // margin to tell whether the pressure is well gone
+    auto exceededBudget = [this, &measurements](double margin) -> const char*
+    {
+        if (m_settings.maxBytesPerSecond > 0.0 && measurements.bytesPerSecond > m_settings.maxBytesPerSecond * margin)
+        {
+            return "bytes_per_second";
+        }
+        if (measurements.writeLoad > m_settings.maxWriteLoad * margin)
+        {
+            return "write_load";
+        }
+        if (measurements.lostFraction > m_settings.maxLostFraction * margin)
+        {
+            return "lost_frames";
+        }
+        if (measurements.bytesPerSecond > 0.0 && measurements.freeBytes != std::numeric_limits<unsigned long long>::max() &&
+            (measurements.freeBytes - m_settings.minFreeBytes) * margin / measurements.bytesPerSecond < m_settings.minRecordingSeconds)
+        {
+            return "free_space";
+        }
+        return nullptr;
+    };
+
+    if (const char* reason = exceededBudget(1.0))
+    {
+        m_quietPeriods = 0;
+        // The effect of a level is measured over a whole period before going further
+        if (level + 1 < kFramesOffLevel)
+        {
+            ChangeLevel(level + 1, timestamp, reason, measurements);
+            return true;
+        }
+        return false;
+    }
+
+    if (level == 0 || exceededBudget(0.5))
+    {
+        m_quietPeriods = 0;
+        return false;
+    }
+    if (++m_quietPeriods < m_settings.relaxPeriods)
+    {
+        return false;
+    }
+    m_quietPeriods = 0;
+    ChangeLevel(level - 1, timestamp, "relaxed", measurements);
+    return true;
+}
+
+void RecordingGovernor::ChangeLevel(unsigned level, long long timestamp, const std::string& reason, const GovernorDecision& measurements)
+{
+    // Lock on m_mutex from caller
+    GovernorDecision decision = measurements;
+    decision.timestamp = timestamp;
+    decision.level = level;
+    decision.reason = reason;
+    m_decisions.push_back(decision);
+    m_level.store(level);
+}
+
+unsigned long long RecordingGovernor::FreeBytes() const
+{
+    // Lock on m_mutex from caller
+    ULARGE_INTEGER freeBytes;
+    if (m_storagePath.empty() || !GetDiskFreeSpaceExW(m_storagePath.c_str(), &freeBytes, nullptr, nullptr))
+    {
+        return std::numeric_limits<unsigned long long>::max();
+    }
+    return freeBytes.QuadPart;
+}
+
+unsigned RecordingGovernor::Level() const
+{
+    return m_level.load();
+}
+
+const GovernorPolicy& RecordingGovernor::Policy() const
+{
+    return kPolicies[m_level.load(std::memory_order_relaxed)];
+}
+
+std::vector<GovernorDecision> RecordingGovernor::Decisions()
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    return m_decisions;
+}
+
+void RecordingGovernor::Write(std::ostream& out)
+{
+    for (const GovernorDecision& decision : Decisions())
+    {
+        out << decision.timestamp << "," << decision.level << "," << kPolicies[decision.level].name << "," << decision.reason << ","
+            << static_cast<uint64_t>(decision.bytesPerSecond) << "," << decision.writeLoad << "," << decision.lostFraction << ",";
+        if (decision.freeBytes != std::numeric_limits<unsigned long long>::max())
+        {
+            out << decision.freeBytes;
+        }
+        out << "\n";
+    }
+}
+
+void RecordingGovernor::WriteFrameCounts(std::ostream& out)
+{
+    const size_t streamCount = m_streamCount.load();
+    for (size_t i = 0; i < streamCount; ++i)
+    {
+        const Stream& stream = m_streams[i];
+        out << stream.name << "," << stream.writtenCount.load(std::memory_order_relaxed) << ","
+            << stream.skippedCount.load(std::memory_order_relaxed) << "," << stream.lostCount.load(std::memory_order_relaxed) << "\n";
+    }
+}
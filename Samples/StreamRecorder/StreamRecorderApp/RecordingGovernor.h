@@ -0,0 +1,134 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+enum class GovernedStreamKind
+{
+    VLC,
+    Depth,
+    PV
+};
+
+struct GovernorSettings
+{
+    double maxBytesPerSecond = 0.0;             // frame bytes written per second by all the streams, 0 for no limit
+    unsigned long long minFreeBytes = 0;        // no frames are written below this much free space
+    double minRecordingSeconds = 60.0;          // throttle when the free space lasts less than this at the current rate
+    double maxWriteLoad = 0.8;                  // fraction of the time a writer may spend writing
+    double maxLostFraction = 0.1;               // fraction of the frames a writer may miss because it was busy
+    long long period = 10000000;                // between two evaluations, in hundreds of nanoseconds
+    unsigned relaxPeriods = 5;                  // evaluations without pressure before the last policy is lifted
+};
+
+// What is written at a throttling level: every Nth frame of each kind of stream, 0 for none
+struct GovernorPolicy
+{
+    const char* name;
+    unsigned vlcDecimation;
+    unsigned depthDecimation;
+    unsigned pvDecimation;
+    bool pvCompact;             // PV frames in NV12 (12 bits per pixel) rather than BGRA8
+};
+
+// One change of level, with the measurements of the period that caused it
+struct GovernorDecision
+{
+    long long timestamp;
+    unsigned level;
+    std::string reason;
+    double bytesPerSecond;
+    double writeLoad;           // highest among the streams
+    double lostFraction;        // highest among the streams
+    unsigned long long freeBytes;
+};
+
+// Keeps a recording within its storage budget. The writers ask with
+// ShouldWrite, before copying or converting anything, whether a frame is to be
+// written, and report the bytes they write, the time spent writing and the
+// frames replaced by the next one before they could take them. The app
+// evaluates the budget with Update once per rendered frame: under pressure the
+// streams are throttled one level at a time (VLC first, depth last), and the
+// levels are lifted one at a time once the pressure is gone for a while.
+class RecordingGovernor
+{
+public:
+    static constexpr size_t kMaxStreams = 16;
+
+    RecordingGovernor(const GovernorSettings& settings);
+
+    // Returns the identifier of the stream for the writer calls
+    size_t Register(const std::wstring& name, GovernedStreamKind kind);
+
+    // Writer side, lock-free
+    bool ShouldWrite(size_t stream);
+    bool IsPVCompact() const;
+    void ReportWrite(size_t stream, size_t bytes, long long durationTicks);
+    void ReportLost(size_t stream);
+
+    // Back to the first level, the free space is measured on storagePath
+    void Start(const std::wstring& storagePath, long long timestamp);
+    // Returns true when the level changed
+    bool Update(long long timestamp);
+
+    unsigned Level() const;
+    const GovernorPolicy& Policy() const;
+    std::vector<GovernorDecision> Decisions();
+    // One "timestamp,level,policy,reason,bytes_per_second,write_load,lost_fraction,free_bytes" line per decision
+    void Write(std::ostream& out);
+    // One "stream,written,skipped,lost" line per stream, frame counts since Start
+    void WriteFrameCounts(std::ostream& out);
+
+    const GovernorSettings& Settings() const { return m_settings; }
+
+private:
+    struct Stream
+    {
+        std::string name;
+        GovernedStreamKind kind = GovernedStreamKind::VLC;
+        std::atomic<uint64_t> frameCount = { 0 };
+        std::atomic<uint64_t> writtenCount = { 0 };
+        std::atomic<uint64_t> skippedCount = { 0 };
+        std::atomic<uint64_t> lostCount = { 0 };
+        std::atomic<uint64_t> byteCount = { 0 };
+        std::atomic<uint64_t> writeTicks = { 0 };
+
+        // Totals at the previous evaluation
+        uint64_t lastWrittenCount = 0;
+        uint64_t lastLostCount = 0;
+        uint64_t lastByteCount = 0;
+        uint64_t lastWriteTicks = 0;
+    };
+
+    unsigned long long FreeBytes() const;
+    void ChangeLevel(unsigned level, long long timestamp, const std::string& reason, const GovernorDecision& measurements);
+
+    const GovernorSettings m_settings;
+
+    std::array<Stream, kMaxStreams> m_streams;
+    std::atomic<size_t> m_streamCount = { 0 };
+    std::atomic<unsigned> m_level = { 0 };
+
+    std::mutex m_mutex;
+    std::wstring m_storagePath;
+    bool m_started = false;
+    long long m_lastEvaluation = 0;
+    unsigned m_quietPeriods = 0;
+    std::vector<GovernorDecision> m_decisions;
+};
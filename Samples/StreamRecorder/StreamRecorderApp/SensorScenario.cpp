@@ -18,6 +18,8 @@ HMODULE LoadLibraryA(
 
 static ResearchModeSensorConsent camAccessCheck;
 static HANDLE camConsentGiven;
+static ResearchModeSensorConsent imuAccessCheck;
+static HANDLE imuConsentGiven;
 
 SensorScenario::SensorScenario(const std::vector<ResearchModeSensorType>& kEnabledSensorTypes):
 	m_kEnabledSensorTypes(kEnabledSensorTypes)
@@ -50,6 +52,18 @@ SensorScenario::~SensorScenario()
 	{
 		m_pAHATSensor->Release();
 	}
+	if (m_pAccelSensor)
+	{
+		m_pAccelSensor->Release();
+	}
+	if (m_pGyroSensor)
+	{
+		m_pGyroSensor->Release();
+	}
+	if (m_pMagSensor)
+	{
+		m_pMagSensor->Release();
+	}
 
 	if (m_pSensorDevice)
 	{
@@ -75,6 +89,7 @@ void SensorScenario::InitializeSensors()
 {
 	size_t sensorCount = 0;
 	camConsentGiven = CreateEvent(nullptr, true, false, nullptr);
+	imuConsentGiven = CreateEvent(nullptr, true, false, nullptr);
 
 	// Load Research Mode library
 	HMODULE hrResearchMode = LoadLibraryA("ResearchModeAPI");
@@ -159,7 +174,40 @@ void SensorScenario::InitializeSensors()
 			}
 			winrt::check_hresult(m_pSensorDevice->GetSensor(sensorDescriptor.sensorType, &m_pAHATSensor));
 		}
+
+		if (sensorDescriptor.sensorType == IMU_ACCEL)
+		{
+			if (std::find(m_kEnabledSensorTypes.begin(), m_kEnabledSensorTypes.end(), IMU_ACCEL) == m_kEnabledSensorTypes.end())
+			{
+				continue;
+			}
+			winrt::check_hresult(m_pSensorDevice->GetSensor(sensorDescriptor.sensorType, &m_pAccelSensor));
+		}
+
+		if (sensorDescriptor.sensorType == IMU_GYRO)
+		{
+			if (std::find(m_kEnabledSensorTypes.begin(), m_kEnabledSensorTypes.end(), IMU_GYRO) == m_kEnabledSensorTypes.end())
+			{
+				continue;
+			}
+			winrt::check_hresult(m_pSensorDevice->GetSensor(sensorDescriptor.sensorType, &m_pGyroSensor));
+		}
+
+		if (sensorDescriptor.sensorType == IMU_MAG)
+		{
+			if (std::find(m_kEnabledSensorTypes.begin(), m_kEnabledSensorTypes.end(), IMU_MAG) == m_kEnabledSensorTypes.end())
+			{
+				continue;
+			}
+			winrt::check_hresult(m_pSensorDevice->GetSensor(sensorDescriptor.sensorType, &m_pMagSensor));
+		}
 	}	
+
+	// IMU access needs its own consent
+	if (m_pAccelSensor || m_pGyroSensor || m_pMagSensor)
+	{
+		winrt::check_hresult(m_pSensorDeviceConsent->RequestIMUAccessAsync(SensorScenario::ImuAccessOnComplete));
+	}
 }
 
 void SensorScenario::CamAccessOnComplete(ResearchModeSensorConsent consent)
@@ -168,6 +216,12 @@ void SensorScenario::CamAccessOnComplete(ResearchModeSensorConsent consent)
 	SetEvent(camConsentGiven);
 }
 
+void SensorScenario::ImuAccessOnComplete(ResearchModeSensorConsent consent)
+{
+	imuAccessCheck = consent;
+	SetEvent(imuConsentGiven);
+}
+
 void SensorScenario::InitializeCameraReaders()
 {
 	// Get RigNode id which will be used to initialize
@@ -212,13 +266,30 @@ void SensorScenario::InitializeCameraReaders()
 	}	
 }
 
+void SensorScenario::InitializeImuReaders()
+{
+	for (IResearchModeSensor* pImuSensor : { m_pAccelSensor, m_pGyroSensor, m_pMagSensor })
+	{
+		if (pImuSensor)
+		{
+			m_imuReaders.push_back(std::make_shared<RMImuReader>(pImuSensor, imuConsentGiven, &imuAccessCheck));
+		}
+	}
+}
+
 void SensorScenario::StartRecording(const winrt::Windows::Storage::StorageFolder& folder,
-									const winrt::Windows::Perception::Spatial::SpatialCoordinateSystem& worldCoordSystem)
+									const winrt::Windows::Perception::Spatial::SpatialCoordinateSystem& worldCoordSystem,
+									const std::shared_ptr<Io::StreamClient>& streamClient)
 {
 	for (int i = 0; i < m_cameraReaders.size(); ++i)
 	{
 		m_cameraReaders[i]->SetWorldCoordSystem(worldCoordSystem);
-		m_cameraReaders[i]->SetStorageFolder(folder);		
+		m_cameraReaders[i]->SetStorageFolder(folder, streamClient);
+	}
+
+	for (int i = 0; i < m_imuReaders.size(); ++i)
+	{
+		m_imuReaders[i]->SetStorageFolder(folder);
 	}
 }
 
@@ -228,4 +299,47 @@ void SensorScenario::StopRecording()
 	{
 		m_cameraReaders[i]->ResetStorageFolder();
 	}
+
+	for (int i = 0; i < m_imuReaders.size(); ++i)
+	{
+		m_imuReaders[i]->ResetStorageFolder();
+	}
+}
+
+void SensorScenario::EnablePreRoll(long long duration, size_t maxBytes,
+								   const winrt::Windows::Perception::Spatial::SpatialCoordinateSystem& worldCoordSystem)
+{
+	for (int i = 0; i < m_cameraReaders.size(); ++i)
+	{
+		m_cameraReaders[i]->EnablePreRoll(duration, maxBytes, worldCoordSystem);
+	}
+}
+
+void SensorScenario::SetTrigger(const std::shared_ptr<TriggerEngine>& trigger)
+{
+	for (int i = 0; i < m_cameraReaders.size(); ++i)
+	{
+		m_cameraReaders[i]->SetTrigger(trigger);
+	}
+}
+
+void SensorScenario::SetGovernor(const std::shared_ptr<RecordingGovernor>& governor)
+{
+	for (int i = 0; i < m_cameraReaders.size(); ++i)
+	{
+		m_cameraReaders[i]->SetGovernor(governor);
+	}
+}
+
+void SensorScenario::SetStreamRates(const StreamSettings& settings)
+{
+	for (int i = 0; i < m_cameraReaders.size(); ++i)
+	{
+		m_cameraReaders[i]->SetStreamRate(settings.Rate(m_cameraReaders[i]->SensorType()));
+	}
+
+	for (int i = 0; i < m_imuReaders.size(); ++i)
+	{
+		m_imuReaders[i]->SetStreamRate(settings.Rate(m_imuReaders[i]->SensorType()));
+	}
 }
@@ -13,6 +13,8 @@
 
 #include "researchmode\ResearchModeApi.h"
 #include "RMCameraReader.h"
+#include "RMImuReader.h"
+#include "StreamSettings.h"
 
 
 class SensorScenario
@@ -23,15 +25,25 @@ public:
 
 	void InitializeSensors();
 	void InitializeCameraReaders();	
-	void StartRecording(const winrt::Windows::Storage::StorageFolder& folder, const winrt::Windows::Perception::Spatial::SpatialCoordinateSystem& worldCoordSystem);
+	void InitializeImuReaders();
+	// Camera frames are streamed to the host of streamClient when not null
+	void StartRecording(const winrt::Windows::Storage::StorageFolder& folder, const winrt::Windows::Perception::Spatial::SpatialCoordinateSystem& worldCoordSystem,
+						const std::shared_ptr<Io::StreamClient>& streamClient = nullptr);
 	void StopRecording();
+	void EnablePreRoll(long long duration, size_t maxBytes, const winrt::Windows::Perception::Spatial::SpatialCoordinateSystem& worldCoordSystem);
+	void SetTrigger(const std::shared_ptr<TriggerEngine>& trigger);
+	void SetGovernor(const std::shared_ptr<RecordingGovernor>& governor);
+	// Rates of the streams in settings, the other ones are recorded at full rate
+	void SetStreamRates(const StreamSettings& settings);
 	static void CamAccessOnComplete(ResearchModeSensorConsent consent);
+	static void ImuAccessOnComplete(ResearchModeSensorConsent consent);
 
 private:
 	void GetRigNodeId(GUID& outGuid) const;
 
 	const std::vector<ResearchModeSensorType>& m_kEnabledSensorTypes;
 	std::vector<std::shared_ptr<RMCameraReader>> m_cameraReaders;
+	std::vector<std::shared_ptr<RMImuReader>> m_imuReaders;
 
 	IResearchModeSensorDevice* m_pSensorDevice = nullptr;
 	IResearchModeSensorDeviceConsent* m_pSensorDeviceConsent = nullptr;
@@ -44,4 +56,7 @@ private:
 	IResearchModeSensor* m_pRRCameraSensor = nullptr;
 	IResearchModeSensor* m_pLTSensor = nullptr;
 	IResearchModeSensor* m_pAHATSensor = nullptr;		
+	IResearchModeSensor* m_pAccelSensor = nullptr;
+	IResearchModeSensor* m_pGyroSensor = nullptr;
+	IResearchModeSensor* m_pMagSensor = nullptr;
 };
@@ -0,0 +1,314 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+// Before any header that includes windows.h
+#include <winsock2.h>
+#include <ws2tcpip.h>
+
+#include "StreamClient.h"
+#include "StringHelpers.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#pragma comment(lib, "Ws2_32.lib")
+
+namespace Io
+{
+    static constexpr int kSocketBufferBytes = 4 * 1024 * 1024;
+
+    static StreamMessageHeader MakeHeader(StreamMessageType type, uint16_t channel, size_t pathSize, uint64_t dataSize)
+    {
+        StreamMessageHeader header = {};
+        memcpy(header.magic, "RMST", sizeof(header.magic));
+        header.type = static_cast<uint16_t>(type);
+        header.channel = channel;
+        header.pathSize = static_cast<uint32_t>(pathSize);
+        header.dataSize = dataSize;
+        return header;
+    }
+
+    StreamClient::StreamClient() :
+        m_socket(INVALID_SOCKET)
+    {
+        WSADATA wsaData;
+        m_wsaStarted = (WSAStartup(MAKEWORD(2, 2), &wsaData) == 0);
+    }
+
+    StreamClient::~StreamClient()
+    {
+        Close(0);
+        if (m_wsaStarted)
+        {
+            WSACleanup();
+        }
+    }
+
+    bool StreamClient::Connect(const std::wstring& host, const std::wstring& port)
+    {
+        if (!m_wsaStarted || m_socket != INVALID_SOCKET)
+        {
+            return false;
+        }
+
+        ADDRINFOW hints = {};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        hints.ai_protocol = IPPROTO_TCP;
+
+        ADDRINFOW* pAddresses = nullptr;
+        if (GetAddrInfoW(host.c_str(), port.c_str(), &hints, &pAddresses) != 0)
+        {
+            OutputDebugString(L"Cannot resolve the streaming host");
+            return false;
+        }
+
+        SOCKET s = INVALID_SOCKET;
+        for (ADDRINFOW* pAddress = pAddresses; pAddress != nullptr; pAddress = pAddress->ai_next)
+        {
+            s = socket(pAddress->ai_family, pAddress->ai_socktype, pAddress->ai_protocol);
+            if (s == INVALID_SOCKET)
+            {
+                continue;
+            }
+            if (connect(s, pAddress->ai_addr, static_cast<int>(pAddress->ai_addrlen)) == 0)
+            {
+                break;
+            }
+            closesocket(s);
+            s = INVALID_SOCKET;
+        }
+        FreeAddrInfoW(pAddresses);
+
+        if (s == INVALID_SOCKET)
+        {
+            OutputDebugString(L"Cannot connect to the streaming host");
+            return false;
+        }
+
+        // Large frames: fewer, larger segments, and room for a few frames in the kernel
+        setsockopt(s, SOL_SOCKET, SO_SNDBUF, reinterpret_cast<const char*>(&kSocketBufferBytes), sizeof(kSocketBufferBytes));
+
+        m_socket = s;
+        {
+            std::lock_guard<std::mutex> guard(m_channelMutex);
+            m_connected = true;
+        }
+        m_ackThread = std::thread(AckThread, this);
+        return true;
+    }
+
+    void StreamClient::Close(unsigned timeoutMs)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_channelMutex);
+            m_channelCondVar.wait_for(lock, std::chrono::milliseconds(timeoutMs), [this]
+            {
+                if (!m_connected)
+                {
+                    return true;
+                }
+                for (const Channel& channel : m_channels)
+                {
+                    if (channel.inFlightBytes > 0)
+                    {
+                        return false;
+                    }
+                }
+                return true;
+            });
+        }
+
+        Disconnect();
+        if (m_ackThread.joinable())
+        {
+            m_ackThread.join();
+        }
+
+        std::lock_guard<std::mutex> guard(m_sendMutex);
+        if (m_socket != INVALID_SOCKET)
+        {
+            closesocket(static_cast<SOCKET>(m_socket));
+            m_socket = INVALID_SOCKET;
+        }
+    }
+
+    bool StreamClient::IsConnected()
+    {
+        std::lock_guard<std::mutex> guard(m_channelMutex);
+        return m_connected;
+    }
+
+    uint16_t StreamClient::AddChannel(size_t windowBytes)
+    {
+        std::lock_guard<std::mutex> guard(m_channelMutex);
+        m_channels.push_back(Channel{ windowBytes, 0, 0 });
+        return static_cast<uint16_t>(m_channels.size() - 1);
+    }
+
+    uint64_t StreamClient::DroppedCount(uint16_t channel)
+    {
+        std::lock_guard<std::mutex> guard(m_channelMutex);
+        return m_channels[channel].droppedCount;
+    }
+
+    bool StreamClient::Send(uint16_t channel, StreamMessageType type, const std::string& path,
+                            const Buffer* parts, size_t partCount, StreamFlow flow)
+    {
+        uint64_t dataSize = 0;
+        for (size_t i = 0; i < partCount; ++i)
+        {
+            dataSize += parts[i].size;
+        }
+        const StreamMessageHeader header = MakeHeader(type, channel, path.size(), dataSize);
+        const size_t messageSize = sizeof(header) + path.size() + static_cast<size_t>(dataSize);
+
+        {
+            std::unique_lock<std::mutex> lock(m_channelMutex);
+            // A message larger than the window goes alone. The channel is looked up
+            // on every check: AddChannel may reallocate m_channels during the wait
+            auto hasRoom = [this, channel, messageSize]
+            {
+                const Channel& state = m_channels[channel];
+                return !m_connected || state.inFlightBytes == 0 || state.inFlightBytes + messageSize <= state.windowBytes;
+            };
+            if (flow == StreamFlow::Wait)
+            {
+                m_channelCondVar.wait(lock, hasRoom);
+            }
+            if (!m_connected)
+            {
+                return false;
+            }
+            Channel& state = m_channels[channel];
+            if (!hasRoom())
+            {
+                ++state.droppedCount;
+                return false;
+            }
+            state.inFlightBytes += messageSize;
+        }
+
+        std::vector<Buffer> message;
+        message.reserve(partCount + 2);
+        message.push_back(Buffer{ reinterpret_cast<const uint8_t*>(&header), sizeof(header) });
+        message.push_back(Buffer{ reinterpret_cast<const uint8_t*>(path.data()), path.size() });
+        message.insert(message.end(), parts, parts + partCount);
+
+        bool sent;
+        {
+            std::lock_guard<std::mutex> guard(m_sendMutex);
+            sent = SendAll(message.data(), message.size());
+        }
+        if (!sent)
+        {
+            Disconnect();
+        }
+        return sent;
+    }
+
+    bool StreamClient::SendAll(const Buffer* parts, size_t partCount)
+    {
+        // Lock on m_sendMutex from caller
+        if (m_socket == INVALID_SOCKET)
+        {
+            return false;
+        }
+
+        std::vector<WSABUF> buffers;
+        buffers.reserve(partCount);
+        for (size_t i = 0; i < partCount; ++i)
+        {
+            if (parts[i].size > 0)
+            {
+                buffers.push_back(WSABUF{ static_cast<ULONG>(parts[i].size), reinterpret_cast<CHAR*>(const_cast<uint8_t*>(parts[i].data)) });
+            }
+        }
+
+        size_t first = 0;
+        while (first < buffers.size())
+        {
+            DWORD sentBytes = 0;
+            if (WSASend(static_cast<SOCKET>(m_socket), &buffers[first], static_cast<DWORD>(buffers.size() - first), &sentBytes, 0, nullptr, nullptr) != 0)
+            {
+                return false;
+            }
+
+            // A blocking send normally takes everything, skip what was taken otherwise
+            while (first < buffers.size() && sentBytes >= buffers[first].len)
+            {
+                sentBytes -= buffers[first].len;
+                ++first;
+            }
+            if (first < buffers.size())
+            {
+                buffers[first].buf += sentBytes;
+                buffers[first].len -= sentBytes;
+            }
+        }
+        return true;
+    }
+
+    void StreamClient::Disconnect()
+    {
+        {
+            std::lock_guard<std::mutex> guard(m_channelMutex);
+            m_connected = false;
+            m_channelCondVar.notify_all();
+        }
+        // Wakes up the acknowledgment thread and any blocked send
+        if (m_socket != INVALID_SOCKET)
+        {
+            shutdown(static_cast<SOCKET>(m_socket), SD_BOTH);
+        }
+    }
+
+    void StreamClient::AckThread(StreamClient* pClient)
+    {
+        const SOCKET s = static_cast<SOCKET>(pClient->m_socket);
+
+        while (true)
+        {
+            StreamMessageHeader header;
+            int received = recv(s, reinterpret_cast<char*>(&header), sizeof(header), MSG_WAITALL);
+            if (received != sizeof(header) || memcmp(header.magic, "RMST", sizeof(header.magic)) != 0 ||
+                header.type != static_cast<uint16_t>(StreamMessageType::Ack) || header.pathSize != 0)
+            {
+                break;
+            }
+
+            std::lock_guard<std::mutex> guard(pClient->m_channelMutex);
+            if (header.channel < pClient->m_channels.size())
+            {
+                Channel& channel = pClient->m_channels[header.channel];
+                channel.inFlightBytes -= std::min<size_t>(channel.inFlightBytes, static_cast<size_t>(header.dataSize));
+                pClient->m_channelCondVar.notify_all();
+            }
+        }
+
+        std::lock_guard<std::mutex> guard(pClient->m_channelMutex);
+        pClient->m_connected = false;
+        pClient->m_channelCondVar.notify_all();
+    }
+
+    StreamedTarball::StreamedTarball(const std::shared_ptr<StreamClient>& client, const std::wstring& tarballFileName, size_t windowBytes) :
+        m_client(client),
+        m_tarballName(Utf16ToUtf8(tarballFileName)),
+        m_channel(client->AddChannel(windowBytes))
+    {
+    }
+
+    bool StreamedTarball::AddFile(const std::wstring& fileName, const Buffer* parts, size_t partCount)
+    {
+        return m_client->Send(m_channel, StreamMessageType::TarFile, m_tarballName + "/" + Utf16ToUtf8(fileName), parts, partCount, StreamFlow::Drop);
+    }
+}
@@ -0,0 +1,133 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+#pragma once
+
+#include "Tar.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Io
+{
+    // Every message is a StreamMessageHeader, followed by pathSize bytes of
+    // UTF-8 path, relative to the recording folder, and dataSize bytes of data.
+    // Received by StreamRecorderConverter/stream_receiver.py
+    enum class StreamMessageType : uint16_t
+    {
+        Begin = 1,      // path: name of the recording folder
+        End = 2,        // the recording is complete
+        TarFile = 3,    // path: <tarball>/<file>, appended to the tarball
+        File = 4,       // path: <file>, created or replaced
+        FileAppend = 5, // path: <file>, data appended to it
+        Ack = 6         // host to device: dataSize bytes of the channel were written
+    };
+
+    struct StreamMessageHeader
+    {
+        char magic[4];      // "RMST"
+        uint16_t type;      // StreamMessageType
+        uint16_t channel;   // flow control channel, see StreamClient::AddChannel
+        uint32_t pathSize;
+        uint32_t reserved;
+        uint64_t dataSize;
+    };
+
+    static_assert(sizeof(StreamMessageHeader) == 24, "Unexpected stream message header size");
+
+    enum class StreamFlow
+    {
+        Drop,   // frames: drop the message when the channel is full
+        Wait    // metadata: wait for the host to catch up
+    };
+
+    // Sends the files of a recording to a host over TCP instead of writing
+    // them to disk. The parts of a message are handed to the socket as they
+    // are (scatter/gather), frame data is never copied into a message buffer.
+    // Every stream sends on its own channel, with a window of bytes the host
+    // has not acknowledged yet: a stream the network cannot keep up with
+    // drops its own frames, and never holds up the other streams for long.
+    class StreamClient
+    {
+    public:
+        // Unacknowledged bytes per channel, a few frames of the largest streams
+        static constexpr size_t kDefaultWindowBytes = 8 * 1024 * 1024;
+
+        StreamClient();
+        ~StreamClient();
+
+        bool Connect(const std::wstring& host, const std::wstring& port);
+        // Waits (at most timeoutMs) for the host to acknowledge all the messages, then disconnects
+        void Close(unsigned timeoutMs = 5000);
+        bool IsConnected();
+
+        uint16_t AddChannel(size_t windowBytes = kDefaultWindowBytes);
+
+        // Returns false when the message was dropped, or the connection is lost
+        bool Send(uint16_t channel, StreamMessageType type, const std::string& path,
+                  const Buffer* parts, size_t partCount, StreamFlow flow);
+        bool Send(uint16_t channel, StreamMessageType type, const std::string& path)
+        {
+            return Send(channel, type, path, nullptr, 0, StreamFlow::Wait);
+        }
+
+        uint64_t DroppedCount(uint16_t channel);
+
+    private:
+        struct Channel
+        {
+            size_t windowBytes;
+            size_t inFlightBytes;
+            uint64_t droppedCount;
+        };
+
+        // Thread for receiving the acknowledgments
+        static void AckThread(StreamClient* pClient);
+        bool SendAll(const Buffer* parts, size_t partCount);
+        void Disconnect();
+
+        // SOCKET, kept out of the header to not depend on winsock2.h
+        uintptr_t m_socket;
+        bool m_wsaStarted = false;
+
+        // Held while a message is being sent, so that messages never interleave
+        std::mutex m_sendMutex;
+
+        std::mutex m_channelMutex;
+        std::condition_variable m_channelCondVar;
+        std::vector<Channel> m_channels;
+        bool m_connected = false;
+
+        std::thread m_ackThread;
+    };
+
+    // Tarball rebuilt on the host from the files sent on a channel of the client
+    class StreamedTarball : public Archive
+    {
+    public:
+        StreamedTarball(const std::shared_ptr<StreamClient>& client, const std::wstring& tarballFileName,
+                        size_t windowBytes = StreamClient::kDefaultWindowBytes);
+
+        // Frames the host could not take in time are dropped
+        using Archive::AddFile;
+        bool AddFile(const std::wstring& fileName, const Buffer* parts, size_t partCount) override;
+
+    private:
+        std::shared_ptr<StreamClient> m_client;
+        std::string m_tarballName;
+        uint16_t m_channel;
+    };
+}
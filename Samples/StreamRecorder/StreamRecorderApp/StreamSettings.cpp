@@ -0,0 +1,181 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+#include "StreamSettings.h"
+
+#include <windows.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+
+static const struct
+{
+    const char* name;
+    ResearchModeSensorType type;
+} kRMStreamNames[] =
+{
+    { "LEFT_FRONT", LEFT_FRONT },
+    { "LEFT_LEFT", LEFT_LEFT },
+    { "RIGHT_FRONT", RIGHT_FRONT },
+    { "RIGHT_RIGHT", RIGHT_RIGHT },
+    { "DEPTH_AHAT", DEPTH_AHAT },
+    { "DEPTH_LONG_THROW", DEPTH_LONG_THROW },
+    { "IMU_ACCEL", IMU_ACCEL },
+    { "IMU_GYRO", IMU_GYRO },
+    { "IMU_MAG", IMU_MAG }
+};
+
+static const struct
+{
+    const char* name;
+    StreamTypes type;
+} kStreamNames[] =
+{
+    { "PV", StreamTypes::PV },
+    { "EYE", StreamTypes::EYE }
+};
+
+static bool ParseRate(const std::string& text, StreamRate& rate)
+{
+    const char* begin = text.c_str();
+    char* end = nullptr;
+    const size_t fpsPos = text.size() > 3 ? text.size() - 3 : std::string::npos;
+    if (fpsPos != std::string::npos && text.compare(fpsPos, 3, "fps") == 0)
+    {
+        const double fps = std::strtod(begin, &end);
+        if (end != begin + fpsPos || !(fps > 0.0) || !std::isfinite(fps))
+        {
+            return false;
+        }
+        rate.everyNth = 1;
+        rate.minInterval = std::max(static_cast<long long>(1e7 / fps), 1LL);
+        return true;
+    }
+
+    const unsigned long everyNth = std::strtoul(begin, &end, 10);
+    if (text.empty() || text[0] == '-' || end != begin + text.size() || everyNth == 0)
+    {
+        return false;
+    }
+    rate.everyNth = static_cast<unsigned>(everyNth);
+    rate.minInterval = 0;
+    return true;
+}
+
+static void WriteRate(std::ostream& out, const StreamRate& rate)
+{
+    if (rate.minInterval > 0)
+    {
+        out << " " << 1e7 / rate.minInterval << "fps";
+    }
+    else if (rate.everyNth > 1)
+    {
+        out << " " << rate.everyNth;
+    }
+}
+
+bool StreamSettings::Read(std::istream& in)
+{
+    rmStreams.clear();
+    streams.clear();
+    rmRates.clear();
+    rates.clear();
+
+    bool valid = true;
+    std::string line;
+    while (std::getline(in, line))
+    {
+        std::istringstream fields(line.substr(0, line.find('#')));
+        std::string name;
+        if (!(fields >> name))
+        {
+            continue;
+        }
+
+        StreamRate rate;
+        std::string rateText;
+        std::string extra;
+        if (((fields >> rateText) && !ParseRate(rateText, rate)) || (fields >> extra))
+        {
+            OutputDebugStringA(("Invalid stream setting: " + line + "\n").c_str());
+            valid = false;
+            continue;
+        }
+
+        bool found = false;
+        for (const auto& stream : kRMStreamNames)
+        {
+            if (name == stream.name)
+            {
+                if (std::find(rmStreams.begin(), rmStreams.end(), stream.type) == rmStreams.end())
+                {
+                    rmStreams.push_back(stream.type);
+                }
+                rmRates[stream.type] = rate;
+                found = true;
+            }
+        }
+        for (const auto& stream : kStreamNames)
+        {
+            if (name == stream.name)
+            {
+                if (std::find(streams.begin(), streams.end(), stream.type) == streams.end())
+                {
+                    streams.push_back(stream.type);
+                }
+                rates[stream.type] = rate;
+                found = true;
+            }
+        }
+        if (!found)
+        {
+            OutputDebugStringA(("Unknown stream: " + name + "\n").c_str());
+            valid = false;
+        }
+    }
+    return valid;
+}
+
+void StreamSettings::Write(std::ostream& out) const
+{
+    for (const auto& stream : kRMStreamNames)
+    {
+        if (std::find(rmStreams.begin(), rmStreams.end(), stream.type) != rmStreams.end())
+        {
+            out << stream.name;
+            WriteRate(out, Rate(stream.type));
+            out << "\n";
+        }
+    }
+    for (const auto& stream : kStreamNames)
+    {
+        if (std::find(streams.begin(), streams.end(), stream.type) != streams.end())
+        {
+            out << stream.name;
+            WriteRate(out, Rate(stream.type));
+            out << "\n";
+        }
+    }
+}
+
+StreamRate StreamSettings::Rate(ResearchModeSensorType type) const
+{
+    auto rate = rmRates.find(type);
+    return rate != rmRates.end() ? rate->second : StreamRate();
+}
+
+StreamRate StreamSettings::Rate(StreamTypes type) const
+{
+    auto rate = rates.find(type);
+    return rate != rates.end() ? rate->second : StreamRate();
+}
@@ -0,0 +1,103 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+#pragma once
+
+#include "researchmode\ResearchModeApi.h"
+
+#include <istream>
+#include <map>
+#include <ostream>
+#include <vector>
+
+enum StreamTypes
+{
+    PV,  // RGB
+    EYE  // Eye gaze tracking
+    // Hands captured by default
+};
+
+// Rate at which the frames (or IMU samples) of a stream are recorded
+struct StreamRate
+{
+    unsigned everyNth = 1;          // every Nth frame
+    long long minInterval = 0;      // at most one frame per interval, in hundreds of nanoseconds
+};
+
+// Streams to record and their rates, read from a text file with one stream
+// per line: its name (LEFT_FRONT, ..., IMU_MAG, PV or EYE) optionally followed
+// by a rate, either N to record every Nth frame or Xfps to record at most X
+// frames per second; the eye gaze stream has no rate, it is recorded with the
+// head and hands at the app frame rate. Everything after a '#' is a comment, e.g.
+//   LEFT_FRONT 3
+//   DEPTH_LONG_THROW
+//   PV 5fps
+struct StreamSettings
+{
+    std::vector<ResearchModeSensorType> rmStreams;
+    std::vector<StreamTypes> streams;
+    std::map<ResearchModeSensorType, StreamRate> rmRates;
+    std::map<StreamTypes, StreamRate> rates;
+
+    // Replaces the settings with the streams of the file. Returns false when a
+    // line cannot be parsed, the other lines are taken into account
+    bool Read(std::istream& in);
+    void Write(std::ostream& out) const;
+
+    StreamRate Rate(ResearchModeSensorType type) const;
+    StreamRate Rate(StreamTypes type) const;
+};
+
+// Drops the frames of a stream in excess of its rate. Frame timestamps are
+// in hundreds of nanoseconds; not thread-safe, the writers call Keep under
+// the lock they hold while deciding what to do with a frame
+class FrameDecimator
+{
+public:
+    void SetRate(const StreamRate& rate)
+    {
+        m_rate = rate;
+        m_frameCount = 0;
+        m_next = 0;
+    }
+
+    const StreamRate& Rate() const { return m_rate; }
+
+    bool Keep(long long timestamp)
+    {
+        if (m_rate.everyNth > 1 && m_frameCount++ % m_rate.everyNth != 0)
+        {
+            return false;
+        }
+        if (m_rate.minInterval > 0)
+        {
+            // Frames are scheduled every interval rather than an interval after the
+            // previous one, so that the jitter of the frame times does not lower the
+            // rate; a tenth of the interval is tolerated
+            if (m_next != 0 && timestamp + m_rate.minInterval / 10 < m_next)
+            {
+                return false;
+            }
+            m_next += m_rate.minInterval;
+            if (m_next <= timestamp)
+            {
+                // First frame, or after a gap
+                m_next = timestamp + m_rate.minInterval;
+            }
+        }
+        return true;
+    }
+
+private:
+    StreamRate m_rate;
+    unsigned long long m_frameCount = 0;
+    long long m_next = 0;
+};
@@ -173,13 +173,19 @@ namespace Io
         }
     }
 
-    void Tarball::AddFile(
+    bool Tarball::AddFile(
             const std::wstring& fileName,
-            const uint8_t* fileData,
-            const size_t fileSize)
+            const Buffer* parts,
+            size_t partCount)
     {
         assert(m_tarballFile.is_open());
 
+        size_t fileSize = 0;
+        for (size_t i = 0; i < partCount; ++i)
+        {
+            fileSize += parts[i].size;
+        }
+
         static_assert(
             sizeof(TarHeader) == 512,
             "Size of the TarHeader structure must be equal to 512 bytes.");
@@ -207,8 +213,11 @@ namespace Io
 
         m_tarballFile.write(
             reinterpret_cast<const char*>(&header), sizeof(header));
-        m_tarballFile.write(
-            reinterpret_cast<const char*>(fileData), fileSize);
+        for (size_t i = 0; i < partCount; ++i)
+        {
+            m_tarballFile.write(
+                reinterpret_cast<const char*>(parts[i].data), parts[i].size);
+        }
 
         // Make sure the file is aligned to 512 byes, otherwise
         // pad the file with zeros.
@@ -222,5 +231,7 @@ namespace Io
             m_tarballFile.write(
                 std::vector<char>(lastBlockPadding, 0).data(), lastBlockPadding);
         }
+
+        return static_cast<bool>(m_tarballFile);
     }
 }
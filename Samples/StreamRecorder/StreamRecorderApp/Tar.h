@@ -18,9 +18,35 @@
 
 namespace Io
 {	
+	// A contiguous part of a file, the data is not owned
+	struct Buffer
+	{
+		const uint8_t* data;
+		size_t size;
+	};
+
+	// Destination of the frame files of a stream: a tarball on disk,
+	// or a tarball rebuilt on the host the frames are streamed to
+	class Archive
+	{
+	public:
+		virtual ~Archive() = default;
+
+		// Add a file made of the concatenation of the parts, which are
+		// written as they are, without being gathered into a single buffer first.
+		// Returns false when the file was not added (dropped, or write error)
+		virtual bool AddFile(const std::wstring& fileName, const Buffer* parts, size_t partCount) = 0;
+
+		bool AddFile(const std::wstring& fileName, const uint8_t* fileData, const size_t fileSize)
+		{
+			const Buffer part = { fileData, fileSize };
+			return AddFile(fileName, &part, 1);
+		}
+	};
+
 	// Class to create tarball, which allows for incremental
 	// streaming of files into the archive
-	class Tarball
+	class Tarball : public Archive
 	{
 	public:
 		Tarball(const std::wstring& tarballFileName);
@@ -30,7 +56,8 @@ namespace Io
 		void Close();
 
 		// Add a file to the tarball
-		void AddFile(const std::wstring& fileName, const uint8_t* fileData, const size_t fileSize);
+		using Archive::AddFile;
+		bool AddFile(const std::wstring& fileName, const Buffer* parts, size_t partCount) override;
 
 	private:
 		// The file handler to the tarball
@@ -0,0 +1,136 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+#include "TriggerEngine.h"
+
+#include <algorithm>
+#include <cmath>
+
+TriggerEngine::TriggerEngine(const TriggerSettings& settings) :
+    m_settings(settings)
+{
+}
+
+unsigned TriggerEngine::Evaluate(const TriggerFeatures& features) const
+{
+    unsigned holding = TriggerNone;
+
+    if ((m_settings.conditions & TriggerHeadMotion) && m_hasPrevious && features.timestamp > m_previous.timestamp)
+    {
+        const float seconds = (features.timestamp - m_previous.timestamp) * 1e-7f;
+        float distance2 = 0.0f;
+        float cosAngle = 0.0f;
+        float norm2 = 0.0f;
+        float previousNorm2 = 0.0f;
+        for (int i = 0; i < 3; ++i)
+        {
+            const float delta = features.headPosition[i] - m_previous.headPosition[i];
+            distance2 += delta * delta;
+            cosAngle += features.headForward[i] * m_previous.headForward[i];
+            norm2 += features.headForward[i] * features.headForward[i];
+            previousNorm2 += m_previous.headForward[i] * m_previous.headForward[i];
+        }
+        cosAngle /= std::max(std::sqrt(norm2 * previousNorm2), 1e-6f);
+        const float degrees = std::acos(std::min(std::max(cosAngle, -1.0f), 1.0f)) * 57.2957795f;
+
+        if (std::sqrt(distance2) > m_settings.headSpeed * seconds ||
+            degrees > m_settings.headAngularSpeed * seconds)
+        {
+            holding |= TriggerHeadMotion;
+        }
+    }
+
+    if ((m_settings.conditions & TriggerHandsPresent) && features.handPresent)
+    {
+        holding |= TriggerHandsPresent;
+    }
+
+    if ((m_settings.conditions & TriggerQRCodeVisible) && features.qrCodeLastSeen != 0 &&
+        features.timestamp - features.qrCodeLastSeen <= m_settings.qrCodeMaxAge)
+    {
+        holding |= TriggerQRCodeVisible;
+    }
+
+    return holding;
+}
+
+unsigned TriggerEngine::Update(const TriggerFeatures& features)
+{
+    const unsigned holding = Evaluate(features);
+    m_previous = features;
+    m_hasPrevious = true;
+
+    std::lock_guard<std::mutex> guard(m_mutex);
+    if (holding != TriggerNone)
+    {
+        // An event starting before the frames kept after the previous one
+        // are over extends the previous window
+        if (!m_triggered && (m_windows.empty() ||
+            features.timestamp - m_settings.preWindow > m_windows.back().end + m_settings.postWindow))
+        {
+            m_windows.push_back(TriggerWindow{ features.timestamp, features.timestamp, holding });
+        }
+        m_windows.back().end = std::max(m_windows.back().end, features.timestamp);
+        m_windows.back().conditions |= holding;
+    }
+    m_triggered = (holding != TriggerNone);
+    return holding;
+}
+
+bool TriggerEngine::ShouldWrite(long long timestamp)
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    for (auto it = m_windows.rbegin(); it != m_windows.rend(); ++it)
+    {
+        // While the conditions hold, the window is open to the frames captured
+        // after the last evaluation
+        const bool open = m_triggered && it == m_windows.rbegin();
+        if (timestamp >= it->begin - m_settings.preWindow &&
+            (open || timestamp <= it->end + m_settings.postWindow))
+        {
+            return true;
+        }
+        // Windows are sorted and disjoint
+        if (!open && timestamp > it->end + m_settings.postWindow)
+        {
+            break;
+        }
+    }
+    return false;
+}
+
+bool TriggerEngine::IsTriggered()
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    return m_triggered;
+}
+
+void TriggerEngine::Reset()
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    m_windows.clear();
+    m_triggered = false;
+    m_hasPrevious = false;
+}
+
+std::vector<TriggerWindow> TriggerEngine::Windows()
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    return m_windows;
+}
+
+void TriggerEngine::Write(std::ostream& out)
+{
+    for (const TriggerWindow& window : Windows())
+    {
+        out << window.begin << "," << window.end << "," << window.conditions << "\n";
+    }
+}
@@ -0,0 +1,90 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+#pragma once
+
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+// Conditions triggering the recording, any of them holding is enough
+enum TriggerCondition : unsigned
+{
+    TriggerNone = 0,
+    TriggerHeadMotion = 1 << 0,     // head moving or turning faster than the thresholds
+    TriggerHandsPresent = 1 << 1,   // at least one hand tracked
+    TriggerQRCodeVisible = 1 << 2   // a QR code (marker) seen recently
+};
+
+struct TriggerSettings
+{
+    unsigned conditions = TriggerNone;
+    float headSpeed = 0.5f;             // meters per second
+    float headAngularSpeed = 90.0f;     // degrees per second
+    long long qrCodeMaxAge = 10000000;  // a QR code is in view if seen less than this ago
+    long long preWindow = 0;            // frames kept before a trigger event
+    long long postWindow = 0;           // frames kept after the conditions stop holding
+};
+
+// Cheap features of an app frame the conditions are evaluated on.
+// Timestamps are in hundreds of nanoseconds, as the frame timestamps
+struct TriggerFeatures
+{
+    long long timestamp = 0;
+    float headPosition[3] = {};
+    float headForward[3] = {};
+    bool handPresent = false;
+    long long qrCodeLastSeen = 0;   // 0 when no QR code was ever seen
+};
+
+// Time interval during which the conditions held
+struct TriggerWindow
+{
+    long long begin;
+    long long end;
+    unsigned conditions;
+};
+
+// Decides which frames are written while a trigger-based recording is armed.
+// The app evaluates the conditions once per rendered frame with Update, the
+// capture threads ask with ShouldWrite whether their frames fall within the
+// windows around the trigger events; the frames before an event are taken
+// from their pre-roll buffers.
+class TriggerEngine
+{
+public:
+    TriggerEngine(const TriggerSettings& settings);
+
+    // Returns the conditions holding at features.timestamp
+    unsigned Update(const TriggerFeatures& features);
+    bool ShouldWrite(long long timestamp);
+    bool IsTriggered();
+    void Reset();
+
+    std::vector<TriggerWindow> Windows();
+    // One "begin,end,conditions" line per window
+    void Write(std::ostream& out);
+
+    const TriggerSettings& Settings() const { return m_settings; }
+
+private:
+    unsigned Evaluate(const TriggerFeatures& features) const;
+
+    const TriggerSettings m_settings;
+
+    TriggerFeatures m_previous;
+    bool m_hasPrevious = false;
+
+    std::mutex m_mutex;
+    std::vector<TriggerWindow> m_windows;
+    // Whether the conditions still hold at the end of the last window
+    bool m_triggered = false;
+};
@@ -11,6 +11,7 @@
 
 #include "VideoFrameProcessor.h"
 #include <winrt/Windows.Foundation.Collections.h>
+#include <chrono>
 #include <fstream>
 
 using namespace winrt::Windows::Foundation::Collections;
@@ -23,6 +24,10 @@ using namespace winrt::Windows::Storage;
 const int VideoFrameProcessor::kImageWidth = 760;
 const wchar_t VideoFrameProcessor::kSensorName[3] = L"PV";
 
+// The write thread sleeps until the next frame, or at most this long so that
+// it notices the exit request and the storage changes
+static constexpr std::chrono::milliseconds kFrameWaitTimeout(100);
+
 winrt::Windows::Foundation::IAsyncAction VideoFrameProcessor::InitializeAsync()
 {
     auto mediaFrameSourceGroups{ co_await MediaFrameSourceGroup::FindAllAsync() };
@@ -113,8 +118,17 @@ void VideoFrameProcessor::OnFrameArrived(const MediaFrameReader& sender, const M
 {
     if (MediaFrameReference frame = sender.TryAcquireLatestFrame())
     {    
-        std::lock_guard<std::shared_mutex> lock(m_frameMutex);
-        m_latestFrame = frame;
+        {
+            std::lock_guard<std::shared_mutex> lock(m_frameMutex);
+            // The write thread fell behind and missed that frame
+            if (m_latestFrame != nullptr && !m_latestFrameTaken && m_governor)
+            {
+                m_governor->ReportLost(m_governorStream);
+            }
+            m_latestFrame = frame;
+            m_latestFrameTaken = false;
+        }
+        m_frameCondVar.notify_one();
     }
 }
 
@@ -125,6 +139,12 @@ void VideoFrameProcessor::Clear()
 }
 
 void VideoFrameProcessor::AddLogFrame()
+{
+    // Lock on m_frameMutex from caller
+    m_PVFrameLog.push_back(CreateLogFrame());
+}
+
+PVFrame VideoFrameProcessor::CreateLogFrame()
 {
     // Lock on m_frameMutex from caller
     PVFrame frame;
@@ -138,15 +158,19 @@ void VideoFrameProcessor::AddLogFrame()
     {
         frame.PVtoWorldtransform = PVtoWorld.Value();
     }
-    m_PVFrameLog.push_back(std::move(frame));
+    return frame;
 }
 
-void VideoFrameProcessor::DumpFrame(const SoftwareBitmap& softwareBitmap, long long timestamp)
-{        
+static std::wstring FrameFileName(long long timestamp)
+{
     // Compose the output file name
     wchar_t bitmapPath[MAX_PATH];
     swprintf_s(bitmapPath, L"%lld.%s", timestamp, L"bytes");
+    return bitmapPath;
+}
 
+size_t VideoFrameProcessor::DumpFrame(const SoftwareBitmap& softwareBitmap, long long timestamp)
+{        
     // Get bitmap buffer object of the frame
     BitmapBuffer bitmapBuffer = softwareBitmap.LockBuffer(BitmapBufferAccessMode::Read);
 
@@ -157,7 +181,50 @@ void VideoFrameProcessor::DumpFrame(const SoftwareBitmap& softwareBitmap, long l
     auto spMemoryBufferByteAccess{ bitmapBuffer.CreateReference().as<::Windows::Foundation::IMemoryBufferByteAccess>() };
     winrt::check_hresult(spMemoryBufferByteAccess->GetBuffer(&pixelBufferData, &pixelBufferDataLength));
 
-    m_tarball->AddFile(bitmapPath, &pixelBufferData[0], pixelBufferDataLength);    
+    if (!m_tarball->AddFile(FrameFileName(timestamp), &pixelBufferData[0], pixelBufferDataLength))
+    {
+        return 0;
+    }
+    return pixelBufferDataLength;
+}
+
+void VideoFrameProcessor::BufferFrame(const SoftwareBitmap& softwareBitmap, const PVFrame& logFrame)
+{
+    BitmapBuffer bitmapBuffer = softwareBitmap.LockBuffer(BitmapBufferAccessMode::Read);
+
+    uint32_t pixelBufferDataLength = 0;
+    uint8_t* pixelBufferData;
+
+    auto spMemoryBufferByteAccess{ bitmapBuffer.CreateReference().as<::Windows::Foundation::IMemoryBufferByteAccess>() };
+    winrt::check_hresult(spMemoryBufferByteAccess->GetBuffer(&pixelBufferData, &pixelBufferDataLength));
+
+    // The bitmap is copied once here, then moved up to the tarball
+    BufferedFrame<PVFrame> frame;
+    frame.timestamp = logFrame.timestamp;
+    frame.hasMetadata = true;
+    frame.metadata = logFrame;
+    frame.files.push_back(BufferedFile{ FrameFileName(logFrame.timestamp),
+                                        std::vector<uint8_t>(pixelBufferData, pixelBufferData + pixelBufferDataLength) });
+    m_preRoll->Push(std::move(frame));
+}
+
+void VideoFrameProcessor::FlushPreRoll()
+{
+    // Lock on m_storageMutex from caller
+    // Only the frames the archive took are logged, pv.txt lists the frames of PV.tar
+    for (const BufferedFrame<PVFrame>& frame : m_preRoll->Drain())
+    {
+        bool added = true;
+        for (const BufferedFile& file : frame.files)
+        {
+            added = m_tarball->AddFile(file.name, file.data.data(), file.data.size()) && added;
+        }
+        if (added)
+        {
+            std::lock_guard<std::shared_mutex> lock(m_frameMutex);
+            m_PVFrameLog.push_back(frame.metadata);
+        }
+    }
 }
 
 bool VideoFrameProcessor::DumpDataToDisk(const StorageFolder& folder, const std::wstring& datetime_path)
@@ -191,17 +258,54 @@ bool VideoFrameProcessor::DumpDataToDisk(const StorageFolder& folder, const std:
     return true;
 }
 
-void VideoFrameProcessor::StartRecording(const StorageFolder& storageFolder, const SpatialCoordinateSystem& worldCoordSystem)
+void VideoFrameProcessor::StartRecording(const StorageFolder& storageFolder, const SpatialCoordinateSystem& worldCoordSystem,
+                                         const std::shared_ptr<Io::StreamClient>& streamClient)
 {
     std::lock_guard<std::mutex> guard(m_storageMutex);
     m_storageFolder = storageFolder;
 
     // Create the tarball for the image files
-    wchar_t fileName[MAX_PATH] = {};
-    swprintf_s(fileName, L"%s\\%s.tar", m_storageFolder.Path().data(), kSensorName);
-    m_tarball.reset(new Io::Tarball(fileName));
+    if (streamClient)
+    {
+        m_tarball.reset(new Io::StreamedTarball(streamClient, std::wstring(kSensorName) + L".tar"));
+    }
+    else
+    {
+        wchar_t fileName[MAX_PATH] = {};
+        swprintf_s(fileName, L"%s\\%s.tar", m_storageFolder.Path().data(), kSensorName);
+        m_tarball.reset(new Io::Tarball(fileName));
+    }
+
+    m_worldCoordSystem = worldCoordSystem;
+    m_storageCondVar.notify_all();
+}
 
+void VideoFrameProcessor::EnablePreRoll(long long duration, size_t maxBytes, const SpatialCoordinateSystem& worldCoordSystem)
+{
+    std::lock_guard<std::mutex> guard(m_storageMutex);
     m_worldCoordSystem = worldCoordSystem;
+    m_preRoll = std::make_unique<PreRollBuffer<PVFrame>>(duration, maxBytes);
+    m_storageCondVar.notify_all();
+}
+
+void VideoFrameProcessor::SetTrigger(const std::shared_ptr<TriggerEngine>& trigger)
+{
+    std::lock_guard<std::mutex> guard(m_storageMutex);
+    m_trigger = trigger;
+}
+
+void VideoFrameProcessor::SetGovernor(const std::shared_ptr<RecordingGovernor>& governor)
+{
+    std::lock_guard<std::mutex> guard(m_storageMutex);
+    std::lock_guard<std::shared_mutex> lock(m_frameMutex);
+    m_governorStream = governor->Register(kSensorName, GovernedStreamKind::PV);
+    m_governor = governor;
+}
+
+void VideoFrameProcessor::SetStreamRate(const StreamRate& rate)
+{
+    std::lock_guard<std::mutex> guard(m_storageMutex);
+    m_decimator.SetRate(rate);
 }
 
 void VideoFrameProcessor::StopRecording()
@@ -215,28 +319,84 @@ void VideoFrameProcessor::CameraWriteThread(VideoFrameProcessor* pProcessor)
 {
     while (!pProcessor->m_fExit)
     {
-        std::lock_guard<std::mutex> guard(pProcessor->m_storageMutex);
-        if (pProcessor->m_storageFolder != nullptr)
         {
+            // Wait for a frame the thread has not looked at yet, rather than
+            // taking both mutexes again and again for the same frame
+            std::unique_lock<std::shared_mutex> lock(pProcessor->m_frameMutex);
+            pProcessor->m_frameCondVar.wait_for(lock, kFrameWaitTimeout, [pProcessor]
+            {
+                return pProcessor->m_fExit || !pProcessor->m_latestFrameTaken;
+            });
+        }
+
+        std::unique_lock<std::mutex> storage_lock(pProcessor->m_storageMutex);
+        if (pProcessor->m_storageFolder == nullptr && !pProcessor->m_preRoll)
+        {
+            // Nothing to do with the frames until the recording starts or pre-roll is enabled
+            pProcessor->m_storageCondVar.wait_for(storage_lock, kFrameWaitTimeout);
+        }
+        if (pProcessor->m_storageFolder != nullptr || pProcessor->m_preRoll)
+        {
+            const bool recording = pProcessor->m_storageFolder != nullptr;
+            bool write = false;
+
             SoftwareBitmap softwareBitmap = nullptr;
+            PVFrame logFrame;
             {
                 std::lock_guard<std::shared_mutex> lock(pProcessor->m_frameMutex);
-                if (pProcessor->m_latestFrame != nullptr)
+                if (pProcessor->m_latestFrame != nullptr && !pProcessor->m_latestFrameTaken)
                 {
                     auto frame = pProcessor->m_latestFrame;                    
                     long long timestamp = pProcessor->m_converter.RelativeTicksToAbsoluteTicks(HundredsOfNanoseconds(frame.SystemRelativeTime().Value().count())).count();
+                    pProcessor->m_latestFrameTaken = true;
                     if (timestamp != pProcessor->m_latestTimestamp)
                     {
-                        softwareBitmap = SoftwareBitmap::Convert(frame.VideoMediaFrame().SoftwareBitmap(), BitmapPixelFormat::Bgra8);
                         pProcessor->m_latestTimestamp = timestamp;
-                        pProcessor->AddLogFrame();
+                        // Decide before converting: frames that are neither written
+                        // nor kept in the pre-roll buffer are dropped, and so are the
+                        // frames in excess of the stream rate and the ones the governor throttles
+                        write = recording && (!pProcessor->m_trigger || pProcessor->m_trigger->ShouldWrite(timestamp));
+                        const bool kept = (write || pProcessor->m_preRoll) && pProcessor->m_decimator.Keep(timestamp);
+                        const bool throttled = kept && write && pProcessor->m_governor && !pProcessor->m_governor->ShouldWrite(pProcessor->m_governorStream);
+                        if (kept && !throttled)
+                        {
+                            // NV12 when the governor asks for smaller frames, the converter tells them apart by their size
+                            const bool compact = write && pProcessor->m_governor && pProcessor->m_governor->IsPVCompact();
+                            softwareBitmap = SoftwareBitmap::Convert(frame.VideoMediaFrame().SoftwareBitmap(), compact ? BitmapPixelFormat::Nv12 : BitmapPixelFormat::Bgra8);
+                            logFrame = pProcessor->CreateLogFrame();
+                        }
                     }
                 }
             }
             // Convert and write the bitmap
             if (softwareBitmap != nullptr)
             {
-                pProcessor->DumpFrame(softwareBitmap, pProcessor->m_latestTimestamp);
+                if (write)
+                {
+                    // Frames buffered before the recording started,
+                    // or before the trigger event, go first
+                    if (pProcessor->m_preRoll)
+                    {
+                        pProcessor->FlushPreRoll();
+                    }
+                    const auto writeStart = std::chrono::steady_clock::now();
+                    const size_t byteCount = pProcessor->DumpFrame(softwareBitmap, logFrame.timestamp);
+                    // Frames dropped by a streamed archive are not logged, pv.txt lists the frames of PV.tar
+                    if (byteCount > 0)
+                    {
+                        std::lock_guard<std::shared_mutex> lock(pProcessor->m_frameMutex);
+                        pProcessor->m_PVFrameLog.push_back(logFrame);
+                    }
+                    if (pProcessor->m_governor)
+                    {
+                        const auto duration = std::chrono::duration_cast<HundredsOfNanoseconds>(std::chrono::steady_clock::now() - writeStart);
+                        pProcessor->m_governor->ReportWrite(pProcessor->m_governorStream, byteCount, duration.count());
+                    }
+                }
+                else
+                {
+                    pProcessor->BufferFrame(softwareBitmap, logFrame);
+                }
             }
         }
     }
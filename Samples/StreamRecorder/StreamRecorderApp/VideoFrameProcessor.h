@@ -16,8 +16,14 @@
 #include <winrt/Windows.Media.Capture.Frames.h>
 #include <winrt/Windows.Perception.Spatial.h>
 #include <winrt/Windows.Graphics.Imaging.h>
+#include "PreRollBuffer.h"
+#include "RecordingGovernor.h"
+#include "StreamClient.h"
+#include "StreamSettings.h"
 #include "Tar.h"
 #include "TimeConverter.h"
+#include "TriggerEngine.h"
+#include <condition_variable>
 #include <mutex>
 #include <shared_mutex>
 #include <thread>
@@ -43,14 +49,29 @@ public:
     virtual ~VideoFrameProcessor()
     {
         m_fExit = true;
+        m_frameCondVar.notify_all();
+        m_storageCondVar.notify_all();
         m_pWriteThread->join();
     }
 
     void Clear();
     void AddLogFrame();
     bool DumpDataToDisk(const winrt::Windows::Storage::StorageFolder& folder, const std::wstring& datetime_path);
-    void StartRecording(const winrt::Windows::Storage::StorageFolder& storageFolder, const winrt::Windows::Perception::Spatial::SpatialCoordinateSystem& worldCoordSystem);
+    // The frames go to PV.tar in storageFolder, or to the host of streamClient when not null
+    void StartRecording(const winrt::Windows::Storage::StorageFolder& storageFolder, const winrt::Windows::Perception::Spatial::SpatialCoordinateSystem& worldCoordSystem,
+                        const std::shared_ptr<Io::StreamClient>& streamClient = nullptr);
     void StopRecording();
+    // Keep the frames of the last duration (in hundreds of nanoseconds, at most maxBytes)
+    // while not recording, and write them at the beginning of the next recording.
+    // Their poses are expressed in worldCoordSystem
+    void EnablePreRoll(long long duration, size_t maxBytes, const winrt::Windows::Perception::Spatial::SpatialCoordinateSystem& worldCoordSystem);
+    // While recording, only write the frames within the trigger windows,
+    // the other ones go to the pre-roll buffer
+    void SetTrigger(const std::shared_ptr<TriggerEngine>& trigger);
+    // While recording, the governor decides which frames are written, and in which format
+    void SetGovernor(const std::shared_ptr<RecordingGovernor>& governor);
+    // Frames in excess of rate are dropped, whether recording or not
+    void SetStreamRate(const StreamRate& rate);
     winrt::Windows::Foundation::IAsyncAction InitializeAsync();
 
 protected:
@@ -58,19 +79,38 @@ protected:
                         const winrt::Windows::Media::Capture::Frames::MediaFrameArrivedEventArgs& args);
 
 private:
-    void DumpFrame(const winrt::Windows::Graphics::Imaging::SoftwareBitmap& softwareBitmap, long long timestamp);
+    PVFrame CreateLogFrame();
+    // Returns the bytes written, 0 when the archive dropped the frame
+    size_t DumpFrame(const winrt::Windows::Graphics::Imaging::SoftwareBitmap& softwareBitmap, long long timestamp);
+    void BufferFrame(const winrt::Windows::Graphics::Imaging::SoftwareBitmap& softwareBitmap, const PVFrame& logFrame);
+    void FlushPreRoll();
 
     winrt::Windows::Media::Capture::Frames::MediaFrameReader m_mediaFrameReader = nullptr;
     winrt::event_token m_OnFrameArrivedRegistration;
 
     std::shared_mutex m_frameMutex;
+    // Signaled when a new frame replaces m_latestFrame
+    std::condition_variable_any m_frameCondVar;
     long long m_latestTimestamp = 0;
     winrt::Windows::Media::Capture::Frames::MediaFrameReference m_latestFrame = nullptr;
+    // Whether the write thread took m_latestFrame before the next one replaced it
+    bool m_latestFrameTaken = true;
     std::vector<PVFrame> m_PVFrameLog;
     
     std::mutex m_storageMutex;
+    // Signaled when the recording starts or pre-roll is enabled
+    std::condition_variable m_storageCondVar;
     winrt::Windows::Storage::StorageFolder m_storageFolder = nullptr;
-    std::unique_ptr<Io::Tarball> m_tarball;
+    std::unique_ptr<Io::Archive> m_tarball;
+    // Frames captured while not recording, null when pre-roll is disabled
+    std::unique_ptr<PreRollBuffer<PVFrame>> m_preRoll;
+    // Null when every frame is written while recording
+    std::shared_ptr<TriggerEngine> m_trigger;
+    // Null when the recording is not governed
+    std::shared_ptr<RecordingGovernor> m_governor;
+    size_t m_governorStream = 0;
+    // Frames in excess of the stream rate
+    FrameDecimator m_decimator;
 
     TimeConverter m_converter;
     winrt::Windows::Perception::Spatial::SpatialCoordinateSystem m_worldCoordSystem = nullptr;
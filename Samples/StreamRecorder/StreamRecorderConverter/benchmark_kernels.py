@@ -0,0 +1,268 @@
+"""
+ Copyright (c) Microsoft. All rights reserved.
+ This code is licensed under the MIT License (MIT).
+ THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+ ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+ IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+ PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+"""
+import os
+import time
+import argparse
+import tempfile
+
+import numpy as np
+
+from native_kernels import (TsdfVolume, VoxelGrid, allocate_point_buffers, depth_to_points,
+                            has_native_kernels, organized_normals, write_ply, zbuffer_splat)
+from utils import DEPTH_SCALING_FACTOR
+
+# Sensor resolutions, (width, height)
+RESOLUTIONS = {'Depth AHaT': (512, 512),
+               'Depth Long Throw': (320, 288)}
+
+
+def synthetic_depth_frame(width, height, seed=0):
+    """Random depth image (mm) and unit-ray LUT with some invalid pixels."""
+    rng = np.random.default_rng(seed)
+    xs, ys = np.meshgrid(np.linspace(-1, 1, width), np.linspace(-1, 1, height))
+    lut = np.stack((xs, ys, np.ones_like(xs)), axis=-1).reshape((-1, 3))
+    lut /= np.linalg.norm(lut, axis=1, keepdims=True)
+    lut = lut.astype(np.float32)
+    depth = rng.integers(200, 4000, size=(height, width), dtype=np.uint16)
+    depth[rng.random((height, width)) < 0.2] = 0
+    rig2world = np.eye(4)
+    rig2world[:3, 3] = [1., 2., 3.]
+    return depth, lut, rig2world
+
+
+def numpy_depth_to_points(img, lut, clamp_min, clamp_max, cam2world_transform):
+    """Reference path, as previously done in save_pclouds.py."""
+    img = img.copy()
+    if clamp_min > 0 and clamp_max > 0:
+        img[img < clamp_min * 1000.] = 0
+        img[img > clamp_max * 1000.] = 0
+    img = np.tile(img.flatten().reshape((-1, 1)), (1, 3))
+    points = img * lut
+    remove_ids = np.where(np.sqrt(np.sum(points**2, axis=1)) < 1e-6)[0]
+    points = np.delete(points, remove_ids, axis=0)
+    points /= 1000.
+    homog_points = np.hstack((points, np.ones((points.shape[0], 1))))
+    world_points = (cam2world_transform @ homog_points.T).T[:, :3]
+    return points, world_points
+
+
+def time_call(fn, repeats):
+    fn()
+    start = time.perf_counter()
+    for _ in range(repeats):
+        fn()
+    return (time.perf_counter() - start) / repeats * 1000.
+
+
+def benchmark_depth_to_points(repeats, num_threads):
+    print('depth_to_points (ms/frame)')
+    for sensor_name, (width, height) in RESOLUTIONS.items():
+        depth, lut, cam2world = synthetic_depth_frame(width, height)
+        buffers = allocate_point_buffers(width * height)
+
+        ref_cam, ref_world = numpy_depth_to_points(depth, lut, 0.5, 3.0, cam2world)
+        result = depth_to_points(depth, lut, 0.5, 3.0, cam2world, buffers, num_threads)
+        assert np.allclose(ref_cam, result['cam'], atol=1e-5)
+        assert np.allclose(ref_world, result['world'], atol=1e-5)
+
+        timings = [('numpy (previous)', time_call(
+                        lambda: numpy_depth_to_points(depth, lut, 0.5, 3.0, cam2world), repeats)),
+                   ('numpy (fused)', time_call(
+                        lambda: depth_to_points(depth, lut, 0.5, 3.0, cam2world, buffers,
+                                                use_native=False), repeats))]
+        if has_native_kernels():
+            timings.append(('native', time_call(
+                lambda: depth_to_points(depth, lut, 0.5, 3.0, cam2world, buffers, num_threads),
+                repeats)))
+        for name, ms in timings:
+            print('  {:<18} {:<18} {:8.3f}'.format(sensor_name, name, ms))
+
+
+def loop_splat(pixel_ids, z, height, width):
+    """Reference path, as previously done in utils.py (last point wins)."""
+    depth_image = np.zeros((height, width))
+    valid_ids = np.flatnonzero(pixel_ids >= 0)
+    for i in valid_ids:
+        depth_image[pixel_ids[i] // width, pixel_ids[i] % width] = z[i]
+    return depth_image
+
+
+def benchmark_zbuffer_splat(repeats):
+    print('zbuffer_splat (ms/frame)')
+    width, height = 760, 428
+    rng = np.random.default_rng(0)
+    for point_count in [100000, 250000]:
+        pixel_ids = rng.integers(-width * height // 4, width * height, point_count)
+        pixel_ids[pixel_ids < 0] = -1
+        z = rng.uniform(0.2, 5., point_count).astype(np.float32)
+
+        native_depth, _ = zbuffer_splat(pixel_ids, z, height, width)
+        numpy_depth, _ = zbuffer_splat(pixel_ids, z, height, width, use_native=False)
+        assert np.array_equal(native_depth, numpy_depth)
+
+        timings = [('python loop', time_call(
+                        lambda: loop_splat(pixel_ids, z, height, width), max(1, repeats // 10))),
+                   ('numpy', time_call(
+                        lambda: zbuffer_splat(pixel_ids, z, height, width, use_native=False), repeats))]
+        if has_native_kernels():
+            timings.append(('native', time_call(
+                lambda: zbuffer_splat(pixel_ids, z, height, width), repeats)))
+        for name, ms in timings:
+            print('  {:<18} {:<18} {:8.3f}'.format('{} points'.format(point_count), name, ms))
+
+
+def knn_normals(points, cam2world):
+    """Reference path, as previously done in save_pclouds.py (needs open3d)."""
+    import open3d as o3d
+    pcd = o3d.geometry.PointCloud()
+    pcd.points = o3d.utility.Vector3dVector(np.asarray(points, dtype=np.float64))
+    pcd.estimate_normals()
+    pcd.orient_normals_towards_camera_location(cam2world[:3, 3])
+    return np.asarray(pcd.normals)
+
+
+def benchmark_normals(repeats, num_threads):
+    print('normals (ms/frame)')
+    try:
+        import open3d  # noqa: F401
+        has_open3d = True
+    except ImportError:
+        has_open3d = False
+    for sensor_name, (width, height) in RESOLUTIONS.items():
+        depth, lut, cam2world = synthetic_depth_frame(width, height)
+        # Smooth surface, the random synthetic depth has no meaningful normals
+        depth = (1000 + np.arange(width, dtype=np.uint16)[None, :] * np.ones((height, 1), np.uint16))
+        buffers = allocate_point_buffers(width * height, pixel_ids=True)
+        result = depth_to_points(depth, lut, 0.5, 3.0, cam2world, buffers, num_threads)
+        pixel_ids = result['pixel_ids']
+
+        native = organized_normals(depth, lut, pixel_ids, 0.5, 3.0, cam2world)
+        fallback = organized_normals(depth, lut, pixel_ids, 0.5, 3.0, cam2world, use_native=False)
+        assert np.allclose(native, fallback, atol=1e-3)
+
+        timings = []
+        if has_open3d:
+            timings.append(('open3d knn', time_call(
+                lambda: knn_normals(result['world'], cam2world), max(1, repeats // 10))))
+        timings.append(('organized numpy', time_call(
+            lambda: organized_normals(depth, lut, pixel_ids, 0.5, 3.0, cam2world,
+                                      use_native=False), repeats)))
+        if has_native_kernels():
+            timings.append(('organized native', time_call(
+                lambda: organized_normals(depth, lut, pixel_ids, 0.5, 3.0, cam2world,
+                                          num_threads=num_threads), repeats)))
+        for name, ms in timings:
+            print('  {:<18} {:<18} {:8.3f}'.format(sensor_name, name, ms))
+
+
+def open3d_write_ply(path, points, colors, normals):
+    """Reference path, as previously done in save_pclouds.py (needs open3d)."""
+    import open3d as o3d
+    pcd = o3d.geometry.PointCloud()
+    pcd.points = o3d.utility.Vector3dVector(np.asarray(points, dtype=np.float64))
+    pcd.colors = o3d.utility.Vector3dVector(np.asarray(colors, dtype=np.float64))
+    pcd.normals = o3d.utility.Vector3dVector(np.asarray(normals, dtype=np.float64))
+    o3d.io.write_point_cloud(path, pcd)
+
+
+def benchmark_write_ply(repeats):
+    print('write_ply (ms/frame)')
+    try:
+        import open3d  # noqa: F401
+        has_open3d = True
+    except ImportError:
+        has_open3d = False
+    rng = np.random.default_rng(0)
+    with tempfile.TemporaryDirectory() as folder:
+        path = os.path.join(folder, 'cloud.ply')
+        for point_count in [100000, 250000]:
+            points = rng.normal(size=(point_count, 3)).astype(np.float32)
+            normals = rng.normal(size=(point_count, 3)).astype(np.float32)
+            colors = rng.random((point_count, 3))
+
+            timings = []
+            if has_open3d:
+                timings.append(('open3d', time_call(
+                    lambda: open3d_write_ply(path, points, colors, normals), repeats)))
+            timings.append(('numpy', time_call(
+                lambda: write_ply(path, points, colors, normals, use_native=False), repeats)))
+            if has_native_kernels():
+                timings.append(('native', time_call(
+                    lambda: write_ply(path, points, colors, normals), repeats)))
+            for name, ms in timings:
+                print('  {:<18} {:<18} {:8.3f}'.format('{} points'.format(point_count), name, ms))
+
+
+def benchmark_voxel_grid(repeats):
+    print('VoxelGrid.add (ms/frame, 0.02m voxels)')
+    rng = np.random.default_rng(0)
+    # Overlapping frames of a 4m room, as seen by a moving headset
+    frames = [(rng.uniform(-2, 2, (80000, 3)).astype(np.float32), rng.random((80000, 3)).astype(np.float32))
+              for _ in range(max(2, repeats // 5))]
+    implementations = [('numpy', False)] + ([('native', True)] if has_native_kernels() else [])
+    for name, use_native in implementations:
+        grid = VoxelGrid(0.02, colors=True, use_native=use_native)
+        start = time.perf_counter()
+        for points, colors in frames:
+            grid.add(points, colors)
+        ms = (time.perf_counter() - start) / len(frames) * 1000.
+        print('  {:<18} {:<18} {:8.3f}'.format('{} voxels'.format(len(grid)), name, ms))
+
+
+def benchmark_tsdf(repeats, num_threads):
+    if not has_native_kernels():
+        return
+    print('TsdfVolume (ms, 0.02m voxels, 320x288 pinhole frames)')
+    width, height, focal_length = 320, 288, 200.
+    intrinsics = [focal_length, focal_length, width / 2., height / 2.]
+    # A slanted wall 2 to 3m away, seen while the camera slides sideways
+    u = np.arange(width).reshape((1, -1))
+    depth = np.repeat((2. + u / width) * DEPTH_SCALING_FACTOR, height, axis=0).astype(np.uint16)
+    color = np.full((height, width, 3), 128, dtype=np.uint8)
+    volume = TsdfVolume(0.02, 0.06)
+    frame_count = max(2, repeats // 5)
+    start = time.perf_counter()
+    for i in range(frame_count):
+        cam2world = np.eye(4)
+        cam2world[0, 3] = 0.01 * i
+        volume.integrate(depth, color, intrinsics, cam2world, DEPTH_SCALING_FACTOR, 7.8,
+                         num_threads=num_threads)
+    integrate_ms = (time.perf_counter() - start) / frame_count * 1000.
+    start = time.perf_counter()
+    mesh = volume.extract_mesh(num_threads=num_threads)
+    extract_ms = (time.perf_counter() - start) * 1000.
+    start = time.perf_counter()
+    volume.extract_mesh(num_threads=num_threads)
+    reextract_ms = (time.perf_counter() - start) * 1000.
+    print('  {:<18} {:<18} {:8.3f}'.format('{} blocks'.format(len(volume)), 'integrate', integrate_ms))
+    print('  {:<18} {:<18} {:8.3f}'.format('{} triangles'.format(len(mesh['triangles'])), 'extract', extract_ms))
+    print('  {:<18} {:<18} {:8.3f}'.format('', 'extract unchanged', reextract_ms))
+    target = len(mesh['triangles']) // 10
+    start = time.perf_counter()
+    volume.extract_mesh(target, num_threads, copy=False)
+    simplify_ms = (time.perf_counter() - start) * 1000.
+    print('  {:<18} {:<18} {:8.3f}'.format('{} triangles'.format(target), 'extract + simplify', simplify_ms))
+
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(description='Benchmark converter kernels against numpy.')
+    parser.add_argument("--repeats", type=int, default=50,
+                        help="Number of timed calls per kernel")
+    parser.add_argument("--num_threads", type=int, default=0,
+                        help="Threads used by the native kernels, 0 for all cores")
+    args = parser.parse_args()
+
+    if not has_native_kernels():
+        print('Native kernels not found, build them with cmake from the native folder')
+    benchmark_depth_to_points(args.repeats, args.num_threads)
+    benchmark_zbuffer_splat(args.repeats)
+    benchmark_normals(args.repeats, args.num_threads)
+    benchmark_write_ply(args.repeats)
+    benchmark_voxel_grid(args.repeats)
+    benchmark_tsdf(args.repeats, args.num_threads)
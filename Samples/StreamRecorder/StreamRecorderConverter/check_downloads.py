@@ -0,0 +1,137 @@
+"""
+ Copyright (c) Microsoft. All rights reserved.
+ This code is licensed under the MIT License (MIT).
+ THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+ ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+ IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+ PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+"""
+import sys
+import filecmp
+import argparse
+import tempfile
+from pathlib import Path
+
+from device_portal_standin import DevicePortalStandIn, make_recording
+from downloader import PART_SUFFIX
+from recorder_console import DevicePortalBrowser
+
+RECORDING_NAME = '2020-01-01-000000'
+RECORDING_FILES = {
+    'PV.tar': 6 * 1024 * 1024 + 17,
+    'Depth Long Throw.tar': 3 * 1024 * 1024 + 5,
+    'Depth Long Throw_lut.bin': 320 * 288 * 12,
+    '2020-01-01-000000_pv.txt': 12345,
+    '2020-01-01-000000_head_hand_eye.csv': 0,
+}
+
+
+def check(condition, message):
+    if not condition:
+        raise AssertionError(message)
+    print('=> OK:', message)
+
+
+def same_files(recording_path, downloaded_path):
+    return all(filecmp.cmp(str(recording_path / name), str(downloaded_path / name), shallow=False)
+               for name in RECORDING_FILES)
+
+
+def connect(standin, num_workers, chunk_size):
+    browser = DevicePortalBrowser(num_workers, chunk_size)
+    browser.connect(standin.address, 'user', 'password')
+    return browser
+
+
+def check_interrupted_download(local_state_path, workspace_path, num_workers, chunk_size):
+    """Download until the stand-in drops the connections halfway, then resume."""
+    total_bytes = sum(RECORDING_FILES.values())
+    recording_path = local_state_path / RECORDING_NAME
+    downloaded_path = workspace_path / RECORDING_NAME
+
+    standin = DevicePortalStandIn(local_state_path).start()
+    try:
+        browser = connect(standin, num_workers, chunk_size)
+        check(browser.recording_names == [RECORDING_NAME], 'the recording is listed')
+
+        standin.fail_after(total_bytes // 2)
+        try:
+            browser.download_recording(0, workspace_path)
+            interrupted = False
+        except Exception as e:
+            print('=> Interrupted as expected:', repr(e))
+            interrupted = True
+        check(interrupted, 'the download fails when the connection drops')
+        check(any(path.name.endswith(PART_SUFFIX) for path in downloaded_path.iterdir()),
+              'partial files are kept')
+
+        standin.restore()
+        sent_before = standin.sent_bytes
+        browser.download_recording(0, workspace_path)
+        resumed_bytes = standin.sent_bytes - sent_before
+        check(same_files(recording_path, downloaded_path), 'the resumed files are identical')
+        check(resumed_bytes < total_bytes - chunk_size,
+              'only the missing chunks are downloaded again ({} of {} bytes)'.format(resumed_bytes, total_bytes))
+        check(not any(path.name.endswith(PART_SUFFIX) or path.name.endswith('.json')
+                      for path in downloaded_path.iterdir()), 'no partial file is left')
+
+        sent_before = standin.sent_bytes
+        browser.download_recording(0, workspace_path)
+        check(standin.sent_bytes == sent_before, 'complete files are not downloaded again')
+
+        browser.delete_recording(0)
+        check(not any(recording_path.iterdir()), 'the recording files are deleted')
+    finally:
+        standin.stop()
+
+
+def check_download_without_ranges(local_state_path, workspace_path, num_workers, chunk_size):
+    """Servers ignoring Range requests are downloaded in one stream per file."""
+    standin = DevicePortalStandIn(local_state_path, support_ranges=False).start()
+    try:
+        browser = connect(standin, num_workers, chunk_size)
+        browser.download_recording(0, workspace_path)
+        check(same_files(local_state_path / RECORDING_NAME, workspace_path / RECORDING_NAME),
+              'the files downloaded without ranges are identical')
+    finally:
+        standin.stop()
+
+
+def check_download_without_sizes(local_state_path, workspace_path, num_workers, chunk_size):
+    """Listings without file sizes: complete files are still not downloaded again."""
+    standin = DevicePortalStandIn(local_state_path, list_sizes=False).start()
+    try:
+        browser = connect(standin, num_workers, chunk_size)
+        browser.download_recording(0, workspace_path)
+        check(same_files(local_state_path / RECORDING_NAME, workspace_path / RECORDING_NAME),
+              'the files downloaded without listed sizes are identical')
+
+        sent_before = standin.sent_bytes
+        browser.download_recording(0, workspace_path)
+        check(standin.sent_bytes == sent_before, 'complete files of unknown size are not downloaded again')
+    finally:
+        standin.stop()
+
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(
+        description='Check the parallel and resumable downloads of recorder_console.py against '
+                    'a local stand-in of the Device Portal, interrupting and resuming a download')
+    parser.add_argument("--download_workers", type=int, default=4,
+                        help="Number of concurrent HTTP connections")
+    parser.add_argument("--chunk_size_kb", type=int, default=256,
+                        help="Size of the downloaded ranges")
+    args = parser.parse_args()
+    chunk_size = args.chunk_size_kb * 1024
+
+    with tempfile.TemporaryDirectory() as tmp:
+        tmp = Path(tmp)
+        for name, check_fn in [('ranges', check_interrupted_download), ('no_ranges', check_download_without_ranges),
+                               ('no_sizes', check_download_without_sizes)]:
+            local_state_path = tmp / name / 'LocalState'
+            workspace_path = tmp / name / 'workspace'
+            workspace_path.mkdir(parents=True)
+            make_recording(local_state_path, RECORDING_NAME, RECORDING_FILES)
+            check_fn(local_state_path, workspace_path, args.download_workers, chunk_size)
+    print('All download checks passed')
+    sys.exit(0)
@@ -7,34 +7,139 @@
  PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
 """
 import os
+import time
 import cv2
 import argparse
 import numpy as np
 import multiprocessing
 from pathlib import Path
 
-from utils import folders_extensions
+from tar_reader import frame_timestamp, open_frame_reader
+from stage_cache import StageManifest
+from utils import pv_video_name, pv_video_timestamps_name
 
+# Output formats for PV frames: one png or jpg file per frame,
+# or a single MJPG video with a side file listing the frame timestamps
+CODECS = ['png', 'jpg', 'video']
 
-def write_bytes_to_png(bytes_path, width, height):
+
+def pv_to_bgr(data, width, height, out=None):
+    """PV frames are BGRA8, or NV12 when the recording was throttled, told apart by their size."""
+    if len(data) != width * height * 4:
+        return nv12_to_bgr(data, width, height, out)
+    return bgra_to_bgr(data, width, height, out)
+
+
+def bgra_to_bgr(data, width, height, out=None):
+    image = np.frombuffer(data, dtype=np.uint8).reshape((height, width, 4))
+    # cvtColor writes a contiguous image, unlike slicing off the alpha channel
+    return cv2.cvtColor(image, cv2.COLOR_BGRA2BGR, dst=out)
+
+
+def nv12_to_bgr(data, width, height, out=None):
+    """PV frames the recording governor wrote in NV12: a luma plane, then
+    interleaved chroma at half resolution, with rows of the same stride."""
+    rows = height + height // 2
+    stride = len(data) // rows
+    if stride < width or len(data) % rows != 0:
+        raise ValueError('Unexpected PV frame size {} for {}x{}'.format(len(data), width, height))
+    image = np.frombuffer(data, dtype=np.uint8).reshape((rows, stride))
+    if stride != width:
+        image = np.ascontiguousarray(image[:, :width])
+    return cv2.cvtColor(image, cv2.COLOR_YUV2BGR_NV12, dst=out)
+
+
+def encode_params(codec, png_compression, jpeg_quality):
+    if codec == 'png':
+        return [cv2.IMWRITE_PNG_COMPRESSION, png_compression]
+    if codec == 'jpg':
+        return [cv2.IMWRITE_JPEG_QUALITY, jpeg_quality]
+    return []
+
+
+def convert_chunk(entries, width, height, output_folder, codec, params, skip_existing=True):
+    """Convert a chunk of PV frames, reusing one file handle and one image buffer.
+
+    entries: list of (source path, offset, size, frame name); size < 0 reads the
+    whole source file. Returns (frames written, bytes written, names of the frames written).
+    """
+    frames = 0
+    written_bytes = 0
+    written_names = []
+    bgr = np.empty((height, width, 3), dtype=np.uint8)
+    source, source_path = None, None
+    try:
+        for path, offset, size, name in entries:
+            output_path = pv_output_path(output_folder, name, codec)
+            if skip_existing and os.path.exists(output_path):
+                continue
+            if path != source_path:
+                if source is not None:
+                    source.close()
+                source, source_path = open(path, 'rb'), path
+            source.seek(offset)
+            bgr = pv_to_bgr(source.read(size), width, height, bgr)
+
+            _, encoded = cv2.imencode('.' + codec, bgr, params)
+            with open(output_path, 'wb') as f:
+                f.write(encoded.tobytes())
+            frames += 1
+            written_bytes += len(encoded)
+            written_names.append(name)
+    finally:
+        if source is not None:
+            source.close()
     print(".", end="", flush=True)
+    return frames, written_bytes, written_names
 
-    output_path = bytes_path.replace('bytes', 'png')
-    if os.path.exists(output_path):
-        return
 
-    image = []
-    with open(bytes_path, 'rb') as f:
-        image = np.frombuffer(f.read(), dtype=np.uint8)
+def pv_output_path(output_folder, name, codec):
+    return os.path.join(str(output_folder), name.replace('bytes', codec))
 
-    image = image.reshape((height, width, 4))
 
-    new_image = image[:, :, :3]
-    cv2.imwrite(output_path, new_image)
+def entry_fingerprint(manifest, entry):
+    path, offset, size, _ = entry
+    if size < 0:
+        return manifest.fingerprint_file(path)
+    return manifest.fingerprint_member(path, offset, size)
 
-    # Delete '*.bytes' files
-    bytes_path.unlink()
 
+def write_video(entries, width, height, output_folder):
+    """Write all the frames, in timestamp order, to a single PV.avi."""
+    timestamps = [frame_timestamp(name) for (_, _, _, name) in entries]
+    # Timestamps are in hundreds of nanoseconds
+    fps = 1e7 / np.median(np.diff(timestamps)) if len(timestamps) > 1 else 30.
+    video_path = os.path.join(output_folder, pv_video_name)
+    writer = cv2.VideoWriter(video_path, cv2.VideoWriter_fourcc(*'MJPG'), fps, (width, height))
+    bgr = np.empty((height, width, 3), dtype=np.uint8)
+    with open(os.path.join(output_folder, pv_video_timestamps_name), 'w') as f:
+        for (path, offset, size, name), timestamp in zip(entries, timestamps):
+            with open(path, 'rb') as source:
+                source.seek(offset)
+                bgr = pv_to_bgr(source.read(size), width, height, bgr)
+            writer.write(bgr)
+            f.write('{}\n'.format(timestamp))
+    writer.release()
+    return len(entries), os.path.getsize(video_path)
+
+
+def remove_other_outputs(output_folder, codec):
+    """Remove the frames converted earlier to another codec: the later stages
+    would read them instead of the new ones."""
+    for other in CODECS:
+        if other == codec:
+            continue
+        if other == 'video':
+            paths = [output_folder / pv_video_name, output_folder / pv_video_timestamps_name]
+        else:
+            paths = output_folder.glob('*.{}'.format(other))
+        for path in paths:
+            if path.exists():
+                path.unlink()
+
+
+def _convert_task(task):
+    return convert_chunk(*task)
 
 
 def get_width_and_height(path):
@@ -45,25 +150,107 @@ def get_width_and_height(path):
     return (int(width), int(height))
 
 
-def convert_images(folder):
-    p = multiprocessing.Pool(multiprocessing.cpu_count())
-    for (img_folder, extension) in folders_extensions:
-        if img_folder == 'PV':
-            pv_path = list(folder.glob('*pv.txt'))
-            assert len(list(pv_path)) == 1 
-            (width, height) = get_width_and_height(pv_path[0])
+def pv_frame_entries(folder):
+    """(source path, offset, size, name) of every PV frame, sorted by timestamp."""
+    reader = open_frame_reader(folder, 'PV')
+    if reader is not None:
+        entries = []
+        for name in reader.names('*bytes'):
+            offset, size = reader.locate(name)
+            entries.append((str(reader.tar_path), offset, size, name))
+        return entries
+    # Extracted recording
+    paths = sorted((folder / 'PV').glob('*bytes'))
+    return [(str(path), 0, -1, path.name) for path in paths]
+
+
+def convert_images(folder, codec='png', png_compression=1, jpeg_quality=95,
+                   chunk_size=32, num_workers=None, manifest=None):
+    """Convert the PV frames of a recording.
+
+    Without a manifest frames whose output already exists are skipped; with a
+    StageManifest only frames whose source or encoding parameters changed are redone.
+    """
+    assert codec in CODECS
+    pv_path = list(folder.glob('*pv.txt'))
+    assert len(list(pv_path)) == 1
+    (width, height) = get_width_and_height(pv_path[0])
+
+    entries = pv_frame_entries(folder)
+    if not entries:
+        return
+    output_folder = folder / 'PV'
+    output_folder.mkdir(exist_ok=True)
+    remove_other_outputs(output_folder, codec)
+
+    stage_params = {'codec': codec, 'width': width, 'height': height}
+    if codec == 'png':
+        stage_params['png_compression'] = png_compression
+    elif codec == 'jpg':
+        stage_params['jpeg_quality'] = jpeg_quality
+
+    print("Processing images")
+    start = time.perf_counter()
+    frames, written_bytes = 0, 0
+    if codec == 'video':
+        video_path = output_folder / pv_video_name
+        inputs = {}
+        if manifest is not None:
+            inputs = {'frames': [entry_fingerprint(manifest, entry) for entry in entries]}
+        if manifest is None or not manifest.is_up_to_date('pv_images', video_path, inputs, stage_params):
+            frames, written_bytes = write_video(entries, width, height, str(output_folder))
+            if manifest is not None:
+                manifest.record('pv_images', video_path, inputs, stage_params,
+                                extra_outputs=[output_folder / pv_video_timestamps_name])
+    else:
+        inputs = {}
+        if manifest is not None:
+            inputs = {entry[3]: {'frame': entry_fingerprint(manifest, entry)} for entry in entries}
+            entries = [entry for entry in entries if not manifest.is_up_to_date(
+                'pv_images', pv_output_path(output_folder, entry[3], codec),
+                inputs[entry[3]], stage_params)]
+        params = encode_params(codec, png_compression, jpeg_quality)
+        chunks = [entries[i:i + chunk_size] for i in range(0, len(entries), chunk_size)]
+        tasks = [(chunk, width, height, str(output_folder), codec, params, manifest is None)
+                 for chunk in chunks]
+        with multiprocessing.Pool(num_workers or multiprocessing.cpu_count()) as p:
+            # Record chunks as they complete, so that an interrupted run resumes from there
+            for chunk_frames, chunk_bytes, written_names in p.imap_unordered(_convert_task, tasks):
+                frames += chunk_frames
+                written_bytes += chunk_bytes
+                if manifest is not None:
+                    for name in written_names:
+                        manifest.record('pv_images', pv_output_path(output_folder, name, codec),
+                                        inputs[name], stage_params)
+    if manifest is not None:
+        manifest.save()
+    elapsed = time.perf_counter() - start
 
-            paths = (folder / img_folder).glob('*bytes')
-            print("Processing images")
-            for path in paths:
-                p.apply_async(write_bytes_to_png, (str(path), width, height))
-    p.close()
-    p.join()
+    print("")
+    if frames:
+        print('Converted {} PV frames to {} in {:.2f}s: {:.1f} frames/s, {:.1f}MB ({:.1f}KB/frame)'.format(
+            frames, codec, elapsed, frames / elapsed, written_bytes / 1e6,
+            written_bytes / frames / 1e3))
 
 
 if __name__ == '__main__':
     parser = argparse.ArgumentParser(description='Convert images')
     parser.add_argument("--recording_path", required=True,
                         help="Path to recording folder")
+    parser.add_argument("--codec", default='png', choices=CODECS,
+                        help="Output format, one image per frame or a single video")
+    parser.add_argument("--png_compression", type=int, default=1,
+                        help="PNG compression level (0-9), low values are faster")
+    parser.add_argument("--jpeg_quality", type=int, default=95,
+                        help="JPEG quality (0-100)")
+    parser.add_argument("--chunk_size", type=int, default=32,
+                        help="Number of frames converted by a worker per task")
+    parser.add_argument("--num_workers", type=int, default=0,
+                        help="Number of worker processes, 0 for one per core")
+    parser.add_argument("--force", action='store_true',
+                        help="Convert every frame, ignoring the stage manifest")
     args = parser.parse_args()
-    convert_images(Path(args.recording_path))
+    folder = Path(args.recording_path)
+    convert_images(folder, args.codec, args.png_compression,
+                   args.jpeg_quality, args.chunk_size, args.num_workers,
+                   StageManifest(folder, force=args.force))
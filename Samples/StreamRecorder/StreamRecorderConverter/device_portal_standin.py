@@ -0,0 +1,236 @@
+"""
+ Copyright (c) Microsoft. All rights reserved.
+ This code is licensed under the MIT License (MIT).
+ THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+ ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+ IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+ PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+"""
+import json
+import socket
+import argparse
+import threading
+from pathlib import Path
+from urllib.parse import urlsplit, parse_qs
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+PACKAGE_NAME = 'StreamRecorder'
+PACKAGE_FULL_NAME = 'StreamRecorder_1.0.0.0_arm64__standin'
+
+# Item types of the Device Portal file API
+TYPE_FOLDER = 16
+TYPE_FILE = 32
+
+COPY_SIZE = 256 * 1024
+
+
+class DevicePortalStandIn(object):
+    """Local stand-in for the parts of the HoloLens Device Portal API used by
+    recorder_console.py: the installed packages, the listing of the app's
+    LocalState folder and the download (with Range requests) and deletion of
+    its files. The recordings are the sub-folders of local_state_path.
+
+    For testing interrupted downloads, fail_after(byte_count) makes the server
+    drop every connection once byte_count more bytes of file data were sent,
+    as a device leaving the network would, until restore() is called.
+    """
+
+    def __init__(self, local_state_path, host='127.0.0.1', port=0, support_ranges=True, list_sizes=True):
+        self.local_state_path = Path(local_state_path)
+        self.support_ranges = support_ranges
+        self.list_sizes = list_sizes
+        self.lock = threading.Lock()
+        self.sent_bytes = 0
+        self.byte_budget = None
+        self.server = ThreadingHTTPServer((host, port), self._handler_class())
+        self.server.daemon_threads = True
+        self.thread = None
+
+    @property
+    def address(self):
+        host, port = self.server.server_address[:2]
+        return '{}:{}'.format(host, port)
+
+    def start(self):
+        self.thread = threading.Thread(target=self.server.serve_forever, daemon=True)
+        self.thread.start()
+        return self
+
+    def stop(self):
+        self.server.shutdown()
+        self.server.server_close()
+        if self.thread is not None:
+            self.thread.join()
+
+    def fail_after(self, byte_count):
+        with self.lock:
+            self.byte_budget = byte_count
+
+    def restore(self):
+        with self.lock:
+            self.byte_budget = None
+
+    def _take(self, byte_count):
+        """Bytes of file data that may be sent before the connection drops."""
+        with self.lock:
+            if self.byte_budget is None:
+                allowed = byte_count
+            else:
+                allowed = min(byte_count, self.byte_budget)
+                self.byte_budget -= allowed
+            self.sent_bytes += allowed
+            return allowed
+
+    def _resolve(self, path):
+        """Local path of a Device Portal path such as \\LocalState\\<recording>\\<file>."""
+        parts = [part for part in path.replace('/', '\\').split('\\') if part]
+        if not parts or parts[0] != 'LocalState' or any(part in ('.', '..') for part in parts):
+            return None
+        return self.local_state_path.joinpath(*parts[1:])
+
+    def _handler_class(self):
+        standin = self
+
+        class Handler(BaseHTTPRequestHandler):
+            def log_message(self, format, *args):
+                pass
+
+            def send_json(self, value):
+                body = json.dumps(value).encode()
+                self.send_response(200)
+                self.send_header('Content-Type', 'application/json')
+                self.send_header('Content-Length', str(len(body)))
+                self.end_headers()
+                self.wfile.write(body)
+
+            def query_path(self, key):
+                values = parse_qs(urlsplit(self.path).query).get(key)
+                if not values:
+                    return None
+                return standin._resolve(values[0])
+
+            def drop_connection(self):
+                self.close_connection = True
+                try:
+                    self.connection.shutdown(socket.SHUT_RDWR)
+                except OSError:
+                    pass
+
+            def do_GET(self):
+                route = urlsplit(self.path).path
+                if route == '/':
+                    self.send_json({})
+                elif route == '/api/app/packagemanager/packages':
+                    self.send_json({'InstalledPackages': [
+                        {'Name': PACKAGE_NAME, 'PackageFullName': PACKAGE_FULL_NAME}]})
+                elif route == '/api/filesystem/apps/files':
+                    self.list_folder(self.query_path('path'))
+                elif route == '/api/filesystem/apps/file':
+                    self.send_file(self.query_path('filename'))
+                else:
+                    self.send_error(404)
+
+            def do_DELETE(self):
+                path = self.query_path('filename')
+                if urlsplit(self.path).path != '/api/filesystem/apps/file' or path is None or not path.is_file():
+                    self.send_error(404)
+                    return
+                path.unlink()
+                self.send_response(200)
+                self.send_header('Content-Length', '0')
+                self.end_headers()
+
+            def list_folder(self, path):
+                if path is None or not path.is_dir():
+                    self.send_error(404)
+                    return
+                items = []
+                for child in sorted(path.iterdir()):
+                    if child.is_dir():
+                        items.append({'Id': child.name, 'Name': child.name, 'Type': TYPE_FOLDER})
+                    else:
+                        item = {'Id': child.name, 'Name': child.name, 'Type': TYPE_FILE}
+                        if standin.list_sizes:
+                            item['FileSize'] = child.stat().st_size
+                        items.append(item)
+                self.send_json({'Items': items})
+
+            def send_file(self, path):
+                if path is None or not path.is_file():
+                    self.send_error(404)
+                    return
+                size = path.stat().st_size
+                begin, end = 0, size
+                byte_range = self.headers.get('Range')
+                if standin.support_ranges and byte_range and byte_range.startswith('bytes='):
+                    first, _, last = byte_range[len('bytes='):].partition('-')
+                    begin = int(first)
+                    end = min(size, int(last) + 1) if last else size
+                    if begin >= end:
+                        self.send_response(416)
+                        self.send_header('Content-Range', 'bytes */{}'.format(size))
+                        self.end_headers()
+                        return
+                    self.send_response(206)
+                    self.send_header('Content-Range', 'bytes {}-{}/{}'.format(begin, end - 1, size))
+                else:
+                    self.send_response(200)
+                self.send_header('Content-Type', 'application/octet-stream')
+                self.send_header('Content-Length', str(end - begin))
+                self.end_headers()
+
+                with open(str(path), 'rb') as f:
+                    f.seek(begin)
+                    position = begin
+                    while position < end:
+                        count = min(COPY_SIZE, end - position)
+                        allowed = standin._take(count)
+                        try:
+                            if allowed > 0:
+                                self.wfile.write(f.read(allowed))
+                                position += allowed
+                        except ConnectionError:
+                            # The client has what it wanted, e.g. the size probe of a
+                            # server ignoring ranges only reads the headers
+                            self.close_connection = True
+                            return
+                        if allowed < count:
+                            self.drop_connection()
+                            return
+
+        return Handler
+
+
+def make_recording(local_state_path, name, file_sizes, seed=0):
+    """Recording folder of files with pseudo-random content, file_sizes maps
+    the file names to their sizes."""
+    import numpy as np
+    random = np.random.default_rng(seed)
+    recording_path = Path(local_state_path) / name
+    recording_path.mkdir(parents=True, exist_ok=True)
+    for file_name, size in file_sizes.items():
+        (recording_path / file_name).write_bytes(random.integers(0, 256, size, dtype=np.uint8).tobytes())
+    return recording_path
+
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(
+        description='Serve recordings as the HoloLens Device Portal does, to try recorder_console.py '
+                    'without a device: run it with --dev_portal_address set to the printed address')
+    parser.add_argument("--local_state_path", required=True,
+                        help="Folder holding the recording folders, as the LocalState folder of the app")
+    parser.add_argument("--host", default='127.0.0.1',
+                        help="Address to listen on")
+    parser.add_argument("--port", type=int, default=8080,
+                        help="Port to listen on")
+    parser.add_argument("--no_ranges", action='store_true',
+                        help="Ignore Range requests, as servers without resume support")
+    args = parser.parse_args()
+
+    standin = DevicePortalStandIn(args.local_state_path, args.host, args.port, not args.no_ranges)
+    print('Serving {} at {}'.format(args.local_state_path, standin.address))
+    try:
+        standin.server.serve_forever()
+    except KeyboardInterrupt:
+        pass
+    standin.server.server_close()
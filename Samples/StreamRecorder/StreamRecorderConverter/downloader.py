@@ -0,0 +1,259 @@
+"""
+ Copyright (c) Microsoft. All rights reserved.
+ This code is licensed under the MIT License (MIT).
+ THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+ ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+ IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+ PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+"""
+import os
+import json
+import time
+import threading
+import http.client
+import urllib.error
+import urllib.request
+from concurrent.futures import ThreadPoolExecutor, as_completed
+
+# Files are fetched in ranges of this size, the unit of parallelism and of resume
+DEFAULT_CHUNK_SIZE = 16 * 1024 * 1024
+DEFAULT_WORKERS = 4
+READ_SIZE = 1024 * 1024
+MAX_ATTEMPTS = 5
+PART_SUFFIX = '.part'
+STATE_SUFFIX = '.part.json'
+
+
+class DownloadTask(object):
+    """A file to download to destination. size is the expected size in bytes,
+    None when unknown."""
+
+    def __init__(self, url, destination, size=None):
+        self.url = url
+        self.destination = destination
+        self.size = size
+        self.resumable = True
+
+    @property
+    def part_path(self):
+        return self.destination.with_name(self.destination.name + PART_SUFFIX)
+
+    @property
+    def state_path(self):
+        return self.destination.with_name(self.destination.name + STATE_SUFFIX)
+
+
+class Progress(object):
+    """Thread safe byte counter printing the progress and throughput at most
+    every interval seconds."""
+
+    def __init__(self, total_bytes, interval=1.):
+        self.total_bytes = total_bytes
+        self.done_bytes = 0
+        self.transferred_bytes = 0
+        self.interval = interval
+        self.start = time.time()
+        self.last_print = 0.
+        self.lock = threading.Lock()
+
+    def add(self, count, transferred=True):
+        with self.lock:
+            self.done_bytes += count
+            if transferred:
+                self.transferred_bytes += count
+            now = time.time()
+            if now - self.last_print >= self.interval:
+                self.last_print = now
+                self.print_status(end='\r')
+
+    def throughput(self):
+        return self.transferred_bytes / max(time.time() - self.start, 1e-6)
+
+    def print_status(self, end='\n'):
+        percent = 100. * self.done_bytes / max(self.total_bytes, 1)
+        print(f"=> {self.done_bytes / 1e6:.1f} / {self.total_bytes / 1e6:.1f} MB ({percent:.1f}%), "
+              f"{self.throughput() / 1e6:.1f} MB/s", end=end, flush=True)
+
+
+def _open_range(url, begin, end):
+    """Response for bytes [begin, end) of url; a 200 status means the server
+    ignored the range and sends the whole file."""
+    request = urllib.request.Request(url, headers={'Range': f'bytes={begin}-{end - 1}'})
+    return urllib.request.urlopen(request)
+
+
+def query_size(url):
+    """Size of a remote file from a one byte range request, None when the
+    server does not support ranges."""
+    try:
+        with _open_range(url, 0, 1) as response:
+            status, content_range = response.status, response.headers.get('Content-Range')
+    except urllib.error.HTTPError as e:
+        # No byte of an empty file can be requested, the size comes with the error
+        if e.code != 416:
+            raise
+        status, content_range = e.code, e.headers.get('Content-Range')
+    if status in (206, 416) and content_range and '/' in content_range:
+        total = content_range.rsplit('/', 1)[1]
+        return int(total) if total != '*' else None
+    return None
+
+
+class _FileState(object):
+    """Chunks of a file still to download, persisted next to the partial file
+    so that an interrupted download restarts from the missing chunks."""
+
+    def __init__(self, task, chunk_size):
+        self.task = task
+        self.chunk_size = chunk_size
+        self.chunk_count = max(1, (task.size + chunk_size - 1) // chunk_size)
+        self.done = set()
+        self.lock = threading.Lock()
+
+        if task.part_path.exists() and task.state_path.exists():
+            try:
+                with open(str(task.state_path)) as f:
+                    state = json.load(f)
+                if state['size'] == task.size and state['chunk_size'] == chunk_size:
+                    self.done = set(state['done'])
+            except (ValueError, KeyError):
+                self.done = set()
+        if not self.done or task.part_path.stat().st_size != task.size:
+            self.done = set()
+            with open(str(task.part_path), 'wb') as f:
+                f.truncate(task.size)
+            self.save()
+
+    def chunk_range(self, chunk):
+        begin = chunk * self.chunk_size
+        return begin, min(self.task.size, begin + self.chunk_size)
+
+    def missing(self):
+        return [chunk for chunk in range(self.chunk_count) if chunk not in self.done]
+
+    def done_bytes(self):
+        return sum(self.chunk_range(chunk)[1] - self.chunk_range(chunk)[0] for chunk in self.done)
+
+    def complete(self, chunk):
+        """Record a downloaded chunk, returns True when it was the last one."""
+        with self.lock:
+            self.done.add(chunk)
+            self.save()
+            return len(self.done) == self.chunk_count
+
+    def save(self):
+        tmp_path = self.task.state_path.with_name(self.task.state_path.name + '.tmp')
+        with open(str(tmp_path), 'w') as f:
+            json.dump({'size': self.task.size, 'chunk_size': self.chunk_size, 'done': sorted(self.done)}, f)
+        os.replace(str(tmp_path), str(self.task.state_path))
+
+    def finish(self):
+        os.replace(str(self.task.part_path), str(self.task.destination))
+        self.task.state_path.unlink()
+
+
+def _download_chunk(state, chunk, progress):
+    """Fetch one chunk into the partial file, retrying from the last byte
+    received when the connection drops."""
+    begin, end = state.chunk_range(chunk)
+    position = begin
+    for attempt in range(MAX_ATTEMPTS):
+        try:
+            with _open_range(state.task.url, position, end) as response, \
+                    open(str(state.task.part_path), 'r+b') as f:
+                if response.status != 206:
+                    raise IOError(f'{state.task.url} does not support range requests')
+                f.seek(position)
+                while position < end:
+                    data = response.read(min(READ_SIZE, end - position))
+                    if not data:
+                        raise http.client.IncompleteRead(b'')
+                    f.write(data)
+                    position += len(data)
+                    progress.add(len(data))
+            return
+        except (urllib.error.URLError, http.client.HTTPException, ConnectionError, TimeoutError):
+            if attempt == MAX_ATTEMPTS - 1:
+                raise
+            time.sleep(0.5 * (attempt + 1))
+
+
+def _download_whole(task, progress):
+    """Single stream download, for servers without range support."""
+    with urllib.request.urlopen(task.url) as response, open(str(task.part_path), 'wb') as f:
+        while True:
+            data = response.read(READ_SIZE)
+            if not data:
+                break
+            f.write(data)
+            progress.add(len(data))
+    os.replace(str(task.part_path), str(task.destination))
+
+
+def download_files(tasks, num_workers=DEFAULT_WORKERS, chunk_size=DEFAULT_CHUNK_SIZE, on_file_done=None):
+    """Download files concurrently: every file is split in chunk_size ranges,
+    and the chunks of all the files are fetched by a pool of num_workers
+    threads, so that small files download side by side and large ones in
+    parallel. Interrupted downloads resume from the missing chunks.
+
+    Files whose destination exists are skipped, unless it is smaller or larger
+    than the expected size when that is known: downloads go to a partial file,
+    renamed to the destination once complete. Files of servers without range
+    support are downloaded in one stream.
+    on_file_done(task) is called, from a worker thread, when a file is complete.
+    Returns the number of bytes transferred.
+    """
+    pending = []
+    for task in tasks:
+        if task.destination.exists() and (task.size is None or task.destination.stat().st_size == task.size):
+            print("=> Skipping, already downloaded:", task.destination.name)
+            if on_file_done is not None:
+                on_file_done(task)
+            continue
+        # The probe also tells whether the server supports range requests
+        remote_size = query_size(task.url)
+        task.resumable = remote_size is not None
+        if task.resumable:
+            task.size = remote_size
+        if task.size == 0:
+            task.destination.touch()
+            if on_file_done is not None:
+                on_file_done(task)
+            continue
+        pending.append(task)
+
+    progress = Progress(sum(task.size or 0 for task in pending))
+    with ThreadPoolExecutor(max_workers=num_workers) as executor:
+        futures = {}
+        for task in pending:
+            if not task.resumable:
+                print("=> Downloading (no resume support):", task.destination.name)
+                futures[executor.submit(_download_whole, task, progress)] = (task, None)
+                continue
+            state = _FileState(task, chunk_size)
+            missing = state.missing()
+            resumed = state.done_bytes()
+            if resumed > 0:
+                print(f"=> Resuming: {task.destination.name} ({resumed / 1e6:.1f} MB already downloaded)")
+                progress.add(resumed, transferred=False)
+            else:
+                print("=> Downloading:", task.destination.name)
+            for chunk in missing:
+                futures[executor.submit(_download_chunk, state, chunk, progress)] = (task, (state, chunk))
+
+        for future in as_completed(futures):
+            task, chunk_state = futures[future]
+            future.result()
+            if chunk_state is not None:
+                state, chunk = chunk_state
+                if not state.complete(chunk):
+                    continue
+                state.finish()
+            if on_file_done is not None:
+                on_file_done(task)
+
+    progress.print_status()
+    elapsed = time.time() - progress.start
+    print(f"=> Downloaded {len(pending)} files, {progress.transferred_bytes / 1e6:.1f} MB in {elapsed:.1f}s "
+          f"({progress.throughput() / 1e6:.1f} MB/s)")
+    return progress.transferred_bytes
@@ -0,0 +1,47 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+#pragma once
+
+#include <cstdint>
+
+namespace Kernels
+{
+    // Same threshold used by the numpy path on the ray length
+    constexpr float kMinPointNorm = 1e-6f;
+    constexpr float kMillimetersToMeters = 1e-3f;
+
+    struct DepthRange
+    {
+        float minMm;
+        float maxMm;
+
+        bool Contains(float depthMm) const
+        {
+            return depthMm > 0.0f &&
+                   (minMm <= 0.0f || depthMm >= minMm) &&
+                   (maxMm <= 0.0f || depthMm <= maxMm);
+        }
+    };
+
+    // True if pixel i yields a point: depth in range and a non degenerate LUT ray
+    inline bool IsValidPixel(const uint16_t* depth, const float* lut, int64_t i, const DepthRange& range)
+    {
+        const float d = static_cast<float>(depth[i]);
+        if (!range.Contains(d))
+        {
+            return false;
+        }
+        const float* ray = lut + 3 * i;
+        const float norm2 = d * d * (ray[0] * ray[0] + ray[1] * ray[1] + ray[2] * ray[2]);
+        return norm2 >= kMinPointNorm * kMinPointNorm;
+    }
+}
@@ -0,0 +1,101 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+#include "Kernels.h"
+#include "DepthPixels.h"
+#include "ParallelFor.h"
+
+#include <vector>
+
+KERNELS_API int64_t DepthToPoints(
+    const uint16_t* depth,
+    const float* lut,
+    int64_t pixelCount,
+    float clampMin,
+    float clampMax,
+    const double* camToWorld,
+    float* outCamPoints,
+    float* outWorldPoints,
+    int32_t* outPixelIds,
+    int32_t threadCount)
+{
+    const Kernels::DepthRange range{ clampMin * 1000.0f, clampMax * 1000.0f };
+
+    float m[12] = {};
+    if (camToWorld)
+    {
+        for (int i = 0; i < 12; ++i)
+        {
+            m[i] = static_cast<float>(camToWorld[i]);
+        }
+    }
+    else
+    {
+        outWorldPoints = nullptr;
+    }
+
+    // First pass counts the valid pixels of every chunk, so that the second
+    // pass can write each chunk straight at its final (compacted) offset
+    const int chunkCount = static_cast<int>(std::max<int64_t>(1, std::min<int64_t>(Kernels::ResolveThreadCount(threadCount), pixelCount)));
+    std::vector<int64_t> chunkOffsets(chunkCount + 1, 0);
+
+    Kernels::ParallelFor(pixelCount, chunkCount, [&](int chunk, int64_t begin, int64_t end)
+    {
+        int64_t valid = 0;
+        for (int64_t i = begin; i < end; ++i)
+        {
+            valid += Kernels::IsValidPixel(depth, lut, i, range) ? 1 : 0;
+        }
+        chunkOffsets[chunk + 1] = valid;
+    });
+
+    for (int chunk = 0; chunk < chunkCount; ++chunk)
+    {
+        chunkOffsets[chunk + 1] += chunkOffsets[chunk];
+    }
+
+    Kernels::ParallelFor(pixelCount, chunkCount, [&](int chunk, int64_t begin, int64_t end)
+    {
+        int64_t out = chunkOffsets[chunk];
+        for (int64_t i = begin; i < end; ++i)
+        {
+            if (!Kernels::IsValidPixel(depth, lut, i, range))
+            {
+                continue;
+            }
+
+            const float d = static_cast<float>(depth[i]) * Kernels::kMillimetersToMeters;
+            const float x = lut[3 * i + 0] * d;
+            const float y = lut[3 * i + 1] * d;
+            const float z = lut[3 * i + 2] * d;
+
+            if (outCamPoints)
+            {
+                outCamPoints[3 * out + 0] = x;
+                outCamPoints[3 * out + 1] = y;
+                outCamPoints[3 * out + 2] = z;
+            }
+            if (outWorldPoints)
+            {
+                outWorldPoints[3 * out + 0] = m[0] * x + m[1] * y + m[2] * z + m[3];
+                outWorldPoints[3 * out + 1] = m[4] * x + m[5] * y + m[6] * z + m[7];
+                outWorldPoints[3 * out + 2] = m[8] * x + m[9] * y + m[10] * z + m[11];
+            }
+            if (outPixelIds)
+            {
+                outPixelIds[out] = static_cast<int32_t>(i);
+            }
+            ++out;
+        }
+    });
+
+    return chunkOffsets[chunkCount];
+}
@@ -0,0 +1,171 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+#pragma once
+
+// C interface of the converter kernels library.
+// It is loaded from python through ctypes (see native_kernels.py), so every
+// entry point only takes plain pointers to contiguous buffers owned by the caller.
+
+#include <cstdint>
+
+#ifdef _WIN32
+#define KERNELS_API extern "C" __declspec(dllexport)
+#else
+#define KERNELS_API extern "C" __attribute__((visibility("default")))
+#endif
+
+// Convert a depth image (millimeters) into a point cloud in one pass:
+// depth * LUT, drop invalid pixels, optional clamping, scale to meters and
+// optional transform to world space.
+//
+// depth:          pixelCount depth values in millimeters
+// lut:            pixelCount * 3 unit-plane rays, as saved in <sensor>_lut.bin
+// clampMin/Max:   depth range in meters, a bound <= 0 is ignored
+// camToWorld:     4x4 row-major transform, may be null
+// outCamPoints:   pixelCount * 3 floats, receives camera space points (may be null)
+// outWorldPoints: pixelCount * 3 floats, receives world space points (may be null,
+//                 ignored when camToWorld is null)
+// outPixelIds:    pixelCount ints, receives the source pixel of every point (may be null)
+//
+// Returns the number of valid points written at the start of each output buffer.
+KERNELS_API int64_t DepthToPoints(
+    const uint16_t* depth,
+    const float* lut,
+    int64_t pixelCount,
+    float clampMin,
+    float clampMax,
+    const double* camToWorld,
+    float* outCamPoints,
+    float* outWorldPoints,
+    int32_t* outPixelIds,
+    int32_t threadCount);
+
+// Nearest-depth z-buffer: splat every point on its pixel and keep the closest one.
+//
+// pixelIds:    pointCount linear pixel ids (y * width + x), negative ids are skipped
+// depths:      pointCount depths, points with depth <= 0 are skipped
+// outDepth:    pixelCount floats, receives the nearest depth per pixel (0 when empty)
+// outWinners:  pixelCount ints, receives the id of the nearest point per pixel (-1 when empty)
+//
+// On equal depths the point with the lowest id wins.
+KERNELS_API void ZBufferSplat(
+    const int64_t* pixelIds,
+    const float* depths,
+    int64_t pointCount,
+    int64_t pixelCount,
+    float* outDepth,
+    int32_t* outWinners);
+
+// Normals of an organized depth frame, from the cross product of the tangents
+// along the image rows and columns, oriented towards the camera.
+//
+// depth, lut:     width * height depth values (mm) and rays, as for DepthToPoints
+// clampMin/Max:   same depth range as passed to DepthToPoints
+// maxDepthJump:   neighbors whose depth differs by more than maxDepthJump * depth
+//                 are across a discontinuity and not used
+// pixelIds:       pointCount source pixels, as written by DepthToPoints
+// camToWorld:     4x4 row-major transform used to rotate the normals, may be null
+// outNormals:     pointCount * 3 floats, receives one unit normal per point
+KERNELS_API void OrganizedNormals(
+    const uint16_t* depth,
+    const float* lut,
+    int32_t width,
+    int32_t height,
+    float clampMin,
+    float clampMax,
+    float maxDepthJump,
+    const int32_t* pixelIds,
+    int64_t pointCount,
+    const double* camToWorld,
+    float* outNormals,
+    int32_t threadCount);
+
+// Write a point cloud or a triangle mesh to a binary little endian PLY file
+// in a single write.
+//
+// path:       file path, in the narrow encoding of the file system
+// points:     pointCount * 3 floats
+// normals:    pointCount * 3 floats, may be null
+// colors:     pointCount * 3 bytes (RGB), may be null
+// triangles:  triangleCount * 3 vertex indices, may be null
+//
+// Returns 0 on success, -1 if the file could not be written.
+KERNELS_API int32_t WritePly(
+    const char* path,
+    const float* points,
+    const float* normals,
+    const uint8_t* colors,
+    int64_t pointCount,
+    const int32_t* triangles,
+    int64_t triangleCount);
+
+// Streaming voxel grid downsampling: points from any number of frames are
+// accumulated in a hashed grid, keeping the running sums of position, color
+// and normal per occupied voxel, so memory grows with the scene, not with the
+// number of frames.
+//
+// VoxelGridCreate:  voxelSize in meters; hasColors/hasNormals select the
+//                   attributes that are accumulated. Free with VoxelGridDestroy.
+// VoxelGridAdd:     pointCount * 3 floats for points, colors (in [0, 1]) and
+//                   normals; colors and normals may be null
+// VoxelGridSize:    number of occupied voxels
+// VoxelGridExtract: writes VoxelGridSize() * 3 floats per attribute: average
+//                   position and color, and the normalized sum of the normals
+KERNELS_API void* VoxelGridCreate(float voxelSize, int32_t hasColors, int32_t hasNormals);
+KERNELS_API void VoxelGridAdd(void* grid, const float* points, const float* colors, const float* normals, int64_t pointCount);
+KERNELS_API int64_t VoxelGridSize(const void* grid);
+KERNELS_API void VoxelGridExtract(const void* grid, float* outPoints, float* outColors, float* outNormals);
+KERNELS_API void VoxelGridDestroy(void* grid);
+
+// Truncated signed distance volume with voxel hashing: 8x8x8 voxel blocks are
+// allocated around the observed surfaces only, and integration runs in
+// parallel over the blocks seen by a frame.
+//
+// TsdfVolumeCreate:      voxelSize and truncation in meters; voxel weights stop
+//                        growing at maxWeight (<= 0 for no limit).
+//                        Free with TsdfVolumeDestroy.
+// TsdfVolumeIntegrate:   depth is width * height values in 1 / depthScale meters
+//                        (the pinhole projection PNGs), depths above depthMax are
+//                        ignored; color is width * height * 3 bytes, RGB or BGR
+//                        (as read by opencv), may be null; intrinsics are
+//                        fx, fy, cx, cy; camToWorld is a 4x4 row-major rigid transform
+// TsdfVolumeBlockCount:  number of allocated blocks
+// TsdfVolumeExtractMesh: runs marching cubes in parallel on the blocks changed
+//                        since the previous call only, joins all the blocks,
+//                        welding the vertices of their seams, and simplifies
+//                        the mesh to at most targetTriangleCount triangles
+//                        (<= 0 to keep them all); returns the vertex count (and
+//                        the triangle count)
+// TsdfVolumeGetMesh:     copies the last extracted mesh, vertexCount * 3 floats
+//                        or bytes per attribute and triangleCount * 3 indices;
+//                        normals, colors and triangles may be null
+// TsdfVolumeWriteMesh:   writes the last extracted mesh to a binary PLY file,
+//                        as a point cloud when withTriangles is 0; returns 0
+//                        on success, -1 if the file could not be written
+KERNELS_API void* TsdfVolumeCreate(float voxelSize, float truncation, float maxWeight);
+KERNELS_API void TsdfVolumeIntegrate(
+    void* volume,
+    const uint16_t* depth,
+    const uint8_t* color,
+    int32_t width,
+    int32_t height,
+    float depthScale,
+    float depthMax,
+    const float* intrinsics,
+    const double* camToWorld,
+    int32_t colorIsBgr,
+    int32_t threadCount);
+KERNELS_API int64_t TsdfVolumeBlockCount(const void* volume);
+KERNELS_API int64_t TsdfVolumeExtractMesh(void* volume, int64_t targetTriangleCount, int32_t threadCount, int64_t* outTriangleCount);
+KERNELS_API void TsdfVolumeGetMesh(const void* volume, float* outVertices, float* outNormals, uint8_t* outColors, int32_t* outTriangles);
+KERNELS_API int32_t TsdfVolumeWriteMesh(const void* volume, const char* path, int32_t withTriangles);
+KERNELS_API void TsdfVolumeDestroy(void* volume);
@@ -0,0 +1,181 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+#include "MarchingCubes.h"
+
+#include <array>
+#include <cstddef>
+#include <utility>
+
+namespace
+{
+    int EdgeBetween(int a, int b)
+    {
+        const int low = a < b ? a : b;
+        const int axis = (a ^ b) == 1 ? 0 : ((a ^ b) == 2 ? 1 : 2);
+        // Index of the start corner among the 4 corners with a zero bit on axis
+        const int other0 = axis == 0 ? 1 : 0;
+        const int other1 = axis == 2 ? 1 : 2;
+        return 4 * axis + ((low >> other0) & 1) + 2 * ((low >> other1) & 1);
+    }
+
+    // The 4 corners of every face, counter clockwise seen from outside the cube
+    std::array<std::array<int, 4>, 6> CubeFaces()
+    {
+        std::array<std::array<int, 4>, 6> faces{};
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            const int b = axis == 0 ? 1 : 0;
+            const int c = axis == 2 ? 1 : 2;
+            for (int side = 0; side < 2; ++side)
+            {
+                std::array<int, 4> face{};
+                const int offsets[4][2] = { { 0, 0 }, { 1, 0 }, { 1, 1 }, { 0, 1 } };
+                for (int k = 0; k < 4; ++k)
+                {
+                    face[k] = (side << axis) | (offsets[k][0] << b) | (offsets[k][1] << c);
+                }
+                // The cycle above turns around +axis for axes 0 and 2, -axis for axis 1
+                const bool turnsPositive = axis != 1;
+                if (turnsPositive != (side == 1))
+                {
+                    std::swap(face[1], face[3]);
+                }
+                faces[2 * axis + side] = face;
+            }
+        }
+        return faces;
+    }
+
+    // Two edges lie on a common face when their start corners agree on an axis
+    // that neither of them runs along
+    bool ShareFace(int edgeA, int edgeB)
+    {
+        const int startA = Kernels::EdgeStart(edgeA);
+        const int startB = Kernels::EdgeStart(edgeB);
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            if (axis != Kernels::EdgeAxis(edgeA) && axis != Kernels::EdgeAxis(edgeB) &&
+                ((startA >> axis) & 1) == ((startB >> axis) & 1))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    std::vector<int8_t> BuildTriangles(int configuration)
+    {
+        const auto inside = [configuration](int corner) { return ((configuration >> corner) & 1) != 0; };
+
+        // On every face, connect each edge where the boundary leaves the inside
+        // region (exit) to the edge where it entered it (entry): going counter
+        // clockwise, an inside run starts at an entry and ends at the next exit.
+        // Every crossed edge is an exit on one of its faces and an entry on the
+        // other, so the segments chain into closed loops.
+        std::array<int, Kernels::kCubeEdgeCount> next{};
+        next.fill(-1);
+        for (const auto& face : CubeFaces())
+        {
+            int events[4];
+            bool isEntry[4];
+            int eventCount = 0;
+            for (int k = 0; k < 4; ++k)
+            {
+                const int from = face[k];
+                const int to = face[(k + 1) % 4];
+                if (inside(from) != inside(to))
+                {
+                    events[eventCount] = EdgeBetween(from, to);
+                    isEntry[eventCount] = inside(to);
+                    ++eventCount;
+                }
+            }
+            for (int k = 0; k < eventCount; ++k)
+            {
+                if (!isEntry[k])
+                {
+                    continue;
+                }
+                const int exit = events[(k + 1) % eventCount];
+                next[exit] = events[k];
+            }
+        }
+
+        std::vector<int8_t> triangles;
+        std::array<bool, Kernels::kCubeEdgeCount> visited{};
+        for (int start = 0; start < Kernels::kCubeEdgeCount; ++start)
+        {
+            if (next[start] < 0 || visited[start])
+            {
+                continue;
+            }
+            std::vector<int> loop;
+            for (int edge = start; !visited[edge]; edge = next[edge])
+            {
+                visited[edge] = true;
+                loop.push_back(edge);
+            }
+            // Fan triangulation of the loop, which runs clockwise seen from
+            // outside. The apex is picked so that no diagonal lies on a cube
+            // face, where it could duplicate a segment of the neighboring cube.
+            const size_t n = loop.size();
+            size_t apex = 0;
+            for (size_t candidate = 0; candidate < n; ++candidate)
+            {
+                bool valid = true;
+                for (size_t i = 2; i + 1 < n && valid; ++i)
+                {
+                    valid = !ShareFace(loop[candidate], loop[(candidate + i) % n]);
+                }
+                if (valid)
+                {
+                    apex = candidate;
+                    break;
+                }
+            }
+            for (size_t i = 1; i + 1 < n; ++i)
+            {
+                triangles.push_back(static_cast<int8_t>(loop[apex]));
+                triangles.push_back(static_cast<int8_t>(loop[(apex + i + 1) % n]));
+                triangles.push_back(static_cast<int8_t>(loop[(apex + i) % n]));
+            }
+        }
+        return triangles;
+    }
+
+    std::array<std::vector<int8_t>, 256> BuildTable()
+    {
+        std::array<std::vector<int8_t>, 256> table;
+        for (int configuration = 0; configuration < 256; ++configuration)
+        {
+            table[configuration] = BuildTriangles(configuration);
+        }
+        return table;
+    }
+}
+
+namespace Kernels
+{
+    int EdgeStart(int edge)
+    {
+        const int axis = EdgeAxis(edge);
+        const int other0 = axis == 0 ? 1 : 0;
+        const int other1 = axis == 2 ? 1 : 2;
+        return ((edge & 1) << other0) | (((edge >> 1) & 1) << other1);
+    }
+
+    const std::vector<int8_t>& MarchingCubesTriangles(int configuration)
+    {
+        static const std::array<std::vector<int8_t>, 256> table = BuildTable();
+        return table[configuration & 255];
+    }
+}
@@ -0,0 +1,39 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace Kernels
+{
+    // Cube corners are numbered by their offsets, corner c is at
+    // (c & 1, (c >> 1) & 1, (c >> 2) & 1). Edge e runs along axis e / 4 from
+    // the corner returned by EdgeStart(e).
+    constexpr int kCubeEdgeCount = 12;
+
+    inline int EdgeAxis(int edge)
+    {
+        return edge / 4;
+    }
+
+    int EdgeStart(int edge);
+
+    // Triangles of the iso-surface for a cube configuration, as edge indices
+    // (three per triangle). Bit c of the configuration is set when corner c is
+    // inside (negative value). Triangles are oriented with their normal pointing
+    // towards the outside (positive values).
+    //
+    // Ambiguous faces always separate the inside corners, a rule that only
+    // depends on the face, so that neighboring cubes produce a closed surface.
+    const std::vector<int8_t>& MarchingCubesTriangles(int configuration);
+}
@@ -0,0 +1,518 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+#include "MeshSimplify.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <queue>
+#include <utility>
+
+namespace
+{
+    // Boundary edges are kept in place by planes orthogonal to their triangle,
+    // weighted much more than the surface planes
+    constexpr double kBoundaryWeight = 1000.0;
+
+    // A collapse is rejected when it turns a triangle by more than ~78 degrees
+    constexpr double kMinNormalCosine = 0.2;
+
+    void Cross(const double a[3], const double b[3], double out[3])
+    {
+        out[0] = a[1] * b[2] - a[2] * b[1];
+        out[1] = a[2] * b[0] - a[0] * b[2];
+        out[2] = a[0] * b[1] - a[1] * b[0];
+    }
+
+    double Dot(const double a[3], const double b[3])
+    {
+        return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+    }
+
+    // Sum of squared distances to a set of planes, as the upper triangle of
+    // the symmetric 4x4 matrix: xx xy xz xw yy yz yw zz zw ww
+    struct Quadric
+    {
+        double m[10] = {};
+
+        void AddPlane(const double normal[3], double offset, double weight)
+        {
+            const double plane[4] = { normal[0], normal[1], normal[2], offset };
+            int k = 0;
+            for (int i = 0; i < 4; ++i)
+            {
+                for (int j = i; j < 4; ++j)
+                {
+                    m[k++] += weight * plane[i] * plane[j];
+                }
+            }
+        }
+
+        Quadric& operator+=(const Quadric& other)
+        {
+            for (int k = 0; k < 10; ++k)
+            {
+                m[k] += other.m[k];
+            }
+            return *this;
+        }
+
+        double Error(const double p[3]) const
+        {
+            const double x = p[0];
+            const double y = p[1];
+            const double z = p[2];
+            return m[0] * x * x + 2.0 * m[1] * x * y + 2.0 * m[2] * x * z + 2.0 * m[3] * x +
+                   m[4] * y * y + 2.0 * m[5] * y * z + 2.0 * m[6] * y +
+                   m[7] * z * z + 2.0 * m[8] * z + m[9];
+        }
+
+        // Point of minimum error, false when the planes do not pin one down
+        bool Minimize(double out[3]) const
+        {
+            const double a00 = m[0], a01 = m[1], a02 = m[2];
+            const double a11 = m[4], a12 = m[5], a22 = m[7];
+            const double c00 = a11 * a22 - a12 * a12;
+            const double c01 = a02 * a12 - a01 * a22;
+            const double c02 = a01 * a12 - a02 * a11;
+            const double determinant = a00 * c00 + a01 * c01 + a02 * c02;
+            const double trace = a00 + a11 + a22;
+            if (!(std::fabs(determinant) > 1e-9 * trace * trace * trace))
+            {
+                return false;
+            }
+            const double c11 = a00 * a22 - a02 * a02;
+            const double c12 = a01 * a02 - a00 * a12;
+            const double c22 = a00 * a11 - a01 * a01;
+            const double b[3] = { -m[3], -m[6], -m[8] };
+            out[0] = (c00 * b[0] + c01 * b[1] + c02 * b[2]) / determinant;
+            out[1] = (c01 * b[0] + c11 * b[1] + c12 * b[2]) / determinant;
+            out[2] = (c02 * b[0] + c12 * b[1] + c22 * b[2]) / determinant;
+            return true;
+        }
+    };
+
+    struct Candidate
+    {
+        double cost;
+        int32_t v0;
+        int32_t v1;
+        uint32_t stamp0;
+        uint32_t stamp1;
+
+        // Cheapest first in std::priority_queue
+        bool operator<(const Candidate& other) const
+        {
+            return cost > other.cost;
+        }
+    };
+
+    class Simplifier
+    {
+    public:
+        explicit Simplifier(Kernels::TriangleMesh& mesh) :
+            m_mesh(mesh),
+            m_vertexCount(static_cast<int32_t>(mesh.vertices.size() / 3)),
+            m_positions(mesh.vertices.begin(), mesh.vertices.end()),
+            m_colors(mesh.colors.begin(), mesh.colors.end()),
+            m_normals(mesh.normals.begin(), mesh.normals.end()),
+            m_triangles(mesh.triangles),
+            m_removed(mesh.triangles.size() / 3, 0),
+            m_adjacency(m_vertexCount),
+            m_quadrics(m_vertexCount),
+            m_stamps(m_vertexCount, 0),
+            m_dead(m_vertexCount, 0),
+            m_boundary(m_vertexCount, 0)
+        {
+        }
+
+        void Run(int64_t targetTriangleCount)
+        {
+            const int32_t triangleCount = static_cast<int32_t>(m_removed.size());
+            std::vector<std::pair<uint64_t, int32_t>> edges;
+            edges.reserve(3 * static_cast<size_t>(triangleCount));
+            for (int32_t t = 0; t < triangleCount; ++t)
+            {
+                const int32_t* triangle = &m_triangles[3 * t];
+                double normal[3];
+                const double area = TriangleNormal(triangle[0], triangle[1], triangle[2], nullptr, normal);
+                for (int k = 0; k < 3; ++k)
+                {
+                    m_adjacency[triangle[k]].push_back(t);
+                    if (area > 0.0)
+                    {
+                        m_quadrics[triangle[k]].AddPlane(normal, -Dot(normal, Position(triangle[0])), area);
+                    }
+                    const int32_t a = std::min(triangle[k], triangle[(k + 1) % 3]);
+                    const int32_t b = std::max(triangle[k], triangle[(k + 1) % 3]);
+                    edges.emplace_back((static_cast<uint64_t>(a) << 32) | static_cast<uint32_t>(b), t);
+                }
+            }
+
+            // Edges used by a single triangle are on the boundary
+            std::sort(edges.begin(), edges.end());
+            std::vector<uint64_t> uniqueEdges;
+            uniqueEdges.reserve(edges.size() / 2 + 1);
+            for (size_t begin = 0, end = 0; begin < edges.size(); begin = end)
+            {
+                end = begin + 1;
+                while (end < edges.size() && edges[end].first == edges[begin].first)
+                {
+                    ++end;
+                }
+                if (end - begin == 1)
+                {
+                    AddBoundaryQuadric(static_cast<int32_t>(edges[begin].first >> 32),
+                                       static_cast<int32_t>(edges[begin].first & 0xffffffffu), edges[begin].second);
+                }
+                uniqueEdges.push_back(edges[begin].first);
+            }
+            std::vector<std::pair<uint64_t, int32_t>>().swap(edges);
+            for (uint64_t edge : uniqueEdges)
+            {
+                Push(static_cast<int32_t>(edge >> 32), static_cast<int32_t>(edge & 0xffffffffu));
+            }
+
+            int64_t liveTriangles = triangleCount;
+            while (liveTriangles > targetTriangleCount && !m_queue.empty())
+            {
+                const Candidate candidate = m_queue.top();
+                m_queue.pop();
+                if (m_dead[candidate.v0] || m_dead[candidate.v1] ||
+                    m_stamps[candidate.v0] != candidate.stamp0 || m_stamps[candidate.v1] != candidate.stamp1)
+                {
+                    continue;
+                }
+                double target[3];
+                CollapseCost(candidate.v0, candidate.v1, target);
+                if (!CanCollapse(candidate.v0, candidate.v1, target))
+                {
+                    continue;
+                }
+                liveTriangles -= Collapse(candidate.v0, candidate.v1, target);
+            }
+
+            Compact();
+        }
+
+    private:
+        const double* Position(int32_t vertex) const
+        {
+            return &m_positions[3 * static_cast<size_t>(vertex)];
+        }
+
+        // Unit normal of the triangle a b c, with a placed at p when it is -1;
+        // returns twice the triangle area
+        double TriangleNormal(int32_t a, int32_t b, int32_t c, const double* p, double normal[3]) const
+        {
+            const double* pa = a == -1 ? p : Position(a);
+            const double* pb = Position(b);
+            const double* pc = Position(c);
+            const double ab[3] = { pb[0] - pa[0], pb[1] - pa[1], pb[2] - pa[2] };
+            const double ac[3] = { pc[0] - pa[0], pc[1] - pa[1], pc[2] - pa[2] };
+            Cross(ab, ac, normal);
+            const double length = std::sqrt(Dot(normal, normal));
+            if (length > 0.0)
+            {
+                for (int axis = 0; axis < 3; ++axis)
+                {
+                    normal[axis] /= length;
+                }
+            }
+            return length;
+        }
+
+        void AddBoundaryQuadric(int32_t a, int32_t b, int32_t triangle)
+        {
+            const int32_t* corners = &m_triangles[3 * triangle];
+            double faceNormal[3];
+            if (TriangleNormal(corners[0], corners[1], corners[2], nullptr, faceNormal) <= 0.0)
+            {
+                return;
+            }
+            const double* pa = Position(a);
+            const double* pb = Position(b);
+            const double edge[3] = { pb[0] - pa[0], pb[1] - pa[1], pb[2] - pa[2] };
+            double normal[3];
+            Cross(edge, faceNormal, normal);
+            const double length = std::sqrt(Dot(normal, normal));
+            if (length <= 0.0)
+            {
+                return;
+            }
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                normal[axis] /= length;
+            }
+            const double weight = kBoundaryWeight * Dot(edge, edge);
+            m_quadrics[a].AddPlane(normal, -Dot(normal, pa), weight);
+            m_quadrics[b].AddPlane(normal, -Dot(normal, pa), weight);
+            m_boundary[a] = 1;
+            m_boundary[b] = 1;
+        }
+
+        // Error of the best position for the merged vertex: the minimum of the
+        // summed quadrics when it is well defined and close to the edge,
+        // otherwise the best of the end points and the middle of the edge
+        double CollapseCost(int32_t v0, int32_t v1, double target[3]) const
+        {
+            Quadric quadric = m_quadrics[v0];
+            quadric += m_quadrics[v1];
+            const double* p0 = Position(v0);
+            const double* p1 = Position(v1);
+            const double middle[3] = { 0.5 * (p0[0] + p1[0]), 0.5 * (p0[1] + p1[1]), 0.5 * (p0[2] + p1[2]) };
+            const double edge[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+
+            if (quadric.Minimize(target))
+            {
+                const double offset[3] = { target[0] - middle[0], target[1] - middle[1], target[2] - middle[2] };
+                if (Dot(offset, offset) <= Dot(edge, edge))
+                {
+                    return std::max(0.0, quadric.Error(target));
+                }
+            }
+            const double* options[3] = { p0, p1, middle };
+            double best = INFINITY;
+            for (const double* option : options)
+            {
+                const double error = quadric.Error(option);
+                if (error < best)
+                {
+                    best = error;
+                    std::copy(option, option + 3, target);
+                }
+            }
+            return std::max(0.0, best);
+        }
+
+        void Push(int32_t v0, int32_t v1)
+        {
+            double target[3];
+            m_queue.push({ CollapseCost(v0, v1, target), v0, v1, m_stamps[v0], m_stamps[v1] });
+        }
+
+        void LiveNeighbors(int32_t vertex, std::vector<int32_t>& neighbors) const
+        {
+            neighbors.clear();
+            for (int32_t t : m_adjacency[vertex])
+            {
+                if (m_removed[t])
+                {
+                    continue;
+                }
+                for (int k = 0; k < 3; ++k)
+                {
+                    if (m_triangles[3 * t + k] != vertex)
+                    {
+                        neighbors.push_back(m_triangles[3 * t + k]);
+                    }
+                }
+            }
+            std::sort(neighbors.begin(), neighbors.end());
+            neighbors.erase(std::unique(neighbors.begin(), neighbors.end()), neighbors.end());
+        }
+
+        bool Contains(int32_t triangle, int32_t vertex) const
+        {
+            const int32_t* corners = &m_triangles[3 * triangle];
+            return corners[0] == vertex || corners[1] == vertex || corners[2] == vertex;
+        }
+
+        bool CanCollapse(int32_t v0, int32_t v1, const double target[3])
+        {
+            // Link condition: the end points may only share the neighbors
+            // opposite to the edge, otherwise the collapse pinches the surface
+            LiveNeighbors(v0, m_neighbors0);
+            LiveNeighbors(v1, m_neighbors1);
+            m_common.clear();
+            std::set_intersection(m_neighbors0.begin(), m_neighbors0.end(), m_neighbors1.begin(), m_neighbors1.end(),
+                                  std::back_inserter(m_common));
+            int sharedTriangles = 0;
+            for (int32_t t : m_adjacency[v0])
+            {
+                sharedTriangles += (!m_removed[t] && Contains(t, v1)) ? 1 : 0;
+            }
+            if (sharedTriangles == 0 || static_cast<int>(m_common.size()) != sharedTriangles)
+            {
+                return false;
+            }
+            // An interior edge between two boundary vertices would close the boundary
+            if (m_boundary[v0] && m_boundary[v1] && sharedTriangles == 2)
+            {
+                return false;
+            }
+
+            // The triangles that remain must not flip or become degenerate
+            for (int32_t moved : { v0, v1 })
+            {
+                const int32_t other = moved == v0 ? v1 : v0;
+                for (int32_t t : m_adjacency[moved])
+                {
+                    if (m_removed[t] || Contains(t, other))
+                    {
+                        continue;
+                    }
+                    const int32_t* corners = &m_triangles[3 * t];
+                    int k = 0;
+                    while (corners[k] != moved)
+                    {
+                        ++k;
+                    }
+                    const int32_t b = corners[(k + 1) % 3];
+                    const int32_t c = corners[(k + 2) % 3];
+                    double before[3];
+                    double after[3];
+                    TriangleNormal(moved, b, c, nullptr, before);
+                    if (TriangleNormal(-1, b, c, target, after) <= 0.0 || Dot(before, after) < kMinNormalCosine)
+                    {
+                        return false;
+                    }
+                }
+            }
+            return true;
+        }
+
+        // Merge v1 into v0 at the target position, returns the number of removed triangles
+        int Collapse(int32_t v0, int32_t v1, const double target[3])
+        {
+            const double* p0 = Position(v0);
+            const double* p1 = Position(v1);
+            const double edge[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+            const double offset[3] = { target[0] - p0[0], target[1] - p0[1], target[2] - p0[2] };
+            const double edgeLength2 = Dot(edge, edge);
+            const float t = static_cast<float>(edgeLength2 > 0.0 ? std::min(1.0, std::max(0.0, Dot(offset, edge) / edgeLength2)) : 0.5);
+            for (std::vector<float>* attribute : { &m_colors, &m_normals })
+            {
+                if (attribute->empty())
+                {
+                    continue;
+                }
+                for (int k = 0; k < 3; ++k)
+                {
+                    float& value = (*attribute)[3 * static_cast<size_t>(v0) + k];
+                    value += t * ((*attribute)[3 * static_cast<size_t>(v1) + k] - value);
+                }
+            }
+            std::copy(target, target + 3, &m_positions[3 * static_cast<size_t>(v0)]);
+
+            int removed = 0;
+            for (int32_t t1 : m_adjacency[v1])
+            {
+                if (m_removed[t1])
+                {
+                    continue;
+                }
+                if (Contains(t1, v0))
+                {
+                    m_removed[t1] = 1;
+                    ++removed;
+                    continue;
+                }
+                for (int k = 0; k < 3; ++k)
+                {
+                    if (m_triangles[3 * t1 + k] == v1)
+                    {
+                        m_triangles[3 * t1 + k] = v0;
+                    }
+                }
+                m_adjacency[v0].push_back(t1);
+            }
+            auto& adjacency = m_adjacency[v0];
+            adjacency.erase(std::remove_if(adjacency.begin(), adjacency.end(), [this](int32_t t0) { return m_removed[t0] != 0; }),
+                            adjacency.end());
+            std::vector<int32_t>().swap(m_adjacency[v1]);
+
+            m_quadrics[v0] += m_quadrics[v1];
+            m_boundary[v0] = m_boundary[v0] | m_boundary[v1];
+            m_dead[v1] = 1;
+            ++m_stamps[v0];
+
+            LiveNeighbors(v0, m_neighbors0);
+            for (int32_t neighbor : m_neighbors0)
+            {
+                Push(v0, neighbor);
+            }
+            return removed;
+        }
+
+        void Compact()
+        {
+            std::vector<int32_t> remap(m_vertexCount, -1);
+            Kernels::TriangleMesh result;
+            for (size_t t = 0; t < m_removed.size(); ++t)
+            {
+                if (m_removed[t])
+                {
+                    continue;
+                }
+                for (int k = 0; k < 3; ++k)
+                {
+                    const int32_t vertex = m_triangles[3 * t + k];
+                    if (remap[vertex] < 0)
+                    {
+                        remap[vertex] = static_cast<int32_t>(result.vertices.size() / 3);
+                        for (int axis = 0; axis < 3; ++axis)
+                        {
+                            const size_t index = 3 * static_cast<size_t>(vertex) + axis;
+                            result.vertices.push_back(static_cast<float>(m_positions[index]));
+                            if (!m_colors.empty())
+                            {
+                                result.colors.push_back(static_cast<uint8_t>(std::min(255.0f, std::max(0.0f, std::round(m_colors[index])))));
+                            }
+                        }
+                        if (!m_normals.empty())
+                        {
+                            const float* n = &m_normals[3 * static_cast<size_t>(vertex)];
+                            const float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+                            const float inverseLength = length > 0.0f ? 1.0f / length : 0.0f;
+                            for (int axis = 0; axis < 3; ++axis)
+                            {
+                                result.normals.push_back(n[axis] * inverseLength);
+                            }
+                        }
+                    }
+                    result.triangles.push_back(remap[vertex]);
+                }
+            }
+            m_mesh = std::move(result);
+        }
+
+        Kernels::TriangleMesh& m_mesh;
+        int32_t m_vertexCount;
+        std::vector<double> m_positions;
+        std::vector<float> m_colors;
+        std::vector<float> m_normals;
+        std::vector<int32_t> m_triangles;
+        std::vector<uint8_t> m_removed;
+        std::vector<std::vector<int32_t>> m_adjacency;
+        std::vector<Quadric> m_quadrics;
+        std::vector<uint32_t> m_stamps;
+        std::vector<uint8_t> m_dead;
+        std::vector<uint8_t> m_boundary;
+        std::priority_queue<Candidate> m_queue;
+        std::vector<int32_t> m_neighbors0;
+        std::vector<int32_t> m_neighbors1;
+        std::vector<int32_t> m_common;
+    };
+}
+
+namespace Kernels
+{
+    void SimplifyMesh(TriangleMesh& mesh, int64_t targetTriangleCount)
+    {
+        if (static_cast<int64_t>(mesh.triangles.size() / 3) <= targetTriangleCount)
+        {
+            return;
+        }
+        Simplifier(mesh).Run(targetTriangleCount);
+    }
+}
@@ -0,0 +1,36 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace Kernels
+{
+    // Indexed triangle mesh, 3 values per vertex for every attribute and 3
+    // vertex indices per triangle. Normals and colors may be empty.
+    struct TriangleMesh
+    {
+        std::vector<float> vertices;
+        std::vector<float> normals;
+        std::vector<uint8_t> colors;
+        std::vector<int32_t> triangles;
+    };
+
+    // Quadric error metric simplification (Garland and Heckbert): edges are
+    // collapsed cheapest first until at most targetTriangleCount triangles are
+    // left, or no edge can be collapsed without folding a triangle over or
+    // making the mesh non-manifold. Open boundaries are preserved by extra
+    // quadrics along the boundary edges. Colors and normals are interpolated
+    // along the collapsed edges.
+    void SimplifyMesh(TriangleMesh& mesh, int64_t targetTriangleCount);
+}
@@ -0,0 +1,187 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+#include "Kernels.h"
+#include "DepthPixels.h"
+#include "ParallelFor.h"
+
+#include <cmath>
+#include <vector>
+
+namespace
+{
+    // Points and normals are kept as separate x, y, z planes with a one pixel
+    // border of invalid (zero depth) pixels, so that the per row loops have no
+    // bounds checks and only use selects, which the compiler vectorizes
+    struct Planes
+    {
+        std::vector<float> x, y, z;
+
+        void Resize(size_t size)
+        {
+            x.assign(size, 0.0f);
+            y.assign(size, 0.0f);
+            z.assign(size, 0.0f);
+        }
+    };
+
+    // Branch free select, exact since weight is 0 or 1; the weight goes
+    // through an int since bool to float conversions are not vectorized
+    inline float Select(float weight, float a, float b)
+    {
+        return weight * a + (1.0f - weight) * b;
+    }
+
+    inline float Weight(bool condition)
+    {
+        return static_cast<float>(static_cast<int32_t>(condition));
+    }
+
+    // Tangents from central differences, falling back to one sided differences
+    // where a neighbor is missing or across a depth discontinuity
+    void NormalsRow(
+        const float* __restrict px,
+        const float* __restrict py,
+        const float* __restrict pz,
+        float* __restrict nx,
+        float* __restrict ny,
+        float* __restrict nz,
+        int64_t first,
+        int64_t width,
+        int64_t stride,
+        float maxDepthJump)
+    {
+        for (int64_t p = first; p < first + width; ++p)
+        {
+            const float z = pz[p];
+            const float tolerance = maxDepthJump * z;
+            const float right = Weight((pz[p + 1] > 0.0f) & (std::fabs(pz[p + 1] - z) <= tolerance));
+            const float left = Weight((pz[p - 1] > 0.0f) & (std::fabs(pz[p - 1] - z) <= tolerance));
+            const float down = Weight((pz[p + stride] > 0.0f) & (std::fabs(pz[p + stride] - z) <= tolerance));
+            const float up = Weight((pz[p - stride] > 0.0f) & (std::fabs(pz[p - stride] - z) <= tolerance));
+
+            const float ux = Select(right, px[p + 1], px[p]) - Select(left, px[p - 1], px[p]);
+            const float uy = Select(right, py[p + 1], py[p]) - Select(left, py[p - 1], py[p]);
+            const float uz = Select(right, pz[p + 1], pz[p]) - Select(left, pz[p - 1], pz[p]);
+            const float vx = Select(down, px[p + stride], px[p]) - Select(up, px[p - stride], px[p]);
+            const float vy = Select(down, py[p + stride], py[p]) - Select(up, py[p - stride], py[p]);
+            const float vz = Select(down, pz[p + stride], pz[p]) - Select(up, pz[p - stride], pz[p]);
+
+            float cx = uy * vz - uz * vy;
+            float cy = uz * vx - ux * vz;
+            float cz = ux * vy - uy * vx;
+            float length = std::sqrt(cx * cx + cy * cy + cz * cz);
+
+            // Isolated pixels (or lines) get a normal facing the camera
+            const float degenerate = Weight(!(length > 1e-12f));
+            const float rayLength = std::sqrt(px[p] * px[p] + py[p] * py[p] + z * z);
+            cx = Select(degenerate, -px[p], cx);
+            cy = Select(degenerate, -py[p], cy);
+            cz = Select(degenerate, -z, cz);
+            length = Select(degenerate, rayLength, length);
+
+            // Orient towards the camera center, at the origin of camera space
+            const float facing = px[p] * cx + py[p] * cy + z * cz;
+            const float scale = Select(Weight(facing > 0.0f), -1.0f, 1.0f) / Select(Weight(length > 0.0f), length, 1.0f);
+            nx[p] = cx * scale;
+            ny[p] = cy * scale;
+            nz[p] = cz * scale;
+        }
+    }
+
+    // Organized points and normals of the current frame, reused across calls
+    thread_local Planes t_points;
+    thread_local Planes t_normals;
+}
+
+KERNELS_API void OrganizedNormals(
+    const uint16_t* depth,
+    const float* lut,
+    int32_t width,
+    int32_t height,
+    float clampMin,
+    float clampMax,
+    float maxDepthJump,
+    const int32_t* pixelIds,
+    int64_t pointCount,
+    const double* camToWorld,
+    float* outNormals,
+    int32_t threadCount)
+{
+    const Kernels::DepthRange range{ clampMin * 1000.0f, clampMax * 1000.0f };
+    const int64_t stride = static_cast<int64_t>(width) + 2;
+    const size_t paddedSize = static_cast<size_t>(stride * (static_cast<int64_t>(height) + 2));
+
+    Planes& points = t_points;
+    Planes& normals = t_normals;
+    points.Resize(paddedSize);
+    normals.Resize(paddedSize);
+    float* px = points.x.data();
+    float* py = points.y.data();
+    float* pz = points.z.data();
+    float* nx = normals.x.data();
+    float* ny = normals.y.data();
+    float* nz = normals.z.data();
+
+    // Organized point cloud, invalid pixels stay at the origin
+    Kernels::ParallelFor(height, threadCount, [&](int, int64_t begin, int64_t end)
+    {
+        for (int64_t row = begin; row < end; ++row)
+        {
+            for (int64_t col = 0; col < width; ++col)
+            {
+                const int64_t i = row * width + col;
+                if (!Kernels::IsValidPixel(depth, lut, i, range))
+                {
+                    continue;
+                }
+                const int64_t p = (row + 1) * stride + col + 1;
+                const float d = static_cast<float>(depth[i]) * Kernels::kMillimetersToMeters;
+                px[p] = lut[3 * i + 0] * d;
+                py[p] = lut[3 * i + 1] * d;
+                pz[p] = lut[3 * i + 2] * d;
+            }
+        }
+    });
+
+    Kernels::ParallelFor(height, threadCount, [&](int, int64_t begin, int64_t end)
+    {
+        for (int64_t row = begin; row < end; ++row)
+        {
+            NormalsRow(px, py, pz, nx, ny, nz, (row + 1) * stride + 1, width, stride, maxDepthJump);
+        }
+    });
+
+    float r[9] = { 1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f };
+    if (camToWorld)
+    {
+        for (int row = 0; row < 3; ++row)
+        {
+            for (int col = 0; col < 3; ++col)
+            {
+                r[3 * row + col] = static_cast<float>(camToWorld[4 * row + col]);
+            }
+        }
+    }
+
+    // Gather the normals of the points, in the order written by DepthToPoints
+    Kernels::ParallelFor(pointCount, threadCount, [&](int, int64_t begin, int64_t end)
+    {
+        for (int64_t k = begin; k < end; ++k)
+        {
+            const int64_t pixel = pixelIds[k];
+            const int64_t p = (pixel / width + 1) * stride + pixel % width + 1;
+            outNormals[3 * k + 0] = r[0] * nx[p] + r[1] * ny[p] + r[2] * nz[p];
+            outNormals[3 * k + 1] = r[3] * nx[p] + r[4] * ny[p] + r[5] * nz[p];
+            outNormals[3 * k + 2] = r[6] * nx[p] + r[7] * ny[p] + r[8] * nz[p];
+        }
+    });
+}
@@ -0,0 +1,57 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+namespace Kernels
+{
+    // Number of worker threads to use when the caller passes threadCount <= 0
+    inline int ResolveThreadCount(int threadCount)
+    {
+        if (threadCount > 0)
+        {
+            return threadCount;
+        }
+        const unsigned int hardwareThreads = std::thread::hardware_concurrency();
+        return hardwareThreads > 0 ? static_cast<int>(hardwareThreads) : 1;
+    }
+
+    // Split [0, count) into one contiguous chunk per thread and call
+    // fn(chunkIndex, begin, end) for each of them. The calling thread
+    // processes the first chunk, so threadCount == 1 never spawns a thread.
+    template <typename Fn>
+    int ParallelFor(int64_t count, int threadCount, Fn&& fn)
+    {
+        const int64_t chunkCount = std::max<int64_t>(1, std::min<int64_t>(ResolveThreadCount(threadCount), count));
+        const int64_t chunkSize = (count + chunkCount - 1) / chunkCount;
+
+        std::vector<std::thread> workers;
+        workers.reserve(static_cast<size_t>(chunkCount - 1));
+        for (int64_t chunk = 1; chunk < chunkCount; ++chunk)
+        {
+            const int64_t begin = std::min(count, chunk * chunkSize);
+            const int64_t end = std::min(count, begin + chunkSize);
+            workers.emplace_back([&fn, chunk, begin, end]() { fn(static_cast<int>(chunk), begin, end); });
+        }
+        fn(0, int64_t(0), std::min(count, chunkSize));
+
+        for (auto& worker : workers)
+        {
+            worker.join();
+        }
+        return static_cast<int>(chunkCount);
+    }
+}
@@ -0,0 +1,94 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace Kernels
+{
+    // Binary little endian PLY with float x y z, optional float nx ny nz and
+    // optional uchar red green blue per vertex (the layout written by open3d),
+    // and optional triangle faces. The whole file is assembled in memory and
+    // written with a single call.
+    //
+    // Returns false if the file could not be written.
+    inline bool WriteBinaryPly(
+        const char* path,
+        const float* points,
+        const float* normals,
+        const uint8_t* colors,
+        int64_t vertexCount,
+        const int32_t* triangles = nullptr,
+        int64_t triangleCount = 0)
+    {
+        std::string header = "ply\nformat binary_little_endian 1.0\n";
+        header += "element vertex " + std::to_string(vertexCount) + "\n";
+        header += "property float x\nproperty float y\nproperty float z\n";
+        if (normals)
+        {
+            header += "property float nx\nproperty float ny\nproperty float nz\n";
+        }
+        if (colors)
+        {
+            header += "property uchar red\nproperty uchar green\nproperty uchar blue\n";
+        }
+        if (triangles)
+        {
+            header += "element face " + std::to_string(triangleCount) + "\n";
+            header += "property list uchar int vertex_indices\n";
+        }
+        header += "end_header\n";
+
+        const size_t vertexSize = 3 * sizeof(float) + (normals ? 3 * sizeof(float) : 0) + (colors ? 3 : 0);
+        const size_t faceSize = 1 + 3 * sizeof(int32_t);
+        std::vector<uint8_t> buffer(header.size() + vertexSize * static_cast<size_t>(vertexCount) +
+                                    (triangles ? faceSize * static_cast<size_t>(triangleCount) : 0));
+
+        // Every platform the converter runs on is little endian, values are copied as is
+        uint8_t* out = buffer.data();
+        std::memcpy(out, header.data(), header.size());
+        out += header.size();
+        for (int64_t i = 0; i < vertexCount; ++i)
+        {
+            std::memcpy(out, points + 3 * i, 3 * sizeof(float));
+            out += 3 * sizeof(float);
+            if (normals)
+            {
+                std::memcpy(out, normals + 3 * i, 3 * sizeof(float));
+                out += 3 * sizeof(float);
+            }
+            if (colors)
+            {
+                std::memcpy(out, colors + 3 * i, 3);
+                out += 3;
+            }
+        }
+        for (int64_t i = 0; triangles && i < triangleCount; ++i)
+        {
+            *out++ = 3;
+            std::memcpy(out, triangles + 3 * i, 3 * sizeof(int32_t));
+            out += 3 * sizeof(int32_t);
+        }
+
+        FILE* file = std::fopen(path, "wb");
+        if (!file)
+        {
+            return false;
+        }
+        const bool written = std::fwrite(buffer.data(), 1, buffer.size(), file) == buffer.size();
+        return (std::fclose(file) == 0) && written;
+    }
+}
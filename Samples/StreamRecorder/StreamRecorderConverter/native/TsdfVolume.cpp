@@ -0,0 +1,775 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+#include "Kernels.h"
+#include "MarchingCubes.h"
+#include "MeshSimplify.h"
+#include "ParallelFor.h"
+#include "PlyWriter.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace
+{
+    constexpr int kBlockSide = 8;
+    constexpr int kBlockVoxels = kBlockSide * kBlockSide * kBlockSide;
+
+    // Block coordinates are packed in 21 bits per axis, as in VoxelGrid.cpp
+    constexpr int64_t kBlockBias = int64_t(1) << 20;
+    constexpr uint64_t kBlockMask = (uint64_t(1) << 21) - 1;
+
+    // Marching cubes vertices are identified by the voxel their edge starts
+    // from (20 bits per axis) and the axis of the edge
+    constexpr int64_t kVoxelBias = int64_t(1) << 19;
+    constexpr uint64_t kVoxelMask = (uint64_t(1) << 20) - 1;
+
+    inline uint64_t PackBlockKey(int64_t x, int64_t y, int64_t z)
+    {
+        return (static_cast<uint64_t>(x + kBlockBias) & kBlockMask) |
+               ((static_cast<uint64_t>(y + kBlockBias) & kBlockMask) << 21) |
+               ((static_cast<uint64_t>(z + kBlockBias) & kBlockMask) << 42);
+    }
+
+    inline std::array<int32_t, 3> UnpackBlockKey(uint64_t key)
+    {
+        return { static_cast<int32_t>(static_cast<int64_t>(key & kBlockMask) - kBlockBias),
+                 static_cast<int32_t>(static_cast<int64_t>((key >> 21) & kBlockMask) - kBlockBias),
+                 static_cast<int32_t>(static_cast<int64_t>((key >> 42) & kBlockMask) - kBlockBias) };
+    }
+
+    inline uint64_t PackEdgeKey(int64_t x, int64_t y, int64_t z, int axis)
+    {
+        return (static_cast<uint64_t>(x + kVoxelBias) & kVoxelMask) |
+               ((static_cast<uint64_t>(y + kVoxelBias) & kVoxelMask) << 20) |
+               ((static_cast<uint64_t>(z + kVoxelBias) & kVoxelMask) << 40) |
+               (static_cast<uint64_t>(axis) << 60);
+    }
+
+    inline std::array<int64_t, 3> UnpackEdgeStart(uint64_t key)
+    {
+        return { static_cast<int64_t>(key & kVoxelMask) - kVoxelBias,
+                 static_cast<int64_t>((key >> 20) & kVoxelMask) - kVoxelBias,
+                 static_cast<int64_t>((key >> 40) & kVoxelMask) - kVoxelBias };
+    }
+
+    inline int UnpackEdgeAxis(uint64_t key)
+    {
+        return static_cast<int>(key >> 60);
+    }
+
+    // Block of a voxel, rounding towards -infinity
+    inline int64_t VoxelToBlock(int64_t voxel)
+    {
+        return voxel >= 0 ? voxel / kBlockSide : -((-voxel + kBlockSide - 1) / kBlockSide);
+    }
+
+    inline int VoxelIndex(int x, int y, int z)
+    {
+        return x + kBlockSide * (y + kBlockSide * z);
+    }
+
+    // 8x8x8 voxels, allocated the first time a depth sample falls within
+    // truncation distance of them
+    struct Block
+    {
+        int32_t index;
+        std::array<int32_t, 3> coordinates;
+        float tsdf[kBlockVoxels];
+        float weight[kBlockVoxels];
+        float color[3 * kBlockVoxels];
+
+        // Mesh of the cubes whose first corner is in this block, rebuilt only
+        // when the block or one of its +x/+y/+z neighbors was integrated into
+        bool meshDirty = true;
+        std::vector<float> vertices;
+        std::vector<float> vertexNormals;
+        std::vector<float> vertexColors;
+        std::vector<uint64_t> edgeKeys;
+        std::vector<int32_t> triangles;
+
+        // (edge key, vertex) sorted by key, to find the vertices of a seam
+        std::vector<std::pair<uint64_t, int32_t>> sortedKeys;
+
+        // Index of every vertex in the joined mesh, filled while welding
+        std::vector<int32_t> meshIds;
+
+        int32_t FindVertex(uint64_t key) const
+        {
+            const auto found = std::lower_bound(sortedKeys.begin(), sortedKeys.end(), std::make_pair(key, int32_t(0)));
+            return (found != sortedKeys.end() && found->first == key) ? found->second : -1;
+        }
+    };
+
+    // The 27 blocks around (and including) a block, null when not allocated
+    struct Neighborhood
+    {
+        const Block* blocks[27];
+
+        // TSDF value of a voxel given in coordinates relative to the center
+        // block, in [-8, 16); false when the voxel was never observed
+        bool Sample(int x, int y, int z, float& value) const
+        {
+            const Block* block = BlockOf(x, y, z);
+            if (!block)
+            {
+                return false;
+            }
+            const int voxel = LocalIndex(x, y, z);
+            value = block->tsdf[voxel];
+            return block->weight[voxel] > 0.0f;
+        }
+
+        // Color of an observed voxel
+        const float* Color(int x, int y, int z) const
+        {
+            return &BlockOf(x, y, z)->color[3 * LocalIndex(x, y, z)];
+        }
+
+        const Block* BlockOf(int x, int y, int z) const
+        {
+            return blocks[((x + kBlockSide) >> 3) + 3 * ((y + kBlockSide) >> 3) + 9 * ((z + kBlockSide) >> 3)];
+        }
+
+        static int LocalIndex(int x, int y, int z)
+        {
+            return VoxelIndex(x & (kBlockSide - 1), y & (kBlockSide - 1), z & (kBlockSide - 1));
+        }
+
+        // TSDF gradient at an observed voxel, by central differences, one
+        // sided next to voxels that were never observed
+        void Gradient(int x, int y, int z, float gradient[3]) const
+        {
+            float center = 0.0f;
+            Sample(x, y, z, center);
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                const int dx = axis == 0 ? 1 : 0;
+                const int dy = axis == 1 ? 1 : 0;
+                const int dz = axis == 2 ? 1 : 0;
+                float plus = 0.0f;
+                float minus = 0.0f;
+                const bool hasPlus = Sample(x + dx, y + dy, z + dz, plus);
+                const bool hasMinus = Sample(x - dx, y - dy, z - dz, minus);
+                gradient[axis] = hasPlus && hasMinus ? 0.5f * (plus - minus)
+                                 : hasPlus          ? plus - center
+                                 : hasMinus         ? center - minus
+                                                    : 0.0f;
+            }
+        }
+    };
+
+    class TsdfVolume
+    {
+    public:
+        TsdfVolume(float voxelSize, float truncation, float maxWeight) :
+            m_voxelSize(voxelSize),
+            m_truncation(truncation),
+            m_maxWeight(maxWeight > 0.0f ? maxWeight : INFINITY)
+        {
+        }
+
+        void Integrate(
+            const uint16_t* depth,
+            const uint8_t* color,
+            int32_t width,
+            int32_t height,
+            float depthScale,
+            float depthMax,
+            const float* intrinsics,
+            const double* camToWorld,
+            bool colorIsBgr,
+            int32_t threadCount)
+        {
+            const std::vector<int32_t> blocks = AllocateBlocks(depth, width, height, depthScale, depthMax, intrinsics, camToWorld, threadCount);
+
+            // World to camera, the inverse of the rigid camToWorld transform
+            float worldToCam[12];
+            for (int row = 0; row < 3; ++row)
+            {
+                double translation = 0.0;
+                for (int column = 0; column < 3; ++column)
+                {
+                    worldToCam[4 * row + column] = static_cast<float>(camToWorld[4 * column + row]);
+                    translation -= camToWorld[4 * column + row] * camToWorld[4 * column + 3];
+                }
+                worldToCam[4 * row + 3] = static_cast<float>(translation);
+            }
+
+            const float fx = intrinsics[0];
+            const float fy = intrinsics[1];
+            const float cx = intrinsics[2];
+            const float cy = intrinsics[3];
+            const float inverseDepthScale = 1.0f / depthScale;
+            const float inverseTruncation = 1.0f / m_truncation;
+            const int red = colorIsBgr ? 2 : 0;
+            const int blue = colorIsBgr ? 0 : 2;
+
+            // Every block is updated by a single thread, there is no sharing
+            std::vector<uint8_t> updated(blocks.size(), 0);
+            Kernels::ParallelFor(static_cast<int64_t>(blocks.size()), threadCount, [&](int, int64_t begin, int64_t end)
+            {
+                for (int64_t b = begin; b < end; ++b)
+                {
+                    Block& block = *m_blocks[blocks[b]];
+                    for (int z = 0; z < kBlockSide; ++z)
+                    {
+                        for (int y = 0; y < kBlockSide; ++y)
+                        {
+                            for (int x = 0; x < kBlockSide; ++x)
+                            {
+                                const float world[3] = {
+                                    (block.coordinates[0] * kBlockSide + x + 0.5f) * m_voxelSize,
+                                    (block.coordinates[1] * kBlockSide + y + 0.5f) * m_voxelSize,
+                                    (block.coordinates[2] * kBlockSide + z + 0.5f) * m_voxelSize };
+                                float cam[3];
+                                for (int row = 0; row < 3; ++row)
+                                {
+                                    cam[row] = worldToCam[4 * row] * world[0] + worldToCam[4 * row + 1] * world[1] +
+                                               worldToCam[4 * row + 2] * world[2] + worldToCam[4 * row + 3];
+                                }
+                                if (cam[2] <= 0.0f)
+                                {
+                                    continue;
+                                }
+                                const int u = static_cast<int>(std::lround(fx * cam[0] / cam[2] + cx));
+                                const int v = static_cast<int>(std::lround(fy * cam[1] / cam[2] + cy));
+                                if (u < 0 || v < 0 || u >= width || v >= height)
+                                {
+                                    continue;
+                                }
+                                const int64_t pixel = static_cast<int64_t>(v) * width + u;
+                                const float d = depth[pixel] * inverseDepthScale;
+                                if (d <= 0.0f || d > depthMax)
+                                {
+                                    continue;
+                                }
+                                // Projective distance along the optical axis, positive in front of the surface
+                                const float sdf = d - cam[2];
+                                if (sdf < -m_truncation)
+                                {
+                                    continue;
+                                }
+
+                                const int voxel = VoxelIndex(x, y, z);
+                                const float tsdf = std::min(1.0f, sdf * inverseTruncation);
+                                const float weight = block.weight[voxel];
+                                const float inverseWeight = 1.0f / (weight + 1.0f);
+                                block.tsdf[voxel] = (block.tsdf[voxel] * weight + tsdf) * inverseWeight;
+                                if (color)
+                                {
+                                    const uint8_t* rgb = color + 3 * pixel;
+                                    float* voxelColor = &block.color[3 * voxel];
+                                    voxelColor[0] = (voxelColor[0] * weight + rgb[red]) * inverseWeight;
+                                    voxelColor[1] = (voxelColor[1] * weight + rgb[1]) * inverseWeight;
+                                    voxelColor[2] = (voxelColor[2] * weight + rgb[blue]) * inverseWeight;
+                                }
+                                block.weight[voxel] = std::min(weight + 1.0f, m_maxWeight);
+                                updated[b] = 1;
+                            }
+                        }
+                    }
+                }
+            });
+
+            // The cubes of the -x/-y/-z neighbors have corners in the updated blocks
+            for (size_t b = 0; b < blocks.size(); ++b)
+            {
+                if (!updated[b])
+                {
+                    continue;
+                }
+                const auto& coordinates = m_blocks[blocks[b]]->coordinates;
+                for (int neighbor = 0; neighbor < 8; ++neighbor)
+                {
+                    Block* block = FindBlock(
+                        coordinates[0] - (neighbor & 1),
+                        coordinates[1] - ((neighbor >> 1) & 1),
+                        coordinates[2] - ((neighbor >> 2) & 1));
+                    if (block)
+                    {
+                        block->meshDirty = true;
+                    }
+                }
+            }
+        }
+
+        int64_t BlockCount() const
+        {
+            return static_cast<int64_t>(m_blocks.size());
+        }
+
+        // Re-mesh the blocks integrated into since the previous extraction, in
+        // parallel, then join the block meshes, welding the vertices of the
+        // block seams, and simplify the result when a triangle budget is given
+        const Kernels::TriangleMesh& ExtractMesh(int64_t targetTriangleCount, int32_t threadCount)
+        {
+            std::vector<Block*> dirty;
+            for (auto& block : m_blocks)
+            {
+                if (block->meshDirty)
+                {
+                    dirty.push_back(block.get());
+                }
+            }
+            Kernels::ParallelFor(static_cast<int64_t>(dirty.size()), threadCount, [&](int, int64_t begin, int64_t end)
+            {
+                for (int64_t b = begin; b < end; ++b)
+                {
+                    MeshBlock(*dirty[b]);
+                }
+            });
+
+            WeldBlocks(threadCount);
+            if (targetTriangleCount > 0)
+            {
+                Kernels::SimplifyMesh(m_mesh, targetTriangleCount);
+            }
+            return m_mesh;
+        }
+
+        const Kernels::TriangleMesh& LastMesh() const
+        {
+            return m_mesh;
+        }
+
+    private:
+        // Blocks within truncation distance of the depth samples, created when
+        // missing. The keys are collected in parallel, the hash map is only
+        // updated by the calling thread.
+        std::vector<int32_t> AllocateBlocks(
+            const uint16_t* depth,
+            int32_t width,
+            int32_t height,
+            float depthScale,
+            float depthMax,
+            const float* intrinsics,
+            const double* camToWorld,
+            int32_t threadCount)
+        {
+            const int chunkCount = std::max(1, std::min(Kernels::ResolveThreadCount(threadCount), height));
+            std::vector<std::vector<uint64_t>> chunkKeys(static_cast<size_t>(chunkCount));
+
+            const float blockSize = kBlockSide * m_voxelSize;
+            const float inverseBlockSize = 1.0f / blockSize;
+            const float inverseDepthScale = 1.0f / depthScale;
+            float rotation[9];
+            float translation[3];
+            for (int row = 0; row < 3; ++row)
+            {
+                for (int column = 0; column < 3; ++column)
+                {
+                    rotation[3 * row + column] = static_cast<float>(camToWorld[4 * row + column]);
+                }
+                translation[row] = static_cast<float>(camToWorld[4 * row + 3]);
+            }
+
+            Kernels::ParallelFor(height, chunkCount, [&](int chunk, int64_t begin, int64_t end)
+            {
+                std::vector<uint64_t>& keys = chunkKeys[chunk];
+                for (int64_t v = begin; v < end; ++v)
+                {
+                    for (int32_t u = 0; u < width; ++u)
+                    {
+                        const float d = depth[v * width + u] * inverseDepthScale;
+                        if (d <= 0.0f || d > depthMax)
+                        {
+                            continue;
+                        }
+                        const float ray[3] = { (u - intrinsics[2]) / intrinsics[0], (v - intrinsics[3]) / intrinsics[1], 1.0f };
+                        float worldRay[3];
+                        for (int row = 0; row < 3; ++row)
+                        {
+                            worldRay[row] = rotation[3 * row] * ray[0] + rotation[3 * row + 1] * ray[1] + rotation[3 * row + 2] * ray[2];
+                        }
+
+                        // Walk the truncation band around the sample in half block steps
+                        const float nearDepth = std::max(0.0f, d - m_truncation);
+                        const float farDepth = d + m_truncation;
+                        const float rayLength = std::sqrt(worldRay[0] * worldRay[0] + worldRay[1] * worldRay[1] + worldRay[2] * worldRay[2]);
+                        const int steps = static_cast<int>(std::ceil((farDepth - nearDepth) * rayLength / (0.5f * blockSize)));
+                        uint64_t previous = ~uint64_t(0);
+                        for (int step = 0; step <= steps; ++step)
+                        {
+                            const float z = nearDepth + (farDepth - nearDepth) * step / std::max(1, steps);
+                            const uint64_t key = PackBlockKey(
+                                static_cast<int64_t>(std::floor((translation[0] + worldRay[0] * z) * inverseBlockSize)),
+                                static_cast<int64_t>(std::floor((translation[1] + worldRay[1] * z) * inverseBlockSize)),
+                                static_cast<int64_t>(std::floor((translation[2] + worldRay[2] * z) * inverseBlockSize)));
+                            if (key != previous)
+                            {
+                                keys.push_back(key);
+                                previous = key;
+                            }
+                        }
+                    }
+                }
+                std::sort(keys.begin(), keys.end());
+                keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+            });
+
+            std::vector<uint64_t> keys;
+            for (const auto& chunk : chunkKeys)
+            {
+                keys.insert(keys.end(), chunk.begin(), chunk.end());
+            }
+            std::sort(keys.begin(), keys.end());
+            keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+            std::vector<int32_t> blocks;
+            blocks.reserve(keys.size());
+            for (uint64_t key : keys)
+            {
+                const auto inserted = m_blockIndex.emplace(key, static_cast<int32_t>(m_blocks.size()));
+                if (inserted.second)
+                {
+                    auto block = std::make_unique<Block>();
+                    block->index = static_cast<int32_t>(m_blocks.size());
+                    block->coordinates = UnpackBlockKey(key);
+                    std::fill(std::begin(block->tsdf), std::end(block->tsdf), 1.0f);
+                    std::fill(std::begin(block->weight), std::end(block->weight), 0.0f);
+                    std::fill(std::begin(block->color), std::end(block->color), 0.0f);
+                    m_blocks.push_back(std::move(block));
+                }
+                blocks.push_back(inserted.first->second);
+            }
+            return blocks;
+        }
+
+        Block* FindBlock(int64_t x, int64_t y, int64_t z) const
+        {
+            const auto found = m_blockIndex.find(PackBlockKey(x, y, z));
+            return found == m_blockIndex.end() ? nullptr : m_blocks[found->second].get();
+        }
+
+        // A vertex on a block seam is produced by every block with a cube
+        // along its edge; it is kept by the one with the lowest index
+        const Block* SeamOwner(const Block& block, uint64_t key) const
+        {
+            const std::array<int64_t, 3> start = UnpackEdgeStart(key);
+            const int axis = UnpackEdgeAxis(key);
+            bool interior = true;
+            for (int a = 0; a < 3; ++a)
+            {
+                const int64_t local = start[a] - static_cast<int64_t>(block.coordinates[a]) * kBlockSide;
+                interior = interior && local < kBlockSide && (local > 0 || (a == axis && local == 0));
+            }
+            if (interior)
+            {
+                return &block;
+            }
+
+            const Block* owner = &block;
+            for (int offset = 0; offset < 8; ++offset)
+            {
+                // The cubes along the edge start at 'start' minus 0 or 1 on
+                // the two other axes
+                if ((offset >> axis) & 1)
+                {
+                    continue;
+                }
+                const Block* candidate = FindBlock(
+                    VoxelToBlock(start[0] - (offset & 1)),
+                    VoxelToBlock(start[1] - ((offset >> 1) & 1)),
+                    VoxelToBlock(start[2] - ((offset >> 2) & 1)));
+                if (candidate && candidate->index < owner->index && candidate->FindVertex(key) >= 0)
+                {
+                    owner = candidate;
+                }
+            }
+            return owner;
+        }
+
+        // Join the cached block meshes in three parallel passes: count the
+        // vertices every block owns, copy them to their place in the mesh,
+        // then resolve the seam vertices and copy the triangles
+        void WeldBlocks(int32_t threadCount)
+        {
+            const int64_t blockCount = static_cast<int64_t>(m_blocks.size());
+            std::vector<int64_t> vertexOffsets(blockCount + 1, 0);
+            std::vector<int64_t> triangleOffsets(blockCount + 1, 0);
+
+            Kernels::ParallelFor(blockCount, threadCount, [&](int, int64_t begin, int64_t end)
+            {
+                for (int64_t b = begin; b < end; ++b)
+                {
+                    Block& block = *m_blocks[b];
+                    block.meshIds.assign(block.edgeKeys.size(), -1);
+                    int32_t owned = 0;
+                    for (size_t i = 0; i < block.edgeKeys.size(); ++i)
+                    {
+                        if (SeamOwner(block, block.edgeKeys[i]) == &block)
+                        {
+                            block.meshIds[i] = owned++;
+                        }
+                    }
+                    vertexOffsets[b + 1] = owned;
+                    triangleOffsets[b + 1] = static_cast<int64_t>(block.triangles.size());
+                }
+            });
+            for (int64_t b = 0; b < blockCount; ++b)
+            {
+                vertexOffsets[b + 1] += vertexOffsets[b];
+                triangleOffsets[b + 1] += triangleOffsets[b];
+            }
+
+            const size_t vertexCount = static_cast<size_t>(vertexOffsets[blockCount]);
+            m_mesh.vertices.resize(3 * vertexCount);
+            m_mesh.normals.resize(3 * vertexCount);
+            m_mesh.colors.resize(3 * vertexCount);
+            m_mesh.triangles.resize(static_cast<size_t>(triangleOffsets[blockCount]));
+
+            Kernels::ParallelFor(blockCount, threadCount, [&](int, int64_t begin, int64_t end)
+            {
+                for (int64_t b = begin; b < end; ++b)
+                {
+                    Block& block = *m_blocks[b];
+                    for (size_t i = 0; i < block.meshIds.size(); ++i)
+                    {
+                        if (block.meshIds[i] < 0)
+                        {
+                            continue;
+                        }
+                        block.meshIds[i] += static_cast<int32_t>(vertexOffsets[b]);
+                        const size_t target = 3 * static_cast<size_t>(block.meshIds[i]);
+                        for (int k = 0; k < 3; ++k)
+                        {
+                            m_mesh.vertices[target + k] = block.vertices[3 * i + k];
+                            m_mesh.normals[target + k] = block.vertexNormals[3 * i + k];
+                            const float value = std::round(block.vertexColors[3 * i + k]);
+                            m_mesh.colors[target + k] = static_cast<uint8_t>(std::min(255.0f, std::max(0.0f, value)));
+                        }
+                    }
+                }
+            });
+
+            Kernels::ParallelFor(blockCount, threadCount, [&](int, int64_t begin, int64_t end)
+            {
+                for (int64_t b = begin; b < end; ++b)
+                {
+                    Block& block = *m_blocks[b];
+                    for (size_t i = 0; i < block.meshIds.size(); ++i)
+                    {
+                        if (block.meshIds[i] < 0)
+                        {
+                            const Block* owner = SeamOwner(block, block.edgeKeys[i]);
+                            block.meshIds[i] = owner->meshIds[owner->FindVertex(block.edgeKeys[i])];
+                        }
+                    }
+                    int32_t* triangles = &m_mesh.triangles[static_cast<size_t>(triangleOffsets[b])];
+                    for (size_t t = 0; t < block.triangles.size(); ++t)
+                    {
+                        triangles[t] = block.meshIds[block.triangles[t]];
+                    }
+                }
+            });
+        }
+
+        // Marching cubes over the cubes whose first corner is in the block;
+        // corners in the +x/+y/+z neighbors are read from them, cubes with a
+        // corner that was never observed are skipped. Only the block itself
+        // is written, so blocks can be meshed in parallel.
+        void MeshBlock(Block& block) const
+        {
+            Neighborhood neighborhood;
+            for (int neighbor = 0; neighbor < 27; ++neighbor)
+            {
+                neighborhood.blocks[neighbor] = FindBlock(
+                    block.coordinates[0] + neighbor % 3 - 1,
+                    block.coordinates[1] + (neighbor / 3) % 3 - 1,
+                    block.coordinates[2] + neighbor / 9 - 1);
+            }
+
+            block.vertices.clear();
+            block.vertexNormals.clear();
+            block.vertexColors.clear();
+            block.edgeKeys.clear();
+            block.triangles.clear();
+            std::unordered_map<uint64_t, int32_t> vertexIds;
+
+            const int64_t originX = static_cast<int64_t>(block.coordinates[0]) * kBlockSide;
+            const int64_t originY = static_cast<int64_t>(block.coordinates[1]) * kBlockSide;
+            const int64_t originZ = static_cast<int64_t>(block.coordinates[2]) * kBlockSide;
+
+            for (int z = 0; z < kBlockSide; ++z)
+            {
+                for (int y = 0; y < kBlockSide; ++y)
+                {
+                    for (int x = 0; x < kBlockSide; ++x)
+                    {
+                        float values[8] = {};
+                        int configuration = 0;
+                        bool observed = true;
+                        for (int corner = 0; corner < 8 && observed; ++corner)
+                        {
+                            observed = neighborhood.Sample(x + (corner & 1), y + ((corner >> 1) & 1), z + ((corner >> 2) & 1), values[corner]);
+                            if (values[corner] < 0.0f)
+                            {
+                                configuration |= 1 << corner;
+                            }
+                        }
+
+                        const std::vector<int8_t>& cubeTriangles = Kernels::MarchingCubesTriangles(configuration);
+                        if (!observed || cubeTriangles.empty())
+                        {
+                            continue;
+                        }
+
+                        for (int8_t edge : cubeTriangles)
+                        {
+                            const int start = Kernels::EdgeStart(edge);
+                            const int axis = Kernels::EdgeAxis(edge);
+                            const int end = start | (1 << axis);
+                            const int lx = x + (start & 1);
+                            const int ly = y + ((start >> 1) & 1);
+                            const int lz = z + ((start >> 2) & 1);
+                            const uint64_t key = PackEdgeKey(originX + lx, originY + ly, originZ + lz, axis);
+
+                            const auto inserted = vertexIds.emplace(key, static_cast<int32_t>(block.edgeKeys.size()));
+                            block.triangles.push_back(inserted.first->second);
+                            if (!inserted.second)
+                            {
+                                continue;
+                            }
+
+                            const float t = values[start] / (values[start] - values[end]);
+                            const int64_t voxel[3] = { originX + lx, originY + ly, originZ + lz };
+                            for (int a = 0; a < 3; ++a)
+                            {
+                                block.vertices.push_back((voxel[a] + 0.5f + (a == axis ? t : 0.0f)) * m_voxelSize);
+                            }
+
+                            // The TSDF grows towards the outside, its gradient is the normal
+                            float g0[3];
+                            float g1[3];
+                            neighborhood.Gradient(lx, ly, lz, g0);
+                            neighborhood.Gradient(lx + (axis == 0), ly + (axis == 1), lz + (axis == 2), g1);
+                            float normal[3];
+                            for (int a = 0; a < 3; ++a)
+                            {
+                                normal[a] = g0[a] + t * (g1[a] - g0[a]);
+                            }
+                            const float length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+                            const float inverseLength = length > 0.0f ? 1.0f / length : 0.0f;
+                            for (int a = 0; a < 3; ++a)
+                            {
+                                block.vertexNormals.push_back(normal[a] * inverseLength);
+                            }
+
+                            const float* c0 = neighborhood.Color(lx, ly, lz);
+                            const float* c1 = neighborhood.Color(lx + (axis == 0), ly + (axis == 1), lz + (axis == 2));
+                            for (int channel = 0; channel < 3; ++channel)
+                            {
+                                block.vertexColors.push_back(c0[channel] + t * (c1[channel] - c0[channel]));
+                            }
+                            block.edgeKeys.push_back(key);
+                        }
+                    }
+                }
+            }
+
+            block.sortedKeys.resize(block.edgeKeys.size());
+            for (size_t i = 0; i < block.edgeKeys.size(); ++i)
+            {
+                block.sortedKeys[i] = { block.edgeKeys[i], static_cast<int32_t>(i) };
+            }
+            std::sort(block.sortedKeys.begin(), block.sortedKeys.end());
+            block.meshDirty = false;
+        }
+
+        float m_voxelSize;
+        float m_truncation;
+        float m_maxWeight;
+
+        std::unordered_map<uint64_t, int32_t> m_blockIndex;
+        std::vector<std::unique_ptr<Block>> m_blocks;
+        Kernels::TriangleMesh m_mesh;
+    };
+}
+
+KERNELS_API void* TsdfVolumeCreate(float voxelSize, float truncation, float maxWeight)
+{
+    return new TsdfVolume(voxelSize, truncation, maxWeight);
+}
+
+KERNELS_API void TsdfVolumeIntegrate(
+    void* volume,
+    const uint16_t* depth,
+    const uint8_t* color,
+    int32_t width,
+    int32_t height,
+    float depthScale,
+    float depthMax,
+    const float* intrinsics,
+    const double* camToWorld,
+    int32_t colorIsBgr,
+    int32_t threadCount)
+{
+    static_cast<TsdfVolume*>(volume)->Integrate(
+        depth, color, width, height, depthScale, depthMax, intrinsics, camToWorld, colorIsBgr != 0, threadCount);
+}
+
+KERNELS_API int64_t TsdfVolumeBlockCount(const void* volume)
+{
+    return static_cast<const TsdfVolume*>(volume)->BlockCount();
+}
+
+KERNELS_API int64_t TsdfVolumeExtractMesh(void* volume, int64_t targetTriangleCount, int32_t threadCount, int64_t* outTriangleCount)
+{
+    const Kernels::TriangleMesh& mesh = static_cast<TsdfVolume*>(volume)->ExtractMesh(targetTriangleCount, threadCount);
+    *outTriangleCount = static_cast<int64_t>(mesh.triangles.size() / 3);
+    return static_cast<int64_t>(mesh.vertices.size() / 3);
+}
+
+KERNELS_API void TsdfVolumeGetMesh(
+    const void* volume,
+    float* outVertices,
+    float* outNormals,
+    uint8_t* outColors,
+    int32_t* outTriangles)
+{
+    const Kernels::TriangleMesh& mesh = static_cast<const TsdfVolume*>(volume)->LastMesh();
+    std::memcpy(outVertices, mesh.vertices.data(), mesh.vertices.size() * sizeof(float));
+    if (outNormals)
+    {
+        std::memcpy(outNormals, mesh.normals.data(), mesh.normals.size() * sizeof(float));
+    }
+    if (outColors)
+    {
+        std::memcpy(outColors, mesh.colors.data(), mesh.colors.size());
+    }
+    if (outTriangles)
+    {
+        std::memcpy(outTriangles, mesh.triangles.data(), mesh.triangles.size() * sizeof(int32_t));
+    }
+}
+
+KERNELS_API int32_t TsdfVolumeWriteMesh(const void* volume, const char* path, int32_t withTriangles)
+{
+    const Kernels::TriangleMesh& mesh = static_cast<const TsdfVolume*>(volume)->LastMesh();
+    const bool written = Kernels::WriteBinaryPly(
+        path, mesh.vertices.data(), mesh.normals.data(), mesh.colors.data(),
+        static_cast<int64_t>(mesh.vertices.size() / 3),
+        withTriangles ? mesh.triangles.data() : nullptr,
+        withTriangles ? static_cast<int64_t>(mesh.triangles.size() / 3) : 0);
+    return written ? 0 : -1;
+}
+
+KERNELS_API void TsdfVolumeDestroy(void* volume)
+{
+    delete static_cast<TsdfVolume*>(volume);
+}
@@ -0,0 +1,223 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+#include "Kernels.h"
+
+#include <cmath>
+#include <vector>
+
+namespace
+{
+    // Voxel coordinates are packed in 21 bits per axis, i.e. +-1M voxels
+    // (+-10km with 1cm voxels) around the world origin
+    constexpr int64_t kCoordinateBias = int64_t(1) << 20;
+    constexpr uint64_t kCoordinateMask = (uint64_t(1) << 21) - 1;
+    constexpr uint64_t kEmptyKey = ~uint64_t(0);
+
+    inline uint64_t PackKey(int64_t x, int64_t y, int64_t z)
+    {
+        return (static_cast<uint64_t>(x + kCoordinateBias) & kCoordinateMask) |
+               ((static_cast<uint64_t>(y + kCoordinateBias) & kCoordinateMask) << 21) |
+               ((static_cast<uint64_t>(z + kCoordinateBias) & kCoordinateMask) << 42);
+    }
+
+    inline uint64_t HashKey(uint64_t key)
+    {
+        // splitmix64 finalizer
+        key ^= key >> 30;
+        key *= 0xbf58476d1ce4e5b9ull;
+        key ^= key >> 27;
+        key *= 0x94d049bb133111ebull;
+        return key ^ (key >> 31);
+    }
+
+    // Running sums of the points that fell in every occupied voxel. Memory is
+    // proportional to the number of occupied voxels, i.e. to the scene size,
+    // however many frames are added.
+    class VoxelGrid
+    {
+    public:
+        VoxelGrid(float voxelSize, bool hasColors, bool hasNormals) :
+            m_inverseVoxelSize(1.0 / voxelSize),
+            m_hasColors(hasColors),
+            m_hasNormals(hasNormals)
+        {
+            Rehash(1 << 16);
+        }
+
+        void Add(const float* points, const float* colors, const float* normals, int64_t count)
+        {
+            for (int64_t i = 0; i < count; ++i)
+            {
+                const float* p = points + 3 * i;
+                if (!std::isfinite(p[0]) || !std::isfinite(p[1]) || !std::isfinite(p[2]))
+                {
+                    continue;
+                }
+                const uint64_t key = PackKey(
+                    static_cast<int64_t>(std::floor(p[0] * m_inverseVoxelSize)),
+                    static_cast<int64_t>(std::floor(p[1] * m_inverseVoxelSize)),
+                    static_cast<int64_t>(std::floor(p[2] * m_inverseVoxelSize)));
+                const size_t voxel = FindOrInsert(key);
+
+                m_counts[voxel] += 1;
+                for (int axis = 0; axis < 3; ++axis)
+                {
+                    m_points[3 * voxel + axis] += p[axis];
+                }
+                if (m_hasColors && colors)
+                {
+                    for (int channel = 0; channel < 3; ++channel)
+                    {
+                        m_colors[3 * voxel + channel] += colors[3 * i + channel];
+                    }
+                }
+                if (m_hasNormals && normals)
+                {
+                    for (int axis = 0; axis < 3; ++axis)
+                    {
+                        m_normals[3 * voxel + axis] += normals[3 * i + axis];
+                    }
+                }
+            }
+        }
+
+        int64_t Size() const
+        {
+            return static_cast<int64_t>(m_counts.size());
+        }
+
+        // Average position, color and (renormalized) normal of every voxel
+        void Extract(float* outPoints, float* outColors, float* outNormals) const
+        {
+            for (size_t voxel = 0; voxel < m_counts.size(); ++voxel)
+            {
+                const double scale = 1.0 / m_counts[voxel];
+                for (int axis = 0; axis < 3; ++axis)
+                {
+                    outPoints[3 * voxel + axis] = static_cast<float>(m_points[3 * voxel + axis] * scale);
+                }
+                if (m_hasColors && outColors)
+                {
+                    for (int channel = 0; channel < 3; ++channel)
+                    {
+                        outColors[3 * voxel + channel] = static_cast<float>(m_colors[3 * voxel + channel] * scale);
+                    }
+                }
+                if (m_hasNormals && outNormals)
+                {
+                    const float* n = &m_normals[3 * voxel];
+                    const float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+                    const float inverseLength = length > 0.0f ? 1.0f / length : 0.0f;
+                    for (int axis = 0; axis < 3; ++axis)
+                    {
+                        outNormals[3 * voxel + axis] = n[axis] * inverseLength;
+                    }
+                }
+            }
+        }
+
+    private:
+        // Linear probing in a power of two table, kept at most half full
+        size_t FindOrInsert(uint64_t key)
+        {
+            size_t slot = HashKey(key) & (m_keys.size() - 1);
+            while (m_keys[slot] != kEmptyKey)
+            {
+                if (m_keys[slot] == key)
+                {
+                    return m_slots[slot];
+                }
+                slot = (slot + 1) & (m_keys.size() - 1);
+            }
+
+            const size_t voxel = m_counts.size();
+            m_keys[slot] = key;
+            m_slots[slot] = voxel;
+            m_counts.push_back(0);
+            m_points.insert(m_points.end(), 3, 0.0);
+            if (m_hasColors)
+            {
+                m_colors.insert(m_colors.end(), 3, 0.0f);
+            }
+            if (m_hasNormals)
+            {
+                m_normals.insert(m_normals.end(), 3, 0.0f);
+            }
+            if (2 * m_counts.size() > m_keys.size())
+            {
+                Rehash(2 * m_keys.size());
+            }
+            return voxel;
+        }
+
+        void Rehash(size_t capacity)
+        {
+            std::vector<uint64_t> keys(capacity, kEmptyKey);
+            std::vector<size_t> slots(capacity, 0);
+            for (size_t old = 0; old < m_keys.size(); ++old)
+            {
+                if (m_keys[old] == kEmptyKey)
+                {
+                    continue;
+                }
+                size_t slot = HashKey(m_keys[old]) & (capacity - 1);
+                while (keys[slot] != kEmptyKey)
+                {
+                    slot = (slot + 1) & (capacity - 1);
+                }
+                keys[slot] = m_keys[old];
+                slots[slot] = m_slots[old];
+            }
+            m_keys.swap(keys);
+            m_slots.swap(slots);
+        }
+
+        double m_inverseVoxelSize;
+        bool m_hasColors;
+        bool m_hasNormals;
+
+        std::vector<uint64_t> m_keys;
+        std::vector<size_t> m_slots;
+
+        // Per voxel sums, in insertion order; positions are summed in double
+        // so that large world coordinates do not lose precision
+        std::vector<uint32_t> m_counts;
+        std::vector<double> m_points;
+        std::vector<float> m_colors;
+        std::vector<float> m_normals;
+    };
+}
+
+KERNELS_API void* VoxelGridCreate(float voxelSize, int32_t hasColors, int32_t hasNormals)
+{
+    return new VoxelGrid(voxelSize, hasColors != 0, hasNormals != 0);
+}
+
+KERNELS_API void VoxelGridAdd(void* grid, const float* points, const float* colors, const float* normals, int64_t pointCount)
+{
+    static_cast<VoxelGrid*>(grid)->Add(points, colors, normals, pointCount);
+}
+
+KERNELS_API int64_t VoxelGridSize(const void* grid)
+{
+    return static_cast<const VoxelGrid*>(grid)->Size();
+}
+
+KERNELS_API void VoxelGridExtract(const void* grid, float* outPoints, float* outColors, float* outNormals)
+{
+    static_cast<const VoxelGrid*>(grid)->Extract(outPoints, outColors, outNormals);
+}
+
+KERNELS_API void VoxelGridDestroy(void* grid)
+{
+    delete static_cast<VoxelGrid*>(grid);
+}
@@ -0,0 +1,25 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+#include "Kernels.h"
+#include "PlyWriter.h"
+
+KERNELS_API int32_t WritePly(
+    const char* path,
+    const float* points,
+    const float* normals,
+    const uint8_t* colors,
+    int64_t pointCount,
+    const int32_t* triangles,
+    int64_t triangleCount)
+{
+    return Kernels::WriteBinaryPly(path, points, normals, colors, pointCount, triangles, triangleCount) ? 0 : -1;
+}
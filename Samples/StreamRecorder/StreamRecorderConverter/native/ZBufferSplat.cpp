@@ -0,0 +1,43 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+#include "Kernels.h"
+
+#include <algorithm>
+
+KERNELS_API void ZBufferSplat(
+    const int64_t* pixelIds,
+    const float* depths,
+    int64_t pointCount,
+    int64_t pixelCount,
+    float* outDepth,
+    int32_t* outWinners)
+{
+    std::fill(outDepth, outDepth + pixelCount, 0.0f);
+    std::fill(outWinners, outWinners + pixelCount, -1);
+
+    // Single pass over the points; the image is small enough to stay in cache,
+    // so scattering is cheaper than sorting points by pixel
+    for (int64_t i = 0; i < pointCount; ++i)
+    {
+        const int64_t pixel = pixelIds[i];
+        const float z = depths[i];
+        if (pixel < 0 || pixel >= pixelCount || !(z > 0.0f))
+        {
+            continue;
+        }
+        if (outWinners[pixel] < 0 || z < outDepth[pixel])
+        {
+            outDepth[pixel] = z;
+            outWinners[pixel] = static_cast<int32_t>(i);
+        }
+    }
+}
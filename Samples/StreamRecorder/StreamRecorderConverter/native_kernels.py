@@ -0,0 +1,500 @@
+"""
+ Copyright (c) Microsoft. All rights reserved.
+ This code is licensed under the MIT License (MIT).
+ THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+ ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+ IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+ PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+"""
+import os
+import sys
+import ctypes
+from pathlib import Path
+
+import numpy as np
+
+# The native kernels are built from the 'native' folder with cmake:
+#   cmake -S native -B native/build && cmake --build native/build --config Release
+# Set CONVERTER_KERNELS_PATH to use a library built somewhere else.
+# When the library cannot be found every function falls back to numpy.
+KERNELS_PATH_VARIABLE = 'CONVERTER_KERNELS_PATH'
+
+
+def _library_candidates():
+    if os.environ.get(KERNELS_PATH_VARIABLE):
+        yield Path(os.environ[KERNELS_PATH_VARIABLE])
+    if sys.platform == 'win32':
+        names = ['converter_kernels.dll']
+    elif sys.platform == 'darwin':
+        names = ['libconverter_kernels.dylib']
+    else:
+        names = ['libconverter_kernels.so']
+    build_dir = Path(__file__).resolve().parent / 'native' / 'build'
+    for sub_dir in ['', 'Release', 'RelWithDebInfo', 'Debug']:
+        for name in names:
+            yield build_dir / sub_dir / name
+
+
+def _load_library():
+    for candidate in _library_candidates():
+        if candidate.exists():
+            try:
+                return ctypes.CDLL(str(candidate))
+            except OSError:
+                continue
+    return None
+
+
+def _pointer(ndim, dtype):
+    return np.ctypeslib.ndpointer(dtype=dtype, ndim=ndim, flags='C_CONTIGUOUS')
+
+
+def _optional(array, dtype):
+    # ctypes accepts None for null pointers, numpy arrays otherwise
+    if array is None:
+        return None
+    assert array.dtype == dtype and array.flags['C_CONTIGUOUS']
+    return array.ctypes.data_as(ctypes.c_void_p)
+
+
+_lib = _load_library()
+if _lib is not None:
+    _lib.DepthToPoints.restype = ctypes.c_int64
+    _lib.DepthToPoints.argtypes = [
+        _pointer(1, np.uint16), _pointer(2, np.float32), ctypes.c_int64,
+        ctypes.c_float, ctypes.c_float, ctypes.c_void_p,
+        ctypes.c_void_p, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_int32]
+    _lib.ZBufferSplat.restype = None
+    _lib.ZBufferSplat.argtypes = [
+        _pointer(1, np.int64), _pointer(1, np.float32), ctypes.c_int64, ctypes.c_int64,
+        _pointer(1, np.float32), _pointer(1, np.int32)]
+    _lib.OrganizedNormals.restype = None
+    _lib.OrganizedNormals.argtypes = [
+        _pointer(1, np.uint16), _pointer(2, np.float32), ctypes.c_int32, ctypes.c_int32,
+        ctypes.c_float, ctypes.c_float, ctypes.c_float,
+        _pointer(1, np.int32), ctypes.c_int64, ctypes.c_void_p,
+        _pointer(2, np.float32), ctypes.c_int32]
+    _lib.VoxelGridCreate.restype = ctypes.c_void_p
+    _lib.VoxelGridCreate.argtypes = [ctypes.c_float, ctypes.c_int32, ctypes.c_int32]
+    _lib.VoxelGridAdd.restype = None
+    _lib.VoxelGridAdd.argtypes = [
+        ctypes.c_void_p, _pointer(2, np.float32), ctypes.c_void_p, ctypes.c_void_p, ctypes.c_int64]
+    _lib.VoxelGridSize.restype = ctypes.c_int64
+    _lib.VoxelGridSize.argtypes = [ctypes.c_void_p]
+    _lib.VoxelGridExtract.restype = None
+    _lib.VoxelGridExtract.argtypes = [
+        ctypes.c_void_p, _pointer(2, np.float32), ctypes.c_void_p, ctypes.c_void_p]
+    _lib.VoxelGridDestroy.restype = None
+    _lib.VoxelGridDestroy.argtypes = [ctypes.c_void_p]
+    _lib.WritePly.restype = ctypes.c_int32
+    _lib.WritePly.argtypes = [
+        ctypes.c_char_p, _pointer(2, np.float32), ctypes.c_void_p, ctypes.c_void_p, ctypes.c_int64,
+        ctypes.c_void_p, ctypes.c_int64]
+    _lib.TsdfVolumeCreate.restype = ctypes.c_void_p
+    _lib.TsdfVolumeCreate.argtypes = [ctypes.c_float, ctypes.c_float, ctypes.c_float]
+    _lib.TsdfVolumeIntegrate.restype = None
+    _lib.TsdfVolumeIntegrate.argtypes = [
+        ctypes.c_void_p, _pointer(2, np.uint16), ctypes.c_void_p, ctypes.c_int32, ctypes.c_int32,
+        ctypes.c_float, ctypes.c_float, _pointer(1, np.float32), _pointer(2, np.float64),
+        ctypes.c_int32, ctypes.c_int32]
+    _lib.TsdfVolumeBlockCount.restype = ctypes.c_int64
+    _lib.TsdfVolumeBlockCount.argtypes = [ctypes.c_void_p]
+    _lib.TsdfVolumeExtractMesh.restype = ctypes.c_int64
+    _lib.TsdfVolumeExtractMesh.argtypes = [
+        ctypes.c_void_p, ctypes.c_int64, ctypes.c_int32, ctypes.POINTER(ctypes.c_int64)]
+    _lib.TsdfVolumeGetMesh.restype = None
+    _lib.TsdfVolumeGetMesh.argtypes = [
+        ctypes.c_void_p, _pointer(2, np.float32), _pointer(2, np.float32), _pointer(2, np.uint8),
+        _pointer(2, np.int32)]
+    _lib.TsdfVolumeWriteMesh.restype = ctypes.c_int32
+    _lib.TsdfVolumeWriteMesh.argtypes = [ctypes.c_void_p, ctypes.c_char_p, ctypes.c_int32]
+    _lib.TsdfVolumeDestroy.restype = None
+    _lib.TsdfVolumeDestroy.argtypes = [ctypes.c_void_p]
+
+
+def has_native_kernels():
+    return _lib is not None
+
+
+def allocate_point_buffers(pixel_count, world=True, pixel_ids=False):
+    """Preallocated output buffers for depth_to_points, reusable across frames."""
+    buffers = {'cam': np.empty((pixel_count, 3), dtype=np.float32)}
+    if world:
+        buffers['world'] = np.empty((pixel_count, 3), dtype=np.float32)
+    if pixel_ids:
+        buffers['pixel_ids'] = np.empty(pixel_count, dtype=np.int32)
+    return buffers
+
+
+def depth_to_points(depth, lut, clamp_min=0., clamp_max=0., cam2world=None,
+                    buffers=None, num_threads=0, use_native=True):
+    """Depth image (mm) to point cloud in meters, in a single pass.
+
+    Pixels with zero depth, a zero LUT ray or depth outside [clamp_min, clamp_max]
+    (in meters, a bound of 0 is unused) are dropped. Returns a dict with the
+    'cam' points, the 'world' points when cam2world is given and the source
+    'pixel_ids' when requested in buffers; values are views into buffers.
+    """
+    depth = np.ascontiguousarray(depth, dtype=np.uint16).reshape(-1)
+    lut = np.ascontiguousarray(lut, dtype=np.float32).reshape((-1, 3))
+    pixel_count = len(depth)
+    assert len(lut) == pixel_count
+    if buffers is None:
+        buffers = allocate_point_buffers(pixel_count, world=cam2world is not None)
+
+    if use_native and _lib is not None:
+        transform = None
+        if cam2world is not None:
+            transform = np.ascontiguousarray(cam2world, dtype=np.float64).reshape(16)
+        count = _lib.DepthToPoints(
+            depth, lut, pixel_count, clamp_min, clamp_max,
+            _optional(transform, np.float64),
+            _optional(buffers.get('cam'), np.float32),
+            _optional(buffers.get('world'), np.float32) if transform is not None else None,
+            _optional(buffers.get('pixel_ids'), np.int32),
+            num_threads)
+        return {key: value[:count] for key, value in buffers.items()
+                if key != 'world' or cam2world is not None}
+
+    # numpy fallback, same semantics as the native kernel
+    depth_mm = depth.astype(np.float32)
+    valid = depth_mm > 0
+    if clamp_min > 0:
+        valid &= depth_mm >= clamp_min * 1000.
+    if clamp_max > 0:
+        valid &= depth_mm <= clamp_max * 1000.
+    valid &= np.sum(lut**2, axis=1) * depth_mm**2 >= 1e-12
+    pixel_ids = np.flatnonzero(valid)
+    count = len(pixel_ids)
+    cam = buffers['cam'][:count]
+    np.multiply(lut[pixel_ids], (depth_mm[pixel_ids] / 1000.).reshape((-1, 1)), out=cam)
+    result = {'cam': cam}
+    if cam2world is not None and 'world' in buffers:
+        cam2world = np.asarray(cam2world, dtype=np.float32)
+        world = buffers['world'][:count]
+        np.matmul(cam, cam2world[:3, :3].T, out=world)
+        world += cam2world[:3, 3]
+        result['world'] = world
+    if 'pixel_ids' in buffers:
+        buffers['pixel_ids'][:count] = pixel_ids
+        result['pixel_ids'] = buffers['pixel_ids'][:count]
+    return result
+
+
+def organized_normals(depth, lut, pixel_ids, clamp_min=0., clamp_max=0., cam2world=None,
+                      max_depth_jump=0.05, out=None, num_threads=0, use_native=True):
+    """Normals of the points returned by depth_to_points, from the depth image grid.
+
+    Tangents are the differences between the neighbors of every pixel along
+    its row and column (one sided where a neighbor is missing or its depth
+    differs by more than max_depth_jump * depth), their cross product is
+    oriented towards the camera. depth is the height x width image, pixel_ids
+    and the clamp bounds are those used by depth_to_points. Normals are rotated
+    to world space when cam2world is given.
+    """
+    height, width = depth.shape
+    depth = np.ascontiguousarray(depth, dtype=np.uint16).reshape(-1)
+    lut = np.ascontiguousarray(lut, dtype=np.float32).reshape((-1, 3))
+    pixel_ids = np.ascontiguousarray(pixel_ids, dtype=np.int32).reshape(-1)
+    assert len(lut) == len(depth)
+    if out is None:
+        out = np.empty((len(pixel_ids), 3), dtype=np.float32)
+    out = out[:len(pixel_ids)]
+
+    if use_native and _lib is not None:
+        transform = None
+        if cam2world is not None:
+            transform = np.ascontiguousarray(cam2world, dtype=np.float64).reshape(16)
+        _lib.OrganizedNormals(depth, lut, width, height, clamp_min, clamp_max, max_depth_jump,
+                              pixel_ids, len(pixel_ids), _optional(transform, np.float64),
+                              out, num_threads)
+        return out
+
+    # numpy fallback, same semantics as the native kernel on zero padded planes
+    grid = depth_to_points(depth, lut, clamp_min, clamp_max,
+                           buffers=allocate_point_buffers(len(depth), world=False, pixel_ids=True),
+                           use_native=False)
+    points = np.zeros((height + 2, width + 2, 3), dtype=np.float32)
+    points[grid['pixel_ids'] // width + 1, grid['pixel_ids'] % width + 1] = grid['cam']
+    center = points[1:-1, 1:-1]
+    z = center[..., 2]
+
+    def neighbor(dy, dx):
+        shifted = points[1 + dy:height + 1 + dy, 1 + dx:width + 1 + dx]
+        usable = (shifted[..., 2] > 0) & (np.abs(shifted[..., 2] - z) <= max_depth_jump * z)
+        return np.where(usable[..., None], shifted, center)
+
+    u = neighbor(0, 1) - neighbor(0, -1)
+    v = neighbor(1, 0) - neighbor(-1, 0)
+    normals = np.cross(u, v)
+    length = np.linalg.norm(normals, axis=-1)
+    degenerate = ~(length > 1e-12)
+    normals[degenerate] = -center[degenerate]
+    length[degenerate] = np.linalg.norm(center[degenerate], axis=-1)
+    facing = np.sum(center * normals, axis=-1)
+    scale = np.where(facing > 0, -1., 1.) / np.where(length > 0, length, 1.)
+    normals = (normals * scale[..., None]).reshape((-1, 3))[pixel_ids]
+    if cam2world is not None:
+        normals = normals @ np.asarray(cam2world, dtype=np.float32)[:3, :3].T
+    out[:] = normals
+    return out
+
+
+def zbuffer_splat(pixel_ids, depths, height, width, use_native=True):
+    """Nearest-depth z-buffer of points already projected on a height x width image.
+
+    pixel_ids holds the linear pixel (y * width + x) of every point, negative
+    for points outside the image; points with depth <= 0 are ignored.
+    Returns the depth image and, per pixel, the id of the nearest point (-1 if none).
+    On equal depths the point with the lowest id wins.
+    """
+    pixel_ids = np.ascontiguousarray(pixel_ids, dtype=np.int64).reshape(-1)
+    depths = np.ascontiguousarray(depths, dtype=np.float32).reshape(-1)
+    assert len(pixel_ids) == len(depths)
+    pixel_count = height * width
+
+    if use_native and _lib is not None:
+        depth_image = np.empty(pixel_count, dtype=np.float32)
+        winners = np.empty(pixel_count, dtype=np.int32)
+        _lib.ZBufferSplat(pixel_ids, depths, len(pixel_ids), pixel_count, depth_image, winners)
+        return depth_image.reshape((height, width)), winners.reshape((height, width))
+
+    # numpy fallback: stable sort by (pixel, depth), the first point of every pixel wins
+    valid = np.flatnonzero((pixel_ids >= 0) & (pixel_ids < pixel_count) & (depths > 0))
+    order = valid[np.lexsort((depths[valid], pixel_ids[valid]))]
+    sorted_pixels = pixel_ids[order]
+    first = np.ones(len(order), dtype=bool)
+    first[1:] = sorted_pixels[1:] != sorted_pixels[:-1]
+    nearest = order[first]
+
+    depth_image = np.zeros(pixel_count, dtype=np.float32)
+    winners = np.full(pixel_count, -1, dtype=np.int32)
+    depth_image[pixel_ids[nearest]] = depths[nearest]
+    winners[pixel_ids[nearest]] = nearest
+    return depth_image.reshape((height, width)), winners.reshape((height, width))
+
+
+class VoxelGrid(object):
+    """Fuse point clouds from many frames into one, averaging the points of every voxel.
+
+    Only the running sums of the occupied voxels are kept, so memory grows
+    with the size of the scene and not with the number of frames added.
+    Colors are floats in [0, 1]; normals are summed and renormalized.
+    """
+
+    def __init__(self, voxel_size, colors=False, normals=False, use_native=True):
+        self.voxel_size = voxel_size
+        self.has_colors = colors
+        self.has_normals = normals
+        self._grid = None
+        if use_native and _lib is not None:
+            self._grid = _lib.VoxelGridCreate(voxel_size, int(colors), int(normals))
+            return
+        # numpy fallback: voxel keys sorted, with the sums in the same order
+        self._keys = np.empty(0, dtype=np.int64)
+        self._counts = np.empty(0, dtype=np.int64)
+        self._sums = {name: np.empty((0, 3)) for name, used in
+                      [('points', True), ('colors', colors), ('normals', normals)] if used}
+
+    def __del__(self):
+        self.close()
+
+    def close(self):
+        if self._grid is not None:
+            _lib.VoxelGridDestroy(self._grid)
+            self._grid = None
+
+    def __len__(self):
+        if self._grid is not None:
+            return _lib.VoxelGridSize(self._grid)
+        return len(self._keys)
+
+    def add(self, points, colors=None, normals=None):
+        points = np.ascontiguousarray(points, dtype=np.float32).reshape((-1, 3))
+        attributes = {'points': points}
+        if self.has_colors:
+            assert colors is not None and len(colors) == len(points)
+            attributes['colors'] = np.ascontiguousarray(colors, dtype=np.float32).reshape((-1, 3))
+        if self.has_normals:
+            assert normals is not None and len(normals) == len(points)
+            attributes['normals'] = np.ascontiguousarray(normals, dtype=np.float32).reshape((-1, 3))
+
+        if self._grid is not None:
+            _lib.VoxelGridAdd(self._grid, points, _optional(attributes.get('colors'), np.float32),
+                              _optional(attributes.get('normals'), np.float32), len(points))
+            return
+
+        finite = np.all(np.isfinite(points), axis=1)
+        # Same quantization as the native grid: float voxel size, double inverse
+        inverse_size = 1. / np.float64(np.float32(self.voxel_size))
+        coordinates = np.floor(points[finite].astype(np.float64) * inverse_size).astype(np.int64)
+        keys = (((coordinates[:, 0] + (1 << 20)) & 0x1fffff) |
+                (((coordinates[:, 1] + (1 << 20)) & 0x1fffff) << 21) |
+                (((coordinates[:, 2] + (1 << 20)) & 0x1fffff) << 42))
+        all_keys, inverse = np.unique(np.concatenate((self._keys, keys)), return_inverse=True)
+        old_ids, new_ids = inverse[:len(self._keys)], inverse[len(self._keys):]
+        counts = np.zeros(len(all_keys), dtype=np.int64)
+        counts[old_ids] = self._counts
+        counts += np.bincount(new_ids, minlength=len(all_keys))
+        for name, values in attributes.items():
+            sums = np.zeros((len(all_keys), 3))
+            sums[old_ids] = self._sums[name]
+            for axis in range(3):
+                sums[:, axis] += np.bincount(new_ids, weights=values[finite, axis], minlength=len(all_keys))
+            self._sums[name] = sums
+        self._keys, self._counts = all_keys, counts
+
+    def extract(self):
+        """Dict with the fused 'points' and, when accumulated, 'colors' and 'normals'."""
+        count = len(self)
+        result = {'points': np.empty((count, 3), dtype=np.float32)}
+        if self.has_colors:
+            result['colors'] = np.empty((count, 3), dtype=np.float32)
+        if self.has_normals:
+            result['normals'] = np.empty((count, 3), dtype=np.float32)
+
+        if self._grid is not None:
+            _lib.VoxelGridExtract(self._grid, result['points'],
+                                  _optional(result.get('colors'), np.float32),
+                                  _optional(result.get('normals'), np.float32))
+            return result
+
+        for name in result:
+            if name == 'normals':
+                lengths = np.linalg.norm(self._sums[name], axis=1, keepdims=True)
+                result[name][:] = self._sums[name] / np.where(lengths > 0, lengths, np.inf)
+            else:
+                result[name][:] = self._sums[name] / self._counts.reshape((-1, 1))
+        return result
+
+
+def colors_to_uint8(colors):
+    """RGB colors as bytes, float colors are expected in [0, 1] (as in open3d)."""
+    colors = np.asarray(colors)
+    if colors.dtype == np.uint8:
+        return np.ascontiguousarray(colors)
+    return np.clip(np.rint(colors * 255.), 0, 255).astype(np.uint8)
+
+
+def write_ply(path, points, colors=None, normals=None, triangles=None, use_native=True):
+    """Write a point cloud, or a mesh with triangles, to a binary little endian PLY in a single write.
+
+    Vertices have float x y z, then float nx ny nz and uchar red green blue
+    when normals and colors are given, the same layout written by open3d.
+    Faces are written as uchar counts followed by int vertex indices.
+    """
+    points = np.ascontiguousarray(points, dtype=np.float32).reshape((-1, 3))
+    if normals is not None:
+        normals = np.ascontiguousarray(normals, dtype=np.float32).reshape((-1, 3))
+        assert len(normals) == len(points)
+    if colors is not None:
+        colors = colors_to_uint8(colors).reshape((-1, 3))
+        assert len(colors) == len(points)
+    if triangles is not None:
+        triangles = np.ascontiguousarray(triangles, dtype=np.int32).reshape((-1, 3))
+
+    if use_native and _lib is not None:
+        result = _lib.WritePly(os.fsencode(str(path)), points, _optional(normals, np.float32),
+                               _optional(colors, np.uint8), len(points),
+                               _optional(triangles, np.int32), 0 if triangles is None else len(triangles))
+        if result != 0:
+            raise IOError('Could not write {}'.format(path))
+        return
+
+    # numpy fallback: interleave the vertex properties in a structured array
+    fields = [('x', '<f4'), ('y', '<f4'), ('z', '<f4')]
+    if normals is not None:
+        fields += [('nx', '<f4'), ('ny', '<f4'), ('nz', '<f4')]
+    if colors is not None:
+        fields += [('red', 'u1'), ('green', 'u1'), ('blue', 'u1')]
+    vertices = np.empty(len(points), dtype=fields)
+    for i, axis in enumerate('xyz'):
+        vertices[axis] = points[:, i]
+        if normals is not None:
+            vertices['n' + axis] = normals[:, i]
+    if colors is not None:
+        for i, channel in enumerate(['red', 'green', 'blue']):
+            vertices[channel] = colors[:, i]
+
+    header = ['ply', 'format binary_little_endian 1.0', 'element vertex {}'.format(len(points))]
+    header += ['property float {}'.format(name) for name, dtype in fields if dtype == '<f4']
+    header += ['property uchar {}'.format(name) for name, dtype in fields if dtype == 'u1']
+    faces = b''
+    if triangles is not None:
+        header += ['element face {}'.format(len(triangles)), 'property list uchar int vertex_indices']
+        faces = np.empty(len(triangles), dtype=[('count', 'u1'), ('indices', '<i4', (3,))])
+        faces['count'] = 3
+        faces['indices'] = triangles
+        faces = faces.tobytes()
+    header += ['end_header', '']
+    with open(str(path), 'wb') as f:
+        f.write('\n'.join(header).encode('ascii') + vertices.tobytes() + faces)
+
+
+class TsdfVolume(object):
+    """Voxel hashing TSDF volume of the native kernels library.
+
+    Frames are integrated in parallel over the 8x8x8 voxel blocks they
+    observe, and extract_mesh only runs marching cubes again on the blocks
+    that changed since the previous extraction, in parallel, before welding
+    the block seams. There is no numpy fallback, check has_native_kernels() first.
+    """
+
+    def __init__(self, voxel_size, sdf_trunc, max_weight=0.):
+        if _lib is None:
+            raise RuntimeError('TsdfVolume needs the native kernels library')
+        self.voxel_size = voxel_size
+        self.sdf_trunc = sdf_trunc
+        self._volume = _lib.TsdfVolumeCreate(voxel_size, sdf_trunc, max_weight)
+
+    def __del__(self):
+        self.close()
+
+    def close(self):
+        if getattr(self, '_volume', None) is not None:
+            _lib.TsdfVolumeDestroy(self._volume)
+            self._volume = None
+
+    def __len__(self):
+        """Number of allocated voxel blocks."""
+        return _lib.TsdfVolumeBlockCount(self._volume)
+
+    def integrate(self, depth, color, intrinsics, cam2world, depth_scale, depth_trunc,
+                  bgr=False, num_threads=0):
+        """Integrate a uint16 depth image (in 1 / depth_scale meters) and an
+        optional uint8 color image (RGB, or BGR as read by opencv), seen with
+        pinhole intrinsics (fx, fy, cx, cy) from the cam2world pose."""
+        depth = np.ascontiguousarray(depth, dtype=np.uint16)
+        height, width = depth.shape
+        if color is not None:
+            color = np.ascontiguousarray(color, dtype=np.uint8)
+            assert color.shape == (height, width, 3)
+        _lib.TsdfVolumeIntegrate(
+            self._volume, depth, _optional(color, np.uint8), width, height,
+            depth_scale, depth_trunc, np.asarray(intrinsics, dtype=np.float32),
+            np.ascontiguousarray(cam2world, dtype=np.float64), int(bgr), num_threads)
+
+    def extract_mesh(self, target_triangles=0, num_threads=0, copy=True):
+        """Dict with the mesh 'vertices', 'normals', 'colors' (uint8 RGB) and 'triangles'.
+
+        With target_triangles > 0 the mesh is simplified with quadric error
+        metrics to at most that many triangles. With copy=False the mesh is
+        kept in the volume, to be saved with write_mesh, and None is returned.
+        """
+        triangle_count = ctypes.c_int64()
+        vertex_count = _lib.TsdfVolumeExtractMesh(self._volume, target_triangles, num_threads,
+                                                  ctypes.byref(triangle_count))
+        if not copy:
+            return None
+        mesh = {'vertices': np.empty((vertex_count, 3), dtype=np.float32),
+                'normals': np.empty((vertex_count, 3), dtype=np.float32),
+                'colors': np.empty((vertex_count, 3), dtype=np.uint8),
+                'triangles': np.empty((triangle_count.value, 3), dtype=np.int32)}
+        _lib.TsdfVolumeGetMesh(self._volume, mesh['vertices'], mesh['normals'],
+                               mesh['colors'], mesh['triangles'])
+        return mesh
+
+    def write_mesh(self, path, triangles=True):
+        """Write the last extracted mesh to a binary PLY, only its vertices when triangles is False."""
+        if _lib.TsdfVolumeWriteMesh(self._volume, os.fsencode(str(path)), int(triangles)) != 0:
+            raise IOError('Could not write {}'.format(path))
@@ -6,38 +6,160 @@
  IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
  PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
 """
+import time
 import argparse
+import threading
+import traceback
 from pathlib import Path
 from project_hand_eye_to_pv import project_hand_eye_to_pv
 from utils import check_framerates, extract_tar_file
 from save_pclouds import save_pclouds
 from convert_images import convert_images
+from stage_cache import StageManifest
 
 
-def process_all(w_path, project_hand_eye=False):
-    # Extract all tar
-    for tar_fname in w_path.glob("*.tar"):
-        print(f"Extracting {tar_fname}")
-        tar_output = ''
-        tar_output = w_path / Path(tar_fname.stem)
-        tar_output.mkdir(exist_ok=True)
-        extract_tar_file(tar_fname, tar_output)
+class Stage(object):
+    """A processing step of a recording, run once all the input files are
+    present and all the stages listed in after are done."""
+
+    def __init__(self, name, inputs, run, after=()):
+        self.name = name
+        self.inputs = set(inputs)
+        self.run = run
+        self.after = set(after)
+
+
+def recording_stages(w_path, file_names, project_hand_eye=False, extract=False, force=False,
+                     hash_inputs=False):
+    """Stages of process_all for a recording made of file_names, in dependency order.
+
+    Every stage needs the small files of the recording (poses, calibration)
+    plus the tarballs it reads. Colored point clouds and hand projections
+    read the converted PV images, so they come after the PV stage.
+    """
+    # Every stage records its outputs in <w_path>/stage_manifest.json, along with
+    # the fingerprints of their inputs and the parameters used. Re-runs, or runs
+    # resumed after a crash, only redo the frames whose inputs or parameters changed.
+    manifest = StageManifest(w_path, use_hash=hash_inputs, force=force)
+    tar_names = sorted(name for name in file_names if name.endswith('.tar'))
+    metadata = set(file_names) - set(tar_names)
+    stages = []
+
+    # Frames are read straight from the tarballs, extracting them
+    # is only needed to export the raw files
+    if extract:
+        for tar_name in tar_names:
+            def extract_tar(tar_name=tar_name):
+                print(f"Extracting {w_path / tar_name}")
+                tar_output = w_path / Path(tar_name).stem
+                tar_output.mkdir(exist_ok=True)
+                extract_tar_file(w_path / tar_name, tar_output)
+            stages.append(Stage(f'extract:{tar_name}', [tar_name], extract_tar))
 
     # Process PV if recorded
-    if (w_path / "PV.tar").exists():
+    has_pv = "PV.tar" in tar_names
+    if has_pv:
         # Convert images
-        convert_images(w_path)
+        stages.append(Stage('pv_images', metadata | {"PV.tar"},
+                            lambda: convert_images(w_path, manifest=manifest)))
 
         # Project
         if project_hand_eye:
-            project_hand_eye_to_pv(w_path)
-# Process depth if recorded
+            stages.append(Stage('hand_eye', metadata,
+                                lambda: project_hand_eye_to_pv(w_path, manifest), after=['pv_images']))
+
+    # Process depth if recorded
     for sensor_name in ["Depth Long Throw", "Depth AHaT"]:
-        if (w_path / "{}.tar".format(sensor_name)).exists():
+        if "{}.tar".format(sensor_name) in tar_names:
             # Save point clouds
-            save_pclouds(w_path, sensor_name)
-    print("")
-    check_framerates(w_path)
+            stages.append(Stage(f'pclouds:{sensor_name}', metadata | {"{}.tar".format(sensor_name)},
+                                lambda sensor_name=sensor_name: save_pclouds(w_path, sensor_name,
+                                                                             manifest=manifest),
+                                after=['pv_images'] if has_pv else []))
+
+    def report():
+        print("")
+        check_framerates(w_path)
+    stages.append(Stage('check_framerates', file_names, report, after=[stage.name for stage in stages]))
+    return stages
+
+
+def process_all(w_path, project_hand_eye=False, extract=False, force=False, hash_inputs=False):
+    file_names = [path.name for path in w_path.iterdir() if path.is_file()]
+    for stage in recording_stages(w_path, file_names, project_hand_eye, extract, force, hash_inputs):
+        stage.run()
+
+
+class ProcessingPipeline(object):
+    """Runs the stages of recordings on a background thread while their files
+    are still being downloaded: a stage starts as soon as its input files have
+    landed, so processing overlaps with the network transfer.
+
+    Stages run one at a time, each of them already using every core.
+    """
+
+    def __init__(self, project_hand_eye=False, extract=False, force=False, hash_inputs=False):
+        self.options = (project_hand_eye, extract, force, hash_inputs)
+        self.pending = []
+        self.done = set()
+        self.landed = set()
+        self.closed = False
+        self.condition = threading.Condition()
+        self.start = time.time()
+        self.thread = threading.Thread(target=self._run, daemon=True)
+        self.thread.start()
+
+    def add_recording(self, w_path, file_names):
+        """Queue the stages of a recording that will be made of file_names."""
+        stages = recording_stages(w_path, file_names, *self.options)
+        with self.condition:
+            self.pending += [(w_path, stage) for stage in stages]
+            self.condition.notify()
+
+    def file_done(self, path):
+        """Called, from any thread, when a file of a recording is complete."""
+        with self.condition:
+            self.landed.add(Path(path))
+            self.condition.notify()
+
+    def close(self):
+        """Wait for every stage whose inputs are complete."""
+        with self.condition:
+            self.closed = True
+            self.condition.notify()
+        self.thread.join()
+        for w_path, stage in self.pending:
+            print(f"=> Skipped {stage.name} of {w_path.name}, some of its inputs are missing")
+        print(f"=> Downloaded and processed in {time.time() - self.start:.1f}s")
+
+    def _ready(self, w_path, stage):
+        return (all(w_path / name in self.landed for name in stage.inputs) and
+                all((w_path, name) in self.done for name in stage.after))
+
+    def _next_stage(self):
+        with self.condition:
+            while True:
+                for i, (w_path, stage) in enumerate(self.pending):
+                    if self._ready(w_path, stage):
+                        return self.pending.pop(i)
+                if self.closed:
+                    return None, None
+                self.condition.wait()
+
+    def _run(self):
+        while True:
+            w_path, stage = self._next_stage()
+            if stage is None:
+                return
+            print(f"=> Processing {stage.name} of {w_path.name}")
+            try:
+                stage.run()
+            except Exception:
+                # Stages depending on this one are left pending, and reported as skipped
+                traceback.print_exc()
+                continue
+            with self.condition:
+                self.done.add((w_path, stage.name))
 
 
 if __name__ == '__main__':
@@ -48,9 +170,21 @@ if __name__ == '__main__':
                         required=False,
                         action='store_true',
                         help="Project hand joints (and eye gaze, if recorded) to rgb images")
+    parser.add_argument("--extract",
+                        required=False,
+                        action='store_true',
+                        help="Also extract the raw files of every tarball")
+    parser.add_argument("--force",
+                        required=False,
+                        action='store_true',
+                        help="Redo every stage, ignoring the stage manifest")
+    parser.add_argument("--hash_inputs",
+                        required=False,
+                        action='store_true',
+                        help="Fingerprint inputs by content instead of size and modification time")
 
     args = parser.parse_args()
 
     w_path = Path(args.recording_path)
 
-    process_all(w_path, args.project_hand_eye)
+    process_all(w_path, args.project_hand_eye, args.extract, args.force, args.hash_inputs)
@@ -10,9 +10,10 @@ import cv2
 import argparse
 import numpy as np
 from pathlib import Path
-import ast
 
-from utils import load_head_hand_eye_data
+from utils import PVImages, load_csv_records, load_head_hand_eye_data
+from timestamp_index import TimestampIndex
+from stage_cache import StageManifest, hash_array
 
 
 def process_timestamps(path):
@@ -23,36 +24,26 @@ def process_timestamps(path):
 
 
 def load_pv_data(csv_path):
-    with open(csv_path) as f:
-        lines = f.readlines()
-
     # The first line contains info about the intrinsics.
     # The following lines (one per frame) contain timestamp, focal length and transform PVtoWorld
-    n_frames = len(lines) - 1
-    frame_timestamps = np.zeros(n_frames, dtype=np.longlong)
-    focal_lengths = np.zeros((n_frames, 2))
-    pv2world_transforms = np.zeros((n_frames, 4, 4))
-
-    intrinsics_ox, intrinsics_oy, \
-        intrinsics_width, intrinsics_height = ast.literal_eval(lines[0])
-
-    for i_frame, frame in enumerate(lines[1:]):
-        # Row format is
-        # timestamp, focal length (2), transform PVtoWorld (4x4)
-        frame = frame.split(',')
-        frame_timestamps[i_frame] = int(frame[0])
-        focal_lengths[i_frame, 0] = float(frame[1])
-        focal_lengths[i_frame, 1] = float(frame[2])
-        pv2world_transforms[i_frame] = np.array(frame[3:20]).astype(float).reshape((4, 4))
+    with open(csv_path) as f:
+        intrinsics = f.readline().split(',')
+    intrinsics_ox, intrinsics_oy = float(intrinsics[0]), float(intrinsics[1])
+    intrinsics_width, intrinsics_height = int(intrinsics[2]), int(intrinsics[3])
+
+    # Row format is
+    # timestamp, focal length (2), transform PVtoWorld (4x4)
+    data = load_csv_records(csv_path, [('timestamp', np.int64),
+                                       ('focal_length', np.float64, (2,)),
+                                       ('pv2world', np.float64, (4, 4))], skiprows=1)
+    frame_timestamps = data['timestamp']
+    focal_lengths = data['focal_length']
+    pv2world_transforms = data['pv2world']
 
     return (frame_timestamps, focal_lengths, pv2world_transforms,
             intrinsics_ox, intrinsics_oy, intrinsics_width, intrinsics_height)
 
 
-def match_timestamp(target, all_timestamps):
-    return np.argmin([abs(x - target) for x in all_timestamps])
-
-
 def get_eye_gaze_point(gaze_data):
     origin_homog = gaze_data[:4]
     direction_homog = gaze_data[4:8]
@@ -64,12 +55,13 @@ def get_eye_gaze_point(gaze_data):
     return point[:3]
 
 
-def project_hand_eye_to_pv(folder):
+def project_hand_eye_to_pv(folder, manifest=None):
     print("")
     head_hat_stream_path = list(folder.glob('*_eye.csv'))[0]
     pv_info_path = list(folder.glob('*pv.txt'))[0]
-    pv_paths = sorted(list((folder / 'PV').glob('*png')))
-    assert(len(pv_paths))
+    pv_images = PVImages(folder)
+    sample_timestamps = pv_images.timestamps()
+    assert(len(sample_timestamps))
 
     # load head, hand, eye data
     (timestamps, _,
@@ -86,24 +78,42 @@ def project_hand_eye_to_pv(folder):
 
     principal_point = np.array([ox, oy])
 
-    n_frames = len(pv_paths)
+    n_frames = len(sample_timestamps)
+    hand_ids = TimestampIndex(timestamps).nearest(sample_timestamps)
+    # Poses are looked up by timestamp: pv.txt may list frames that have no image
+    pose_ids = TimestampIndex(frame_timestamps).within(sample_timestamps, 0)
+
     output_folder = folder / 'eye_hands'
     output_folder.mkdir(exist_ok=True)
     for pv_id in range(n_frames):
         print(".", end="", flush=True)
-        pv_path = pv_paths[pv_id]
-        sample_timestamp = int(str(pv_path.name).replace('.png', ''))
-
-        hand_ts = match_timestamp(sample_timestamp, timestamps)
-        # print('Frame-hand delta: {:.3f}ms'.format((sample_timestamp - timestamps[hand_ts]) * 1e-4))
-
-        img = cv2.imread(str(pv_path))
+        pv_ts = sample_timestamps[pv_id]
+        hand_ts = hand_ids[pv_id]
+        pose_id = pose_ids[pv_id]
+        if pose_id < 0:
+            print('No pose for PV frame {}'.format(pv_ts))
+            continue
+        output_path = str(output_folder / 'hands') + 'proj{}.png'.format(str(pv_id).zfill(4))
+        if manifest is not None:
+            inputs = {'pv': manifest.fingerprint_file(pv_images.source_path(pv_ts)),
+                      'pv_pose': hash_array(np.concatenate((focal_lengths[pose_id].ravel(),
+                                                            pv2world_transforms[pose_id].ravel()))),
+                      'hand_eye': hash_array(np.concatenate((
+                          left_hand_transs[hand_ts].ravel(), right_hand_transs[hand_ts].ravel(),
+                          gaze_data[hand_ts].ravel(),
+                          [left_hand_transs_available[hand_ts], right_hand_transs_available[hand_ts],
+                           gaze_available[hand_ts]])))}
+            if manifest.is_up_to_date('eye_hands', output_path, inputs, {}):
+                continue
+        # print('Frame-hand delta: {:.3f}ms'.format((sample_timestamps[pv_id] - timestamps[hand_ts]) * 1e-4))
+
+        img = pv_images.read(pv_ts)
         # pinhole
-        K = np.array([[focal_lengths[pv_id][0], 0, principal_point[0]],
-                      [0, focal_lengths[pv_id][1], principal_point[1]],
+        K = np.array([[focal_lengths[pose_id][0], 0, principal_point[0]],
+                      [0, focal_lengths[pose_id][1], principal_point[1]],
                       [0, 0, 1]])
         try:
-            Rt = np.linalg.inv(pv2world_transforms[pv_id])
+            Rt = np.linalg.inv(pv2world_transforms[pose_id])
         except np.linalg.LinAlgError:
             print('No pv2world transform')
             continue
@@ -130,7 +140,12 @@ def project_hand_eye_to_pv(folder):
             ixy = (width - ixy[0], ixy[1])
             img = cv2.circle(img, ixy, radius=3, color=colors[2])
 
-        cv2.imwrite(str(output_folder / 'hands') + 'proj{}.png'.format(str(pv_id).zfill(4)), img)
+        cv2.imwrite(output_path, img)
+        if manifest is not None:
+            manifest.record('eye_hands', output_path, inputs, {})
+    pv_images.close()
+    if manifest is not None:
+        manifest.save()
 
 
 if __name__ == "__main__":
@@ -138,6 +153,9 @@ if __name__ == "__main__":
     parser = argparse.ArgumentParser(description='Process recorded data.')
     parser.add_argument("--recording_path", required=True,
                         help="Path to recording folder")
+    parser.add_argument("--force", action='store_true',
+                        help="Project every frame, ignoring the stage manifest")
 
     args = parser.parse_args()
-    project_hand_eye_to_pv(Path(args.recording_path))
+    folder = Path(args.recording_path)
+    project_hand_eye_to_pv(folder, StageManifest(folder, force=args.force))
@@ -13,7 +13,8 @@ import argparse
 import urllib.request
 from pathlib import Path
 from urllib.parse import quote
-from process_all import process_all
+from process_all import process_all, ProcessingPipeline
+from downloader import DownloadTask, download_files, DEFAULT_CHUNK_SIZE, DEFAULT_WORKERS
 
 
 class RecorderShell(cmd.Cmd):
@@ -60,8 +61,29 @@ class RecorderShell(cmd.Cmd):
 
 
     def do_download_all(self, arg):
-        for recording_idx in range(len(self.dev_portal_browser.recording_names)):
-            self.dev_portal_browser.download_recording(recording_idx, self.w_path)
+        self.dev_portal_browser.download_recordings(
+            range(len(self.dev_portal_browser.recording_names)), self.w_path)
+
+    def do_download_process(self, arg):
+        try:
+            recording_idx = int(arg)
+            if recording_idx is not None:
+                self.download_and_process([recording_idx])
+        except ValueError:
+            print(f"I can't download {arg}")
+
+    def do_download_process_all(self, arg):
+        self.download_and_process(
+            range(len(self.dev_portal_browser.recording_names)))
+
+    def download_and_process(self, recording_indices):
+        # Every file is handed to the processing stages as soon as it landed
+        pipeline = ProcessingPipeline()
+        try:
+            self.dev_portal_browser.download_recordings(
+                recording_indices, self.w_path, pipeline)
+        finally:
+            pipeline.close()
 
     def do_delete_all(self, arg):
         for _ in range(len(self.dev_portal_browser.recording_names)):
@@ -102,6 +124,13 @@ def parse_args():
     parser.add_argument("--workspace_path", required=True,
                         help="Path to workspace folder used for downloading "
                              "recordings")
+    parser.add_argument("--download_workers", type=int, default=DEFAULT_WORKERS,
+                        help="Number of concurrent HTTP connections used for "
+                             "downloading")
+    parser.add_argument("--chunk_size_mb", type=int,
+                        default=DEFAULT_CHUNK_SIZE // (1024 * 1024),
+                        help="Files are downloaded, in parallel and resumably, "
+                             "in ranges of this size")
 
     args = parser.parse_args()
 
@@ -110,6 +139,10 @@ def parse_args():
 
 class DevicePortalBrowser(object):
 
+    def __init__(self, num_workers=DEFAULT_WORKERS, chunk_size=DEFAULT_CHUNK_SIZE):
+        self.num_workers = num_workers
+        self.chunk_size = chunk_size
+
     def connect(self, address, username, password):
         print("Connecting to HoloLens Device Portal...")
         self.url = "http://{}".format(address)
@@ -172,37 +205,57 @@ class DevicePortalBrowser(object):
         except IndexError:
             print("=> Recording does not exist")
 
-    def download_recording(self, recording_idx, w_path):
+    def recording_files(self, recording_idx, w_path):
+        """Download tasks of the files of a recording."""
         recording_name = self.get_recording_name(recording_idx)
         if recording_name is None:
-            return
+            return []
 
         recording_path = w_path / recording_name
         recording_path.mkdir(exist_ok=True)
 
-        print("Downloading recording {}...".format(recording_name))
-
         response = urllib.request.urlopen(
             "{}/api/filesystem/apps/files?knownfolderid="
             "LocalAppData&packagefullname={}&path=\\LocalState\\{}".format(
                 self.url, self.package_full_name, recording_name))
         files = json.loads(response.read().decode())
 
+        tasks = []
         for file in files["Items"]:
             if file["Type"] != 32:
                 continue
 
-            destination_path = recording_path / file["Id"]
-            if destination_path.exists():
-                print("=> Skipping, already downloaded:", file["Id"])
-                continue
-
-            print("=> Downloading:", file["Id"])
-            urllib.request.urlretrieve(
+            tasks.append(DownloadTask(
                 "{}/api/filesystem/apps/file?knownfolderid=LocalAppData&"
                 "packagefullname={}&filename=\\LocalState\\{}\\{}".format(
                     self.url, self.package_full_name,
-                    recording_name, quote(file["Id"])), str(destination_path))
+                    recording_name, quote(file["Id"])),
+                recording_path / file["Id"], file.get("FileSize")))
+
+        # Chunks are fetched in order: the small files needed by every stage
+        # come first, then PV, which the colored point clouds depend on
+        tasks.sort(key=lambda task: (task.destination.suffix == ".tar",
+                                     task.destination.name != "PV.tar"))
+        return tasks
+
+    def download_recordings(self, recording_indices, w_path, pipeline=None):
+        tasks = []
+        for recording_idx in recording_indices:
+            recording_name = self.get_recording_name(recording_idx)
+            if recording_name is not None:
+                print("Downloading recording {}...".format(recording_name))
+                files = self.recording_files(recording_idx, w_path)
+                if pipeline is not None:
+                    pipeline.add_recording(w_path / recording_name,
+                                           [task.destination.name for task in files])
+                tasks += files
+        on_file_done = None
+        if pipeline is not None:
+            on_file_done = lambda task: pipeline.file_done(task.destination)
+        download_files(tasks, self.num_workers, self.chunk_size, on_file_done)
+
+    def download_recording(self, recording_idx, w_path):
+        self.download_recordings([recording_idx], w_path)
 
     def delete_recording(self, recording_idx):
         recording_name = self.get_recording_name(recording_idx)
@@ -240,6 +293,8 @@ def print_help():
     print("  list_workspace:           List all recordings in the workspace")
     print("  download X:               Download recording X from the HoloLens")
     print("  download_all:             Download all recordings from the HoloLens")
+    print("  download_process X:       Download recording X and process it while downloading")
+    print("  download_process_all:     Download and process all recordings")
     print("  delete X:                 Delete recording X from the HoloLens")
     print("  delete_all:               Delete all recordings from the HoloLens")
     print("  process X:                Process recording X ")
@@ -259,7 +314,8 @@ def main():
     w_path = Path(args.workspace_path)
     w_path.mkdir(exist_ok=True)
 
-    dev_portal_browser = DevicePortalBrowser()
+    dev_portal_browser = DevicePortalBrowser(
+        args.download_workers, args.chunk_size_mb * 1024 * 1024)
     dev_portal_browser.connect(args.dev_portal_address,
                                args.dev_portal_username,
                                args.dev_portal_password)
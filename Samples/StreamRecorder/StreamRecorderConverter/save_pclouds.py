@@ -7,15 +7,31 @@
  PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
 """
 import argparse
-import multiprocessing
 from pathlib import Path
 
 import numpy as np
 import cv2
-import open3d as o3d
 
-from project_hand_eye_to_pv import load_pv_data, match_timestamp
-from utils import extract_tar_file, load_lut, DEPTH_SCALING_FACTOR, project_on_depth, project_on_pv
+from project_hand_eye_to_pv import load_pv_data
+from timestamp_index import TimestampIndex
+from tar_reader import open_frame_reader
+from utils import PVImages, load_csv_records, load_lut, DEPTH_SCALING_FACTOR, project_on_depth, project_on_pv
+from native_kernels import VoxelGrid, allocate_point_buffers, depth_to_points, organized_normals, write_ply
+from stage_cache import StageManifest, hash_array
+
+# Normal estimation modes: 'organized' uses the neighbors in the depth image grid,
+# 'knn' lets open3d search the nearest neighbors of every point (slower)
+NORMALS_MODES = ['organized', 'knn']
+
+# Output buffers reused by depth_to_points across the frames handled by a process
+_point_buffers = {}
+
+
+def get_point_buffers(pixel_count, world, pixel_ids=False):
+    key = (pixel_count, world, pixel_ids)
+    if key not in _point_buffers:
+        _point_buffers[key] = allocate_point_buffers(pixel_count, world=world, pixel_ids=pixel_ids)
+    return _point_buffers[key]
 
 
 def save_output_txt_files(folder, shared_dict):
@@ -55,72 +71,82 @@ def save_output_txt_files(folder, shared_dict):
 
 def save_single_pcloud(shared_dict,
                        path,
-                       folder,
+                       pv_images,
                        pinhole_folder,
                        save_in_cam_space,
                        lut,
                        has_pv,
                        focal_lengths,
                        principal_point,
-                       rig2world_transforms,
+                       rig2world,
                        rig2cam,
                        pv_timestamps,
+                       pv_target_id,
                        pv2world_transforms,
                        discard_no_rgb,
                        clamp_min,
                        clamp_max,
                        depth_path_suffix,
-                       disable_project_pinhole
+                       disable_project_pinhole,
+                       depth_reader=None,
+                       normals_mode='organized',
+                       fuse=False
                        ):
+    """Save the point cloud of a depth frame, or with fuse return its world space
+    points, colors and normals for the caller to accumulate in the fused cloud
+    (None when the frame has no pose). The returned arrays may be views on
+    buffers reused by the next call of the process."""
     suffix = '_cam' if save_in_cam_space else ''
-    output_path = str(path)[:-4] + f'{suffix}.ply'
-
-
-#    if Path(output_path).exists():
-#        print(output_path + ' is already exists, skip generating this pclouds')
-#        return
-
+    output_path = pcloud_output_path(path, save_in_cam_space)
 
     print(".", end="", flush=True)
 
     # extract the timestamp for this frame
     timestamp = extract_timestamp(path.name.replace(depth_path_suffix, ''))
-    # load depth img
-    img = cv2.imread(str(path), -1)
+    # load depth img, from the tarball if it was not extracted
+    if depth_reader is not None:
+        img = depth_reader.read_pgm(path.name)
+    else:
+        img = cv2.imread(str(path), -1)
     height, width = img.shape
     assert len(lut) == width * height
 
-    # Clamp values if requested
-    if clamp_min > 0 and clamp_max > 0:
-        # Convert crop values to mm
-        clamp_min = clamp_min * 1000.
-        clamp_max = clamp_max * 1000.
-        # Clamp depth values
-        img[img < clamp_min] = 0
-        img[img > clamp_max] = 0
-
-    # Get xyz points in camera space
-    points = get_points_in_cam_space(img, lut)
+    # Clamp values only if both bounds are given
+    if not (clamp_min > 0 and clamp_max > 0):
+        clamp_min = clamp_max = 0.
+
+    cam2world_transform = None
+    if not save_in_cam_space and rig2world is not None:
+        # if we have the transform from rig to world for this frame,
+        # then put the point clouds in world space
+        cam2world_transform = rig2world @ np.linalg.inv(rig2cam)
+
+    # Get xyz points in camera (and world) space in a single pass
+    organized = normals_mode == 'organized'
+    buffers = get_point_buffers(width * height, world=cam2world_transform is not None,
+                                pixel_ids=organized)
+    points_dict = depth_to_points(img, lut, clamp_min, clamp_max, cam2world_transform, buffers)
+    points = points_dict['cam']
+    normals = None
+    if organized:
+        # Normals from the depth grid, already oriented towards the camera
+        normals = organized_normals(img, lut, points_dict['pixel_ids'], clamp_min, clamp_max,
+                                    cam2world_transform)
     if save_in_cam_space:
-        save_ply(output_path, points, rgb=None)
+        save_ply(output_path, points, rgb=None, normals=normals)
         # print('Saved %s' % output_path)
     else:
-        if rig2world_transforms and (timestamp in rig2world_transforms):
-            # if we have the transform from rig to world for this frame,
-            # then put the point clouds in world space
-            rig2world = rig2world_transforms[timestamp]
-            # print('Transform found for timestamp %s' % timestamp)
-            xyz, cam2world_transform = cam2world(points, rig2cam, rig2world)
+        if cam2world_transform is not None:
+            xyz = points_dict['world']
 
             rgb = None
             if has_pv:
                 # if we have pv, get vertex colors
                 # get the pv frame which is closest in time
-                target_id = match_timestamp(timestamp, pv_timestamps)
+                target_id = pv_target_id
                 pv_ts = pv_timestamps[target_id]
-                rgb_path = str(folder / 'PV' / f'{pv_ts}.png')
-                assert Path(rgb_path).exists()
-                pv_img = cv2.imread(rgb_path)
+                pv_img = pv_images.read(pv_ts)
+                assert pv_img is not None
 
                 # Project from depth to pv going via world space
                 rgb, depth = project_on_pv(
@@ -179,24 +205,56 @@ def save_single_pcloud(shared_dict,
                 colored_points = rgb[:, 0] > 0
                 xyz = xyz[colored_points]
                 rgb = rgb[colored_points]
-            save_ply(output_path, xyz, rgb, cam2world_transform)
+                if normals is not None:
+                    normals = normals[colored_points]
+            if fuse:
+                # Accumulated in the fused cloud instead of saving one cloud per frame
+                if normals is None:
+                    normals = estimate_knn_normals(xyz, cam2world_transform)
+                return xyz, rgb, normals
+            else:
+                save_ply(output_path, xyz, rgb, cam2world_transform, normals)
             # print('Saved %s' % output_path)
         else:
             print('Transform not found for timestamp %s' % timestamp)
 
 
-def save_ply(output_path, points, rgb=None, cam2world_transform=None):
+def pcloud_output_path(depth_path, save_in_cam_space):
+    suffix = '_cam' if save_in_cam_space else ''
+    return str(depth_path)[:-4] + f'{suffix}.ply'
+
+
+def pcloud_inputs(manifest, path, depth_reader, frame_rig2world, has_pv, pv_images,
+                  pv_timestamps, pv_target_id, focal_lengths, pv2world_transforms):
+    """Fingerprints of everything a single point cloud depends on."""
+    inputs = {'depth': manifest.fingerprint_frame(depth_reader, path.name, path)}
+    if frame_rig2world is not None:
+        inputs['rig2world'] = hash_array(frame_rig2world)
+    if has_pv and pv_target_id is not None:
+        rgb_path = pv_images.source_path(pv_timestamps[pv_target_id])
+        inputs['pv'] = manifest.fingerprint_file(rgb_path) if rgb_path is not None else None
+        inputs['pv_pose'] = hash_array(np.concatenate((
+            focal_lengths[pv_target_id].ravel(), pv2world_transforms[pv_target_id].ravel())))
+    return inputs
+
+
+def save_ply(output_path, points, rgb=None, cam2world_transform=None, normals=None):
+    if normals is None:
+        normals = estimate_knn_normals(points, cam2world_transform)
+    write_ply(output_path, points, rgb, normals)
+
+
+def estimate_knn_normals(points, cam2world_transform=None):
+    # open3d is only needed by the (slower) nearest neighbors normals
+    import open3d as o3d
     pcd = o3d.geometry.PointCloud()
-    pcd.points = o3d.utility.Vector3dVector(points)
-    if rgb is not None:
-        pcd.colors = o3d.utility.Vector3dVector(rgb)
+    pcd.points = o3d.utility.Vector3dVector(np.asarray(points, dtype=np.float64))
     pcd.estimate_normals()
     if cam2world_transform is not None:
         # Camera center
         camera_center = (cam2world_transform) @ np.array([0, 0, 0, 1])
         o3d.geometry.PointCloud.orient_normals_towards_camera_location(pcd, camera_center[:3])
-
-    o3d.io.write_point_cloud(output_path, pcd)
+    return np.asarray(pcd.normals)
 
 
 def load_extrinsics(extrinsics_path):
@@ -226,16 +284,9 @@ def extract_timestamp(path):
 
 
 def load_rig2world_transforms(path):
-    transforms = {}
-    with open(path, "r") as f:
-        lines = [l.strip() for l in f.readlines()]
-    for line in lines:
-        value = line.split(",")
-        timestamp = int(value[0])
-        transform_entries = [float(v) for v in value[1:]]
-        transform = np.array(transform_entries).reshape((4, 4))
-        transforms[timestamp] = transform
-    return transforms
+    """Timestamps and rig2world transforms (one per frame), sorted by timestamp."""
+    data = load_csv_records(path, [('timestamp', np.int64), ('rig2world', np.float64, (4, 4))])
+    return data['timestamp'], data['rig2world']
 
 
 def save_pclouds(folder,
@@ -245,8 +296,19 @@ def save_pclouds(folder,
                  clamp_min=0.,
                  clamp_max=0.,
                  depth_path_suffix='',
-                 disable_project_pinhole=False
+                 disable_project_pinhole=False,
+                 manifest=None,
+                 normals_mode='organized',
+                 fuse_voxel_size=0.
                  ):
+    """Save one point cloud per depth frame.
+
+    With a StageManifest, frames whose inputs and parameters did not change
+    since the last run are skipped. With fuse_voxel_size > 0 the world space
+    points of all the frames are instead fused in a single <sensor>_fused.ply,
+    averaging the points that fall in the same voxel.
+    """
+    assert not (fuse_voxel_size > 0 and save_in_cam_space), 'Fused clouds are in world space'
     print("")
     print("Saving point clouds")
 
@@ -259,20 +321,15 @@ def save_pclouds(folder,
 
     # check if we have pv
     has_pv = False
-    try:
-        if __name__ == '__main__':
-            extract_tar_file(str(folder / 'PV.tar'), folder / 'PV')
-    except FileNotFoundError:
-        pass
-
     pv_info_path = sorted(folder.glob(r'*pv.txt'))
     has_pv = len(list(pv_info_path)) > 0
     if has_pv:
         (pv_timestamps, focal_lengths, pv2world_transforms, ox,
          oy, _, _) = load_pv_data(list(pv_info_path)[0])
         principal_point = np.array([ox, oy])
+        pv_images = PVImages(folder)
     else:
-        pv_timestamps = focal_lengths = pv2world_transforms = ox = oy = principal_point = None
+        pv_timestamps = focal_lengths = pv2world_transforms = ox = oy = principal_point = pv_images = None
 
     # lookup table to extract xyz from depth
     lut = load_lut(calib_path)
@@ -281,8 +338,8 @@ def save_pclouds(folder,
     rig2cam = load_extrinsics(rig2campath)
 
     # from rig to world transformations (one per frame)
-    rig2world_transforms = load_rig2world_transforms(
-        rig2world_path) if rig2world_path != '' and Path(rig2world_path).exists() else None
+    rig2world_timestamps, rig2world_transforms = load_rig2world_transforms(
+        rig2world_path) if rig2world_path != '' and Path(rig2world_path).exists() else (None, None)
     depth_path = Path(folder / sensor_name)
     depth_path.mkdir(exist_ok=True)
 
@@ -298,43 +355,129 @@ def save_pclouds(folder,
         pinhole_folder_depth = pinhole_folder / 'depth'
         pinhole_folder_depth.mkdir(exist_ok=True)
 
-    # Extract tar only when calling the script directly
-    if __name__ == '__main__':
-        extract_tar_file(str(folder / '{}.tar'.format(sensor_name)), str(depth_path))
-
     # Depth path suffix used for now only if we load masked AHAT
     depth_paths = sorted(depth_path.glob('*[0-9]{}.pgm'.format(depth_path_suffix)))
+
+    # If the depth frames were not extracted, stream them from the tarball
+    depth_reader = None
+    if len(depth_paths) == 0 and depth_path_suffix == '':
+        depth_reader = open_frame_reader(folder, sensor_name)
+        if depth_reader is not None:
+            depth_paths = [depth_path / name for name in depth_reader.names('*[0-9].pgm')]
     assert len(list(depth_paths)) > 0 
 
-    # Create shared dictionary to save odometry and file list
-    manager = multiprocessing.Manager()
-    shared_dict = manager.dict()
-
-    multiprocess_pool = multiprocessing.Pool(multiprocessing.cpu_count())
-    for path in depth_paths:
-        multiprocess_pool.apply_async(
-            save_single_pcloud(shared_dict,
-                               path,
-                               folder,
-                               pinhole_folder,
-                               save_in_cam_space,
-                               lut,
-                               has_pv,
-                               focal_lengths,
-                               principal_point,
-                               rig2world_transforms,
-                               rig2cam,
-                               pv_timestamps,
-                               pv2world_transforms,
-                               discard_no_rgb,
-                               clamp_min,
-                               clamp_max,
-                               depth_path_suffix,
-                               disable_project_pinhole
-                               )
-        )
-    multiprocess_pool.close()
-    multiprocess_pool.join()
+    depth_timestamps = [extract_timestamp(path.name.replace(depth_path_suffix, ''))
+                        for path in depth_paths]
+
+    # Look up the rig2world transform saved for every depth frame
+    if rig2world_transforms is not None and len(rig2world_transforms):
+        rig2world_ids = TimestampIndex(rig2world_timestamps).within(depth_timestamps, 0)
+        rig2world_per_frame = [rig2world_transforms[i] if i >= 0 else None for i in rig2world_ids]
+    else:
+        rig2world_per_frame = [None] * len(depth_paths)
+
+    # Match every depth frame to the closest pv frame in one batch
+    if has_pv:
+        # Only the pv.txt rows with a converted frame are matched: frames
+        # dropped while streaming are listed by older recordings, without an image
+        pv_ids = np.flatnonzero([pv_images.source_path(ts) is not None for ts in pv_timestamps])
+        assert len(pv_ids) > 0, 'No converted PV frame, run convert_images.py first'
+        pv_target_ids = pv_ids[TimestampIndex(pv_timestamps[pv_ids]).nearest(depth_timestamps)]
+    else:
+        pv_target_ids = [None] * len(depth_paths)
+
+    # Dictionary to save odometry and file list
+    shared_dict = {}
+
+    stage = 'pclouds:{}'.format(sensor_name)
+    stage_params = {'cam_space': save_in_cam_space, 'discard_no_rgb': discard_no_rgb,
+                    'clamp_min': clamp_min, 'clamp_max': clamp_max,
+                    'depth_path_suffix': depth_path_suffix,
+                    'project_pinhole': not disable_project_pinhole,
+                    'normals': normals_mode}
+    if manifest is not None:
+        # Frame independent inputs are part of the parameters
+        stage_params['lut'] = manifest.fingerprint_file(calib_path)
+        stage_params['extrinsics'] = manifest.fingerprint_file(rig2campath)
+
+    # The fused cloud depends on every frame, it is either up to date or fully recomputed
+    voxel_grid = None
+    if fuse_voxel_size > 0:
+        stage_params['fuse_voxel_size'] = fuse_voxel_size
+        fused_path = folder / '{}_fused.ply'.format(sensor_name)
+        if manifest is not None:
+            fused_inputs = {path.name: pcloud_inputs(manifest, path, depth_reader, frame_rig2world, has_pv,
+                                                     pv_images, pv_timestamps, pv_target_id, focal_lengths,
+                                                     pv2world_transforms)
+                            for path, frame_rig2world, pv_target_id
+                            in zip(depth_paths, rig2world_per_frame, pv_target_ids)}
+            if manifest.is_up_to_date(stage, fused_path, fused_inputs, stage_params):
+                print('{} is up to date'.format(fused_path))
+                return
+        voxel_grid = VoxelGrid(fuse_voxel_size, colors=has_pv, normals=True)
+
+    # Frames are processed one after the other: the manifest entry of a frame
+    # is recorded once its cloud is written, and the fused cloud is only ever
+    # accumulated here, from the points the frames return
+    for path, frame_rig2world, pv_target_id in zip(depth_paths, rig2world_per_frame, pv_target_ids):
+        output_path = pcloud_output_path(path, save_in_cam_space)
+        if manifest is not None and voxel_grid is None:
+            inputs = pcloud_inputs(manifest, path, depth_reader, frame_rig2world, has_pv, pv_images,
+                                   pv_timestamps, pv_target_id, focal_lengths, pv2world_transforms)
+            if manifest.is_up_to_date(stage, output_path, inputs, stage_params):
+                # Restore the odometry entry of the skipped frame
+                entry = manifest.extra(output_path)
+                if entry is not None:
+                    shared_dict[path.stem] = [Path(entry[0]), Path(entry[1]),
+                                              np.array(entry[2]), np.array(entry[3])]
+                continue
+        points = save_single_pcloud(shared_dict,
+                                    path,
+                                    pv_images,
+                                    pinhole_folder,
+                                    save_in_cam_space,
+                                    lut,
+                                    has_pv,
+                                    focal_lengths,
+                                    principal_point,
+                                    frame_rig2world,
+                                    rig2cam,
+                                    pv_timestamps,
+                                    pv_target_id,
+                                    pv2world_transforms,
+                                    discard_no_rgb,
+                                    clamp_min,
+                                    clamp_max,
+                                    depth_path_suffix,
+                                    disable_project_pinhole,
+                                    depth_reader,
+                                    normals_mode,
+                                    voxel_grid is not None
+                                    )
+        if voxel_grid is not None:
+            if points is not None:
+                voxel_grid.add(*points)
+            continue
+        if manifest is not None and Path(output_path).exists():
+            entry, extra_outputs = shared_dict.get(path.stem), []
+            if entry is not None:
+                extra_outputs = [pinhole_folder / entry[0], pinhole_folder / entry[1]]
+                entry = [entry[0].as_posix(), entry[1].as_posix(),
+                         entry[2].tolist(), entry[3].tolist()]
+            manifest.record(stage, output_path, inputs, stage_params, entry, extra_outputs)
+
+    if pv_images is not None:
+        pv_images.close()
+
+    if voxel_grid is not None:
+        fused = voxel_grid.extract()
+        print("")
+        print('Fused {} frames in {} voxels of {}m'.format(len(depth_paths), len(voxel_grid), fuse_voxel_size))
+        write_ply(fused_path, fused['points'], fused.get('colors'), fused['normals'])
+        if manifest is not None:
+            manifest.record(stage, fused_path, fused_inputs, stage_params)
+    if manifest is not None:
+        manifest.save()
 
     if not disable_project_pinhole and has_pv:
         save_output_txt_files(pinhole_folder, shared_dict)
@@ -376,8 +519,22 @@ if __name__ == '__main__':
                         choices=["", "_masked"],
                         help="Specify the suffix for depth img filenames, in order"
                              "to work on postprocessed ones (e.g. masked AHAT)")
+    parser.add_argument("--normals",
+                        default='organized',
+                        choices=NORMALS_MODES,
+                        help="Estimate normals from the depth image grid (fast) "
+                             "or from the nearest neighbors of every point")
+    parser.add_argument("--fuse_voxel_size",
+                        type=float,
+                        default=0.,
+                        help="Fuse all the frames in a single <sensor>_fused.ply, downsampled on a voxel "
+                             "grid of this size in meters, instead of saving one cloud per frame")
+    parser.add_argument("--force",
+                        action='store_true',
+                        help="Recompute every point cloud, ignoring the stage manifest")
 
     args = parser.parse_args()
+    manifest = StageManifest(Path(args.recording_path), force=args.force)
     for sensor_name in ["Depth Long Throw", "Depth AHaT"]:
         if (Path(args.recording_path) / f"{sensor_name}.tar").exists():
             save_pclouds(Path(args.recording_path),
@@ -387,4 +544,7 @@ if __name__ == '__main__':
                          args.clamp_min,
                          args.clamp_max,
                          args.depth_path_suffix,
-                         args.disable_project_pinhole)
+                         args.disable_project_pinhole,
+                         manifest,
+                         args.normals,
+                         args.fuse_voxel_size)
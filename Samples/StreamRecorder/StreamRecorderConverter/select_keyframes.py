@@ -0,0 +1,170 @@
+"""
+ Copyright (c) Microsoft. All rights reserved.
+ This code is licensed under the MIT License (MIT).
+ THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+ ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+ IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+ PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+"""
+import argparse
+from pathlib import Path
+
+import cv2
+import numpy as np
+
+from utils import DEPTH_SCALING_FACTOR, load_image_list, load_odometry
+
+# Suffix of the reduced odometry and image lists, e.g. odometry_keyframes.log
+KEYFRAMES_SUFFIX = '_keyframes'
+
+
+def pose_delta(cam2world, reference_cam2world):
+    """Translation (meters) and rotation angle (degrees) between two poses."""
+    relative = np.linalg.inv(reference_cam2world) @ cam2world
+    translation = np.linalg.norm(relative[:3, 3])
+    cos_angle = np.clip((np.trace(relative[:3, :3]) - 1.) / 2., -1., 1.)
+    return translation, np.degrees(np.arccos(cos_angle))
+
+
+def depth_overlap(depth, cam2world, reference_depth, reference_cam2world, intrinsics,
+                  depth_scale=DEPTH_SCALING_FACTOR, depth_trunc=7.8, stride=4, tolerance=0.05):
+    """Fraction of the valid depth pixels of a frame that are also seen, at a
+    consistent depth (within tolerance * depth), by the reference frame.
+
+    Only one pixel every stride rows and columns is tested.
+    """
+    fx, fy, cx, cy = intrinsics
+    depth = depth[::stride, ::stride].astype(np.float32) / depth_scale
+    v, u = np.nonzero((depth > 0) & (depth <= depth_trunc))
+    if len(u) == 0:
+        return 1.
+    z = depth[v, u]
+    u = u * stride
+    v = v * stride
+    points = np.stack(((u - cx) / fx * z, (v - cy) / fy * z, z), axis=1)
+
+    cam2reference = np.linalg.inv(reference_cam2world) @ cam2world
+    points = points @ cam2reference[:3, :3].T + cam2reference[:3, 3]
+    in_front = points[:, 2] > 1e-6
+    points = points[in_front]
+    pixel_u = np.rint(fx * points[:, 0] / points[:, 2] + cx).astype(np.int64)
+    pixel_v = np.rint(fy * points[:, 1] / points[:, 2] + cy).astype(np.int64)
+    height, width = reference_depth.shape
+    inside = (pixel_u >= 0) & (pixel_u < width) & (pixel_v >= 0) & (pixel_v < height)
+
+    reference_z = reference_depth[pixel_v[inside], pixel_u[inside]] / depth_scale
+    projected_z = points[inside, 2]
+    consistent = (reference_z > 0) & (np.abs(reference_z - projected_z) <= tolerance * projected_z)
+    return np.count_nonzero(consistent) / len(z)
+
+
+class KeyframeSelector(object):
+    """Keep a frame when the camera moved or turned enough since the last
+    keyframe, or when too little of its depth is explained by the last keyframe.
+
+    The overlap test is only run when the pose deltas are below the thresholds.
+    """
+
+    def __init__(self, intrinsics, max_translation=0.1, max_rotation=10., min_overlap=0.8,
+                 depth_scale=DEPTH_SCALING_FACTOR, depth_trunc=7.8):
+        self.intrinsics = intrinsics
+        self.max_translation = max_translation
+        self.max_rotation = max_rotation
+        self.min_overlap = min_overlap
+        self.depth_scale = depth_scale
+        self.depth_trunc = depth_trunc
+        self.keyframe_pose = None
+        self.keyframe_depth = None
+        self.frame_count = 0
+        self.keyframe_count = 0
+
+    def is_keyframe(self, cam2world, depth):
+        self.frame_count += 1
+        keyframe = self.keyframe_pose is None
+        if not keyframe:
+            translation, rotation = pose_delta(cam2world, self.keyframe_pose)
+            keyframe = translation > self.max_translation or rotation > self.max_rotation
+        if not keyframe and self.min_overlap > 0:
+            overlap = depth_overlap(depth, cam2world, self.keyframe_depth, self.keyframe_pose,
+                                    self.intrinsics, self.depth_scale, self.depth_trunc)
+            keyframe = overlap < self.min_overlap
+        if keyframe:
+            self.keyframe_pose = cam2world
+            self.keyframe_depth = depth
+            self.keyframe_count += 1
+        return keyframe
+
+    def report(self):
+        skipped = self.frame_count - self.keyframe_count
+        return (f"Kept {self.keyframe_count} keyframes out of {self.frame_count} frames, "
+                f"skipped {skipped} ({100. * skipped / max(self.frame_count, 1):.1f}%)")
+
+
+def add_keyframe_arguments(parser):
+    parser.add_argument("--max_translation",
+                        required=False,
+                        default=0.1,
+                        type=float,
+                        help="Keep a frame when the camera moved more than this (meters) "
+                        "since the last keyframe")
+    parser.add_argument("--max_rotation",
+                        required=False,
+                        default=10.,
+                        type=float,
+                        help="Keep a frame when the camera turned more than this (degrees) "
+                        "since the last keyframe")
+    parser.add_argument("--min_overlap",
+                        required=False,
+                        default=0.8,
+                        type=float,
+                        help="Keep a frame when less than this fraction of its depth pixels "
+                        "is seen by the last keyframe (0 to only use the pose)")
+
+
+def save_keyframe_lists(pinhole_path, keyframes, suffix=KEYFRAMES_SUFFIX):
+    """Write odometry, rgb and depth lists of the keyframes only, in the
+    format of save_pclouds.py, next to the full lists."""
+    poses = load_odometry(pinhole_path / 'odometry.log')
+    rgb_list = load_image_list(pinhole_path / 'rgb.txt')
+    depth_list = load_image_list(pinhole_path / 'depth.txt')
+    with open(str(pinhole_path / f'odometry{suffix}.log'), 'w') as of, \
+            open(str(pinhole_path / f'rgb{suffix}.txt'), 'w') as rf, \
+            open(str(pinhole_path / f'depth{suffix}.txt'), 'w') as df:
+        for i, frame in enumerate(keyframes):
+            rf.write(f"{rgb_list[frame][0]} {rgb_list[frame][1]}\n")
+            df.write(f"{depth_list[frame][0]} {depth_list[frame][1]}\n")
+            of.write(f"{i} {i} {i}\n")
+            for row in poses[frame]:
+                of.write(' '.join(map(str, row)) + '\n')
+
+
+def select_keyframes(pinhole_path, max_translation=0.1, max_rotation=10., min_overlap=0.8):
+    """Indices of the keyframes of a pinhole projection folder."""
+    poses = load_odometry(pinhole_path / 'odometry.log')
+    depth_list = load_image_list(pinhole_path / 'depth.txt')
+    intrinsics = np.loadtxt(str(pinhole_path / 'calibration.txt'))
+    selector = KeyframeSelector(intrinsics, max_translation, max_rotation, min_overlap)
+    keyframes = []
+    for i in range(min(len(poses), len(depth_list))):
+        depth = None
+        if selector.min_overlap > 0:
+            depth = cv2.imread(str(pinhole_path / depth_list[i][1]), cv2.IMREAD_UNCHANGED)
+        if selector.is_keyframe(poses[i], depth):
+            keyframes.append(i)
+    print(selector.report())
+    return keyframes
+
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(
+        description='Select the keyframes of a pinhole projection folder, and write '
+        f'odometry{KEYFRAMES_SUFFIX}.log, rgb{KEYFRAMES_SUFFIX}.txt and depth{KEYFRAMES_SUFFIX}.txt')
+    parser.add_argument("--pinhole_path",
+                        required=True,
+                        help="Path to folder inside recording containing pinhole projected images")
+    add_keyframe_arguments(parser)
+    args = parser.parse_args()
+
+    pinhole_path = Path(args.pinhole_path)
+    keyframes = select_keyframes(pinhole_path, args.max_translation, args.max_rotation, args.min_overlap)
+    save_keyframe_lists(pinhole_path, keyframes)
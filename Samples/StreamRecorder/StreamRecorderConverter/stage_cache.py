@@ -0,0 +1,144 @@
+"""
+ Copyright (c) Microsoft. All rights reserved.
+ This code is licensed under the MIT License (MIT).
+ THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+ ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+ IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+ PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+"""
+import os
+import json
+import hashlib
+from pathlib import Path
+
+import numpy as np
+
+from tar_reader import read_member
+
+MANIFEST_NAME = 'stage_manifest.json'
+# Number of new records after which the manifest is saved,
+# so that an interrupted run only redoes the last few frames
+SAVE_INTERVAL = 100
+
+
+def hash_bytes(data):
+    return hashlib.sha1(data).hexdigest()
+
+
+def hash_array(array):
+    """Fingerprint of in-memory values, e.g. the pose of a single frame."""
+    return hash_bytes(np.ascontiguousarray(array).tobytes())
+
+
+class StageManifest(object):
+    """Manifest of the outputs produced by the converter stages of a recording.
+
+    Every output (keyed by its path relative to the recording folder) records
+    the stage that produced it, the fingerprints of its inputs and the stage
+    parameters. An output is up to date only if it still exists and both its
+    inputs and parameters are unchanged, so re-runs only redo invalidated frames.
+
+    Input fingerprints are size + mtime for files, and the size + mtime of the
+    tarball with the offset + size of the member for tarball members, so that a
+    tarball recorded again with the same layout is not taken for the old one;
+    with use_hash they are content hashes instead, which survives re-downloading
+    a recording at the cost of reading every input.
+    """
+
+    def __init__(self, folder, use_hash=False, force=False):
+        self.folder = Path(folder)
+        self.path = self.folder / MANIFEST_NAME
+        self.use_hash = use_hash
+        # With force every output is considered stale, but the manifest is rebuilt
+        self.force = force
+        self.records = {}
+        self._file_fingerprints = {}
+        self._unsaved = 0
+        if self.path.exists():
+            try:
+                with open(str(self.path)) as f:
+                    self.records = json.load(f)
+            except ValueError:
+                print('Ignoring corrupted manifest {}'.format(self.path))
+
+    def _key(self, output_path):
+        path = Path(output_path)
+        try:
+            path = path.relative_to(self.folder)
+        except ValueError:
+            pass
+        return path.as_posix()
+
+    def fingerprint_file(self, path):
+        path = str(path)
+        if path not in self._file_fingerprints:
+            if not os.path.exists(path):
+                fingerprint = None
+            elif self.use_hash:
+                with open(path, 'rb') as f:
+                    fingerprint = hash_bytes(f.read())
+            else:
+                stat = os.stat(path)
+                fingerprint = '{}:{}'.format(stat.st_size, stat.st_mtime_ns)
+            self._file_fingerprints[path] = fingerprint
+        return self._file_fingerprints[path]
+
+    def fingerprint_member(self, tar_path, offset, size):
+        if self.use_hash:
+            return hash_bytes(read_member(tar_path, offset, size))
+        return '{}:{}:{}'.format(self.fingerprint_file(tar_path), offset, size)
+
+    def fingerprint_frame(self, reader, name, path):
+        """Fingerprint a frame read from a TarFrameReader, or from path if reader is None."""
+        if reader is None:
+            return self.fingerprint_file(path)
+        offset, size = reader.locate(name)
+        return self.fingerprint_member(str(reader.tar_path), offset, size)
+
+    def is_up_to_date(self, stage, output_path, inputs, params):
+        if self.force:
+            return False
+        record = self.records.get(self._key(output_path))
+        if record is None or record['stage'] != stage:
+            return False
+        if record['inputs'] != inputs or record['params'] != _normalize(params):
+            return False
+        if record['output'] != self.fingerprint_output(output_path):
+            return False
+        return all(os.path.exists(str(self.folder / p)) for p in record.get('extra_outputs', []))
+
+    def fingerprint_output(self, output_path):
+        if not os.path.exists(str(output_path)):
+            return None
+        stat = os.stat(str(output_path))
+        return '{}:{}'.format(stat.st_size, stat.st_mtime_ns)
+
+    def record(self, stage, output_path, inputs, params, extra=None, extra_outputs=()):
+        """Record an output written by stage. extra holds stage data to restore on skip."""
+        self.records[self._key(output_path)] = {
+            'stage': stage,
+            'inputs': inputs,
+            'params': _normalize(params),
+            'output': self.fingerprint_output(output_path),
+            'extra': extra,
+            'extra_outputs': [self._key(p) for p in extra_outputs]}
+        self._unsaved += 1
+        if self._unsaved >= SAVE_INTERVAL:
+            self.save()
+
+    def extra(self, output_path):
+        record = self.records.get(self._key(output_path))
+        return None if record is None else record.get('extra')
+
+    def save(self):
+        # Write to a temporary file first, so that a crash never leaves a truncated manifest
+        tmp_path = self.path.with_suffix('.tmp')
+        with open(str(tmp_path), 'w') as f:
+            json.dump(self.records, f)
+        os.replace(str(tmp_path), str(self.path))
+        self._unsaved = 0
+
+
+def _normalize(params):
+    # Compare parameters as they come back from json (tuples become lists, ...)
+    return json.loads(json.dumps(params, sort_keys=True))
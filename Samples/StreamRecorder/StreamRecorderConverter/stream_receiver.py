@@ -0,0 +1,198 @@
+"""
+ Copyright (c) Microsoft. All rights reserved.
+ This code is licensed under the MIT License (MIT).
+ THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+ ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+ IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+ PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+"""
+import time
+import socket
+import struct
+import tarfile
+import argparse
+from pathlib import Path
+
+# Framed protocol of StreamRecorderApp/StreamClient.h: every message is a header,
+# followed by path_size bytes of UTF-8 path and data_size bytes of data
+MESSAGE_HEADER = struct.Struct('<4sHHIIQ')  # magic, type, channel, path_size, reserved, data_size
+MESSAGE_MAGIC = b'RMST'
+
+MSG_BEGIN = 1        # path: name of the recording folder
+MSG_END = 2          # the recording is complete
+MSG_TAR_FILE = 3     # path: <tarball>/<file>, appended to the tarball
+MSG_FILE = 4         # path: <file>, created or replaced
+MSG_FILE_APPEND = 5  # path: <file>, data appended to it
+MSG_ACK = 6          # receiver to sender: data_size bytes of the channel were written
+
+DEFAULT_PORT = 23940
+
+TAR_BLOCK = 512
+
+
+class ProtocolError(Exception):
+    pass
+
+
+def check_name(name):
+    """Paths come from the network: only plain file names are accepted."""
+    if not name or name in ('.', '..') or Path(name).name != name or '\\' in name:
+        raise ProtocolError('Invalid file name: {!r}'.format(name))
+    return name
+
+
+class RecordingWriter(object):
+    """Writes a streamed recording with the layout of a recording saved on the device,
+    so that it can be processed by process_all.py as a downloaded one."""
+
+    def __init__(self, folder):
+        self.folder = Path(folder)
+        self.folder.mkdir(parents=True, exist_ok=True)
+        self.tarballs = {}
+        self.file_counts = {}
+        self.byte_count = 0
+
+    def add_tar_file(self, tar_name, name, data):
+        tarball = self.tarballs.get(tar_name)
+        if tarball is None:
+            tarball = open(str(self.folder / check_name(tar_name)), 'wb')
+            self.tarballs[tar_name] = tarball
+            self.file_counts[tar_name] = 0
+
+        # Same members as Io::Tarball on the device: ustar header, data, zero padding
+        info = tarfile.TarInfo(check_name(name))
+        info.size = len(data)
+        info.mtime = int(time.time())
+        info.mode = 0o777
+        tarball.write(info.tobuf(format=tarfile.USTAR_FORMAT))
+        tarball.write(data)
+        padding = -len(data) % TAR_BLOCK
+        if padding:
+            tarball.write(bytes(padding))
+        self.file_counts[tar_name] += 1
+        self.byte_count += len(data)
+
+    def write_file(self, name, data, append=False):
+        with open(str(self.folder / check_name(name)), 'ab' if append else 'wb') as f:
+            f.write(data)
+        self.byte_count += len(data)
+
+    def close(self):
+        for tarball in self.tarballs.values():
+            # The tarball always ends with two blocks of zeros
+            tarball.write(bytes(2 * TAR_BLOCK))
+            tarball.close()
+        self.tarballs = {}
+
+
+class Connection(object):
+    def __init__(self, sock):
+        self.sock = sock
+        self.buffer = bytearray(1 << 20)
+
+    def recv_exact(self, size):
+        """Receive size bytes into the reused buffer, returns a view on them."""
+        if size > len(self.buffer):
+            self.buffer = bytearray(max(size, 2 * len(self.buffer)))
+        view = memoryview(self.buffer)[:size]
+        received = 0
+        while received < size:
+            count = self.sock.recv_into(view[received:], size - received)
+            if count == 0:
+                raise ConnectionError('Connection closed')
+            received += count
+        return view
+
+    def recv_message(self):
+        magic, msg_type, channel, path_size, _, data_size = MESSAGE_HEADER.unpack(
+            self.recv_exact(MESSAGE_HEADER.size))
+        if magic != MESSAGE_MAGIC:
+            raise ProtocolError('Invalid message header')
+        path = bytes(self.recv_exact(path_size)).decode('utf-8')
+        data = self.recv_exact(data_size)
+        return msg_type, channel, path, data, MESSAGE_HEADER.size + path_size + data_size
+
+    def send_ack(self, channel, byte_count):
+        self.sock.sendall(MESSAGE_HEADER.pack(MESSAGE_MAGIC, MSG_ACK, channel, 0, 0, byte_count))
+
+
+def receive_recording(sock, output_path):
+    """Handle the messages of one connection, returns the recording folder."""
+    connection = Connection(sock)
+    writer = None
+    folder = None
+    start = time.time()
+    try:
+        while True:
+            try:
+                msg_type, channel, path, data, message_size = connection.recv_message()
+            except ConnectionError:
+                if writer is not None:
+                    print('Connection lost, the recording is incomplete')
+                break
+
+            if msg_type == MSG_BEGIN:
+                if writer is not None:
+                    writer.close()
+                writer = RecordingWriter(Path(output_path) / check_name(path))
+                folder = writer.folder
+                start = time.time()
+                print('Receiving {}'.format(writer.folder))
+            elif writer is None:
+                raise ProtocolError('Message before the beginning of a recording')
+            elif msg_type == MSG_TAR_FILE:
+                tar_name, _, name = path.partition('/')
+                writer.add_tar_file(tar_name, name, data)
+            elif msg_type in (MSG_FILE, MSG_FILE_APPEND):
+                writer.write_file(path, data, append=msg_type == MSG_FILE_APPEND)
+            elif msg_type == MSG_END:
+                writer.close()
+                elapsed = max(time.time() - start, 1e-6)
+                for tar_name, count in sorted(writer.file_counts.items()):
+                    print('  {}: {} files'.format(tar_name, count))
+                print('Received {:.1f} MB in {:.1f} s ({:.1f} MB/s)'.format(
+                    writer.byte_count / 1e6, elapsed, writer.byte_count / 1e6 / elapsed))
+                writer = None
+            else:
+                raise ProtocolError('Unknown message type {}'.format(msg_type))
+
+            # The sender keeps at most a window of unacknowledged bytes per channel
+            connection.send_ack(channel, message_size)
+    finally:
+        if writer is not None:
+            writer.close()
+    return folder
+
+
+def serve(output_path, host='0.0.0.0', port=DEFAULT_PORT, once=False):
+    with socket.socket(socket.AF_INET, socket.SOCK_STREAM) as server:
+        server.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+        server.bind((host, port))
+        server.listen(1)
+        print('Waiting for recordings on port {}'.format(port))
+        while True:
+            sock, address = server.accept()
+            print('Connection from {}'.format(address[0]))
+            with sock:
+                sock.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, 4 * 1024 * 1024)
+                try:
+                    receive_recording(sock, output_path)
+                except ProtocolError as e:
+                    print('Closing the connection: {}'.format(e))
+            if once:
+                break
+
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(description='Receive recordings streamed by StreamRecorderApp')
+    parser.add_argument("--output_path", required=True,
+                        help="Folder where the recording folders are written")
+    parser.add_argument("--host", default='0.0.0.0',
+                        help="Address to listen on")
+    parser.add_argument("--port", type=int, default=DEFAULT_PORT,
+                        help="Port to listen on, AppMain::kStreamingPort in the app")
+    parser.add_argument("--once", action='store_true',
+                        help="Exit after the first connection")
+    args = parser.parse_args()
+
+    serve(args.output_path, args.host, args.port, args.once)
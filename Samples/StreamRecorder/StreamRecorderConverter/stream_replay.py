@@ -0,0 +1,131 @@
+"""
+ Copyright (c) Microsoft. All rights reserved.
+ This code is licensed under the MIT License (MIT).
+ THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+ ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+ IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+ PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+"""
+import time
+import socket
+import tarfile
+import argparse
+import threading
+from pathlib import Path
+
+from stream_receiver import (MESSAGE_HEADER, MESSAGE_MAGIC, MSG_BEGIN, MSG_END, MSG_TAR_FILE,
+                             MSG_FILE, MSG_ACK, DEFAULT_PORT)
+
+# Same window as Io::StreamClient::kDefaultWindowBytes
+DEFAULT_WINDOW_BYTES = 8 * 1024 * 1024
+
+
+class StreamSender(object):
+    """Sender side of the streaming protocol, as Io::StreamClient in the app:
+    one window of unacknowledged bytes per channel, messages sent with a
+    single gathering sendmsg call."""
+
+    def __init__(self, host, port, window_bytes=DEFAULT_WINDOW_BYTES):
+        self.sock = socket.create_connection((host, port))
+        self.window_bytes = window_bytes
+        self.in_flight = {}
+        self.condition = threading.Condition()
+        self.connected = True
+        self.ack_thread = threading.Thread(target=self._receive_acks, daemon=True)
+        self.ack_thread.start()
+
+    def _receive_acks(self):
+        header = bytearray(MESSAGE_HEADER.size)
+        try:
+            while True:
+                view = memoryview(header)
+                while len(view):
+                    count = self.sock.recv_into(view)
+                    if count == 0:
+                        raise ConnectionError('Connection closed')
+                    view = view[count:]
+                magic, msg_type, channel, _, _, byte_count = MESSAGE_HEADER.unpack(header)
+                if magic != MESSAGE_MAGIC or msg_type != MSG_ACK:
+                    break
+                with self.condition:
+                    self.in_flight[channel] -= byte_count
+                    self.condition.notify_all()
+        except OSError:
+            pass
+        with self.condition:
+            self.connected = False
+            self.condition.notify_all()
+
+    def send(self, channel, msg_type, path, data=b''):
+        path = path.encode('utf-8')
+        header = MESSAGE_HEADER.pack(MESSAGE_MAGIC, msg_type, channel, len(path), 0, len(data))
+        size = len(header) + len(path) + len(data)
+        with self.condition:
+            # A message larger than the window goes alone
+            self.condition.wait_for(lambda: not self.connected or self.in_flight.get(channel, 0) == 0 or
+                                    self.in_flight[channel] + size <= self.window_bytes)
+            if not self.connected:
+                raise ConnectionError('Connection lost')
+            self.in_flight[channel] = self.in_flight.get(channel, 0) + size
+
+        buffers = [memoryview(header), memoryview(path), memoryview(data)]
+        while buffers:
+            sent = self.sock.sendmsg(buffers)
+            while buffers and sent >= len(buffers[0]):
+                sent -= len(buffers[0])
+                buffers.pop(0)
+            if buffers:
+                buffers[0] = buffers[0][sent:]
+
+    def close(self, timeout=10.0):
+        with self.condition:
+            self.condition.wait_for(lambda: not self.connected or not any(self.in_flight.values()), timeout)
+        self.sock.shutdown(socket.SHUT_RDWR)
+        self.sock.close()
+        self.ack_thread.join()
+
+
+def replay_recording(recording_path, host='127.0.0.1', port=DEFAULT_PORT, name=None):
+    """Send a downloaded recording as the app streams it: the tarball members
+    one by one, one channel per tarball, then the other files."""
+    recording_path = Path(recording_path)
+    sender = StreamSender(host, port)
+    start = time.time()
+    byte_count = 0
+
+    sender.send(0, MSG_BEGIN, name or recording_path.name)
+    tar_paths = sorted(recording_path.glob('*.tar'))
+    for channel, tar_path in enumerate(tar_paths, start=1):
+        with tarfile.open(str(tar_path), mode='r:') as tar:
+            for member in tar:
+                if member.isfile():
+                    data = tar.extractfile(member).read()
+                    sender.send(channel, MSG_TAR_FILE, '{}/{}'.format(tar_path.name, member.name), data)
+                    byte_count += len(data)
+
+    for file_path in sorted(recording_path.iterdir()):
+        if file_path.is_file() and file_path.suffix != '.tar':
+            data = file_path.read_bytes()
+            sender.send(0, MSG_FILE, file_path.name, data)
+            byte_count += len(data)
+
+    sender.send(0, MSG_END, '')
+    sender.close()
+    elapsed = max(time.time() - start, 1e-6)
+    print('Sent {:.1f} MB in {:.1f} s ({:.1f} MB/s)'.format(byte_count / 1e6, elapsed, byte_count / 1e6 / elapsed))
+
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(
+        description='Stream a downloaded recording to stream_receiver.py, as the app does')
+    parser.add_argument("--recording_path", required=True,
+                        help="Path to recording folder")
+    parser.add_argument("--host", default='127.0.0.1',
+                        help="Host running stream_receiver.py")
+    parser.add_argument("--port", type=int, default=DEFAULT_PORT,
+                        help="Port of stream_receiver.py")
+    parser.add_argument("--name", default=None,
+                        help="Name of the received recording folder, the same by default")
+    args = parser.parse_args()
+
+    replay_recording(args.recording_path, args.host, args.port, args.name)
@@ -0,0 +1,97 @@
+"""
+ Copyright (c) Microsoft. All rights reserved.
+ This code is licensed under the MIT License (MIT).
+ THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+ ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+ IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+ PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+"""
+import re
+import tarfile
+from fnmatch import fnmatch
+from pathlib import Path
+
+import numpy as np
+
+# PGM files written by the app: "P5\n<width> <height>\n<max value>\n<pixels>"
+PGM_HEADER = re.compile(rb'P5\s+(\d+)\s+(\d+)\s+(\d+)\s')
+
+
+def decode_pgm(data):
+    """Decode a binary PGM in memory, 16-bit images are big endian."""
+    match = PGM_HEADER.match(data)
+    assert match is not None, 'Not a binary PGM'
+    width, height, max_value = (int(v) for v in match.groups())
+    dtype = np.dtype('>u2') if max_value > 255 else np.dtype(np.uint8)
+    image = np.frombuffer(data, dtype=dtype, count=width * height, offset=match.end())
+    image = image.reshape((height, width))
+    return image.astype(np.uint16) if max_value > 255 else image
+
+
+def read_member(tar_path, offset, size):
+    with open(tar_path, 'rb') as f:
+        f.seek(offset)
+        return f.read(size)
+
+
+def frame_timestamp(name):
+    # Frames are named <timestamp>.<ext> or <timestamp>_<suffix>.<ext>
+    return int(Path(name).name.split('.')[0].split('_')[0])
+
+
+class TarFrameReader(object):
+    """Random access to the frames of a recording tarball, without extracting it.
+
+    The tarballs written by the app are uncompressed, so the reader only
+    scans the headers once to build a name -> (data offset, size) index, then
+    reads every frame with a single seek. The reader can be pickled; each
+    process reopens the tarball on first access.
+    """
+
+    def __init__(self, tar_path):
+        self.tar_path = Path(tar_path)
+        self.members = {}
+        with tarfile.open(str(self.tar_path), mode='r:') as tar:
+            for member in tar:
+                if member.isfile():
+                    self.members[member.name] = (member.offset_data, member.size)
+        self._file = None
+
+    def __getstate__(self):
+        state = self.__dict__.copy()
+        state['_file'] = None
+        return state
+
+    def __len__(self):
+        return len(self.members)
+
+    def __contains__(self, name):
+        return name in self.members
+
+    def close(self):
+        if self._file is not None:
+            self._file.close()
+            self._file = None
+
+    def names(self, pattern='*'):
+        """Sorted member names matching a glob pattern, e.g. '*[0-9].pgm'."""
+        return sorted(name for name in self.members if fnmatch(name, pattern))
+
+    def locate(self, name):
+        return self.members[name]
+
+    def read_bytes(self, name):
+        if self._file is None:
+            self._file = open(str(self.tar_path), 'rb')
+        offset, size = self.members[name]
+        self._file.seek(offset)
+        return self._file.read(size)
+
+    def read_pgm(self, name):
+        return decode_pgm(self.read_bytes(name))
+
+
+def open_frame_reader(folder, stream_name):
+    """Reader for <folder>/<stream_name>.tar, or None if the tarball is missing."""
+    tar_path = Path(folder) / '{}.tar'.format(stream_name)
+    return TarFrameReader(tar_path) if tar_path.exists() else None
@@ -0,0 +1,68 @@
+"""
+ Copyright (c) Microsoft. All rights reserved.
+ This code is licensed under the MIT License (MIT).
+ THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+ ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+ IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+ PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+"""
+import numpy as np
+
+
+class TimestampIndex(object):
+    """Sorted view over the timestamps of one stream.
+
+    Timestamps are presorted once, then every query is answered with a binary
+    search. Queries accept a scalar or an array of timestamps; the returned
+    ids always refer to positions in the array passed to the constructor,
+    so they can be used to index the other per-frame arrays of that stream.
+    Missing matches are reported as -1.
+    """
+
+    def __init__(self, timestamps):
+        self.timestamps = np.asarray(timestamps).astype(np.int64).ravel()
+        self.order = np.argsort(self.timestamps, kind='stable')
+        self.sorted_timestamps = self.timestamps[self.order]
+
+    def __len__(self):
+        return len(self.sorted_timestamps)
+
+    def _to_original(self, sorted_ids, queries):
+        ids = np.where(sorted_ids >= 0, self.order[np.maximum(sorted_ids, 0)], -1)
+        if np.ndim(queries) == 0:
+            return int(ids)
+        return ids
+
+    def nearest(self, queries):
+        """Id of the closest timestamp (the earlier one on ties)."""
+        assert len(self) > 0
+        q = np.asarray(queries, dtype=np.int64)
+        n = len(self)
+        pos = np.searchsorted(self.sorted_timestamps, q, side='left')
+        before = np.clip(pos - 1, 0, n - 1)
+        after = np.clip(pos, 0, n - 1)
+        pick_after = (np.abs(self.sorted_timestamps[after] - q) <
+                      np.abs(q - self.sorted_timestamps[before]))
+        return self._to_original(np.where(pick_after, after, before), queries)
+
+    def bracket(self, queries):
+        """Ids (before, after) of the timestamps surrounding each query.
+
+        before is the last timestamp <= query and after the first timestamp
+        >= query, so both are equal on an exact match.
+        """
+        q = np.asarray(queries, dtype=np.int64)
+        n = len(self)
+        before = np.searchsorted(self.sorted_timestamps, q, side='right') - 1
+        after = np.searchsorted(self.sorted_timestamps, q, side='left')
+        after = np.where(after < n, after, -1)
+        return self._to_original(before, queries), self._to_original(after, queries)
+
+    def within(self, queries, tolerance):
+        """Id of the closest timestamp if it is at most tolerance away, else -1."""
+        ids = np.asarray(self.nearest(queries))
+        q = np.asarray(queries, dtype=np.int64)
+        ids = np.where(np.abs(self.timestamps[ids] - q) <= tolerance, ids, -1)
+        if np.ndim(queries) == 0:
+            return int(ids)
+        return ids
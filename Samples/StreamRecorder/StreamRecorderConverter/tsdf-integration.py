@@ -7,30 +7,111 @@
  PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
 """
 import argparse
+import time
+from collections import deque
+from concurrent.futures import ThreadPoolExecutor
+from itertools import islice
 from pathlib import Path
 
+import cv2
 import numpy as np
-import open3d as o3d
 
-from utils import DEPTH_SCALING_FACTOR
+from native_kernels import has_native_kernels, TsdfVolume
+from select_keyframes import KeyframeSelector, add_keyframe_arguments, save_keyframe_lists
+from utils import DEPTH_SCALING_FACTOR, load_image_list, load_odometry
 
+# Depths beyond this distance (meters) are not integrated
+DEPTH_TRUNC = 7.8
 
-if __name__ == '__main__':
-    parser = argparse.ArgumentParser(description='TSDF-Integration with open3d')
-    parser.add_argument("--pinhole_path",
-                        required=True,
-                        help="Path to folder inside recording containing pinhole projected images "
-                        "recordings")
 
-    parser.add_argument("--voxel_size",
-                        required=False,
-                        default=0.04,
-                        type=float,
-                        help="Voxel size to use for tsdf integration."
-                        "Bigger values results in denser but slower reconstructions.")
+def load_frames(pinhole_path, rgb_files, depth_files, num_workers=4):
+    """Yield (rgb, depth) pairs as read by opencv, decoding the next frames on
+    a thread pool while the current one is integrated. At most 2 * num_workers
+    frames are decoded ahead, so memory does not grow with the recording length
+    when decoding is faster than integration."""
+    def read(paths):
+        rgb_file, depth_file = paths
+        return (cv2.imread(str(pinhole_path / rgb_file), cv2.IMREAD_COLOR),
+                cv2.imread(str(pinhole_path / depth_file), cv2.IMREAD_UNCHANGED))
+
+    frame_paths = zip(rgb_files, depth_files)
+    with ThreadPoolExecutor(max_workers=num_workers) as executor:
+        pending = deque(executor.submit(read, paths)
+                        for paths in islice(frame_paths, 2 * num_workers))
+        while pending:
+            frame = pending.popleft().result()
+            # One more frame is submitted as each one is handed out
+            paths = next(frame_paths, None)
+            if paths is not None:
+                pending.append(executor.submit(read, paths))
+            yield frame
+
+
+def save_mesh(volume, pinhole_path, target_triangles=0, num_threads=0):
+    """Extract the mesh of the volume and write it to tsdf-mesh.ply."""
+    mesh_path = pinhole_path / 'tsdf-mesh.ply'
+    volume.extract_mesh(target_triangles, num_threads, copy=False)
+    volume.write_mesh(mesh_path)
+    return mesh_path
+
+
+def integrate_native(pinhole_path, voxel_size, mesh_every=0, num_threads=0, selector=None,
+                     target_triangles=0):
+    """Integrate the pinhole projected frames with the native TSDF volume.
+
+    With mesh_every > 0 the mesh is saved every mesh_every frames; extraction
+    is incremental, only the voxel blocks touched since the previous one are
+    meshed again. With a KeyframeSelector, only keyframes are integrated.
+    With target_triangles > 0 the saved meshes are simplified to that budget.
+    """
+    poses = load_odometry(pinhole_path / 'odometry.log')
+    intrinsics = np.loadtxt(str(pinhole_path / 'calibration.txt'))
+    rgb_files = [path for _, path in load_image_list(pinhole_path / 'rgb.txt')]
+    depth_files = [path for _, path in load_image_list(pinhole_path / 'depth.txt')]
+    frame_count = min(len(poses), len(rgb_files), len(depth_files))
+    print(f"Integrating {frame_count} images")
+
+    # truncation value is set at 3x voxel size
+    volume = TsdfVolume(voxel_size, voxel_size * 3)
+    start = time.time()
+    frames = load_frames(pinhole_path, rgb_files[:frame_count], depth_files[:frame_count])
+    keyframes = []
+    for i, (rgb, depth) in enumerate(frames):
+        if selector is not None and not selector.is_keyframe(poses[i], depth):
+            continue
+        keyframes.append(i)
+        volume.integrate(depth, rgb, intrinsics, poses[i], DEPTH_SCALING_FACTOR, DEPTH_TRUNC,
+                         bgr=True, num_threads=num_threads)
+        print(".", end="", flush=True)
+        if mesh_every > 0 and len(keyframes) % mesh_every == 0:
+            save_mesh(volume, pinhole_path, target_triangles, num_threads)
+    print("\n")
+    elapsed = time.time() - start
+    print(f"Processed {frame_count} frames in {elapsed:.1f}s ({frame_count / max(elapsed, 1e-6):.1f} fps), "
+          f"integrated {len(keyframes)}, {len(volume)} voxel blocks")
+    if selector is not None:
+        print(selector.report())
+        save_keyframe_lists(pinhole_path, keyframes)
+
+    # The vertices of the full resolution mesh are the zero crossings of the volume
+    start = time.time()
+    volume.extract_mesh(num_threads=num_threads, copy=False)
+    pc_path = pinhole_path / 'tsdf-pc.ply'
+    print(f"Saving point cloud to {pc_path}")
+    volume.write_mesh(pc_path, triangles=False)
+
+    print(f"Saving mesh to {pinhole_path / 'tsdf-mesh.ply'}")
+    if target_triangles > 0:
+        save_mesh(volume, pinhole_path, target_triangles, num_threads)
+    else:
+        volume.write_mesh(pinhole_path / 'tsdf-mesh.ply')
+    print(f"Mesh extraction took {time.time() - start:.1f}s")
+    return pc_path
+
+
+def integrate_open3d(pinhole_path, voxel_size, selector=None, target_triangles=0):
+    import open3d as o3d
 
-    args = parser.parse_args()
-    pinhole_path = Path(args.pinhole_path)
     # WARNING: in read_pinhole_camera_trajectory extrinsic gets inverted!
     trajectory = o3d.io.read_pinhole_camera_trajectory(
         str(pinhole_path / 'odometry.log'))
@@ -42,10 +123,10 @@ if __name__ == '__main__':
         o3d_integration = o3d.integration
     else:
         o3d_integration = o3d.pipelines.integration
-        
+
     volume = o3d_integration.ScalableTSDFVolume(
-        voxel_length=args.voxel_size,
-        sdf_trunc=args.voxel_size*3,  # truncation value is set at 3x voxel size
+        voxel_length=voxel_size,
+        sdf_trunc=voxel_size*3,  # truncation value is set at 3x voxel size
         color_type=o3d_integration.TSDFVolumeColorType.RGB8)
     #   color_type=o3d.integration.TSDFVolumeColorType.NoColor)
 
@@ -56,6 +137,7 @@ if __name__ == '__main__':
 
     intrinsic_np = np.loadtxt(str(intrinsic_path))
 
+    keyframes = []
     with open(str(rgb_file_list)) as rf, open(str(depth_file_list)) as df:
         i = 0
         while True:
@@ -70,6 +152,11 @@ if __name__ == '__main__':
             color = o3d.io.read_image(rgb_path)
             depth = o3d.io.read_image(depth_path)
             depth_np = np.asarray(depth)
+            if selector is not None and not selector.is_keyframe(
+                    np.linalg.inv(trajectory.parameters[i].extrinsic), depth_np):
+                i = i + 1
+                continue
+            keyframes.append(i)
             intrinsic = o3d.camera.PinholeCameraIntrinsic(
                 depth_np.shape[1], depth_np.shape[0],
                 intrinsic_np[0], intrinsic_np[1],
@@ -77,15 +164,20 @@ if __name__ == '__main__':
             rgbd = o3d.geometry.RGBDImage.create_from_color_and_depth(
                 color, depth,
                 depth_scale=DEPTH_SCALING_FACTOR,
-                depth_trunc=7.8, convert_rgb_to_intensity=False)
+                depth_trunc=DEPTH_TRUNC, convert_rgb_to_intensity=False)
             volume.integrate(
                 rgbd,
                 intrinsic,
                 trajectory.parameters[i].extrinsic)
             i = i + 1
     print("\n")
+    if selector is not None:
+        print(selector.report())
+        save_keyframe_lists(pinhole_path, keyframes)
 
     mesh = volume.extract_triangle_mesh()
+    if target_triangles > 0:
+        mesh = mesh.simplify_quadric_decimation(target_triangles)
     mesh.compute_vertex_normals()
     mesh_path = str(pinhole_path / 'tsdf-mesh.ply')
     print(f"Saving mesh to {mesh_path}")
@@ -96,5 +188,70 @@ if __name__ == '__main__':
     pc_path = str(pinhole_path / 'tsdf-pc.ply')
     print(f"Saving point cloud to {pc_path}")
     o3d.io.write_point_cloud(pc_path, pc)
+    return pc_path
+
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(description='TSDF-Integration')
+    parser.add_argument("--pinhole_path",
+                        required=True,
+                        help="Path to folder inside recording containing pinhole projected images "
+                        "recordings")
+
+    parser.add_argument("--voxel_size",
+                        required=False,
+                        default=0.04,
+                        type=float,
+                        help="Voxel size to use for tsdf integration."
+                        "Bigger values results in denser but slower reconstructions.")
+    parser.add_argument("--mesh_every",
+                        required=False,
+                        default=0,
+                        type=int,
+                        help="Also save the mesh every N frames (native volume only)")
+    parser.add_argument("--target_triangles",
+                        required=False,
+                        default=0,
+                        type=int,
+                        help="Simplify the mesh to at most this many triangles with quadric error "
+                        "metrics, 0 to keep the full resolution mesh")
+    parser.add_argument("--num_threads",
+                        required=False,
+                        default=0,
+                        type=int,
+                        help="Integration threads, 0 for one per core (native volume only)")
+    parser.add_argument("--use_open3d",
+                        required=False,
+                        action='store_true',
+                        help="Integrate with open3d, even if the native kernels are built")
+    parser.add_argument("--keyframes",
+                        required=False,
+                        action='store_true',
+                        help="Only integrate keyframes, selected from the pose change and the depth "
+                        "overlap with the previous keyframe, and save their lists next to the full ones")
+    add_keyframe_arguments(parser)
+    parser.add_argument("--no_visualization",
+                        required=False,
+                        action='store_true',
+                        help="Do not show the point cloud at the end")
+
+    args = parser.parse_args()
+    pinhole_path = Path(args.pinhole_path)
+    selector = None
+    if args.keyframes:
+        selector = KeyframeSelector(np.loadtxt(str(pinhole_path / 'calibration.txt')),
+                                    args.max_translation, args.max_rotation, args.min_overlap,
+                                    DEPTH_SCALING_FACTOR, DEPTH_TRUNC)
+    if has_native_kernels() and not args.use_open3d:
+        pc_path = integrate_native(pinhole_path, args.voxel_size, args.mesh_every, args.num_threads, selector,
+                                   args.target_triangles)
+    else:
+        pc_path = integrate_open3d(pinhole_path, args.voxel_size, selector, args.target_triangles)
 
-    o3d.visualization.draw_geometries([pc])
+    if not args.no_visualization:
+        try:
+            import open3d as o3d
+        except ImportError:
+            o3d = None
+        if o3d is not None:
+            o3d.visualization.draw_geometries([o3d.io.read_point_cloud(str(pc_path))])
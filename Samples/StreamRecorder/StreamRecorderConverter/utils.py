@@ -7,11 +7,14 @@
  PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
 """
 import tarfile
+import warnings
 
-import numpy as np
 import cv2
+import numpy as np
 
 from hand_defs import HandJointIndex
+from native_kernels import zbuffer_splat
+from tar_reader import frame_timestamp, open_frame_reader
 
 # Depth values are saved inside a 16bit png with the following scaling factor
 # This correponds to the scaling factor used by the TUM slam dataset:w
@@ -26,6 +29,72 @@ folders_extensions = [('PV', 'bytes'),
                       ('VLC RR', '[0-9].pgm')]
 
 
+# Image formats written by convert_images, in order of preference
+pv_image_extensions = ['png', 'jpg']
+# Single video written by convert_images --codec video, with the timestamps of its frames
+pv_video_name = 'PV.avi'
+pv_video_timestamps_name = 'PV_timestamps.txt'
+
+
+class PVImages(object):
+    """The PV frames converted by convert_images: one image file per frame,
+    or a single video whose frame timestamps are listed in a side file.
+
+    Video frames are decoded on demand; reading them in timestamp order
+    avoids seeking in the video.
+    """
+
+    def __init__(self, folder):
+        pv_folder = folder / 'PV'
+        self.paths = {}
+        self.video_path = None
+        self.frame_ids = {}
+        for ext in pv_image_extensions:
+            paths = sorted(pv_folder.glob('*.{}'.format(ext)))
+            if paths:
+                self.paths = {int(path.stem): path for path in paths}
+                break
+        timestamps_path = pv_folder / pv_video_timestamps_name
+        if not self.paths and (pv_folder / pv_video_name).exists() and timestamps_path.exists():
+            self.video_path = pv_folder / pv_video_name
+            timestamps = np.loadtxt(str(timestamps_path), dtype=np.int64, ndmin=1)
+            self.frame_ids = {int(timestamp): i for i, timestamp in enumerate(timestamps)}
+        self.capture = None
+        self.next_frame_id = 0
+
+    def timestamps(self):
+        return sorted(self.paths or self.frame_ids)
+
+    def source_path(self, timestamp):
+        """File holding the frame (its image, or the video), None when it is missing."""
+        if timestamp in self.paths:
+            return self.paths[timestamp]
+        if timestamp in self.frame_ids:
+            return self.video_path
+        return None
+
+    def read(self, timestamp):
+        """BGR image of the frame, None when it is missing."""
+        if timestamp in self.paths:
+            return cv2.imread(str(self.paths[timestamp]))
+        frame_id = self.frame_ids.get(timestamp)
+        if frame_id is None:
+            return None
+        if self.capture is None:
+            self.capture = cv2.VideoCapture(str(self.video_path))
+            self.next_frame_id = 0
+        if frame_id != self.next_frame_id:
+            self.capture.set(cv2.CAP_PROP_POS_FRAMES, frame_id)
+        ok, image = self.capture.read()
+        self.next_frame_id = frame_id + 1
+        return image if ok else None
+
+    def close(self):
+        if self.capture is not None:
+            self.capture.release()
+            self.capture = None
+
+
 def extract_tar_file(tar_filename, output_path):
     tar = tarfile.open(tar_filename)
     tar.extractall(output_path)
@@ -39,6 +108,45 @@ def load_lut(lut_filename):
     return lut
 
 
+# Binary IMU streams written by RMImuReader (<sensor>_imu.bin): a 16 bytes header
+# followed by one 40 bytes record per sample, see RMImuReader.h
+IMU_MAGIC = b'RMIM'
+IMU_SENSOR_TYPES = {6: 'accel', 7: 'gyro', 8: 'mag'}
+imu_header_dtype = np.dtype([('magic', 'S4'), ('version', '<u4'),
+                             ('sensor_type', '<u4'), ('record_size', '<u4')])
+imu_record_dtype = np.dtype([('timestamp', '<i8'),
+                             ('soc_ticks', '<u8'),
+                             ('vinyl_hup_ticks', '<u8'),
+                             ('values', '<f4', (3,)),
+                             ('temperature', '<f4')])
+
+
+def load_imu(imu_path, mmap=False):
+    """All the samples of an IMU stream as a structured array, sorted by timestamp.
+
+    Fields are timestamp (absolute hundreds of ns, as the frame names), soc_ticks,
+    vinyl_hup_ticks (IMU clock, ns), values (x, y, z: m/s^2, rad/s or gauss) and
+    temperature (0 for the magnetometer). The whole file is read in one go, or
+    memory mapped with mmap. Returns (sensor name, samples).
+    """
+    header = np.fromfile(str(imu_path), dtype=imu_header_dtype, count=1)
+    if len(header) == 0 or header['magic'][0] != IMU_MAGIC:
+        raise ValueError('{} is not an IMU stream'.format(imu_path))
+    if header['record_size'][0] != imu_record_dtype.itemsize:
+        raise ValueError('Unsupported IMU record size {} in {}'.format(header['record_size'][0], imu_path))
+
+    if mmap:
+        samples = np.memmap(str(imu_path), dtype=imu_record_dtype, mode='r',
+                            offset=imu_header_dtype.itemsize)
+    else:
+        samples = np.fromfile(str(imu_path), dtype=imu_record_dtype,
+                              offset=imu_header_dtype.itemsize)
+    # Batches are written in order, only sort when needed
+    if len(samples) > 1 and np.any(np.diff(samples['timestamp']) < 0):
+        samples = samples[np.argsort(samples['timestamp'], kind='stable')]
+    return IMU_SENSOR_TYPES.get(int(header['sensor_type'][0]), 'unknown'), samples
+
+
 def check_framerates(capture_path):
     HundredsOfNsToMilliseconds = 1e-4
     MillisecondsToSeconds = 1e-3
@@ -51,11 +159,23 @@ def check_framerates(capture_path):
         base_folder = capture_path / img_folder
         paths = base_folder.glob('*%s' % img_ext)
         timestamps = [int(path.stem) for path in paths]
+        if not timestamps:
+            # Not extracted, read the frame names from the tarball
+            reader = open_frame_reader(capture_path, img_folder)
+            if reader is not None:
+                timestamps = [frame_timestamp(name) for name in reader.names('*%s' % img_ext)]
         if len(timestamps):
             avg_delta = get_avg_delta(timestamps) * HundredsOfNsToMilliseconds
             print('Average {} delta: {:.3f}ms, fps: {:.3f}'.format(
                 img_folder, avg_delta, 1/(avg_delta * MillisecondsToSeconds)))
 
+    for imu_path in sorted(capture_path.glob('*_imu.bin')):
+        sensor, samples = load_imu(imu_path, mmap=True)
+        if len(samples) > 1:
+            avg_delta = np.mean(np.diff(samples['timestamp'])) * HundredsOfNsToMilliseconds
+            print('Average {} delta: {:.3f}ms, rate: {:.1f}Hz'.format(
+                sensor, avg_delta, 1/(avg_delta * MillisecondsToSeconds)))
+
     head_hat_stream_path = capture_path.glob('*eye.csv')
     try:
         head_hat_stream_path = next(head_hat_stream_path)
@@ -67,54 +187,74 @@ def check_framerates(capture_path):
         pass
 
 
+def load_csv_records(csv_path, fields, skiprows=0):
+    """Parse a whole csv file into a structured array, sorted by its 'timestamp' field.
+
+    Parsing happens in numpy's C reader; with an int64 timestamp field the
+    timestamps (hundreds of ns) do not go through float64 and keep full precision.
+    """
+    with warnings.catch_warnings():
+        # empty recordings are not an error
+        warnings.simplefilter('ignore', UserWarning)
+        records = np.loadtxt(str(csv_path), delimiter=',', dtype=fields,
+                             skiprows=skiprows, ndmin=1)
+    return records[np.argsort(records['timestamp'], kind='stable')]
+
+
 def load_head_hand_eye_data(csv_path):
     joint_count = HandJointIndex.Count.value
 
-    data = np.loadtxt(csv_path, delimiter=',')
-
-    n_frames = len(data)
-    timestamps = np.zeros(n_frames)
-    head_transs = np.zeros((n_frames, 3))
-
-    left_hand_transs = np.zeros((n_frames, joint_count, 3))
-    left_hand_transs_available = np.ones(n_frames, dtype=bool)
-    right_hand_transs = np.zeros((n_frames, joint_count, 3))
-    right_hand_transs_available = np.ones(n_frames, dtype=bool)
-
-    # origin (vector, homog) + direction (vector, homog) + distance (scalar)
-    gaze_data = np.zeros((n_frames, 9))
-    gaze_available = np.ones(n_frames, dtype=bool)
-
-    for i_frame, frame in enumerate(data):
-        timestamps[i_frame] = frame[0]
-        # head
-        head_transs[i_frame, :] = frame[1:17].reshape((4, 4))[:3, 3]
-        # left hand
-        left_hand_transs_available[i_frame] = (frame[17] == 1)
-        left_start_id = 18
-        for i_j in range(joint_count):
-            j_start_id = left_start_id + 16 * i_j
-            j_trans = frame[j_start_id:j_start_id + 16].reshape((4, 4))[:3, 3]
-            left_hand_transs[i_frame, i_j, :] = j_trans
-        # right hand
-        right_hand_transs_available[i_frame] = (
-            frame[left_start_id + joint_count * 4 * 4] == 1)
-        right_start_id = left_start_id + joint_count * 4 * 4 + 1
-        for i_j in range(joint_count):
-            j_start_id = right_start_id + 16 * i_j
-            j_trans = frame[j_start_id:j_start_id + 16].reshape((4, 4))[:3, 3]
-            right_hand_transs[i_frame, i_j, :] = j_trans
-
-        assert(j_start_id + 16 == 851)
-        gaze_available[i_frame] = (frame[851] == 1)
-        gaze_data[i_frame, :4] = frame[852:856]
-        gaze_data[i_frame, 4:8] = frame[856:860]
-        gaze_data[i_frame, 8] = frame[860]
+    # Row format is
+    # timestamp, head transform (4x4),
+    # left hand available, left joint transforms (joint_count x 4x4),
+    # right hand available, right joint transforms (joint_count x 4x4),
+    # gaze available, origin (vector, homog) + direction (vector, homog) + distance (scalar)
+    hand_fields = [('available', np.float64), ('joints', np.float64, (joint_count, 4, 4))]
+    data = load_csv_records(csv_path, [('timestamp', np.int64),
+                                       ('head', np.float64, (4, 4)),
+                                       ('left', hand_fields),
+                                       ('right', hand_fields),
+                                       ('gaze_available', np.float64),
+                                       ('gaze', np.float64, (9,))])
+
+    timestamps = data['timestamp']
+    head_transs = data['head'][:, :3, 3]
+
+    left_hand_transs = data['left']['joints'][:, :, :3, 3]
+    left_hand_transs_available = data['left']['available'] == 1
+    right_hand_transs = data['right']['joints'][:, :, :3, 3]
+    right_hand_transs_available = data['right']['available'] == 1
+
+    gaze_data = data['gaze']
+    gaze_available = data['gaze_available'] == 1
 
     return (timestamps, head_transs, left_hand_transs, left_hand_transs_available,
             right_hand_transs, right_hand_transs_available, gaze_data, gaze_available)
 
 
+def pinhole_to_pixel_ids(points, focal_length, principal_point, width, height,
+                         mirror_x=False, rounding=np.floor):
+    """Project camera space points on a pinhole camera without distortion.
+
+    Returns the linear pixel id (y * width + x) of every point, -1 for points
+    behind the camera or outside the image. With mirror_x, x is flipped around
+    the principal point, as for PV images.
+    """
+    z = points[:, 2]
+    in_front = z > 0
+    safe_z = np.where(in_front, z, 1.)
+    x = focal_length[0] * points[:, 0] / safe_z
+    x = principal_point[0] - x if mirror_x else principal_point[0] + x
+    y = focal_length[1] * points[:, 1] / safe_z + principal_point[1]
+    x = rounding(x)
+    y = rounding(y)
+
+    valid = in_front & (0 <= x) & (x < width) & (0 <= y) & (y < height)
+    pixel_ids = np.full(len(points), -1, dtype=np.int64)
+    pixel_ids[valid] = y[valid].astype(np.int64) * width + x[valid].astype(np.int64)
+    return pixel_ids
+
+
 def project_on_pv(points, pv_img, pv2world_transform, focal_length, principal_point):
     height, width, _ = pv_img.shape
 
@@ -122,54 +262,46 @@ def project_on_pv(points, pv_img, pv2world_transform, focal_length, principal_po
     world2pv_transform = np.linalg.inv(pv2world_transform)
     points_pv = (world2pv_transform @ homog_points.T).T[:, :3]
 
-    intrinsic_matrix = np.array([[focal_length[0], 0, width-principal_point[0]], [
-        0, focal_length[1], principal_point[1]], [0, 0, 1]])
-    rvec = np.zeros(3)
-    tvec = np.zeros(3)
-    xy, _ = cv2.projectPoints(points_pv, rvec, tvec, intrinsic_matrix, None)
-    xy = np.squeeze(xy)
-    xy[:, 0] = width - xy[:, 0]
-    xy = np.floor(xy).astype(int)
+    # PV images are mirrored along x
+    pixel_ids = pinhole_to_pixel_ids(points_pv, focal_length, principal_point,
+                                     width, height, mirror_x=True, rounding=np.floor)
+    depth_image, _ = zbuffer_splat(pixel_ids, points_pv[:, 2], height, width)
 
     rgb = np.zeros_like(points)
-    width_check = np.logical_and(0 <= xy[:, 0], xy[:, 0] < width)
-    height_check = np.logical_and(0 <= xy[:, 1], xy[:, 1] < height)
-    valid_ids = np.where(np.logical_and(width_check, height_check))[0]
-
-    z = points_pv[valid_ids, 2]
-    xy = xy[valid_ids, :]
-
-    depth_image = np.zeros((height, width))
-    for i, p in enumerate(xy):
-        depth_image[p[1], p[0]] = z[i]
-
-    colors = pv_img[xy[:, 1], xy[:, 0], :]
+    valid_ids = np.flatnonzero(pixel_ids >= 0)
+    colors = pv_img.reshape((-1, 3))[pixel_ids[valid_ids]]
     rgb[valid_ids, :] = colors[:, ::-1] / 255.
 
     return rgb, depth_image
 
 
 def project_on_depth(points, rgb, intrinsic_matrix, width, height):
-    rvec = np.zeros(3)
-    tvec = np.zeros(3)
-    xy, _ = cv2.projectPoints(points, rvec, tvec, intrinsic_matrix, None)
-    xy = np.squeeze(xy)
-    xy = np.around(xy).astype(int)
-
-    width_check = np.logical_and(0 <= xy[:, 0], xy[:, 0] < width)
-    height_check = np.logical_and(0 <= xy[:, 1], xy[:, 1] < height)
-    valid_ids = np.where(np.logical_and(width_check, height_check))[0]
-    xy = xy[valid_ids, :]
-
-    z = points[valid_ids, 2]
-    depth_image = np.zeros((height, width))
+    focal_length = (intrinsic_matrix[0, 0], intrinsic_matrix[1, 1])
+    principal_point = (intrinsic_matrix[0, 2], intrinsic_matrix[1, 2])
+    pixel_ids = pinhole_to_pixel_ids(points, focal_length, principal_point,
+                                     width, height, rounding=np.around)
+    depth_image, winners = zbuffer_splat(pixel_ids, points[:, 2], height, width)
+
+    # Color of the nearest point on every pixel
     image = np.zeros((height, width, 3))
-    rgb = rgb[valid_ids, :]
-    rgb = rgb[:, ::-1]
-    for i, p in enumerate(xy):
-        depth_image[p[1], p[0]] = z[i]
-        image[p[1], p[0]] = rgb[i]
+    visible = winners >= 0
+    image[visible] = rgb[winners[visible], ::-1]
 
     image = image * 255.
 
     return image, depth_image
+
+
+def load_odometry(odometry_path):
+    """cam2world poses of a pinhole projection odometry.log, as written by
+    save_pclouds.py: one 'i i i' line followed by the 4 rows of the transform per frame."""
+    with open(str(odometry_path)) as f:
+        lines = [line.split() for line in f if line.strip()]
+    rows = [row for i, row in enumerate(lines) if i % 5 != 0]
+    return np.array(rows, dtype=np.float64).reshape((-1, 4, 4))
+
+
+def load_image_list(list_path):
+    """(timestamp, relative path) entries of a pinhole projection rgb.txt or depth.txt."""
+    with open(str(list_path)) as f:
+        return [tuple(line.split()[:2]) for line in f if line.strip()]